@@ -4,9 +4,12 @@
 #include "freertos/task.h"
 #include "driver/i2c.h"
 #include "driver/gpio.h"
+#include "nvs_flash.h"
 
 #include "sbs_smb.h"
 #include "sbs_bq.h"
+#include "sbs_profile.h"
+#include "sbs_profile_nvs.h"
 
 #define I2C_PORT        I2C_NUM_0
 #define SDA_PIN         10
@@ -16,6 +19,10 @@
 
 sbs_smb_battery_t battery;
 
+// Profiles of the batteries seen so far, kept in NVS so a known battery is never probed again
+sbs_profile_t profiles[8];
+sbs_profile_store_t profileStore;
+
 // scan for devices present on the bus. A smart battery typically appears at address 0x0B
 int I2CTest()
 {
@@ -55,30 +62,34 @@ void app_main(void)
   uint16_t fullAccessKey2[] = {0xFFFF, 0xFFFF};
 
   int ret;
+  sbs_profile_t *profile;
 
-  if((ret = SBSBqAccessSha1Hmac(&battery, SBS_BQ_COMMAND_UNSEAL_DEVICE, unsealKey)) == SMBUS_ERR_OK)
-  {
-    printf("Unsealed with SBSBqAccessSha1Hmac()\n");
-    if ((ret = SBSBqAccessSha1Hmac(&battery, SBS_BQ_COMMAND_FULL_ACCESS_DEVICE, fullAccessKey)) == SMBUS_ERR_OK)
-      printf("Full Access obtained with SBSBqAccessSha1Hmac()\n");
-    else
-      printf("Error %d. Could not obtain Full Access\n", ret);
+  nvs_flash_init();
+  SBSProfileStoreInit(&profileStore, profiles, sizeof(profiles) / sizeof(profiles[0]));
+  if ((ret = SBSProfileNvsLoad(&profileStore)) != SMBUS_ERR_OK)
+    printf("Error %d. Starting with no saved profiles\n", ret);
 
-    if ((ret = SBSBqSeal(&battery)) == SMBUS_ERR_OK)
-      printf("Device sealed successfully!");
-    else
-      printf("Error %d. Device sealing failed!", ret);
-  }
-  else
-  if ((ret = SBSBqAccess2WordKey(&battery, SBS_BQ_COMMAND_UNSEAL_DEVICE, unsealKey2)) == SMBUS_ERR_OK)
+  if ((ret = SBSProfileGet(&battery, &profileStore, &profile)) != SMBUS_ERR_OK)
+    while (1)
+    {
+      printf("Error %d. Could not identify the battery!\n", ret);
+      vTaskDelay(pdMS_TO_TICKS(3000));
+    }
+
+  printf("Battery %u: PEC %s, MAC %s, DeviceType 0x%04X\n", profile->serialNumber, profile->pec ? "yes" : "no",
+         (profile->mac == SBS_PROFILE_MAC_BLOCK_ACCESS) ? "ManufacturerBlockAccess()" :
+         (profile->mac == SBS_PROFILE_MAC_ACCESS) ? "ManufacturerAccess()" : "none", profile->deviceType);
+
+  // Only the first unseal of a battery tries both methods, after that the profile knows which one works
+  if ((ret = SBSProfileAccess(&battery, profile, SBS_BQ_COMMAND_UNSEAL_DEVICE, unsealKey, unsealKey2)) == SMBUS_ERR_OK)
   {
-    printf("Unsealed with SBSBqAccess2WordKey()\n");
-    if ((ret = SBSBqAccess2WordKey(&battery, SBS_BQ_COMMAND_FULL_ACCESS_DEVICE, fullAccessKey2) == SMBUS_ERR_OK))
-      printf("Full Access obtained with SBSBqAccess2WordKey()\n");
+    printf("Unsealed with %s\n", (profile->auth == SBS_PROFILE_AUTH_SHA1_HMAC) ? "SHA1 HMAC" : "the two-word key");
+    if ((ret = SBSProfileAccess(&battery, profile, SBS_BQ_COMMAND_FULL_ACCESS_DEVICE, fullAccessKey, fullAccessKey2)) == SMBUS_ERR_OK)
+      printf("Full Access obtained\n");
     else
       printf("Error %d. Could not obtain Full Access\n", ret);
 
-    if ((ret = SBSBqSeal(&battery)) == SMBUS_ERR_OK)
+    if ((ret = SBSProfileSeal(&battery, profile)) == SMBUS_ERR_OK)
       printf("Device sealed successfully!");
     else
       printf("Error %d. Device sealing failed!", ret);
@@ -86,6 +97,9 @@ void app_main(void)
   else
     printf("Error %d. Unseal failed\n", ret);
 
+  if ((ret = SBSProfileNvsSave(&profileStore)) != SMBUS_ERR_OK)
+    printf("Error %d. Could not save the battery profiles\n", ret);
+
   while (1)
   {
     vTaskDelay(pdMS_TO_TICKS(3000));
@@ -0,0 +1,174 @@
+/**
+ *
+ * @file:   sbs_bqfs_play.c - Programs a gauge from a TI .bq.fs/.df.fs flash stream file
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * Files are memory mapped and played straight from the mapping, "-" streams the script from stdin instead.
+ * Either way the parser only ever holds one command.
+ *
+ *  sbs_bqfs_play -b /dev/i2c-1 -r firmware.bq.fs     unseal first, then enter ROM mode and program the gauge at 0x0B
+ *  sbs_bqfs_play -n firmware.bq.fs                   only check that the file parses
+ *
+ * */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sbs_smb.h"
+#include "sbs_bq.h"
+#include "sbs_bqfs.h"
+
+#define STREAM_CHUNK                4096
+
+static uint64_t NowMs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Parse and play a script read from a file descriptor a chunk at a time
+static int PlayStream(sbs_bqfs_player_t *player, int fd, bool dryRun)
+{
+  char chunk[STREAM_CHUNK];
+  sbs_bqfs_parser_t parser;
+  sbs_bqfs_cmd_t cmd;
+  ssize_t len;
+  int ret;
+
+  SBSBqfsParserInit(&parser);
+
+  do
+  {
+    len = read(fd, chunk, sizeof(chunk));
+    if (len < 0)
+      return SMBUS_ERR_FAIL;
+
+    // A read of 0 bytes is the end of the script, which parses the last line if it has no line break
+    size_t offset = 0;
+    do
+    {
+      size_t consumed;
+      ret = SBSBqfsParse(&parser, chunk + offset, len - offset, &consumed, &cmd);
+      if (ret != SMBUS_ERR_OK)
+      {
+        player->line = parser.line;
+        return ret;
+      }
+      offset += consumed;
+
+      if (dryRun)
+      {
+        player->line = cmd.type ? cmd.line : player->line;
+        player->writes += (cmd.type == SBS_BQFS_CMD_WRITE);
+        player->compares += (cmd.type == SBS_BQFS_CMD_COMPARE);
+        player->waitMs += (cmd.type == SBS_BQFS_CMD_WAIT) ? cmd.waitMs : 0;
+      }
+      else if ((ret = SBSBqfsPlayerRun(player, &cmd)) != SMBUS_ERR_OK)
+        return ret;
+    }while (offset < (size_t)len);
+  }while (len > 0);
+
+  if (!dryRun)
+    SBSBqfsPlayerFinish(player);
+  return SMBUS_ERR_OK;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *port = "sim";
+  uint8_t address = 0x0B;
+  bool romMode = false;
+  bool dryRun = false;
+  int pollMs = -1;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:a:p:rn")) != -1)
+  {
+    switch (opt)
+    {
+      case 'b': port = optarg;                          break;
+      case 'a': address = strtoul(optarg, NULL, 0);     break;
+      case 'p': pollMs = atoi(optarg);                  break;
+      case 'r': romMode = true;                         break;
+      case 'n': dryRun = true;                          break;
+      default:
+        optind = argc;
+        break;
+    }
+  }
+
+  if (optind >= argc)
+  {
+    fprintf(stderr, "Usage: %s [-b <i2c device>] [-a <gauge address>] [-p <poll ms>] [-r] [-n] <file | ->\n", argv[0]);
+    return 1;
+  }
+
+  sbs_smb_battery_t battery = { .busAddress = address };
+  sbs_bqfs_player_t player;
+
+  if (!dryRun)
+  {
+    // Flash stream commands carry no PEC
+    battery.bus = SMBusInit((void *)port, 0, 100000, -1, -1, -1, 1000, false);
+    if (!battery.bus)
+    {
+      fprintf(stderr, "Couldn't open %s\n", port);
+      return 1;
+    }
+  }
+
+  SBSBqfsPlayerInit(&player, &battery);
+  if (pollMs >= 0)
+    player.pollIntervalMs = pollMs;
+
+  if (romMode && !dryRun && SBSBqEnterRomMode(&battery) != SMBUS_ERR_OK)
+  {
+    fprintf(stderr, "Couldn't put the gauge at 0x%02X in ROM mode\n", address);
+    return 1;
+  }
+
+  uint64_t start = NowMs();
+  int ret;
+
+  if (!strcmp(argv[optind], "-"))
+    ret = PlayStream(&player, STDIN_FILENO, dryRun);
+  else
+  {
+    int fd = open(argv[optind], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+      fprintf(stderr, "Couldn't open %s\n", argv[optind]);
+      return 1;
+    }
+
+    // Fall back to reading the file if it can't be mapped, e.g. an empty file or a pipe
+    char *text = (dryRun || !st.st_size) ? MAP_FAILED : mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text == MAP_FAILED)
+      ret = PlayStream(&player, fd, dryRun);
+    else
+    {
+      ret = SBSBqfsPlay(&player, text, st.st_size);
+      munmap(text, st.st_size);
+    }
+    close(fd);
+  }
+
+  printf("%s at line %u: %u writes, %u compares, %u ms of waits of which %u ms skipped, %llu ms total\n",
+         (ret == SMBUS_ERR_OK) ? "done" : "failed", player.line, player.writes, player.compares,
+         player.waitMs, player.savedMs, (unsigned long long)(NowMs() - start));
+
+  if (battery.bus)
+    SMBusDeinit(battery.bus);
+  return (ret == SMBUS_ERR_OK) ? 0 : 1;
+}
@@ -0,0 +1,625 @@
+/**
+ *
+ * @file:   sbs_fleetd.c - Polls a fleet of smart batteries spread over several buses and muxes
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * Every bus gets its own worker thread since transfers on one bus can't overlap anyway, while
+ * transfers on different buses can. Each worker polls its batteries in mux order to keep channel
+ * switches to a minimum, then appends a telemetry frame per battery to the stream of its bus
+ * and publishes the decoded snapshot to shared memory for other local processes, see sbs_shmdump.c
+ *
+ * A throughput and latency report is printed every few seconds and once more on exit, e.g.
+ *
+ *  sbs_fleetd -c fleet.conf -o /var/run/sbs -m /sbs_fleet -r 5
+ *  sbs_fleetd -s 32:2:8:1 -d 30            simulated 32 buses, each with 2 muxes x 8 channels x 1 battery
+ *
+ * */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "sbs_smb.h"
+#include "sbs_mux.h"
+#include "sbs_telemetry.h"
+#include "sbs_shm.h"
+#include "smbus_sim.h"
+
+#define FLEET_MAX_BUSES             64
+#define FLEET_MAX_MUXES_PER_BUS     8
+#define FLEET_MAX_BATTERIES_PER_BUS 256     // Telemetry ids are 8 bits wide and unique per bus stream
+#define FLEET_MAX_NAME              32
+#define FLEET_MAX_LINE              256
+
+#define FLEET_DEFAULT_SPEED         100000
+#define FLEET_DEFAULT_TIMEOUT_MS    1000
+
+// Latency histogram: exact below 8us, then 8 linear steps per power of two i.e. within 12.5% of the real value
+#define HIST_SUB_BITS               3
+#define HIST_SUB_COUNT              (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS                (HIST_SUB_COUNT * 30)
+
+typedef struct
+{
+  uint64_t count;
+  uint64_t errors;
+  uint64_t maxUs;
+  uint32_t bucket[HIST_BUCKETS];
+} fleet_stats_t;
+
+typedef struct
+{
+  char name[FLEET_MAX_NAME];
+  char port[FLEET_MAX_LINE];
+  uint32_t speed;
+  bool usePec;
+  smbus_handle_t handle;
+
+  sbs_mux_t mux[FLEET_MAX_MUXES_PER_BUS];
+  uint8_t muxCount;
+
+  sbs_smb_battery_t *battery;
+  sbs_smb_battery_t **order;              // Polling order, sorted by mux and channel
+  sbs_telemetry_t *telemetry;
+  uint16_t batteryCount;
+
+  int outFd;
+  uint32_t shmSlot;                       // Shared memory slot of the first battery, the rest follow in order
+  pthread_t thread;
+
+  pthread_mutex_t statsLock;
+  fleet_stats_t window;                   // Since the last report
+  fleet_stats_t total;                    // Since start up
+} fleet_bus_t;
+
+typedef struct
+{
+  fleet_bus_t bus[FLEET_MAX_BUSES];
+  uint8_t busCount;
+  uint32_t intervalMs;                    // Start of one polling round to the start of the next, 0 to poll back to back
+  sbs_shm_t *shm;
+} fleet_t;
+
+static fleet_t fleet;
+static atomic_bool stopRequested;
+
+static void OnSignal(int sig)
+{
+  (void)sig;
+  atomic_store(&stopRequested, true);
+}
+
+static uint64_t NowUs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static uint16_t HistBucket(uint64_t us)
+{
+  if (us < HIST_SUB_COUNT)
+    return (uint16_t)us;
+
+  int msb = 63 - __builtin_clzll(us);
+  uint16_t bucket = (msb - HIST_SUB_BITS + 1) * HIST_SUB_COUNT + ((us >> (msb - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1));
+
+  return (bucket < HIST_BUCKETS) ? bucket : HIST_BUCKETS - 1;
+}
+
+// Upper bound of the values that fall into a bucket
+static uint64_t HistBucketLimit(uint16_t bucket)
+{
+  if (bucket < HIST_SUB_COUNT)
+    return bucket;
+
+  int msb = bucket / HIST_SUB_COUNT + HIST_SUB_BITS - 1;
+  uint64_t sub = bucket % HIST_SUB_COUNT;
+
+  return ((HIST_SUB_COUNT + sub + 1) << (msb - HIST_SUB_BITS)) - 1;
+}
+
+static uint64_t HistPercentile(const fleet_stats_t *stats, double percentile)
+{
+  if (!stats->count)
+    return 0;
+
+  uint64_t rank = (uint64_t)(stats->count * percentile / 100.0 + 0.5);
+  uint64_t seen = 0;
+
+  if (rank < 1)
+    rank = 1;
+
+  for (uint16_t i = 0; i < HIST_BUCKETS; i++)
+  {
+    seen += stats->bucket[i];
+    if (seen >= rank)
+      return (HistBucketLimit(i) < stats->maxUs) ? HistBucketLimit(i) : stats->maxUs;
+  }
+
+  return stats->maxUs;
+}
+
+static void StatsAdd(fleet_stats_t *stats, uint64_t us, bool failed)
+{
+  stats->count++;
+  stats->errors += failed;
+  stats->bucket[HistBucket(us)]++;
+  if (us > stats->maxUs)
+    stats->maxUs = us;
+}
+
+static void StatsMerge(fleet_stats_t *into, const fleet_stats_t *from)
+{
+  into->count += from->count;
+  into->errors += from->errors;
+  if (from->maxUs > into->maxUs)
+    into->maxUs = from->maxUs;
+  for (uint16_t i = 0; i < HIST_BUCKETS; i++)
+    into->bucket[i] += from->bucket[i];
+}
+
+static fleet_bus_t *FindBus(const char *name)
+{
+  for (uint8_t i = 0; i < fleet.busCount; i++)
+    if (!strcmp(fleet.bus[i].name, name))
+      return &fleet.bus[i];
+
+  return NULL;
+}
+
+static fleet_bus_t *AddBus(const char *name, const char *port, uint32_t speed, bool usePec)
+{
+  if (fleet.busCount >= FLEET_MAX_BUSES || FindBus(name))
+    return NULL;
+
+  fleet_bus_t *bus = &fleet.bus[fleet.busCount++];
+  snprintf(bus->name, sizeof(bus->name), "%s", name);
+  snprintf(bus->port, sizeof(bus->port), "%s", port);
+  bus->speed = speed;
+  bus->usePec = usePec;
+  bus->outFd = -1;
+  bus->battery = calloc(FLEET_MAX_BATTERIES_PER_BUS, sizeof(sbs_smb_battery_t));
+  bus->order = calloc(FLEET_MAX_BATTERIES_PER_BUS, sizeof(sbs_smb_battery_t *));
+  bus->telemetry = calloc(FLEET_MAX_BATTERIES_PER_BUS, sizeof(sbs_telemetry_t));
+  pthread_mutex_init(&bus->statsLock, NULL);
+
+  if (!bus->battery || !bus->order || !bus->telemetry)
+    return NULL;
+
+  return bus;
+}
+
+static sbs_mux_t *FindMux(fleet_bus_t *bus, uint8_t address)
+{
+  for (uint8_t i = 0; i < bus->muxCount; i++)
+    if (bus->mux[i].busAddress == address)
+      return &bus->mux[i];
+
+  return NULL;
+}
+
+// The bus handle isn't open yet, so muxes are linked up and given their handle in OpenBuses()
+static sbs_mux_t *AddMux(fleet_bus_t *bus, uint8_t address)
+{
+  if (bus->muxCount >= FLEET_MAX_MUXES_PER_BUS || FindMux(bus, address))
+    return NULL;
+
+  sbs_mux_t *mux = &bus->mux[bus->muxCount++];
+  mux->busAddress = address;
+  return mux;
+}
+
+static sbs_smb_battery_t *AddBattery(fleet_bus_t *bus, uint8_t address, sbs_mux_t *mux, uint8_t channel)
+{
+  if (bus->batteryCount >= FLEET_MAX_BATTERIES_PER_BUS || channel >= SBS_MUX_MAX_CHANNELS)
+    return NULL;
+
+  sbs_smb_battery_t *battery = &bus->battery[bus->batteryCount];
+  battery->busAddress = address;
+  battery->mux = mux;
+  battery->muxChannel = channel;
+
+  bus->order[bus->batteryCount] = battery;
+  SBSTelemetryInit(&bus->telemetry[bus->batteryCount], (uint8_t)bus->batteryCount);
+  bus->batteryCount++;
+
+  return battery;
+}
+
+/**
+ * One statement per line, '#' starts a comment:
+ *
+ *  bus     <name> <device|sim> [speed [pec|nopec]]
+ *  mux     <bus name> <address>
+ *  battery <bus name> <address> [<mux address> <channel>]
+ * */
+static int LoadConfig(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (!f)
+  {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  char line[FLEET_MAX_LINE];
+  int lineNo = 0;
+  int ret = 0;
+
+  while (!ret && fgets(line, sizeof(line), f))
+  {
+    char *comment = strchr(line, '#');
+    if (comment)
+      *comment = '\0';
+
+    char kind[16], name[FLEET_MAX_NAME], arg[FLEET_MAX_LINE], pec[8] = "pec";
+    unsigned int speed = FLEET_DEFAULT_SPEED, address, muxAddress, channel;
+    int fields = sscanf(line, "%15s %31s %255s", kind, name, arg);
+
+    lineNo++;
+    if (fields <= 0)
+      continue;
+
+    if (!strcmp(kind, "bus") && fields == 3)
+    {
+      sscanf(line, "%*s %*s %*s %u %7s", &speed, pec);
+      if (!AddBus(name, arg, speed, strcmp(pec, "nopec") != 0))
+        ret = -1;
+    }
+    else if (!strcmp(kind, "mux") && fields == 3)
+    {
+      fleet_bus_t *bus = FindBus(name);
+      if (!bus || sscanf(arg, "%i", &address) != 1 || address > 0x7F || !AddMux(bus, address))
+        ret = -1;
+    }
+    else if (!strcmp(kind, "battery") && fields == 3)
+    {
+      fleet_bus_t *bus = FindBus(name);
+      sbs_mux_t *mux = NULL;
+      int args = sscanf(line, "%*s %*s %i %i %u", &address, &muxAddress, &channel);
+
+      // Without its channel the battery would be taken as wired to the bus directly
+      if (args == 2)
+      {
+        fprintf(stderr, "%s:%d: battery behind mux 0x%02X has no channel\n", path, lineNo, muxAddress);
+        fclose(f);
+        return -1;
+      }
+
+      if (args == 3)
+        mux = bus ? FindMux(bus, muxAddress) : NULL;
+      else
+      {
+        muxAddress = 0;
+        channel = 0;
+      }
+
+      if (args < 1 || !bus || address > 0x7F || (muxAddress && !mux) || !AddBattery(bus, address, mux, channel))
+        ret = -1;
+    }
+    else
+      ret = -1;
+  }
+
+  if (ret)
+    fprintf(stderr, "%s:%d: invalid or unresolvable statement\n", path, lineNo);
+
+  fclose(f);
+  return ret;
+}
+
+// Build a simulated fleet from "buses:muxes:channels:batteries per channel"
+static int GenerateFleet(const char *spec, uint32_t speed)
+{
+  unsigned int buses, muxes, channels, perChannel;
+
+  if (sscanf(spec, "%u:%u:%u:%u", &buses, &muxes, &channels, &perChannel) != 4 ||
+      buses > FLEET_MAX_BUSES || muxes > FLEET_MAX_MUXES_PER_BUS || channels > SBS_MUX_MAX_CHANNELS ||
+      perChannel > 0x70 - 0x08 || (muxes ? muxes * channels : 1) * perChannel > FLEET_MAX_BATTERIES_PER_BUS)
+  {
+    fprintf(stderr, "Invalid simulated fleet '%s'\n", spec);
+    return -1;
+  }
+
+  for (unsigned int b = 0; b < buses; b++)
+  {
+    char name[FLEET_MAX_NAME];
+    snprintf(name, sizeof(name), "sim%u", b);
+
+    fleet_bus_t *bus = AddBus(name, SMBUS_SIM_PORT_NAME, speed, true);
+    if (!bus)
+      return -1;
+
+    for (unsigned int m = 0; m < muxes; m++)
+      AddMux(bus, SMBUS_SIM_MUX_ADDRESS_FIRST + m);
+
+    // Smart batteries usually live at 0x0B, spread any extra ones upwards from there
+    for (unsigned int m = 0; m < (muxes ? muxes : 1); m++)
+      for (unsigned int c = 0; c < (muxes ? channels : 1); c++)
+        for (unsigned int a = 0; a < perChannel; a++)
+          AddBattery(bus, 0x0B + a, muxes ? &bus->mux[m] : NULL, c);
+  }
+
+  return 0;
+}
+
+static void BatteryLabel(fleet_bus_t *bus, sbs_smb_battery_t *battery, char *label, size_t size)
+{
+  if (battery->mux)
+    snprintf(label, size, "%s/0x%02X.%u/0x%02X", bus->name, battery->mux->busAddress, battery->muxChannel, battery->busAddress);
+  else
+    snprintf(label, size, "%s/0x%02X", bus->name, battery->busAddress);
+}
+
+static int OpenBuses(const char *outDir, const char *shmName)
+{
+  uint32_t slotCount = 0;
+
+  for (uint8_t i = 0; i < fleet.busCount; i++)
+  {
+    fleet.bus[i].shmSlot = slotCount;
+    slotCount += fleet.bus[i].batteryCount;
+  }
+
+  if (shmName && !(fleet.shm = SBSShmCreate(shmName, slotCount ? slotCount : 1)))
+  {
+    fprintf(stderr, "Couldn't create shared memory %s\n", shmName);
+    return -1;
+  }
+
+  for (uint8_t i = 0; i < fleet.busCount; i++)
+  {
+    fleet_bus_t *bus = &fleet.bus[i];
+
+    bus->handle = SMBusInit(bus->port, 0, bus->speed, -1, -1, -1, FLEET_DEFAULT_TIMEOUT_MS, bus->usePec);
+    if (!bus->handle)
+    {
+      fprintf(stderr, "Couldn't init SMBus %s on %s\n", bus->name, bus->port);
+      return -1;
+    }
+
+    for (uint8_t m = 0; m < bus->muxCount; m++)
+      SBSMuxInit(&bus->mux[m], bus->handle, bus->mux[m].busAddress, m ? &bus->mux[0] : NULL);
+
+    for (uint16_t b = 0; b < bus->batteryCount; b++)
+      bus->battery[b].bus = bus->handle;
+
+    SBSMuxSortBatteries(bus->order, bus->batteryCount);
+
+    if (outDir)
+    {
+      char path[FLEET_MAX_LINE + FLEET_MAX_NAME + 8];
+      snprintf(path, sizeof(path), "%s/%s.sbt", outDir, bus->name);
+
+      bus->outFd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (bus->outFd < 0)
+      {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static void WriteAll(int fd, const uint8_t *data, size_t len)
+{
+  while (len)
+  {
+    ssize_t written = write(fd, data, len);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return;
+    data += written;
+    len -= written;
+  }
+}
+
+static void *BusWorker(void *arg)
+{
+  fleet_bus_t *bus = (fleet_bus_t *)arg;
+  size_t outSize = (size_t)bus->batteryCount * SBS_TELEMETRY_MAX_SNAPSHOT_SIZE;
+  uint8_t *out = malloc(outSize);
+
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  while (!atomic_load(&stopRequested))
+  {
+    size_t outLen = 0;
+
+    for (uint16_t i = 0; i < bus->batteryCount && !atomic_load(&stopRequested); i++)
+    {
+      sbs_smb_battery_t *battery = bus->order[i];
+
+      uint64_t start = NowUs();
+      int ret = SBSGetBatteryInfo(battery);
+      uint64_t elapsed = NowUs() - start;
+
+      // A failed transfer may have left a mux in an unknown state
+      if (ret != SMBUS_ERR_OK && battery->mux)
+        SBSMuxInvalidate(battery->mux);
+
+      pthread_mutex_lock(&bus->statsLock);
+      StatsAdd(&bus->window, elapsed, ret != SMBUS_ERR_OK);
+      pthread_mutex_unlock(&bus->statsLock);
+
+      if (fleet.shm)
+      {
+        char label[FLEET_MAX_NAME + 16];    // Truncated to SBS_SHM_LABEL_SIZE when published
+        BatteryLabel(bus, battery, label, sizeof(label));
+        SBSShmPublish(fleet.shm, bus->shmSlot + (battery - bus->battery), label, battery, ret);
+      }
+
+      if (ret == SMBUS_ERR_OK && out)
+      {
+        size_t len = 0;
+        sbs_telemetry_t *telemetry = &bus->telemetry[battery - bus->battery];
+
+        if (SBSTelemetryEncode(telemetry, battery, out + outLen, outSize - outLen, &len) == SMBUS_ERR_OK)
+          outLen += len;
+      }
+    }
+
+    if (bus->outFd >= 0 && outLen)
+      WriteAll(bus->outFd, out, outLen);
+
+    if (fleet.intervalMs)
+    {
+      next.tv_nsec += (long)(fleet.intervalMs % 1000) * 1000000L;
+      next.tv_sec += fleet.intervalMs / 1000 + next.tv_nsec / 1000000000L;
+      next.tv_nsec %= 1000000000L;
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+  }
+
+  free(out);
+  return NULL;
+}
+
+static void PrintStatsLine(const char *name, uint16_t batteries, const fleet_stats_t *stats, double seconds)
+{
+  printf("%-10s %6u %10.1f %8llu %8llu %9.2f %9.2f %9.2f\n", name, batteries,
+         seconds > 0 ? stats->count / seconds : 0.0,
+         (unsigned long long)stats->count, (unsigned long long)stats->errors,
+         HistPercentile(stats, 50) / 1000.0, HistPercentile(stats, 99) / 1000.0, stats->maxUs / 1000.0);
+}
+
+// Print the window since the last report, or everything since start up if [final]
+static void Report(double seconds, bool final)
+{
+  static fleet_stats_t all, bus;
+  uint32_t batteries = 0;
+
+  memset(&all, 0, sizeof(all));
+
+  printf("\n%s over %.1fs\n", final ? "Total" : "Last", seconds);
+  printf("%-10s %6s %10s %8s %8s %9s %9s %9s\n", "bus", "packs", "polls/s", "polls", "errors", "p50 ms", "p99 ms", "max ms");
+
+  for (uint8_t i = 0; i < fleet.busCount; i++)
+  {
+    fleet_bus_t *b = &fleet.bus[i];
+
+    pthread_mutex_lock(&b->statsLock);
+    StatsMerge(&b->total, &b->window);
+    bus = final ? b->total : b->window;
+    memset(&b->window, 0, sizeof(b->window));
+    pthread_mutex_unlock(&b->statsLock);
+
+    PrintStatsLine(b->name, b->batteryCount, &bus, seconds);
+    StatsMerge(&all, &bus);
+    batteries += b->batteryCount;
+  }
+
+  PrintStatsLine("all", batteries, &all, seconds);
+  fflush(stdout);
+}
+
+static void Usage(const char *argv0)
+{
+  fprintf(stderr,
+          "Usage: %s (-c <fleet.conf> | -s <buses:muxes:channels:packs>) [options]\n"
+          "  -c <file>   Fleet description, see fleet.conf\n"
+          "  -s <spec>   Poll a generated fleet on simulated buses instead\n"
+          "  -b <hz>     Bus speed of the simulated buses (default %u, 0 for no transfer time)\n"
+          "  -i <ms>     Polling interval per bus (default 0, back to back)\n"
+          "  -o <dir>    Write a telemetry stream per bus to <dir>/<bus name>.sbt\n"
+          "  -m <name>   Publish snapshots to the shared memory segment <name>, e.g. /sbs_fleet\n"
+          "  -r <s>      Report interval (default 5)\n"
+          "  -d <s>      Stop after this long (default run until interrupted)\n",
+          argv0, FLEET_DEFAULT_SPEED);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *configPath = NULL, *simSpec = NULL, *outDir = NULL, *shmName = NULL;
+  uint32_t simSpeed = FLEET_DEFAULT_SPEED, reportS = 5, durationS = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "c:s:b:i:o:m:r:d:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'c': configPath = optarg;                    break;
+      case 's': simSpec = optarg;                       break;
+      case 'b': simSpeed = strtoul(optarg, NULL, 0);    break;
+      case 'i': fleet.intervalMs = strtoul(optarg, NULL, 0); break;
+      case 'o': outDir = optarg;                        break;
+      case 'm': shmName = optarg;                       break;
+      case 'r': reportS = strtoul(optarg, NULL, 0);     break;
+      case 'd': durationS = strtoul(optarg, NULL, 0);   break;
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (!configPath == !simSpec || !reportS)
+  {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  if ((configPath ? LoadConfig(configPath) : GenerateFleet(simSpec, simSpeed)) != 0 || OpenBuses(outDir, shmName) != 0)
+    return 1;
+
+  signal(SIGINT, OnSignal);
+  signal(SIGTERM, OnSignal);
+
+  for (uint8_t i = 0; i < fleet.busCount; i++)
+  {
+    if (pthread_create(&fleet.bus[i].thread, NULL, BusWorker, &fleet.bus[i]) != 0)
+    {
+      fprintf(stderr, "Couldn't start the worker of bus %s\n", fleet.bus[i].name);
+      atomic_store(&stopRequested, true);
+      fleet.busCount = i;
+      break;
+    }
+  }
+
+  uint64_t start = NowUs(), lastReport = start;
+
+  while (!atomic_load(&stopRequested))
+  {
+    SMBusPlatformDelayMs(100);
+
+    uint64_t now = NowUs();
+    if (durationS && now - start >= (uint64_t)durationS * 1000000ULL)
+      atomic_store(&stopRequested, true);
+    else if (now - lastReport >= (uint64_t)reportS * 1000000ULL)
+    {
+      Report((now - lastReport) / 1e6, false);
+      lastReport = now;
+    }
+  }
+
+  for (uint8_t i = 0; i < fleet.busCount; i++)
+    pthread_join(fleet.bus[i].thread, NULL);
+
+  Report((NowUs() - start) / 1e6, true);
+
+  for (uint8_t i = 0; i < fleet.busCount; i++)
+  {
+    if (fleet.bus[i].outFd >= 0)
+      close(fleet.bus[i].outFd);
+    SMBusDeinit(fleet.bus[i].handle);
+  }
+
+  // The segment is left in place so readers can still look at the last snapshots
+  SBSShmClose(fleet.shm);
+
+  return 0;
+}
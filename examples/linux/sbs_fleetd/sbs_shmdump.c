@@ -0,0 +1,116 @@
+/**
+ *
+ * @file:   sbs_shmdump.c - Prints the battery snapshots published by sbs_fleetd to shared memory
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ *  sbs_shmdump /sbs_fleet              print every slot once
+ *  sbs_shmdump -w 1000 /sbs_fleet      print the slots that changed every second
+ *  sbs_shmdump -t /sbs_fleet           time SBSShmRead() while the publisher is running
+ *
+ * */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sbs_smb.h"
+#include "sbs_shm.h"
+
+#define TIMING_READS    1000000
+
+static uint64_t NowNs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void PrintSlot(sbs_shm_t *shm, uint32_t slot)
+{
+  sbs_shm_reading_t reading;
+
+  if (SBSShmRead(shm, slot, &reading) != SMBUS_ERR_OK)
+    return;
+
+  sbs_smb_battery_t *b = &reading.battery;
+  printf("%-24s %6u %4d %6u %5.1f %6d %4u%% %6u %5u  %s\n", reading.label, reading.sequence, reading.error,
+         b->serialNumber, b->temperatureCentiC / 100.0, (int)b->terminalVoltageMv, b->relativeStateOfCharge,
+         b->remainingCapacity, b->cycleCount, b->name);
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t watchMs = 0;
+  bool timing = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "w:t")) != -1)
+  {
+    switch (opt)
+    {
+      case 'w': watchMs = strtoul(optarg, NULL, 0);  break;
+      case 't': timing = true;                        break;
+      default:
+        fprintf(stderr, "Usage: %s [-w <ms>] [-t] <shared memory name>\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (optind >= argc)
+  {
+    fprintf(stderr, "Usage: %s [-w <ms>] [-t] <shared memory name>\n", argv[0]);
+    return 1;
+  }
+
+  sbs_shm_t *shm = SBSShmOpen(argv[optind]);
+  if (!shm)
+  {
+    fprintf(stderr, "Couldn't open %s, is the publisher running?\n", argv[optind]);
+    return 1;
+  }
+
+  uint32_t slotCount = SBSShmSlotCount(shm);
+
+  if (timing)
+  {
+    sbs_shm_reading_t reading;
+    uint64_t start = NowNs();
+
+    for (uint32_t i = 0; i < TIMING_READS; i++)
+      SBSShmRead(shm, i % slotCount, &reading);
+
+    printf("%u slots, %.1f ns per read\n", slotCount, (double)(NowNs() - start) / TIMING_READS);
+    SBSShmClose(shm);
+    return 0;
+  }
+
+  uint32_t *lastSequence = calloc(slotCount, sizeof(uint32_t));
+
+  do
+  {
+    printf("%-24s %6s %4s %6s %5s %6s %5s %6s %5s  %s\n",
+           "battery", "seq", "err", "serial", "C", "mV", "soc", "cap", "cyc", "name");
+
+    for (uint32_t i = 0; i < slotCount; i++)
+    {
+      uint32_t sequence = SBSShmSequence(shm, i);
+      if (lastSequence && sequence == lastSequence[i])
+        continue;
+      if (lastSequence)
+        lastSequence[i] = sequence;
+      PrintSlot(shm, i);
+    }
+
+    fflush(stdout);
+    if (watchMs)
+      usleep(watchMs * 1000);
+  }while (watchMs);
+
+  free(lastSequence);
+  SBSShmClose(shm);
+  return 0;
+}
@@ -0,0 +1,173 @@
+/**
+ *
+ * @file:   sbs_gang.c - Provisions packs on several buses at once with SBSBqGangRun()
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * Every bus gets a thread that runs the state machines of all the packs behind its mux. The target image sets
+ * the first rows of data flash to a fixed pattern, so each pack gets those rows written and verified.
+ *
+ *  sbs_gang -s 8:8 -r 16 -S        8 simulated buses with 8 packs each, 16 rows per pack, seal when done
+ *
+ * */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "sbs_smb.h"
+#include "sbs_mux.h"
+#include "smbus_sim.h"
+#include "sbs_bq_gang.h"
+
+#define GANG_MAX_BUSES          64
+#define GANG_SPEED              100000
+
+typedef struct
+{
+  smbus_handle_t handle;
+  sbs_mux_t mux;
+  sbs_smb_battery_t battery[SBS_MUX_MAX_CHANNELS];
+  sbs_bq_df_image_t image[SBS_MUX_MAX_CHANNELS];
+  uint8_t data[SBS_MUX_MAX_CHANNELS][SBS_BQ_DF_SIZE];
+  uint8_t valid[SBS_MUX_MAX_CHANNELS][SBS_BQ_DF_BITMAP_SIZE(SBS_BQ_DF_SIZE)];
+  uint8_t dirty[SBS_MUX_MAX_CHANNELS][SBS_BQ_DF_BITMAP_SIZE(SBS_BQ_DF_SIZE)];
+  sbs_bq_gang_pack_t pack[SBS_MUX_MAX_CHANNELS];
+  uint16_t packCount;
+  uint16_t failed;
+  pthread_t thread;
+} gang_bus_t;
+
+static gang_bus_t bus[GANG_MAX_BUSES];
+static sbs_bq_gang_config_t config;
+
+static const char *stateName[] = {
+  "UNSEAL", "UNSEAL_WAIT", "CHECKSUM", "CHECKSUM_CHECK", "STAGE", "WRITE",
+  "VERIFY", "VERIFY_CHECK", "SEAL", "SEAL_WAIT", "DONE", "FAILED",
+};
+
+static uint64_t NowMs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void *BusThread(void *arg)
+{
+  gang_bus_t *b = (gang_bus_t *)arg;
+  b->failed = SBSBqGangRun(&config, b->pack, b->packCount);
+  return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned busCount = 1, packCount = 8, rowCount = 8;
+  uint16_t unsealKey[] = { 0x0414, 0x3672 };
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:r:S")) != -1)
+  {
+    switch (opt)
+    {
+      case 's': sscanf(optarg, "%u:%u", &busCount, &packCount);  break;
+      case 'r': rowCount = strtoul(optarg, NULL, 0);            break;
+      case 'S': config.seal = true;                             break;
+      default:
+        fprintf(stderr, "Usage: %s [-s <buses>:<packs per bus>] [-r <rows>] [-S]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (!busCount || busCount > GANG_MAX_BUSES || !packCount || packCount > SBS_MUX_MAX_CHANNELS ||
+      !rowCount || rowCount > SBS_BQ_DF_ROW_COUNT(SBS_BQ_DF_SIZE))
+  {
+    fprintf(stderr, "Up to %u buses, %u packs per bus and %u rows\n", GANG_MAX_BUSES, SBS_MUX_MAX_CHANNELS,
+            SBS_BQ_DF_ROW_COUNT(SBS_BQ_DF_SIZE));
+    return 1;
+  }
+
+  // Target: the first rowCount rows of data flash
+  static uint8_t targetData[SBS_BQ_DF_SIZE], targetValid[SBS_BQ_DF_BITMAP_SIZE(SBS_BQ_DF_SIZE)];
+  static uint8_t targetDirty[SBS_BQ_DF_BITMAP_SIZE(SBS_BQ_DF_SIZE)];
+  static sbs_bq_df_image_t target;
+  uint8_t row[SBS_BQ_DF_ROW_SIZE];
+
+  SBSBqDfImageInit(&target, SBS_BQ_DF_ADDRESS_START, SBS_BQ_DF_SIZE, targetData, targetValid, targetDirty);
+  for (unsigned r = 0; r < rowCount; r++)
+  {
+    for (unsigned i = 0; i < sizeof(row); i++)
+      row[i] = (uint8_t)(r + i);
+    SBSBqDfImageWrite(&target, SBS_BQ_DF_ADDRESS_START + r * SBS_BQ_DF_ROW_SIZE, row, sizeof(row));
+  }
+
+  config.unsealKey = unsealKey;
+  config.target = &target;
+
+  for (unsigned b = 0; b < busCount; b++)
+  {
+    bus[b].handle = SMBusInit(SMBUS_SIM_PORT_NAME, 0, GANG_SPEED, -1, -1, -1, 1000, true);
+    if (!bus[b].handle)
+    {
+      fprintf(stderr, "Couldn't open simulated bus %u\n", b);
+      return 1;
+    }
+    SBSMuxInit(&bus[b].mux, bus[b].handle, SBS_MUX_DEFAULT_ADDRESS, NULL);
+
+    for (unsigned p = 0; p < packCount; p++)
+    {
+      sbs_smb_battery_t *battery = &bus[b].battery[p];
+      battery->bus = bus[b].handle;
+      battery->busAddress = SBS_BATTERY_DEFAULT_ADDRESS;
+      battery->mux = &bus[b].mux;
+      battery->muxChannel = p;
+
+      SBSBqDfImageInit(&bus[b].image[p], SBS_BQ_DF_ADDRESS_START, SBS_BQ_DF_SIZE,
+                       bus[b].data[p], bus[b].valid[p], bus[b].dirty[p]);
+      SBSBqGangInitPack(&bus[b].pack[p], battery, &bus[b].image[p]);
+    }
+    bus[b].packCount = packCount;
+  }
+
+  uint64_t start = NowMs();
+
+  for (unsigned b = 0; b < busCount; b++)
+    pthread_create(&bus[b].thread, NULL, BusThread, &bus[b]);
+
+  unsigned failed = 0;
+  for (unsigned b = 0; b < busCount; b++)
+  {
+    pthread_join(bus[b].thread, NULL);
+    failed += bus[b].failed;
+  }
+
+  uint64_t elapsedMs = NowMs() - start;
+
+  printf("%-4s %-4s %-14s %4s %4s %7s %7s %7s %7s %7s\n",
+         "bus", "pack", "state", "err", "rows", "unseal", "program", "verify", "seal", "total");
+  for (unsigned b = 0; b < busCount; b++)
+  {
+    for (unsigned p = 0; p < packCount; p++)
+    {
+      sbs_bq_gang_pack_t *pack = &bus[b].pack[p];
+      printf("%-4u %-4u %-14s %4d %4u %7u %7u %7u %7u %7u\n", b, p,
+             (pack->state == SBS_BQ_GANG_STATE_FAILED) ? stateName[pack->failedState] : stateName[pack->state],
+             pack->result, pack->rowsWritten, pack->phaseMs[SBS_BQ_GANG_PHASE_UNSEAL],
+             pack->phaseMs[SBS_BQ_GANG_PHASE_PROGRAM], pack->phaseMs[SBS_BQ_GANG_PHASE_VERIFY],
+             pack->phaseMs[SBS_BQ_GANG_PHASE_SEAL], pack->totalMs);
+    }
+  }
+
+  printf("%u packs on %u buses in %llu ms, %u failed, %.1f packs/s\n", busCount * packCount, busCount,
+         (unsigned long long)elapsedMs, failed, elapsedMs ? busCount * packCount * 1000.0 / elapsedMs : 0.0);
+
+  for (unsigned b = 0; b < busCount; b++)
+    SMBusDeinit(bus[b].handle);
+
+  return failed ? 1 : 0;
+}
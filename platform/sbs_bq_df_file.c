@@ -0,0 +1,103 @@
+/**
+ * @file    sbs_bq_df_file.c  -   Data flash images kept in memory mapped files
+ * @author  skuodi
+ * @date    18 October 2026.
+ *
+ * **/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sbs_bq_df_file.h"
+
+#define SBS_BQ_DF_FILE_MAGIC    0x46444253      // "SBDF"
+#define SBS_BQ_DF_FILE_VERSION  1
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint16_t startAddress;
+    uint16_t size;
+}sbs_bq_df_file_header_t;
+
+static size_t SBSBqDfFileSize(uint16_t size)
+{
+    return sizeof(sbs_bq_df_file_header_t) + size + 2 * SBS_BQ_DF_BITMAP_SIZE(size);
+}
+
+int SBSBqDfFileOpen(sbs_bq_df_image_t *image, const char *path, uint16_t startAddress, uint16_t size)
+{
+    if (!image || !path)
+        return SMBUS_ERR_INVALID_ARG;
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return SMBUS_ERR_FAIL;
+
+    struct stat st;
+    size_t fileSize = SBSBqDfFileSize(size);
+    bool fresh = fstat(fd, &st) != 0 || (size_t)st.st_size != fileSize;
+
+    if (fresh && ftruncate(fd, fileSize) != 0)
+    {
+        close(fd);
+        return SMBUS_ERR_FAIL;
+    }
+
+    sbs_bq_df_file_header_t *header = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED)
+        return SMBUS_ERR_FAIL;
+
+    uint8_t *data = (uint8_t *)header + sizeof(*header);
+    uint8_t *valid = data + size;
+    uint8_t *dirty = valid + SBS_BQ_DF_BITMAP_SIZE(size);
+
+    fresh = fresh || header->magic != SBS_BQ_DF_FILE_MAGIC || header->version != SBS_BQ_DF_FILE_VERSION ||
+            header->headerSize != sizeof(*header) || header->startAddress != startAddress || header->size != size;
+
+    // SBSBqDfImageInit() clears the bitmaps, keep the rows an existing file already holds
+    uint8_t bitmaps[2 * SBS_BQ_DF_BITMAP_SIZE(SBS_BQ_DF_SIZE)];
+    if (!fresh && size <= SBS_BQ_DF_SIZE)
+        memcpy(bitmaps, valid, 2 * SBS_BQ_DF_BITMAP_SIZE(size));
+
+    int ret = SBSBqDfImageInit(image, startAddress, size, data, valid, dirty);
+    if (ret != SMBUS_ERR_OK)
+    {
+        munmap(header, fileSize);
+        return ret;
+    }
+
+    if (!fresh)
+        memcpy(valid, bitmaps, 2 * SBS_BQ_DF_BITMAP_SIZE(size));
+
+    if (fresh)
+    {
+        header->magic = SBS_BQ_DF_FILE_MAGIC;
+        header->version = SBS_BQ_DF_FILE_VERSION;
+        header->headerSize = sizeof(*header);
+        header->startAddress = startAddress;
+        header->size = size;
+    }
+
+    return SMBUS_ERR_OK;
+}
+
+void SBSBqDfFileClose(sbs_bq_df_image_t *image)
+{
+    if (!image || !image->data)
+        return;
+
+    void *header = image->data - sizeof(sbs_bq_df_file_header_t);
+    size_t fileSize = SBSBqDfFileSize(image->size);
+
+    msync(header, fileSize, MS_SYNC);
+    munmap(header, fileSize);
+    memset(image, 0, sizeof(*image));
+}
@@ -0,0 +1,36 @@
+/**
+ * @file    sbs_bq_df_file.h  -   Data flash images kept in memory mapped files
+ * @author  skuodi
+ * @date    18 October 2026.
+ *
+ * The image data and its valid/dirty bitmaps are mapped straight from a file, so whatever was read from a gauge
+ * is still there for the next run and a dump interrupted halfway only reads the missing rows when run again.
+ * Use one file per gauge e.g. named after its SerialNumber().
+ *
+ * File layout: header, data, valid bitmap, dirty bitmap
+ *
+ * **/
+
+#ifndef _SBS_BQ_DF_FILE_H
+#define _SBS_BQ_DF_FILE_H
+
+#include <stdint.h>
+
+#include "sbs_bq_df.h"
+
+/**
+ * @brief               Map an image file, creating it if it doesn't exist
+ * @param path          File to map
+ * @param startAddress  First data flash address covered by the image
+ * @param size          Size of the image in bytes
+ * @return              SMBUS_ERR_OK, SMBUS_ERR_INVALID_ARG for a bad range, or SMBUS_ERR_FAIL if the file couldn't be mapped.
+ *                      A file made for a different range is started over.
+ **/
+int SBSBqDfFileOpen(sbs_bq_df_image_t *image, const char *path, uint16_t startAddress, uint16_t size);
+
+/**
+ * @brief Flush an image to its file and unmap it
+ **/
+void SBSBqDfFileClose(sbs_bq_df_image_t *image);
+
+#endif
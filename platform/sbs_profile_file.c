@@ -0,0 +1,72 @@
+/**
+ * @file    sbs_profile_file.c  -   Device profile store kept in a file
+ * @author  skuodi
+ * @date    18 October 2026.
+ *
+ * **/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sbs_profile_file.h"
+
+int SBSProfileFileLoad(sbs_profile_store_t *store, const char *path)
+{
+    if (!store || !path)
+        return SMBUS_ERR_INVALID_ARG;
+
+    store->count = 0;
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return (errno == ENOENT) ? SMBUS_ERR_OK : SMBUS_ERR_FAIL;
+
+    int ret = SMBUS_ERR_FAIL;
+    long len = (fseek(file, 0, SEEK_END) == 0) ? ftell(file) : -1;
+    uint8_t *blob = (len > 0) ? (uint8_t *)malloc(len) : NULL;
+
+    if (blob && fseek(file, 0, SEEK_SET) == 0 && fread(blob, 1, len, file) == (size_t)len)
+        ret = SBSProfileStoreDeserialize(store, blob, len);
+
+    free(blob);
+    fclose(file);
+    return ret;
+}
+
+int SBSProfileFileSave(sbs_profile_store_t *store, const char *path)
+{
+    if (!store || !path)
+        return SMBUS_ERR_INVALID_ARG;
+
+    if (!SBSProfileStoreChanged(store))
+        return SMBUS_ERR_OK;
+
+    size_t len = SBSProfileStoreBlobSize(store);
+    uint8_t *blob = (uint8_t *)malloc(len);
+    char *tmpPath = (char *)malloc(strlen(path) + 5);
+    int ret = SMBUS_ERR_FAIL;
+
+    if (blob && tmpPath && SBSProfileStoreSerialize(store, blob, len) == len)
+    {
+        sprintf(tmpPath, "%s.tmp", path);
+
+        FILE *file = fopen(tmpPath, "wb");
+        if (file)
+        {
+            bool written = fwrite(blob, 1, len, file) == len;
+            if (fclose(file) == 0 && written && rename(tmpPath, path) == 0)
+                ret = SMBUS_ERR_OK;
+            else
+                remove(tmpPath);
+        }
+    }
+
+    if (ret == SMBUS_ERR_OK)
+        SBSProfileStoreSaved(store);
+
+    free(tmpPath);
+    free(blob);
+    return ret;
+}
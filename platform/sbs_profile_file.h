@@ -0,0 +1,27 @@
+/**
+ * @file    sbs_profile_file.h  -   Device profile store kept in a file
+ * @author  skuodi
+ * @date    18 October 2026.
+ *
+ * The whole store is written as one blob from SBSProfileStoreSerialize(). Saving goes through a temporary file
+ * that is renamed over the old one, so a crash never leaves a half written store behind.
+ *
+ * **/
+
+#ifndef _SBS_PROFILE_FILE_H
+#define _SBS_PROFILE_FILE_H
+
+#include "sbs_profile.h"
+
+/**
+ * @brief   Load the store from a file
+ * @return  SMBUS_ERR_OK with an empty store if the file doesn't exist yet, or as SBSProfileStoreDeserialize()
+ **/
+int SBSProfileFileLoad(sbs_profile_store_t *store, const char *path);
+
+/**
+ * @brief   Save the store if any profile changed since it was loaded or last saved
+ **/
+int SBSProfileFileSave(sbs_profile_store_t *store, const char *path);
+
+#endif
@@ -0,0 +1,71 @@
+/**
+ * @file    sbs_profile_nvs.c  -   Device profile store kept in ESP-IDF NVS
+ * @author  skuodi
+ * @date    18 October 2026.
+ *
+ * **/
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "nvs.h"
+
+#include "sbs_profile_nvs.h"
+
+int SBSProfileNvsLoad(sbs_profile_store_t *store)
+{
+    if (!store)
+        return SMBUS_ERR_INVALID_ARG;
+
+    store->count = 0;
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(SBS_PROFILE_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        return SMBUS_ERR_OK;
+    if (err != ESP_OK)
+        return SMBUS_ERR_FAIL;
+
+    int ret = SMBUS_ERR_FAIL;
+    size_t len = 0;
+    uint8_t *blob = NULL;
+
+    err = nvs_get_blob(nvs, SBS_PROFILE_NVS_KEY, NULL, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        ret = SMBUS_ERR_OK;
+    else if (err == ESP_OK && (blob = (uint8_t *)malloc(len)) && nvs_get_blob(nvs, SBS_PROFILE_NVS_KEY, blob, &len) == ESP_OK)
+        ret = SBSProfileStoreDeserialize(store, blob, len);
+
+    free(blob);
+    nvs_close(nvs);
+    return ret;
+}
+
+int SBSProfileNvsSave(sbs_profile_store_t *store)
+{
+    if (!store)
+        return SMBUS_ERR_INVALID_ARG;
+
+    if (!SBSProfileStoreChanged(store))
+        return SMBUS_ERR_OK;
+
+    size_t len = SBSProfileStoreBlobSize(store);
+    uint8_t *blob = (uint8_t *)malloc(len);
+    if (!blob)
+        return SMBUS_ERR_FAIL;
+
+    int ret = SMBUS_ERR_FAIL;
+    nvs_handle_t nvs;
+
+    if (SBSProfileStoreSerialize(store, blob, len) == len && nvs_open(SBS_PROFILE_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK)
+    {
+        if (nvs_set_blob(nvs, SBS_PROFILE_NVS_KEY, blob, len) == ESP_OK && nvs_commit(nvs) == ESP_OK)
+            ret = SMBUS_ERR_OK;
+        nvs_close(nvs);
+    }
+
+    if (ret == SMBUS_ERR_OK)
+        SBSProfileStoreSaved(store);
+
+    free(blob);
+    return ret;
+}
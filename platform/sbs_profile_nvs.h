@@ -0,0 +1,30 @@
+/**
+ * @file    sbs_profile_nvs.h  -   Device profile store kept in ESP-IDF NVS
+ * @author  skuodi
+ * @date    18 October 2026.
+ *
+ * The whole store is kept as one blob from SBSProfileStoreSerialize() under a single key. nvs_flash_init() has
+ * to be called before loading.
+ *
+ * **/
+
+#ifndef _SBS_PROFILE_NVS_H
+#define _SBS_PROFILE_NVS_H
+
+#include "sbs_profile.h"
+
+#define SBS_PROFILE_NVS_NAMESPACE       "sbs"
+#define SBS_PROFILE_NVS_KEY             "profiles"
+
+/**
+ * @brief   Load the store from NVS
+ * @return  SMBUS_ERR_OK with an empty store if nothing was saved yet, or as SBSProfileStoreDeserialize()
+ **/
+int SBSProfileNvsLoad(sbs_profile_store_t *store);
+
+/**
+ * @brief   Save the store if any profile changed since it was loaded or last saved
+ **/
+int SBSProfileNvsSave(sbs_profile_store_t *store);
+
+#endif
@@ -0,0 +1,216 @@
+/**
+ * @file    sbs_shm.c  -   Battery snapshots shared between local processes through POSIX shared memory
+ * @author  skuodi
+ * @date    18 October 2026.
+ *
+ * **/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sbs_shm.h"
+
+#define SBS_SHM_MAGIC           0x53425348      // "SBSH"
+#define SBS_SHM_VERSION         1
+
+#define SBS_SHM_CACHE_LINE      64
+
+typedef struct
+{
+    _Atomic uint32_t magic;     // Stored last by the publisher, once the rest of the header is valid
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t slotSize;          // Tells apart builds with a different sbs_smb_battery_t
+    uint32_t slotCount;
+}sbs_shm_header_t;
+
+typedef struct
+{
+    _Atomic uint32_t seq;       // Odd while the publisher is updating the slot
+    sbs_shm_reading_t reading;
+}sbs_shm_slot_t;
+
+// Keep slots on separate cache lines so publishing one doesn't slow down readers of its neighbours
+#define SBS_SHM_ALIGN(size)         (((size) + SBS_SHM_CACHE_LINE - 1) & ~(size_t)(SBS_SHM_CACHE_LINE - 1))
+#define SBS_SHM_HEADER_SIZE         SBS_SHM_ALIGN(sizeof(sbs_shm_header_t))
+#define SBS_SHM_SLOT_SIZE           SBS_SHM_ALIGN(sizeof(sbs_shm_slot_t))
+
+struct sbs_shm
+{
+    sbs_shm_header_t *header;
+    size_t size;
+    uint32_t slotCount;
+};
+
+static sbs_shm_slot_t *SBSShmSlot(sbs_shm_t *shm, uint32_t slot)
+{
+    return (sbs_shm_slot_t *)((uint8_t *)shm->header + SBS_SHM_HEADER_SIZE + (size_t)slot * SBS_SHM_SLOT_SIZE);
+}
+
+sbs_shm_t* SBSShmCreate(const char *name, uint32_t slotCount)
+{
+    if (!name || !slotCount)
+        return NULL;
+
+    sbs_shm_t *shm = (sbs_shm_t *)calloc(1, sizeof(sbs_shm_t));
+    if (!shm)
+        return NULL;
+
+    // Start from a fresh segment so that readers still mapping an old one don't see it change layout
+    shm_unlink(name);
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        free(shm);
+        return NULL;
+    }
+
+    shm->size = SBS_SHM_HEADER_SIZE + (size_t)slotCount * SBS_SHM_SLOT_SIZE;
+    shm->slotCount = slotCount;
+
+    if (ftruncate(fd, shm->size) != 0 ||
+        (shm->header = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        shm_unlink(name);
+        free(shm);
+        return NULL;
+    }
+    close(fd);
+
+    // ftruncate() zero fills, so every slot starts out unpublished
+    shm->header->version = SBS_SHM_VERSION;
+    shm->header->headerSize = SBS_SHM_HEADER_SIZE;
+    shm->header->slotSize = SBS_SHM_SLOT_SIZE;
+    shm->header->slotCount = slotCount;
+    atomic_store_explicit(&shm->header->magic, SBS_SHM_MAGIC, memory_order_release);
+
+    return shm;
+}
+
+sbs_shm_t* SBSShmOpen(const char *name)
+{
+    if (!name)
+        return NULL;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    sbs_shm_t *shm = (sbs_shm_t *)calloc(1, sizeof(sbs_shm_t));
+
+    if (!shm || fstat(fd, &st) != 0 || (size_t)st.st_size < SBS_SHM_HEADER_SIZE ||
+        (shm->header = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        free(shm);
+        return NULL;
+    }
+    close(fd);
+
+    shm->size = st.st_size;
+    shm->slotCount = shm->header->slotCount;
+
+    if (atomic_load_explicit(&shm->header->magic, memory_order_acquire) != SBS_SHM_MAGIC ||
+        shm->header->version != SBS_SHM_VERSION ||
+        shm->header->headerSize != SBS_SHM_HEADER_SIZE ||
+        shm->header->slotSize != SBS_SHM_SLOT_SIZE ||
+        shm->size < SBS_SHM_HEADER_SIZE + (size_t)shm->slotCount * SBS_SHM_SLOT_SIZE)
+    {
+        SBSShmClose(shm);
+        return NULL;
+    }
+
+    return shm;
+}
+
+void SBSShmClose(sbs_shm_t *shm)
+{
+    if (!shm)
+        return;
+
+    munmap(shm->header, shm->size);
+    free(shm);
+}
+
+int SBSShmUnlink(const char *name)
+{
+    if (!name)
+        return SMBUS_ERR_INVALID_ARG;
+
+    return (shm_unlink(name) == 0) ? SMBUS_ERR_OK : SMBUS_ERR_FAIL;
+}
+
+uint32_t SBSShmSlotCount(sbs_shm_t *shm)
+{
+    return shm ? shm->slotCount : 0;
+}
+
+int SBSShmPublish(sbs_shm_t *shm, uint32_t slot, const char *label, const sbs_smb_battery_t *battery, int error)
+{
+    if (!shm || !battery || slot >= shm->slotCount)
+        return SMBUS_ERR_INVALID_ARG;
+
+    sbs_shm_slot_t *s = SBSShmSlot(shm, slot);
+    uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    if (label)
+        strncpy(s->reading.label, label, SBS_SHM_LABEL_SIZE - 1);
+    s->reading.timestampMs = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    s->reading.error = error;
+    s->reading.sequence = seq / 2 + 1;
+    s->reading.battery = *battery;
+    s->reading.battery.bus = NULL;
+    s->reading.battery.mux = NULL;
+    s->reading.battery.cache = NULL;
+    s->reading.battery.cmdSet = NULL;
+
+    atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+    return SMBUS_ERR_OK;
+}
+
+int SBSShmRead(sbs_shm_t *shm, uint32_t slot, sbs_shm_reading_t *reading)
+{
+    if (!shm || !reading || slot >= shm->slotCount)
+        return SMBUS_ERR_INVALID_ARG;
+
+    sbs_shm_slot_t *s = SBSShmSlot(shm, slot);
+    uint32_t before, after;
+
+    do
+    {
+        before = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (before & 1)
+            continue;
+
+        memcpy(reading, &s->reading, sizeof(*reading));
+
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    }while ((before & 1) || before != after);
+
+    return before ? SMBUS_ERR_OK : SMBUS_ERR_FAIL;
+}
+
+uint32_t SBSShmSequence(sbs_shm_t *shm, uint32_t slot)
+{
+    if (!shm || slot >= shm->slotCount)
+        return 0;
+
+    return atomic_load_explicit(&SBSShmSlot(shm, slot)->seq, memory_order_acquire) / 2;
+}
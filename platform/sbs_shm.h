@@ -0,0 +1,81 @@
+/**
+ * @file    sbs_shm.h  -   Battery snapshots shared between local processes through POSIX shared memory
+ * @author  skuodi
+ * @date    18 October 2026.
+ *
+ * One process polls the batteries and publishes every snapshot to a numbered slot of a named segment,
+ * any number of other processes map the segment read-only and copy snapshots out without touching the bus.
+ *
+ * Each slot is guarded by a sequence counter (seqlock): the publisher makes it odd while it updates the slot
+ * and even again when done. A reader copies the slot and retries if the counter was odd or changed meanwhile,
+ * so neither side ever blocks the other and a reader never sees half of an update.
+ * There must be only one publisher per slot.
+ *
+ * **/
+
+#ifndef _SBS_SHM_H
+#define _SBS_SHM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sbs_smb.h"
+
+#define SBS_SHM_LABEL_SIZE      32
+
+typedef struct sbs_shm sbs_shm_t;
+
+typedef struct
+{
+    char label[SBS_SHM_LABEL_SIZE];     // Set by the publisher to tell slots apart, e.g. "<bus>/<mux>.<channel>/<address>"
+    uint64_t timestampMs;               // CLOCK_REALTIME of the poll in ms
+    int32_t error;                      // Result of the poll
+    uint32_t sequence;                  // Number of times the slot has been published
+    sbs_smb_battery_t battery;          // Decoded values. The pointers are cleared since they are only valid in the publisher
+} sbs_shm_reading_t;
+
+/**
+ * @brief               Create a segment, or re-create it if it already exists, and map it for publishing
+ * @param name          Segment name as taken by shm_open(), e.g. "/sbs_fleet"
+ * @param slotCount     Number of batteries that can be published
+ * @return              The segment handle or NULL on failure
+ **/
+sbs_shm_t* SBSShmCreate(const char *name, uint32_t slotCount);
+
+/**
+ * @brief               Map an existing segment for reading
+ * @return              The segment handle or NULL if the segment doesn't exist or was made by an incompatible build
+ **/
+sbs_shm_t* SBSShmOpen(const char *name);
+
+/**
+ * @brief Unmap a segment. The segment itself lives on until SBSShmUnlink()
+ **/
+void SBSShmClose(sbs_shm_t *shm);
+
+/**
+ * @brief Remove a segment name. Processes that have it mapped keep their mapping
+ **/
+int SBSShmUnlink(const char *name);
+
+uint32_t SBSShmSlotCount(sbs_shm_t *shm);
+
+/**
+ * @brief               Publish the snapshot of a battery
+ * @param label         Identifies the battery to readers, can be NULL to keep the previous label
+ * @param error         Result of the poll the snapshot comes from
+ **/
+int SBSShmPublish(sbs_shm_t *shm, uint32_t slot, const char *label, const sbs_smb_battery_t *battery, int error);
+
+/**
+ * @brief               Copy out the latest snapshot of a slot
+ * @return              SMBUS_ERR_OK, or SMBUS_ERR_FAIL if nothing has been published to the slot yet
+ **/
+int SBSShmRead(sbs_shm_t *shm, uint32_t slot, sbs_shm_reading_t *reading);
+
+/**
+ * @brief Number of times a slot has been published, to cheaply check for a new snapshot before SBSShmRead()
+ **/
+uint32_t SBSShmSequence(sbs_shm_t *shm, uint32_t slot);
+
+#endif
@@ -8,7 +8,8 @@
  *          e.g. ...,data byte,A,... means a peripheral device sent an 8-bit byte of data, which was received and acknowledged by the bus controller
  *          e.g. ...,DATA BYTE,a,... means the bus controller device sent an 8-bit byte of data, which was received and acknowledged by a peripheral device.
  * 
- * @note    This SMBus AVR implementation does not support PEC and the handle's usePEC field is igonored
+ * @note    With usePEC set, the PEC is calculated one byte at a time as the bytes pass through TWDR, from a table in flash.
+ *          Sent bytes are added while the TWI shifts them out, so only received bytes cost time on the bus.
  * 
  * **/
 #include <stdint.h>
@@ -16,10 +17,20 @@
 #include <stdlib.h>
 
 #include "avr/io.h"
+#include "avr/pgmspace.h"
 #include "smbus_platform.h"
 
 #define FCPU 16000000
 
+#ifdef ARDUINO
+#include "Arduino.h"
+#else
+#ifndef F_CPU
+#define F_CPU FCPU
+#endif
+#include "util/delay.h"
+#endif
+
 struct smbus_handle
 {
     void* i2cPort;    // Implementation specific handle to an I2C peripheral
@@ -42,6 +53,30 @@ struct smbus_handle
 #define TWI_STATUS_DATA_RECIEVED_ACK_TRANSMITTED        (10<<3)
 #define TWI_STATUS_DATA_RECIEVED_NACK_TRANSMITTED       (11<<3)
 
+// CRC-8 with polynomial x^8 + x^2 + x + 1, the SMBus PEC
+static const uint8_t smbusCrc8Table[256] PROGMEM =
+{
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3,
+};
+
+// Every function using the TWI_ macros below keeps the PEC of its transaction in a local uint8_t pec = 0
+#define TWI_PEC_UPDATE(d)                               pec = pgm_read_byte(&smbusCrc8Table[pec ^ (d)])
+
 #define TWI_STATUS_TO_SMBUS_ERR()                       -(TWSR >> 3)
 
 #define TWI_WAIT()              while(!(TWCR & (1<<TWINT)))//Wait for the last initiated operation to be executed
@@ -61,10 +96,12 @@ struct smbus_handle
                                 }while(0) //Send repeated start condition = clear interrupt flag, set start bit, enable TWI
 
 #define TWI_SEND_BYTE(d)        do{\
-                                    TWDR = d;\
+                                    uint8_t twiByte = d;\
+                                    TWDR = twiByte;\
                                     TWCR = (1<<TWINT) | (1<<TWEN);\
+                                    TWI_PEC_UPDATE(twiByte);\
                                     TWI_WAIT();\
-                                }while(0) // Place data in data register and wait for it to be sent
+                                }while(0) // Place data in data register and wait for it to be sent, adding it to the PEC meanwhile
 
 #define TWI_SEND_DATA_ACK(d)    do{\
                                     TWI_SEND_BYTE(d);\
@@ -82,6 +119,7 @@ struct smbus_handle
                                     TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWEA);\
                                     TWI_WAIT();\
                                     *dp = TWDR;\
+                                    TWI_PEC_UPDATE(*dp);\
                                     if (TWI_STATUS != TWI_STATUS_DATA_RECIEVED_ACK_TRANSMITTED)\
                                         return TWI_STATUS_TO_SMBUS_ERR();\
                                 }while(0) //Receive one data byte and reply with ACK
@@ -90,6 +128,7 @@ struct smbus_handle
                                     TWCR = (1 << TWINT) | (1<<TWEN);\
                                     TWI_WAIT();\
                                     *dp = TWDR;\
+                                    TWI_PEC_UPDATE(*dp);\
                                     if (TWI_STATUS != TWI_STATUS_DATA_RECIEVED_NACK_TRANSMITTED)\
                                         return TWI_STATUS_TO_SMBUS_ERR();\
                                 }while(0) //Receive one data byte and reply with NACK
@@ -110,11 +149,36 @@ struct smbus_handle
                                     TWCR = (1 << TWINT) | (1 << TWSTO) | (1 << TWEN);\
                                 }while(0) //Send stop condition = clear interrupt flag, set stop bit, enable TWI
 
+#define TWI_SEND_PEC()          do{\
+                                    if (handle->info.usePEC)\
+                                        TWI_SEND_DATA_ACK(pec);\
+                                }while(0) //Send the PEC of the bytes so far if enabled
+
+#define TWI_RECV_DATA_LAST(dp)  do{\
+                                    if (handle->info.usePEC)\
+                                        TWI_RECV_DATA_ACK(dp);\
+                                    else\
+                                        TWI_RECV_DATA_NACK(dp);\
+                                }while(0) //Receive the last data byte, which is followed by the PEC if enabled
+
+#define TWI_RECV_PEC()          do{\
+                                    if (handle->info.usePEC)\
+                                    {\
+                                        uint8_t twiPec;\
+                                        TWI_RECV_DATA_NACK((&twiPec));\
+                                        if (pec)\
+                                        {\
+                                            TWI_STOP();\
+                                            return SMBUS_ERR_BAD_CRC;\
+                                        }\
+                                    }\
+                                }while(0) //Receive and check the PEC if enabled. The PEC of the bytes followed by their PEC is 0
+
 
 #define TWI_MAX_SPEED           400000
 
                    
-smbus_handle_t SMBusInit(void* i2cPort, int8_t myAddress, uint32_t i2cSpeed, int sdaPin, int sclPin, int intPin, long timeoutMs)
+smbus_handle_t SMBusInit(void* i2cPort, int8_t myAddress, uint32_t i2cSpeed, int sdaPin, int sclPin, int intPin, long timeoutMs, bool usePec)
 {
     if(!i2cPort || i2cSpeed > TWI_MAX_SPEED)
         return NULL;
@@ -147,6 +211,8 @@ smbus_handle_t SMBusInit(void* i2cPort, int8_t myAddress, uint32_t i2cSpeed, int
     busHandle->info.sclPin = sclPin;
     busHandle->info.intPin = intPin;
     busHandle->info.timeoutMs = timeoutMs;
+    busHandle->info.usePEC = usePec;
+    busHandle->info.initPEC = usePec;
 
     return busHandle;
 }
@@ -171,11 +237,23 @@ smbus_err_t SMBusGetInfo(smbus_handle_t handle, smbus_info_t *info)
     info->sdaPin    = ((struct smbus_handle*)handle)->info.sdaPin;
     info->sclPin    = ((struct smbus_handle*)handle)->info.sclPin;
     info->intPin    = ((struct smbus_handle*)handle)->info.intPin;
+    info->timeoutMs = ((struct smbus_handle*)handle)->info.timeoutMs;
+    info->usePEC    = ((struct smbus_handle*)handle)->info.usePEC;
+    info->initPEC   = ((struct smbus_handle*)handle)->info.initPEC;
     
     return SMBUS_ERR_OK;
     
 }
 
+smbus_err_t SMBusSetPec(smbus_handle_t handle, bool usePec)
+{
+    if(!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    handle->info.usePEC = usePec;
+    return SMBUS_ERR_OK;
+}
+
 
 /**
  * @note    This function does not comply with the SMBus standard on AVR as the TWI phy
@@ -185,6 +263,8 @@ smbus_err_t SMBusGetInfo(smbus_handle_t handle, smbus_info_t *info)
  **/
 smbus_err_t SMBusQuickCommand(smbus_handle_t handle, uint8_t devAddr, bool readWriteBit)
 {
+    uint8_t pec = 0;    // Updated by TWI_SEND_ADDR_W_ACK() but never sent, a quick command has no PEC
+
     TWI_START();
     TWI_SEND_ADDR_W_ACK(devAddr);
     TWI_STOP();
@@ -194,9 +274,15 @@ smbus_err_t SMBusQuickCommand(smbus_handle_t handle, uint8_t devAddr, bool readW
 
 smbus_err_t SMBusSendByte(smbus_handle_t handle, uint8_t devAddr, uint8_t data)
 {
+    if(!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t pec = 0;
+
     TWI_START();
     TWI_SEND_ADDR_W_ACK(devAddr);
     TWI_SEND_DATA_ACK(data);
+    TWI_SEND_PEC();
     TWI_STOP();
 
     return SMBUS_ERR_OK;
@@ -207,9 +293,12 @@ smbus_err_t SMBusReceiveByte(smbus_handle_t handle, uint8_t devAddr, uint8_t* da
     if(!handle || !data)
         return SMBUS_ERR_INVALID_ARG;
 
+    uint8_t pec = 0;
+
     TWI_START();
     TWI_SEND_ADDR_R_ACK(devAddr);
-    TWI_RECV_DATA_NACK(data);
+    TWI_RECV_DATA_LAST(data);
+    TWI_RECV_PEC();
     TWI_STOP();
 
     return SMBUS_ERR_OK;
@@ -217,10 +306,16 @@ smbus_err_t SMBusReceiveByte(smbus_handle_t handle, uint8_t devAddr, uint8_t* da
 
 smbus_err_t SMBusWriteByte(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint8_t data)
 {
+    if(!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t pec = 0;
+
     TWI_START();
     TWI_SEND_ADDR_W_ACK(devAddr);
     TWI_SEND_DATA_ACK(command);
     TWI_SEND_DATA_ACK(data);
+    TWI_SEND_PEC();
     TWI_STOP();
 
     return SMBUS_ERR_OK;
@@ -228,11 +323,17 @@ smbus_err_t SMBusWriteByte(smbus_handle_t handle, uint8_t devAddr, uint8_t comma
 
 smbus_err_t SMBusWriteWord(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint16_t data)
 {
+    if(!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t pec = 0;
+
     TWI_START();
     TWI_SEND_ADDR_W_ACK(devAddr);
     TWI_SEND_DATA_ACK(command);
     TWI_SEND_DATA_ACK(data & 0xFF);
     TWI_SEND_DATA_ACK(data >> 8);
+    TWI_SEND_PEC();
     TWI_STOP();
 
     return SMBUS_ERR_OK;
@@ -244,12 +345,15 @@ smbus_err_t SMBusReadByte(smbus_handle_t handle, uint8_t devAddr, uint8_t comman
     if(!handle || !data)
         return SMBUS_ERR_INVALID_ARG;
 
+    uint8_t pec = 0;
+
     TWI_START();
     TWI_SEND_ADDR_W_ACK(devAddr);
     TWI_SEND_DATA_ACK(command);
     TWI_START_REPEATED();
     TWI_SEND_ADDR_R_ACK(devAddr);
-    TWI_RECV_DATA_ACK(data);
+    TWI_RECV_DATA_LAST(data);
+    TWI_RECV_PEC();
     TWI_STOP();
 
     return SMBUS_ERR_OK;
@@ -261,6 +365,7 @@ smbus_err_t SMBusReadWord(smbus_handle_t handle, uint8_t devAddr, uint8_t comman
         return SMBUS_ERR_INVALID_ARG;
 
     uint8_t dataLow, dataHigh;
+    uint8_t pec = 0;
 
     TWI_START();
     TWI_SEND_ADDR_W_ACK(devAddr);
@@ -268,7 +373,8 @@ smbus_err_t SMBusReadWord(smbus_handle_t handle, uint8_t devAddr, uint8_t comman
     TWI_START_REPEATED();
     TWI_SEND_ADDR_R_ACK(devAddr);
     TWI_RECV_DATA_ACK((&dataLow));
-    TWI_RECV_DATA_NACK((&dataHigh));
+    TWI_RECV_DATA_LAST((&dataHigh));
+    TWI_RECV_PEC();
     *data = (dataHigh << 8) | dataLow;
     TWI_STOP();
 
@@ -281,6 +387,7 @@ smbus_err_t SMBusProcessCall(smbus_handle_t handle, uint8_t devAddr, uint8_t com
         return SMBUS_ERR_INVALID_ARG;
 
     uint8_t dataRecvHigh, dataRecvLow;
+    uint8_t pec = 0;
 
     TWI_START();
     TWI_SEND_ADDR_W_ACK(devAddr);
@@ -290,7 +397,8 @@ smbus_err_t SMBusProcessCall(smbus_handle_t handle, uint8_t devAddr, uint8_t com
     TWI_START_REPEATED();
     TWI_SEND_ADDR_R_ACK(devAddr);
     TWI_RECV_DATA_ACK((&dataRecvLow));
-    TWI_RECV_DATA_NACK((&dataRecvHigh));
+    TWI_RECV_DATA_LAST((&dataRecvHigh));
+    TWI_RECV_PEC();
     *dataRecv = (dataRecvHigh << 8) | dataRecvLow;
     TWI_STOP();
 
@@ -303,6 +411,8 @@ smbus_err_t SMBusBlockWrite(smbus_handle_t handle, uint8_t devAddr, uint8_t comm
     if(!handle || !dataSent)
         return SMBUS_ERR_INVALID_ARG;
     
+    uint8_t pec = 0;
+
     TWI_START();
     TWI_SEND_ADDR_W_ACK(devAddr);
     TWI_SEND_DATA_ACK(command);
@@ -311,6 +421,7 @@ smbus_err_t SMBusBlockWrite(smbus_handle_t handle, uint8_t devAddr, uint8_t comm
     for(int i = 0; i < dataLength; i++)
         TWI_SEND_DATA_ACK(dataSent[i]);
 
+    TWI_SEND_PEC();
     TWI_STOP();
 
     return SMBUS_ERR_OK;
@@ -321,6 +432,8 @@ smbus_err_t SMBusBlockRead(smbus_handle_t handle, uint8_t devAddr, uint8_t comma
     if(!handle || !dataRecv || !dataLength)
         return SMBUS_ERR_INVALID_ARG;
     
+    uint8_t pec = 0;
+
     TWI_START();
     TWI_SEND_ADDR_W_ACK(devAddr);
     TWI_SEND_DATA_ACK(command);
@@ -331,7 +444,8 @@ smbus_err_t SMBusBlockRead(smbus_handle_t handle, uint8_t devAddr, uint8_t comma
     for(int i = 0; i < *dataLength - 1; i++)
         TWI_RECV_DATA_ACK((&dataRecv[i]));
     
-    TWI_RECV_DATA_NACK((&dataRecv[*dataLength - 1]));
+    TWI_RECV_DATA_LAST((&dataRecv[*dataLength - 1]));
+    TWI_RECV_PEC();
     TWI_STOP();
 
     return SMBUS_ERR_OK;
@@ -344,6 +458,8 @@ smbus_err_t SMBusBlockWriteBlockReadProcessCall(smbus_handle_t handle, uint8_t d
     if(!handle || !dataSent  || !dataRecv || !dataRecvLength)
         return SMBUS_ERR_INVALID_ARG;
 
+    uint8_t pec = 0;
+
     TWI_START();
     TWI_SEND_ADDR_W_ACK(devAddr);
     TWI_SEND_DATA_ACK(command);
@@ -361,7 +477,8 @@ smbus_err_t SMBusBlockWriteBlockReadProcessCall(smbus_handle_t handle, uint8_t d
     for(int i = 0; i < *dataRecvLength - 1; i++)
         TWI_RECV_DATA_ACK((&dataRecv[i]));
     
-    TWI_RECV_DATA_NACK((&dataRecv[*dataRecvLength - 1]));
+    TWI_RECV_DATA_LAST((&dataRecv[*dataRecvLength - 1]));
+    TWI_RECV_PEC();
 
     TWI_STOP();
 
@@ -376,6 +493,11 @@ smbus_err_t SMBusHostNotify(smbus_handle_t handle, uint8_t hostAddr, uint8_t dev
 
 smbus_err_t SMBusWrite32(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint32_t dataSent)
 {
+    if(!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t pec = 0;
+
     TWI_START();
 
     TWI_SEND_ADDR_W_ACK(devAddr);
@@ -384,6 +506,7 @@ smbus_err_t SMBusWrite32(smbus_handle_t handle, uint8_t devAddr, uint8_t command
     for(int i = 0; i < 4; i++)
         TWI_SEND_DATA_ACK((dataSent >> (i*8)) & 0xFF);
 
+    TWI_SEND_PEC();
     TWI_STOP();
 
     return SMBUS_ERR_OK;
@@ -395,6 +518,8 @@ smbus_err_t SMBusRead32(smbus_handle_t handle, uint8_t devAddr, uint8_t command,
         return SMBUS_ERR_INVALID_ARG;
 
     uint8_t dataBuf[4];
+    uint8_t pec = 0;
+
     TWI_START();
     TWI_SEND_ADDR_W_ACK(devAddr);
     TWI_SEND_DATA_ACK(command);
@@ -404,7 +529,8 @@ smbus_err_t SMBusRead32(smbus_handle_t handle, uint8_t devAddr, uint8_t command,
     for(int i = 0; i < 3; i++)
         TWI_RECV_DATA_ACK((&dataBuf[i]));
     
-    TWI_RECV_DATA_NACK((&dataBuf[3]));
+    TWI_RECV_DATA_LAST((&dataBuf[3]));
+    TWI_RECV_PEC();
 
     *dataRecv = ((uint32_t)dataBuf[3] << 24) |
                 ((uint32_t)dataBuf[2] << 16) |
@@ -419,6 +545,11 @@ smbus_err_t SMBusRead32(smbus_handle_t handle, uint8_t devAddr, uint8_t command,
 
 smbus_err_t SMBusWrite64(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint64_t dataSent)
 {
+    if(!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t pec = 0;
+
     TWI_START();
     TWI_SEND_ADDR_W_ACK(devAddr);
     TWI_SEND_DATA_ACK(command);
@@ -426,6 +557,7 @@ smbus_err_t SMBusWrite64(smbus_handle_t handle, uint8_t devAddr, uint8_t command
     for(int i = 0; i < 8; i++)
         TWI_SEND_DATA_ACK((dataSent >> (i*8)) & 0xFF);
 
+    TWI_SEND_PEC();
     TWI_STOP();
 
     return SMBUS_ERR_OK;
@@ -437,6 +569,7 @@ smbus_err_t SMBusRead64(smbus_handle_t handle, uint8_t devAddr, uint8_t command,
         return SMBUS_ERR_INVALID_ARG;
     
     uint8_t dataBuf[8];
+    uint8_t pec = 0;
 
     TWI_START();
     TWI_SEND_ADDR_W_ACK(devAddr);
@@ -447,7 +580,8 @@ smbus_err_t SMBusRead64(smbus_handle_t handle, uint8_t devAddr, uint8_t command,
     for(int i = 0; i < 8 - 1; i++)
         TWI_RECV_DATA_ACK((&dataBuf[i]));
     
-    TWI_RECV_DATA_NACK((&dataBuf[8 - 1]));
+    TWI_RECV_DATA_LAST((&dataBuf[8 - 1]));
+    TWI_RECV_PEC();
 
     *dataRecv = ((uint64_t)dataBuf[7] << 54) |
                 ((uint64_t)dataBuf[6] << 48) |
@@ -464,17 +598,112 @@ smbus_err_t SMBusRead64(smbus_handle_t handle, uint8_t devAddr, uint8_t command,
 
 }
 
+/**
+ * @note    Plain I2C for devices that aren't SMBus devices, e.g. a PCA9548 mux taking its channel mask.
+ *          There's never a PEC, whatever usePEC is set to.
+ **/
+smbus_err_t SMBusWriteRaw(smbus_handle_t handle, uint8_t devAddr, uint8_t *dataSent, uint8_t dataLength)
+{
+    if(!handle || !dataSent)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t pec = 0;    // Updated by the TWI_ macros but never sent
+
+    TWI_START();
+    TWI_SEND_ADDR_W_ACK(devAddr);
+
+    for(int i = 0; i < dataLength; i++)
+        TWI_SEND_DATA_ACK(dataSent[i]);
+
+    TWI_STOP();
+
+    return SMBUS_ERR_OK;
+}
+
+smbus_err_t SMBusReadRaw(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint8_t *dataRecv, uint8_t dataLength)
+{
+    if(!handle || !dataRecv || !dataLength)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t pec = 0;    // Updated by the TWI_ macros but never checked
+
+    TWI_START();
+    TWI_SEND_ADDR_W_ACK(devAddr);
+    TWI_SEND_DATA_ACK(command);
+    TWI_START_REPEATED();
+    TWI_SEND_ADDR_R_ACK(devAddr);
+
+    for(int i = 0; i < dataLength - 1; i++)
+        TWI_RECV_DATA_ACK((&dataRecv[i]));
+
+    TWI_RECV_DATA_NACK((&dataRecv[dataLength - 1]));
+    TWI_STOP();
+
+    return SMBUS_ERR_OK;
+}
+
+#ifndef ARDUINO
+static uint32_t delayedMs;  // Milliseconds spent in SMBusPlatformDelayMs(), the clock without Arduino's timer
+#endif
+
+/**
+ * @note    Weak like SMBusPlatformMillis(), so an application with its own timer can replace both
+ **/
+__attribute__((weak)) void SMBusPlatformDelayMs(uint32_t delayMs)
+{
+#ifdef ARDUINO
+    delay(delayMs);
+#else
+    while (delayMs--)
+    {
+        _delay_ms(1);
+        delayedMs++;
+    }
+#endif
+}
+
+/**
+ * @note    On Arduino this is millis(). Otherwise there's no timer set aside for the library, so the count only moves on
+ *          by the time slept in SMBusPlatformDelayMs(): waits, cache TTLs and periods all pass as long as the application
+ *          sleeps through the library. An application that sleeps another way should provide its own clock.
+ **/
+__attribute__((weak)) uint32_t SMBusPlatformMillis(void)
+{
+#ifdef ARDUINO
+    return millis();
+#else
+    return delayedMs;
+#endif
+}
+
+/**
+ * @note    Everything runs in a single thread on AVR, so the mutex functions only need to hand out a non-NULL handle
+ **/
+smbus_mutex_t SMBusPlatformMutexCreate(void)
+{
+    static uint8_t dummyMutex;
+    return (smbus_mutex_t)&dummyMutex;
+}
+
+void SMBusPlatformMutexLock(smbus_mutex_t mutex)
+{
+}
+
+void SMBusPlatformMutexUnlock(smbus_mutex_t mutex)
+{
+}
+
+void SMBusPlatformMutexDelete(smbus_mutex_t mutex)
+{
+}
+
 uint8_t SMBusCrc8(uint8_t crc8, uint8_t const *data, uint16_t dataLength)
 {
     if (!data)
         return 0xff;
 
     while (dataLength--)
-	{
-        crc8 ^= *data++;
-        for (uint8_t k = 0; k < 8; k++)
-            crc8 = crc8 & 0x80 ? (crc8 << 1) ^ 0x07 : crc8 << 1;
-    }
+        crc8 = pgm_read_byte(&smbusCrc8Table[crc8 ^ *data++]);
 
     return crc8;
 }
\ No newline at end of file
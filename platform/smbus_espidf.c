@@ -11,6 +11,10 @@
 #include <string.h>
 
 #include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "driver/i2c.h"
 #include "driver/gpio.h"
 #include "smbus_platform.h"
@@ -81,6 +85,7 @@ smbus_handle_t SMBusInit(void* i2cPort, int8_t myAddress, uint32_t i2cSpeed, int
     busHandle->info.intPin = intPin;
     busHandle->info.timeoutMs = (timeoutMs) ? timeoutMs : portMAX_DELAY;
     busHandle->info.usePEC = usePec;
+    busHandle->info.initPEC = usePec;
 
     return busHandle;
 }
@@ -108,10 +113,21 @@ smbus_err_t SMBusGetInfo(smbus_handle_t handle, smbus_info_t *info)
     info->sclPin    = ((struct smbus_handle*)handle)->info.sclPin;
     info->intPin    = ((struct smbus_handle*)handle)->info.intPin;
     info->timeoutMs = ((struct smbus_handle*)handle)->info.timeoutMs;
+    info->usePEC    = ((struct smbus_handle*)handle)->info.usePEC;
+    info->initPEC   = ((struct smbus_handle*)handle)->info.initPEC;
     
     return SMBUS_ERR_OK;
 }
 
+smbus_err_t SMBusSetPec(smbus_handle_t handle, bool usePec)
+{
+    if(!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    ((struct smbus_handle*)handle)->info.usePEC = usePec;
+    return SMBUS_ERR_OK;
+}
+
 smbus_err_t SMBusQuickCommand(smbus_handle_t handle, uint8_t devAddr, bool readWriteBit)
 {
     if (!handle)
@@ -617,6 +633,17 @@ smbus_err_t SMBusWriteRaw(smbus_handle_t handle, uint8_t devAddr, uint8_t *dataS
                                                                      : SMBUS_ERR_FAIL;
 }
 
+smbus_err_t SMBusReadRaw(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint8_t *dataRecv, uint8_t dataLength)
+{
+    if(!handle || !dataRecv || !dataLength)
+        return SMBUS_ERR_INVALID_ARG;
+
+    int ret = i2c_master_write_read_device(handle->i2cPort, devAddr, &command, 1, dataRecv, dataLength, pdMS_TO_TICKS(handle->info.timeoutMs));
+
+    return (ret == ESP_OK) ? SMBUS_ERR_OK : (ret == ESP_ERR_TIMEOUT) ? SMBUS_ERR_TIMEOUT
+                                                                     : SMBUS_ERR_FAIL;
+}
+
 smbus_err_t SMBusWriteWordReadBlock(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint16_t word, bool wordFlipEndianness,
                                        uint8_t responseCommand, uint8_t *dataRecv, uint8_t *dataLength, int delayMs)
 {
@@ -668,6 +695,31 @@ void SMBusPlatformDelayMs(uint32_t delayMs)
     vTaskDelay(pdMS_TO_TICKS(delayMs));
 }
 
+uint32_t SMBusPlatformMillis(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+smbus_mutex_t SMBusPlatformMutexCreate(void)
+{
+    return (smbus_mutex_t)xSemaphoreCreateMutex();
+}
+
+void SMBusPlatformMutexLock(smbus_mutex_t mutex)
+{
+    xSemaphoreTake((SemaphoreHandle_t)mutex, portMAX_DELAY);
+}
+
+void SMBusPlatformMutexUnlock(smbus_mutex_t mutex)
+{
+    xSemaphoreGive((SemaphoreHandle_t)mutex);
+}
+
+void SMBusPlatformMutexDelete(smbus_mutex_t mutex)
+{
+    vSemaphoreDelete((SemaphoreHandle_t)mutex);
+}
+
 static uint8_t SMBusCrc8(uint8_t crc8, uint8_t const *data, uint16_t dataLength)
 {
     if (!data)
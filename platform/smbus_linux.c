@@ -0,0 +1,689 @@
+/**
+ * @file    smbus_linux.c  -   SMBUS data link layer protocol bus controller implementation using Linux i2c-dev
+ *                         -   Pass the device node e.g. "/dev/i2c-1" as the i2cPort of SMBusInit(),
+ *                             or "sim" to run against the simulated segment in smbus_sim.c
+ * @author  skuodi
+ * @date    18 October 2026.
+ *
+ * **/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "smbus_platform.h"
+#include "smbus_sim.h"
+
+#define I2C_RW_READ     0x01                    ///< I2C RW bit read mode
+#define I2C_RW_WRITE    0x00                    ///< I2C RW bit write mode
+
+#define CRC_INIT_VALUE  0x00
+
+#define SMBUS_BLOCK_MAX         I2C_SMBUS_BLOCK_MAX     ///< Longest block i2c-dev adapters read with I2C_M_RECV_LEN
+#define SMBUS_LONG_BLOCK_MAX    255                     ///< SMBus 3.0 block size, read as raw bytes of known length
+
+struct smbus_handle
+{
+    int fd;             // i2c-dev file descriptor, -1 for a simulated segment
+    smbus_sim_t *sim;   // Simulated segment, NULL for a real bus
+    smbus_info_t info;
+};
+
+static uint8_t SMBusCrc8(uint8_t crc8, uint8_t const *data, uint16_t dataLength);
+
+// Returns the number of messages transferred or a negative errno value, like the I2C_RDWR ioctl
+static int SMBusTransferMsgs(smbus_handle_t handle, struct i2c_msg *msgs, int msgCount)
+{
+    if (handle->sim)
+        return SMBusSimTransfer(handle->sim, msgs, msgCount);
+
+    struct i2c_rdwr_ioctl_data data = { .msgs = msgs, .nmsgs = msgCount };
+    int ret = ioctl(handle->fd, I2C_RDWR, &data);
+    return (ret < 0) ? -errno : ret;
+}
+
+static smbus_err_t SMBusTransferResult(int ret, int msgCount)
+{
+    if (ret == msgCount)
+        return SMBUS_ERR_OK;
+
+    return (ret == -ETIMEDOUT) ? SMBUS_ERR_TIMEOUT : SMBUS_ERR_FAIL;
+}
+
+static smbus_err_t SMBusTransfer(smbus_handle_t handle, struct i2c_msg *msgs, int msgCount)
+{
+    return SMBusTransferResult(SMBusTransferMsgs(handle, msgs, msgCount), msgCount);
+}
+
+// Send [dataLength] bytes in a single write message, followed by a PEC if enabled
+static smbus_err_t SMBusWriteBytes(smbus_handle_t handle, uint8_t devAddr, const uint8_t *dataSent, uint16_t dataLength)
+{
+    uint8_t sendBuff[1 + dataLength + 1];
+    sendBuff[0] = (devAddr << 1) | I2C_RW_WRITE;
+    memcpy(&sendBuff[1], dataSent, dataLength);
+    sendBuff[1 + dataLength] = SMBusCrc8(CRC_INIT_VALUE, sendBuff, 1 + dataLength);
+
+    struct i2c_msg msg = {
+        .addr = devAddr,
+        .flags = 0,
+        .len = (handle->info.usePEC) ? dataLength + 1 : dataLength,
+        .buf = &sendBuff[1],
+    };
+
+    return SMBusTransfer(handle, &msg, 1);
+}
+
+// Send [sendLength] bytes then receive [recvLength] bytes after a repeated start, checking the PEC if enabled
+static smbus_err_t SMBusWriteReadBytes(smbus_handle_t handle, uint8_t devAddr, const uint8_t *dataSent, uint16_t sendLength,
+                                       uint8_t *dataRecv, uint16_t recvLength)
+{
+    uint8_t dataBuff[1 + sendLength + 1 + recvLength + 1];
+    uint8_t *recvBuff = &dataBuff[1 + sendLength + 1];
+
+    dataBuff[0] = (devAddr << 1) | I2C_RW_WRITE;
+    memcpy(&dataBuff[1], dataSent, sendLength);
+    dataBuff[1 + sendLength] = (devAddr << 1) | I2C_RW_READ;
+
+    struct i2c_msg msgs[] = {
+        { .addr = devAddr, .flags = 0, .len = sendLength, .buf = &dataBuff[1] },
+        { .addr = devAddr, .flags = I2C_M_RD, .len = (handle->info.usePEC) ? recvLength + 1 : recvLength, .buf = recvBuff },
+    };
+
+    smbus_err_t ret = SMBusTransfer(handle, msgs, 2);
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+
+    if (handle->info.usePEC)
+    {
+        uint8_t refCrc = SMBusCrc8(CRC_INIT_VALUE, dataBuff, sizeof(dataBuff) - 1);
+        if (refCrc != dataBuff[sizeof(dataBuff) - 1])
+            return SMBUS_ERR_BAD_CRC;
+    }
+
+    memcpy(dataRecv, recvBuff, recvLength);
+    return SMBUS_ERR_OK;
+}
+
+// Receive a block longer than an adapter reads with I2C_M_RECV_LEN, e.g. the 34-byte ManufacturerBlockAccess() responses.
+// The count is read on its own first, then the block is read again as raw bytes of that known length.
+static smbus_err_t SMBusWriteReadLongBlock(smbus_handle_t handle, uint8_t devAddr, const uint8_t *dataSent, uint16_t sendLength,
+                                           uint8_t *dataRecv, uint8_t *dataLength)
+{
+    uint8_t dataBuff[1 + sendLength + 1 + 1 + SMBUS_LONG_BLOCK_MAX + 1];
+    uint8_t *recvBuff = &dataBuff[1 + sendLength + 1];
+
+    dataBuff[0] = (devAddr << 1) | I2C_RW_WRITE;
+    memcpy(&dataBuff[1], dataSent, sendLength);
+    dataBuff[1 + sendLength] = (devAddr << 1) | I2C_RW_READ;
+
+    struct i2c_msg msgs[] = {
+        { .addr = devAddr, .flags = 0, .len = sendLength, .buf = &dataBuff[1] },
+        { .addr = devAddr, .flags = I2C_M_RD, .len = 1, .buf = recvBuff },
+    };
+
+    smbus_err_t ret = SMBusTransfer(handle, msgs, 2);
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+
+    uint8_t recvLen = recvBuff[0];
+    if (!recvLen)
+        return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+    msgs[1].len = (handle->info.usePEC) ? 1 + recvLen + 1 : 1 + recvLen;
+    ret = SMBusTransfer(handle, msgs, 2);
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+
+    if (recvBuff[0] != recvLen)
+        return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+    if (handle->info.usePEC)
+    {
+        uint8_t refCrc = SMBusCrc8(CRC_INIT_VALUE, dataBuff, 1 + sendLength + 1 + 1 + recvLen);
+        if (refCrc != recvBuff[1 + recvLen])
+            return SMBUS_ERR_BAD_CRC;
+    }
+
+    memcpy(dataRecv, &recvBuff[1], recvLen);
+    *dataLength = recvLen;
+    return SMBUS_ERR_OK;
+}
+
+// Send [sendLength] bytes then receive a byte count followed by that many bytes, checking the PEC if enabled
+static smbus_err_t SMBusWriteReadBlock(smbus_handle_t handle, uint8_t devAddr, const uint8_t *dataSent, uint16_t sendLength,
+                                       uint8_t *dataRecv, uint8_t *dataLength)
+{
+    uint8_t dataBuff[1 + sendLength + 1 + 1 + SMBUS_BLOCK_MAX + 1];
+    uint8_t *recvBuff = &dataBuff[1 + sendLength + 1];
+
+    dataBuff[0] = (devAddr << 1) | I2C_RW_WRITE;
+    memcpy(&dataBuff[1], dataSent, sendLength);
+    dataBuff[1 + sendLength] = (devAddr << 1) | I2C_RW_READ;
+
+    // i2c-dev takes buf[0] as the number of bytes read besides the data (the count, and the PEC) and wants room for
+    // the longest block after them. The adapter then sets len to buf[0] plus the count it reads.
+    recvBuff[0] = (handle->info.usePEC) ? 2 : 1;
+
+    struct i2c_msg msgs[] = {
+        { .addr = devAddr, .flags = 0, .len = sendLength, .buf = &dataBuff[1] },
+        { .addr = devAddr, .flags = I2C_M_RD | I2C_M_RECV_LEN, .len = recvBuff[0] + SMBUS_BLOCK_MAX, .buf = recvBuff },
+    };
+
+    // The adapter refuses a count over SMBUS_BLOCK_MAX once it has read it
+    int xfer = SMBusTransferMsgs(handle, msgs, 2);
+    if (xfer == -EPROTO || xfer == -EMSGSIZE || xfer == -EOVERFLOW)
+        return SMBusWriteReadLongBlock(handle, devAddr, dataSent, sendLength, dataRecv, dataLength);
+
+    smbus_err_t ret = SMBusTransferResult(xfer, 2);
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+
+    uint8_t recvLen = recvBuff[0];
+    if (!recvLen || recvLen > SMBUS_BLOCK_MAX)
+        return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+    if (handle->info.usePEC)
+    {
+        uint8_t refCrc = SMBusCrc8(CRC_INIT_VALUE, dataBuff, 1 + sendLength + 1 + 1 + recvLen);
+        if (refCrc != recvBuff[1 + recvLen])
+            return SMBUS_ERR_BAD_CRC;
+    }
+
+    memcpy(dataRecv, &recvBuff[1], recvLen);
+    *dataLength = recvLen;
+    return SMBUS_ERR_OK;
+}
+
+smbus_handle_t SMBusInit(void* i2cPort, int8_t myAddress, uint32_t i2cSpeed, int sdaPin,
+                         int sclPin, int intPin, long timeoutMs, bool usePec)
+{
+    const char *port = (const char *)i2cPort;
+
+    if (!port)
+        return NULL;
+
+    struct smbus_handle* busHandle = (struct smbus_handle*) calloc(1, sizeof(struct smbus_handle));
+    if(!busHandle)
+        return NULL;
+
+    busHandle->fd = -1;
+
+    if (!strcmp(port, SMBUS_SIM_PORT_NAME))
+    {
+        busHandle->sim = SMBusSimCreate(i2cSpeed);
+        if (!busHandle->sim)
+        {
+            free(busHandle);
+            return NULL;
+        }
+    }
+    else
+    {
+        busHandle->fd = open(port, O_RDWR);
+        if (busHandle->fd < 0)
+        {
+            free(busHandle);
+            return NULL;
+        }
+
+        // The bus speed is set by the adapter driver. The timeout is in units of 10ms
+        if (timeoutMs)
+            ioctl(busHandle->fd, I2C_TIMEOUT, (timeoutMs + 9) / 10);
+    }
+
+    busHandle->info.myAddress = myAddress;
+    busHandle->info.i2cSpeed = i2cSpeed;
+    busHandle->info.sdaPin = sdaPin;
+    busHandle->info.sclPin = sclPin;
+    busHandle->info.intPin = intPin;
+    busHandle->info.timeoutMs = timeoutMs;
+    busHandle->info.usePEC = usePec;
+    busHandle->info.initPEC = usePec;
+
+    return busHandle;
+}
+
+smbus_err_t SMBusDeinit(smbus_handle_t handle)
+{
+    if(!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    if (handle->sim)
+        SMBusSimDestroy(handle->sim);
+    else if (close(handle->fd) != 0)
+        return SMBUS_ERR_FAIL;
+
+    free(handle);
+    return SMBUS_ERR_OK;
+}
+
+smbus_err_t SMBusGetInfo(smbus_handle_t handle, smbus_info_t *info)
+{
+    if(!handle || !info)
+        return SMBUS_ERR_INVALID_ARG;
+
+    *info = handle->info;
+    return SMBUS_ERR_OK;
+}
+
+smbus_err_t SMBusSetPec(smbus_handle_t handle, bool usePec)
+{
+    if(!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    handle->info.usePEC = usePec;
+    return SMBUS_ERR_OK;
+}
+
+smbus_err_t SMBusQuickCommand(smbus_handle_t handle, uint8_t devAddr, bool readWriteBit)
+{
+    if (!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    struct i2c_msg msg = { .addr = devAddr, .flags = readWriteBit ? I2C_M_RD : 0, .len = 0, .buf = NULL };
+    return SMBusTransfer(handle, &msg, 1);
+}
+
+smbus_err_t SMBusSendByte(smbus_handle_t handle, uint8_t devAddr, uint8_t data)
+{
+    if (!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    return SMBusWriteBytes(handle, devAddr, &data, 1);
+}
+
+smbus_err_t SMBusReceiveByte(smbus_handle_t handle, uint8_t devAddr, uint8_t* data)
+{
+    if (!handle || !data)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t recvBuff[] = {(devAddr << 1) | I2C_RW_READ, 0, 0};
+    struct i2c_msg msg = { .addr = devAddr, .flags = I2C_M_RD, .len = (handle->info.usePEC) ? 2 : 1, .buf = &recvBuff[1] };
+
+    smbus_err_t ret = SMBusTransfer(handle, &msg, 1);
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+
+    if (handle->info.usePEC)
+    {
+        uint8_t refCrc = SMBusCrc8(CRC_INIT_VALUE, recvBuff, sizeof(recvBuff) - 1);
+        if(refCrc != recvBuff[sizeof(recvBuff) - 1])
+            return SMBUS_ERR_BAD_CRC;
+    }
+
+    *data = recvBuff[1];
+    return SMBUS_ERR_OK;
+}
+
+smbus_err_t SMBusWriteByte(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint8_t data)
+{
+    if (!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t sendBuff[] = {command, data};
+    return SMBusWriteBytes(handle, devAddr, sendBuff, sizeof(sendBuff));
+}
+
+smbus_err_t SMBusWriteWord(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint16_t data)
+{
+    if (!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t sendBuff[] = {command, (data & 0xFF), (data >> 8)};
+    return SMBusWriteBytes(handle, devAddr, sendBuff, sizeof(sendBuff));
+}
+
+smbus_err_t SMBusReadByte(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint8_t* data)
+{
+    if (!handle || !data)
+        return SMBUS_ERR_INVALID_ARG;
+
+    return SMBusWriteReadBytes(handle, devAddr, &command, 1, data, 1);
+}
+
+smbus_err_t SMBusReadWord(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint16_t* data)
+{
+    if(!handle || !data)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t recvBuff[2];
+    smbus_err_t ret = SMBusWriteReadBytes(handle, devAddr, &command, 1, recvBuff, sizeof(recvBuff));
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+
+    *data = ((uint16_t)recvBuff[1] << 8) | recvBuff[0];
+    return SMBUS_ERR_OK;
+}
+
+smbus_err_t SMBusProcessCall(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint16_t dataSent, uint16_t* dataRecv)
+{
+    if(!handle || !dataRecv)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t sendBuff[] = {command, (dataSent & 0xFF), (dataSent >> 8)};
+    uint8_t recvBuff[2];
+
+    smbus_err_t ret = SMBusWriteReadBytes(handle, devAddr, sendBuff, sizeof(sendBuff), recvBuff, sizeof(recvBuff));
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+
+    *dataRecv = ((uint16_t)recvBuff[1] << 8) | recvBuff[0];
+    return SMBUS_ERR_OK;
+}
+
+smbus_err_t SMBusBlockWrite(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint8_t* dataSent, uint8_t dataLength)
+{
+    if(!handle || !dataSent || !dataLength)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t sendBuff[2 + dataLength];
+    sendBuff[0] = command;
+    sendBuff[1] = dataLength;
+    memcpy(&sendBuff[2], dataSent, dataLength);
+
+    return SMBusWriteBytes(handle, devAddr, sendBuff, sizeof(sendBuff));
+}
+
+smbus_err_t SMBusBlockRead(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint8_t* dataRecv, uint8_t *dataLength)
+{
+    if(!handle || !dataRecv || !dataLength)
+        return SMBUS_ERR_INVALID_ARG;
+
+    return SMBusWriteReadBlock(handle, devAddr, &command, 1, dataRecv, dataLength);
+}
+
+smbus_err_t SMBusBlockWriteBlockReadProcessCall(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint8_t* dataSent,
+                                                    uint8_t dataSentLength, uint8_t* dataRecv, uint8_t* dataRecvLength)
+{
+    if(!handle || !dataSent || !dataSentLength || !dataRecv || !dataRecvLength)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t sendBuff[2 + dataSentLength];
+    sendBuff[0] = command;
+    sendBuff[1] = dataSentLength;
+    memcpy(&sendBuff[2], dataSent, dataSentLength);
+
+    return SMBusWriteReadBlock(handle, devAddr, sendBuff, sizeof(sendBuff), dataRecv, dataRecvLength);
+}
+
+smbus_err_t SMBusHostNotify(smbus_handle_t handle, uint8_t hostAddr, uint8_t devAddr, uint16_t data)
+{
+    if (!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t sendBuff[] = {(devAddr << 1), data & 0xFF, data >> 8};
+    struct i2c_msg msg = { .addr = hostAddr, .flags = 0, .len = sizeof(sendBuff), .buf = sendBuff };
+
+    return SMBusTransfer(handle, &msg, 1);
+}
+
+smbus_err_t SMBusWrite32(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint32_t dataSent)
+{
+    if(!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t sendBuff[1 + sizeof(uint32_t)];
+    sendBuff[0] = command;
+    for (int i = 0; i < 4; i++)
+        sendBuff[1 + i] = (dataSent >> (i * 8)) & 0xFF;
+
+    return SMBusWriteBytes(handle, devAddr, sendBuff, sizeof(sendBuff));
+}
+
+smbus_err_t SMBusRead32(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint32_t *dataRecv)
+{
+    if(!handle || !dataRecv)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t recvBuff[sizeof(uint32_t)];
+    smbus_err_t ret = SMBusWriteReadBytes(handle, devAddr, &command, 1, recvBuff, sizeof(recvBuff));
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+
+    *dataRecv = 0;
+    for (int i = 3; i >= 0; i--)
+        *dataRecv = (*dataRecv << 8) | recvBuff[i];
+
+    return SMBUS_ERR_OK;
+}
+
+smbus_err_t SMBusWrite64(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint64_t dataSent)
+{
+    if(!handle)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t sendBuff[1 + sizeof(uint64_t)];
+    sendBuff[0] = command;
+    for (int i = 0; i < 8; i++)
+        sendBuff[1 + i] = (dataSent >> (i * 8)) & 0xFF;
+
+    return SMBusWriteBytes(handle, devAddr, sendBuff, sizeof(sendBuff));
+}
+
+smbus_err_t SMBusRead64(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint64_t *dataRecv)
+{
+    if(!handle || !dataRecv)
+        return SMBUS_ERR_INVALID_ARG;
+
+    uint8_t recvBuff[sizeof(uint64_t)];
+    smbus_err_t ret = SMBusWriteReadBytes(handle, devAddr, &command, 1, recvBuff, sizeof(recvBuff));
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+
+    *dataRecv = 0;
+    for (int i = 7; i >= 0; i--)
+        *dataRecv = (*dataRecv << 8) | recvBuff[i];
+
+    return SMBUS_ERR_OK;
+}
+
+smbus_err_t SMBusWrite16Block(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint16_t dataSent)
+{
+    uint8_t dataBuff[] = {(dataSent >> 0) & 0xFF,
+                          (dataSent >> 8) & 0xFF};
+
+    return SMBusBlockWrite(handle, devAddr, command, dataBuff, sizeof(uint16_t));
+}
+
+smbus_err_t SMBusRead16Block(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint16_t *dataRecv)
+{
+    uint8_t dataBuff[SMBUS_LONG_BLOCK_MAX];
+    uint8_t recvLen;
+    smbus_err_t ret = SMBusBlockRead(handle, devAddr, command, dataBuff, &recvLen);
+
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+    if (recvLen != sizeof(uint16_t))
+        return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+    *dataRecv = ((uint16_t)dataBuff[1] << 8) | dataBuff[0];
+    return SMBUS_ERR_OK;
+}
+
+smbus_err_t SMBusWrite32Block(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint32_t dataSent)
+{
+    uint8_t dataBuff[sizeof(uint32_t)];
+    for (int i = 0; i < 4; i++)
+        dataBuff[i] = (dataSent >> (i * 8)) & 0xFF;
+
+    return SMBusBlockWrite(handle, devAddr, command, dataBuff, sizeof(dataBuff));
+}
+
+smbus_err_t SMBusRead32Block(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint32_t *dataRecv)
+{
+    uint8_t dataBuff[SMBUS_LONG_BLOCK_MAX];
+    uint8_t recvLen;
+    smbus_err_t ret = SMBusBlockRead(handle, devAddr, command, dataBuff, &recvLen);
+
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+    if (recvLen != sizeof(uint32_t))
+        return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+    *dataRecv = 0;
+    for (int i = 3; i >= 0; i--)
+        *dataRecv = (*dataRecv << 8) | dataBuff[i];
+
+    return SMBUS_ERR_OK;
+}
+
+smbus_err_t SMBusWrite64Block(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint64_t dataSent)
+{
+    uint8_t dataBuff[sizeof(uint64_t)];
+    for (int i = 0; i < 8; i++)
+        dataBuff[i] = (dataSent >> (i * 8)) & 0xFF;
+
+    return SMBusBlockWrite(handle, devAddr, command, dataBuff, sizeof(dataBuff));
+}
+
+smbus_err_t SMBusRead64Block(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint64_t *dataRecv)
+{
+    uint8_t dataBuff[SMBUS_LONG_BLOCK_MAX];
+    uint8_t recvLen;
+    smbus_err_t ret = SMBusBlockRead(handle, devAddr, command, dataBuff, &recvLen);
+
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+    if (recvLen != sizeof(uint64_t))
+        return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+    *dataRecv = 0;
+    for (int i = 7; i >= 0; i--)
+        *dataRecv = (*dataRecv << 8) | dataBuff[i];
+
+    return SMBUS_ERR_OK;
+}
+
+smbus_err_t SMBusWriteRaw(smbus_handle_t handle, uint8_t devAddr, uint8_t *dataSent, uint8_t dataLength)
+{
+    if (!handle || !dataSent)
+        return SMBUS_ERR_INVALID_ARG;
+
+    struct i2c_msg msg = { .addr = devAddr, .flags = 0, .len = dataLength, .buf = dataSent };
+    return SMBusTransfer(handle, &msg, 1);
+}
+
+smbus_err_t SMBusReadRaw(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint8_t *dataRecv, uint8_t dataLength)
+{
+    if (!handle || !dataRecv || !dataLength)
+        return SMBUS_ERR_INVALID_ARG;
+
+    struct i2c_msg msgs[] = {
+        { .addr = devAddr, .flags = 0, .len = 1, .buf = &command },
+        { .addr = devAddr, .flags = I2C_M_RD, .len = dataLength, .buf = dataRecv },
+    };
+    return SMBusTransfer(handle, msgs, 2);
+}
+
+smbus_err_t SMBusWriteWordReadBlock(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint16_t word, bool wordFlipEndianness,
+                                       uint8_t responseCommand, uint8_t *dataRecv, uint8_t *dataLength, int delayMs)
+{
+    if(wordFlipEndianness)
+        word = (word << 8) | (word >> 8);
+
+    smbus_err_t ret = SMBusWriteWord(handle, devAddr, command, word);
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+
+    if(delayMs > 0)
+        SMBusPlatformDelayMs(delayMs);
+
+    return SMBusBlockRead(handle, devAddr, responseCommand, dataRecv, dataLength);
+}
+
+smbus_err_t SMBusWriteWordWriteBlock(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint16_t word, bool wordFlipEndianness,
+                                        uint8_t responseCommand, uint8_t *dataSent, uint8_t dataLength, int delayMs)
+{
+    if (wordFlipEndianness)
+        word = (word << 8) | (word >> 8);
+
+    smbus_err_t ret = SMBusWriteWord(handle, devAddr, command, word);
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+
+    if(delayMs > 0)
+        SMBusPlatformDelayMs(delayMs);
+
+    return SMBusBlockWrite(handle, devAddr, responseCommand, dataSent, dataLength);
+}
+
+smbus_err_t SMBusWriteWordBlockReadBlock(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint16_t word,
+                                            uint8_t responseCommand, uint8_t *dataRecv, uint8_t *dataLength, int delayMs)
+{
+    smbus_err_t ret = SMBusWrite16Block(handle, devAddr, command, word);
+    if (ret != SMBUS_ERR_OK)
+        return ret;
+
+    if(delayMs > 0)
+        SMBusPlatformDelayMs(delayMs);
+
+    return SMBusBlockRead(handle, devAddr, responseCommand, dataRecv, dataLength);
+}
+
+void SMBusPlatformDelayMs(uint32_t delayMs)
+{
+    struct timespec ts = { .tv_sec = delayMs / 1000, .tv_nsec = (delayMs % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+uint32_t SMBusPlatformMillis(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+smbus_mutex_t SMBusPlatformMutexCreate(void)
+{
+    pthread_mutex_t *mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
+    if (mutex && pthread_mutex_init(mutex, NULL) != 0)
+    {
+        free(mutex);
+        mutex = NULL;
+    }
+
+    return (smbus_mutex_t)mutex;
+}
+
+void SMBusPlatformMutexLock(smbus_mutex_t mutex)
+{
+    pthread_mutex_lock((pthread_mutex_t *)mutex);
+}
+
+void SMBusPlatformMutexUnlock(smbus_mutex_t mutex)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)mutex);
+}
+
+void SMBusPlatformMutexDelete(smbus_mutex_t mutex)
+{
+    if (!mutex)
+        return;
+
+    pthread_mutex_destroy((pthread_mutex_t *)mutex);
+    free(mutex);
+}
+
+static uint8_t SMBusCrc8(uint8_t crc8, uint8_t const *data, uint16_t dataLength)
+{
+    if (!data)
+        return 0xff;
+
+    while (dataLength--)
+    {
+        crc8 ^= *data++;
+        for (uint8_t k = 0; k < 8; k++)
+            crc8 = crc8 & 0x80 ? (crc8 << 1) ^ 0x07 : crc8 << 1;
+    }
+
+    return crc8;
+}
@@ -42,11 +42,14 @@ typedef struct
     int sdaPin;
     int sclPin;
     int intPin;         // I2C Interrupt/SMBALERT pin
-    int usePEC;         // Whether to append/check a checksum byte when sending/receiving
+    int usePEC;         // Whether to append/check a checksum byte when sending/receiving. See SMBusSetPec()
+    int initPEC;        // The usePec of SMBusInit(), which SMBusSetPec() doesn't change
 }smbus_info_t;
 
 typedef struct smbus_handle* smbus_handle_t;
 
+typedef struct smbus_mutex* smbus_mutex_t;
+
 /****************************************************SMBus Protocol Functions***************************************/
 
 /**
@@ -66,6 +69,13 @@ smbus_err_t SMBusDeinit(smbus_handle_t handle);
  */
 smbus_err_t SMBusGetInfo(smbus_handle_t handle, smbus_info_t *info);
 
+/**
+ * @brief           Enable or disable PEC for the transactions that follow on the bus.
+ *                  Lets devices with and without PEC support share a bus: select the setting of each device
+ *                  before talking to it. The usePec of SMBusInit() is the initial setting, and stays in initPEC.
+ **/
+smbus_err_t SMBusSetPec(smbus_handle_t handle, bool usePec);
+
 /**
  * @brief                       Send the device address along with a read/write bit
  * @param       devAddr         7-bit peripheral device address
@@ -284,6 +294,15 @@ smbus_err_t SMBusRead64Block(smbus_handle_t handle, uint8_t devAddr, uint8_t com
  **/
 smbus_err_t SMBusWriteRaw(smbus_handle_t handle, uint8_t devAddr, uint8_t *dataSent, uint8_t dataLength);
 
+/**
+ * @brief                   send a command byte then receive [datalength] consecutive bytes of data using standard I2C
+ * @param       devAddr     7-bit peripheral device address
+ *
+ * @sequence:               S,ADDRESS+W,a,COMMAND,a,Sr,ADDRESS+R,a,data byte 1,A,data byte 2,A,...,data byte N,N,P
+ *
+ **/
+smbus_err_t SMBusReadRaw(smbus_handle_t handle, uint8_t devAddr, uint8_t command, uint8_t *dataRecv, uint8_t dataLength);
+
 /**
  * @brief                   send an 8-bit command followed by an 16-bit word then receive a chunk of data using ReadBlock() protocol
  * @param   devAddr         7-bit peripheral device address
@@ -321,4 +340,24 @@ smbus_err_t SMBusWriteWordBlockReadBlock(smbus_handle_t handle, uint8_t devAddr,
  **/
 void SMBusPlatformDelayMs(uint32_t delayMs);
 
+/**
+ * @brief platform-specific millisecond tick count. Only differences between two values are meaningful and it may wrap around
+ **/
+uint32_t SMBusPlatformMillis(void);
+
+/**
+ * @brief   platform-specific mutex used to serialize access to a device shared by several tasks
+ * @return  The mutex or NULL on failure
+ **/
+smbus_mutex_t SMBusPlatformMutexCreate(void);
+
+/**
+ * @brief Block until the mutex is available and take it
+ **/
+void SMBusPlatformMutexLock(smbus_mutex_t mutex);
+
+void SMBusPlatformMutexUnlock(smbus_mutex_t mutex);
+
+void SMBusPlatformMutexDelete(smbus_mutex_t mutex);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,574 @@
+/**
+ * @file    smbus_sim.c  -   In-process simulated SMBus segment populated with smart batteries behind I2C muxes
+ * @author  skuodi
+ * @date    18 October 2026.
+ *
+ * **/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "smbus_sim.h"
+
+#define SIM_MUX_COUNT           (SMBUS_SIM_MUX_ADDRESS_LAST - SMBUS_SIM_MUX_ADDRESS_FIRST + 1)
+#define SIM_MUX_CHANNELS        8
+#define SIM_ROUTE_DIRECT        (SIM_MUX_COUNT * SIM_MUX_CHANNELS)  // Batteries connected directly to the segment
+#define SIM_ROUTE_SELECTOR      (SIM_ROUTE_DIRECT + 1)              // Batteries A - D behind the selector
+#define SIM_SELECTOR_BATTERIES  4
+#define SIM_ROUTE_COUNT         (SIM_ROUTE_SELECTOR + SIM_SELECTOR_BATTERIES)
+#define SIM_ADDRESS_COUNT       128
+
+#define SIM_BLOCK_MAX           255             // SMBus 3.0 block size
+
+#define SIM_DF_START            0x4000          // bq40z50 data flash, accessed through ManufacturerBlockAccess()
+#define SIM_DF_END              0x6000
+#define SIM_DF_ROW_SIZE         32
+
+#define SIM_SEC_FULL_ACCESS     1               // OperationStatus() SEC1:SEC0
+#define SIM_SEC_UNSEALED        2
+#define SIM_SEC_SEALED          3
+#define SIM_SEC_DELAY_MS        250             // A key or SEAL takes this long to change the mode
+
+#define SIM_UNSEAL_KEY          0x04143672      // Default bq40z50 keys, sent as two words to ManufacturerAccess()
+#define SIM_FULL_ACCESS_KEY     0xFFFFFFFF
+
+typedef struct
+{
+    uint16_t serial;
+    bool pec;                   // Supports PEC. A battery without it leaves the bus idle (0xFF) where the PEC would be.
+    uint32_t reads;             // Number of transfers served, used to make the readings move
+    uint16_t macCommand;        // Last command written to ManufacturerAccess() or ManufacturerBlockAccess()
+    uint16_t atRate;
+    uint16_t batteryMode;
+    uint8_t *dataFlash;         // Allocated on the first data flash access
+    uint16_t lastWord;          // Previous word written to ManufacturerAccess(), the first half of a key
+    uint8_t security;           // SEC bits of OperationStatus()
+    uint8_t securityNext;       // Mode a key or SEAL changes to at securityDue, 0 if none is pending
+    struct timespec securityDue;
+}sim_battery_t;
+
+struct smbus_sim
+{
+    uint32_t i2cSpeed;
+    uint8_t muxMask[SIM_MUX_COUNT];                             // Enabled channels of each mux
+    sim_battery_t *battery[SIM_ROUTE_COUNT][SIM_ADDRESS_COUNT];
+    uint16_t selectorState;                                     // SMB, POWER_BY, CHARGE and PRESENT nibbles
+};
+
+static uint8_t SMBusSimCrc8(uint8_t crc8, uint8_t const *data, uint16_t dataLength)
+{
+    while (dataLength--)
+    {
+        crc8 ^= *data++;
+        for (uint8_t k = 0; k < 8; k++)
+            crc8 = crc8 & 0x80 ? (crc8 << 1) ^ 0x07 : crc8 << 1;
+    }
+
+    return crc8;
+}
+
+// Sleep for as long as the transfer would have occupied a real bus: 9 clocks per byte plus start/stop conditions
+static void SMBusSimWireDelay(smbus_sim_t *sim, struct i2c_msg *msgs, int msgCount)
+{
+    if (!sim->i2cSpeed)
+        return;
+
+    uint64_t bits = 2;
+    for (int i = 0; i < msgCount; i++)
+        bits += 9 * (1 + msgs[i].len) + 1;
+
+    uint64_t ns = bits * 1000000000ULL / sim->i2cSpeed;
+    struct timespec ts = { .tv_sec = ns / 1000000000ULL, .tv_nsec = ns % 1000000000ULL };
+    nanosleep(&ts, NULL);
+}
+
+static sim_battery_t *SMBusSimGetBattery(smbus_sim_t *sim, uint8_t devAddr)
+{
+    int route = -1;
+
+    for (int m = 0; m < SIM_MUX_COUNT; m++)
+    {
+        for (int c = 0; c < SIM_MUX_CHANNELS; c++)
+        {
+            if (!(sim->muxMask[m] & (1 << c)))
+                continue;
+            // More than one enabled channel means more than one battery answers at this address
+            if (route >= 0)
+                return NULL;
+            route = m * SIM_MUX_CHANNELS + c;
+        }
+    }
+
+    // The default battery address reaches the battery the SMB nibble of the selector selects
+    if (route < 0 && devAddr == 0x0B)
+    {
+        for (int b = 0; b < SIM_SELECTOR_BATTERIES; b++)
+            if ((sim->selectorState >> 12) == (1 << b))
+                route = SIM_ROUTE_SELECTOR + b;
+        if (route < 0)
+            return NULL;
+    }
+
+    if (route < 0)
+        route = SIM_ROUTE_DIRECT;
+
+    sim_battery_t *battery = sim->battery[route][devAddr];
+    if (battery)
+        return battery;
+
+    battery = (sim_battery_t *)calloc(1, sizeof(sim_battery_t));
+    if (!battery)
+        return NULL;
+
+    battery->serial = (uint16_t)((route << 7) | devAddr);
+    battery->security = SIM_SEC_SEALED;
+    battery->pec = devAddr & 1;
+    sim->battery[route][devAddr] = battery;
+    return battery;
+}
+
+static bool SMBusSimReadWord(sim_battery_t *battery, uint8_t command, uint16_t *value)
+{
+    uint16_t drift = (battery->reads / 16) % 200;
+
+    switch (command)
+    {
+        case 0x00: *value = battery->macCommand;                break;  // ManufacturerAccess
+        case 0x01: *value = 500;                                break;  // RemainingCapacityAlarm
+        case 0x02: *value = 10;                                 break;  // RemainingTimeAlarm
+        case 0x03: *value = battery->batteryMode;               break;  // BatteryMode
+        case 0x04: *value = battery->atRate;                    break;  // AtRate
+        case 0x05: *value = battery->atRate ? 120 : 0xFFFF;     break;  // AtRateTimeToFull
+        case 0x06: *value = battery->atRate ? 90 : 0xFFFF;      break;  // AtRateTimeToEmpty
+        case 0x07: *value = 1;                                  break;  // AtRateOK
+        case 0x08: *value = 2981 + drift / 20;                  break;  // Temperature 0.1K
+        case 0x09: *value = 12000 + drift;                      break;  // Voltage mV
+        case 0x0A: *value = (uint16_t)(-500 - (int)drift);      break;  // Current mA
+        case 0x0B: *value = (uint16_t)-500;                     break;  // AverageCurrent mA
+        case 0x0C: *value = 1;                                  break;  // MaxError %
+        case 0x0D: *value = 80 - drift / 10;                    break;  // RelativeStateOfCharge %
+        case 0x0E: *value = 75 - drift / 10;                    break;  // AbsoluteStateOfCharge %
+        case 0x0F: *value = 4000 - drift;                       break;  // RemainingCapacity
+        case 0x10: *value = 5000;                               break;  // FullChargeCapacity
+        case 0x11: case 0x12: *value = 480;                     break;  // RunTimeToEmpty, AverageTimeToEmpty
+        case 0x13: *value = 0xFFFF;                             break;  // AverageTimeToFull
+        case 0x14: *value = 2000;                               break;  // ChargingCurrent
+        case 0x15: *value = 12600;                              break;  // ChargingVoltage
+        case 0x16: *value = 0x00C0;                             break;  // BatteryStatus: initialized, discharging
+        case 0x17: *value = 42;                                 break;  // CycleCount
+        case 0x18: *value = 5200;                               break;  // DesignCapacity
+        case 0x19: *value = 11100;                              break;  // DesignVoltage
+        case 0x1A: *value = battery->pec ? 0x0031 : 0x0021;     break;  // SpecificationInfo: 1.1 with or without PEC, no scaling
+        case 0x1B: *value = (44 << 9) | (6 << 5) | 15;          break;  // ManufactureDate 2024-06-15
+        case 0x1C: *value = battery->serial;                    break;  // SerialNumber
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+static uint8_t *SMBusSimDataFlash(sim_battery_t *battery)
+{
+    if (battery->dataFlash)
+        return battery->dataFlash;
+
+    battery->dataFlash = (uint8_t *)malloc(SIM_DF_END - SIM_DF_START);
+    if (!battery->dataFlash)
+        return NULL;
+
+    // Contents that differ between addresses and between batteries
+    for (uint32_t i = 0; i < SIM_DF_END - SIM_DF_START; i++)
+        battery->dataFlash[i] = (uint8_t)((i * 7) ^ (i >> 8) ^ battery->serial);
+
+    return battery->dataFlash;
+}
+
+static void SMBusSimChangeSecurity(sim_battery_t *battery, uint8_t security)
+{
+    clock_gettime(CLOCK_MONOTONIC, &battery->securityDue);
+    battery->securityDue.tv_nsec += SIM_SEC_DELAY_MS * 1000000L;
+    battery->securityDue.tv_sec += battery->securityDue.tv_nsec / 1000000000L;
+    battery->securityDue.tv_nsec %= 1000000000L;
+    battery->securityNext = security;
+}
+
+// Apply a pending mode change once it is due
+static void SMBusSimUpdateSecurity(sim_battery_t *battery)
+{
+    struct timespec now;
+
+    if (!battery->securityNext)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec > battery->securityDue.tv_sec ||
+        (now.tv_sec == battery->securityDue.tv_sec && now.tv_nsec >= battery->securityDue.tv_nsec))
+    {
+        battery->security = battery->securityNext;
+        battery->securityNext = 0;
+    }
+}
+
+static bool SMBusSimIsDataFlash(uint16_t address)
+{
+    return address >= SIM_DF_START && address < SIM_DF_END;
+}
+
+static uint8_t SMBusSimReadBlock(sim_battery_t *battery, uint8_t command, uint8_t *data)
+{
+    const char *str = NULL;
+    uint8_t len = 0;
+
+    switch (command)
+    {
+        case 0x20: str = "SimCorp";     break;  // ManufacturerName
+        case 0x21: str = "SIM-PACK";    break;  // DeviceName
+        case 0x22: str = "LION";        break;  // DeviceChemistry
+
+        case 0x23:  // ManufacturerData: response to the last ManufacturerAccess() command
+        case 0x44:  // ManufacturerBlockAccess: same response, prefixed by the command
+            if (command == 0x44)
+            {
+                data[len++] = battery->macCommand & 0xFF;
+                data[len++] = battery->macCommand >> 8;
+
+                // A data flash address returns the row starting at it
+                if (SMBusSimIsDataFlash(battery->macCommand))
+                {
+                    uint8_t *dataFlash = SMBusSimDataFlash(battery);
+                    if (!dataFlash)
+                        return 0;
+                    uint16_t rowLen = SIM_DF_END - battery->macCommand;
+                    if (rowLen > SIM_DF_ROW_SIZE)
+                        rowLen = SIM_DF_ROW_SIZE;
+                    memcpy(&data[len], &dataFlash[battery->macCommand - SIM_DF_START], rowLen);
+                    return len + rowLen;
+                }
+
+                // DataFlashChecksum
+                if (battery->macCommand == 0x0005)
+                {
+                    uint8_t *dataFlash = SMBusSimDataFlash(battery);
+                    if (!dataFlash)
+                        return 0;
+                    uint16_t checksum = 0;
+                    for (uint32_t i = 0; i < SIM_DF_END - SIM_DF_START; i++)
+                        checksum += dataFlash[i];
+                    data[len++] = checksum & 0xFF;
+                    data[len++] = checksum >> 8;
+                    return len;
+                }
+            }
+
+            // OperationStatus
+            if (battery->macCommand == 0x0054)
+            {
+                SMBusSimUpdateSecurity(battery);
+                data[len++] = 0;
+                data[len++] = battery->security;
+                data[len++] = 0;
+                data[len++] = 0;
+                return len;
+            }
+
+            // Calibration output: counter moves on every 4 reads, counts jitter by a few LSB around fixed values
+            if (battery->macCommand == 0xF081 || battery->macCommand == 0xF082)
+            {
+                bool shorted = battery->macCommand == 0xF082;
+                int16_t noise = (int16_t)((battery->reads * 7) % 5) - 2;
+                int16_t word[12] = {-12, 16000, 16010, 15990, 0, 24000, 24010, 3, 3, 3, 0};
+                if (!shorted)
+                    word[0] = 8192;
+                data[len++] = (uint8_t)(battery->reads / 4);
+                data[len++] = shorted ? 2 : 1;
+                for (uint8_t i = 0; i < 12; i++)
+                {
+                    uint16_t value = (uint16_t)(word[i] + noise);
+                    data[len++] = value & 0xFF;
+                    data[len++] = value >> 8;
+                }
+                return len;
+            }
+
+            // DAStatus1: 3S pack, so CellVoltage4 reads 0. The cells drift apart as the readings move.
+            if (battery->macCommand == 0x0071)
+            {
+                uint16_t drift = (battery->reads / 16) % 200;
+                uint16_t word[16] = {4000 + drift / 4, 4002, 4001 - drift / 8, 0, 12000, 12000, (uint16_t)-500,
+                                     (uint16_t)-500, (uint16_t)-500, 0, (uint16_t)-2000, (uint16_t)-2000,
+                                     (uint16_t)-2000, 0, (uint16_t)-6000, (uint16_t)-6000};
+                for (uint8_t i = 0; i < 16; i++)
+                {
+                    data[len++] = word[i] & 0xFF;
+                    data[len++] = word[i] >> 8;
+                }
+                return len;
+            }
+
+            // DAStatus2: internal, TS1-TS4, cell, FET and gauging temperatures
+            if (battery->macCommand == 0x0072)
+            {
+                uint16_t word[8] = {2991, 2981, 2983, 2985, 2987, 2983, 3001, 2983};
+                for (uint8_t i = 0; i < 8; i++)
+                {
+                    data[len++] = word[i] & 0xFF;
+                    data[len++] = word[i] >> 8;
+                }
+                return len;
+            }
+
+            for (uint8_t i = 0; i < 4; i++)
+                data[len++] = (uint8_t)(battery->macCommand >> (i & 1 ? 8 : 0)) ^ i;
+            return len;
+
+        default:
+            return 0;
+    }
+
+    len = (uint8_t)strlen(str);
+    memcpy(data, str, len);
+    return len;
+}
+
+static void SMBusSimWrite(sim_battery_t *battery, uint8_t *data, uint16_t len)
+{
+    if (len < 3)
+        return;
+
+    SMBusSimUpdateSecurity(battery);
+
+    switch (data[0])
+    {
+        case 0x00:  // ManufacturerAccess
+        {
+            uint16_t word = data[1] | (data[2] << 8);
+            uint32_t key = ((uint32_t)battery->lastWord << 16) | word;
+
+            if (word == 0x0030)
+                SMBusSimChangeSecurity(battery, SIM_SEC_SEALED);
+            else if (key == SIM_UNSEAL_KEY && battery->security == SIM_SEC_SEALED)
+                SMBusSimChangeSecurity(battery, SIM_SEC_UNSEALED);
+            else if (key == SIM_FULL_ACCESS_KEY && battery->security == SIM_SEC_UNSEALED)
+                SMBusSimChangeSecurity(battery, SIM_SEC_FULL_ACCESS);
+
+            // A key is only taken as two words in a row
+            battery->lastWord = (key == SIM_UNSEAL_KEY || key == SIM_FULL_ACCESS_KEY) ? 0 : word;
+            battery->macCommand = word;
+            break;
+        }
+        case 0x03:  // BatteryMode
+            battery->batteryMode = data[1] | (data[2] << 8);
+            break;
+        case 0x04:  // AtRate
+            battery->atRate = data[1] | (data[2] << 8);
+            break;
+        case 0x44:  // ManufacturerBlockAccess
+            if (len >= 4 && data[1] >= 2)
+                battery->macCommand = data[2] | (data[3] << 8);
+
+            // An address followed by data writes the data flash, unless sealed
+            if (battery->security != SIM_SEC_SEALED && data[1] > 2 && data[1] <= 2 + SIM_DF_ROW_SIZE && len >= 2 + data[1] && SMBusSimIsDataFlash(battery->macCommand) &&
+                battery->macCommand + data[1] - 2 <= SIM_DF_END)
+            {
+                uint8_t *dataFlash = SMBusSimDataFlash(battery);
+                if (dataFlash)
+                    memcpy(&dataFlash[battery->macCommand - SIM_DF_START], &data[4], data[1] - 2);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Fill a read message and append a PEC if the host asked for one more byte than the response holds
+static int SMBusSimFillRead(sim_battery_t *battery, struct i2c_msg *write, struct i2c_msg *read, uint8_t *data, uint8_t dataLength)
+{
+    uint8_t pecLen = 0;
+
+    if (read->flags & I2C_M_RECV_LEN)
+    {
+        pecLen = (read->buf[0] > 1) ? 1 : 0;
+        read->buf[0] = dataLength;
+        memcpy(&read->buf[1], data, dataLength);
+        read->len = 1 + dataLength + pecLen;
+        dataLength += 1;
+    }
+    else
+    {
+        // A shorter read is NACKed early by the host, e.g. a ReadByte() of a word register
+        if (read->len < dataLength)
+            dataLength = read->len;
+        pecLen = (read->len > dataLength) ? 1 : 0;
+        memcpy(read->buf, data, dataLength);
+    }
+
+    if (pecLen && !battery->pec)
+        read->buf[dataLength] = 0xFF;
+    else if (pecLen)
+    {
+        uint8_t addr = read->addr << 1;
+        uint8_t crc = SMBusSimCrc8(0, &addr, 1);
+        crc = SMBusSimCrc8(crc, write->buf, write->len);
+        addr |= 1;
+        crc = SMBusSimCrc8(crc, &addr, 1);
+        read->buf[dataLength] = SMBusSimCrc8(crc, read->buf, dataLength);
+    }
+
+    return 0;
+}
+
+smbus_sim_t* SMBusSimCreate(uint32_t i2cSpeed)
+{
+    smbus_sim_t *sim = (smbus_sim_t *)calloc(1, sizeof(smbus_sim_t));
+    if (!sim)
+        return NULL;
+
+    sim->i2cSpeed = i2cSpeed;
+    sim->selectorState = 0x110F;    // SMB to and powered by battery A, all present
+    return sim;
+}
+
+void SMBusSimDestroy(smbus_sim_t *sim)
+{
+    if (!sim)
+        return;
+
+    for (int r = 0; r < SIM_ROUTE_COUNT; r++)
+        for (int a = 0; a < SIM_ADDRESS_COUNT; a++)
+        {
+            if (sim->battery[r][a])
+                free(sim->battery[r][a]->dataFlash);
+            free(sim->battery[r][a]);
+        }
+
+    free(sim);
+}
+
+// Hand the transfer to the mux, selector or battery at the address
+static int SMBusSimRoute(smbus_sim_t *sim, struct i2c_msg *msgs, int msgCount)
+{
+    uint8_t devAddr = msgs[0].addr & 0x7F;
+
+    if (devAddr >= SMBUS_SIM_MUX_ADDRESS_FIRST && devAddr <= SMBUS_SIM_MUX_ADDRESS_LAST)
+    {
+        uint8_t *mask = &sim->muxMask[devAddr - SMBUS_SIM_MUX_ADDRESS_FIRST];
+
+        if (msgCount != 1 || msgs[0].len > 1)
+            return -EIO;
+        if (msgs[0].len == 1)
+        {
+            if (msgs[0].flags & I2C_M_RD)
+                msgs[0].buf[0] = *mask;
+            else
+                *mask = msgs[0].buf[0];
+        }
+        return msgCount;
+    }
+
+    if (devAddr == SMBUS_SIM_SELECTOR_ADDRESS)
+    {
+        // Word write to SelectorState(). PRESENT is read only.
+        if (msgCount == 1)
+        {
+            if ((msgs[0].flags & I2C_M_RD) || msgs[0].len < 3 || msgs[0].buf[0] != 0x01)
+                return -EIO;
+            uint16_t state = msgs[0].buf[1] | (msgs[0].buf[2] << 8);
+            sim->selectorState = (state & 0xFFF0) | (sim->selectorState & 0x000F);
+            return msgCount;
+        }
+
+        // Word read of SelectorState() or SelectorInfo(): SBSM 1.1, 4 batteries. A PEC byte reads as idle bus.
+        if ((msgs[0].flags & I2C_M_RD) || !(msgs[1].flags & I2C_M_RD) || msgs[0].len < 1 || msgs[1].len < 2)
+            return -EIO;
+        uint16_t word;
+        if (msgs[0].buf[0] == 0x01)
+            word = sim->selectorState;
+        else if (msgs[0].buf[0] == 0x04)
+            word = 0x001F;
+        else
+            return -EIO;
+        msgs[1].buf[0] = word & 0xFF;
+        msgs[1].buf[1] = word >> 8;
+        if (msgs[1].len > 2)
+            msgs[1].buf[2] = 0xFF;
+        return msgCount;
+    }
+
+    sim_battery_t *battery = SMBusSimGetBattery(sim, devAddr);
+    if (!battery)
+        return -EIO;
+
+    battery->reads++;
+
+    // Quick command, or a plain write
+    if (msgCount == 1)
+    {
+        if (msgs[0].flags & I2C_M_RD)
+            return (msgs[0].len == 0) ? msgCount : -EIO;
+
+        SMBusSimWrite(battery, msgs[0].buf, msgs[0].len);
+        return msgCount;
+    }
+
+    // Write command then read the response
+    if ((msgs[0].flags & I2C_M_RD) || !(msgs[1].flags & I2C_M_RD) || msgs[0].len < 1)
+        return -EIO;
+
+    uint8_t command = msgs[0].buf[0];
+    uint8_t data[1 + SIM_BLOCK_MAX];
+    uint16_t word;
+    uint8_t dataLength;
+
+    if (msgs[1].flags & I2C_M_RECV_LEN)
+    {
+        dataLength = SMBusSimReadBlock(battery, command, data);
+        if (!dataLength)
+            return -EIO;
+        // Like adapters do, refuse a count longer than a RECV_LEN read takes once it has been read
+        if (dataLength > I2C_SMBUS_BLOCK_MAX)
+            return -EPROTO;
+    }
+    else if (SMBusSimReadWord(battery, command, &word))
+    {
+        data[0] = word & 0xFF;
+        data[1] = word >> 8;
+        dataLength = 2;
+    }
+    else
+    {
+        // A plain read of a block command gets the count and the block as ordinary bytes
+        dataLength = SMBusSimReadBlock(battery, command, &data[1]);
+        if (!dataLength)
+            return -EIO;
+        data[0] = dataLength++;
+    }
+
+    return (SMBusSimFillRead(battery, &msgs[0], &msgs[1], data, dataLength) == 0) ? msgCount : -EIO;
+}
+
+int SMBusSimTransfer(smbus_sim_t *sim, struct i2c_msg *msgs, int msgCount)
+{
+    if (!sim || !msgs || msgCount < 1 || msgCount > 2)
+        return -EINVAL;
+
+    // i2c-dev checks RECV_LEN reads before anything goes on the wire: buf[0] holds the bytes read besides the data,
+    // 1 for the count or 2 with a PEC, and len must leave room for the longest block after them
+    for (int i = 0; i < msgCount; i++)
+    {
+        if (!(msgs[i].flags & I2C_M_RECV_LEN))
+            continue;
+        if (!(msgs[i].flags & I2C_M_RD) || !msgs[i].len || msgs[i].buf[0] < 1 ||
+            msgs[i].len < msgs[i].buf[0] + I2C_SMBUS_BLOCK_MAX)
+            return -EINVAL;
+    }
+
+    int ret = SMBusSimRoute(sim, msgs, msgCount);
+
+    // A RECV_LEN read only has its length once it is filled, and a failed transfer stops after the first message
+    SMBusSimWireDelay(sim, msgs, (ret < 0) ? 1 : msgCount);
+    return ret;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file    smbus_sim.h  -   In-process simulated SMBus segment for the Linux platform
+ * @author  skuodi
+ * @date    18 October 2026.
+ *
+ * The simulated segment answers I2C_RDWR-style transfers the way a real bus populated with smart batteries would:
+ *  - PCA9548-style muxes at 0x70 - 0x77. Writing one byte sets the enabled channel mask, reading one byte returns it.
+ *  - A Smart Battery Selector at 0x0A with four batteries. While no mux channel is enabled, the battery address 0x0B
+ *    reaches the battery the SMB nibble of SelectorState() selects, battery A at first.
+ *  - A smart battery at every other address, behind every mux channel and directly on the bus, created on first access.
+ *    Batteries answer the SBS word and block commands and echo ManufacturerAccess()/ManufacturerBlockAccess() commands.
+ *    ManufacturerBlockAccess() also reads and writes a bq40z50-style data flash at 0x4000 - 0x5FFF.
+ *    Batteries at odd addresses, like the default 0x0B, support PEC. Those at even addresses report SBS 1.1 without PEC.
+ *    Batteries start SEALED and take the default bq40z50 UNSEAL and FULL ACCESS keys. A mode change takes effect
+ *    250ms after the key, and the data flash can't be written while sealed.
+ *  - A transfer to a battery address while channels on more than one mux are enabled fails, like a real collision would.
+ *  - Each transfer takes the time the same number of bits would take on the wire at the configured bus speed.
+ *
+ * Select the simulated segment by passing "sim" as the i2cPort of SMBusInit() in smbus_linux.c
+ *
+ * **/
+
+#ifndef _SMBUS_SIM_H
+#define _SMBUS_SIM_H
+
+#include <stdint.h>
+#include <linux/i2c.h>
+
+#define SMBUS_SIM_PORT_NAME             "sim"
+
+#define SMBUS_SIM_MUX_ADDRESS_FIRST     0x70
+#define SMBUS_SIM_MUX_ADDRESS_LAST      0x77
+#define SMBUS_SIM_SELECTOR_ADDRESS      0x0A
+
+typedef struct smbus_sim smbus_sim_t;
+
+/**
+ * @brief           Create a simulated bus segment
+ * @param i2cSpeed  Bus clock in Hz used to emulate transfer times. 0 disables the emulation.
+ **/
+smbus_sim_t* SMBusSimCreate(uint32_t i2cSpeed);
+
+/**
+ * @brief Free a simulated bus segment and all the devices on it
+ **/
+void SMBusSimDestroy(smbus_sim_t *sim);
+
+/**
+ * @brief       Perform a combined transfer with the same semantics as the I2C_RDWR ioctl, including I2C_M_RECV_LEN
+ * @return      The number of messages transferred, or a negative errno value
+ **/
+int SMBusSimTransfer(smbus_sim_t *sim, struct i2c_msg *msgs, int msgCount);
+
+#endif
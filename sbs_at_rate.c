@@ -0,0 +1,152 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "platform/smbus_platform.h"
+#include "sbs_at_rate.h"
+
+static void _SBSAtRateFinishRow(sbs_at_rate_sweep_t *sweep, int result)
+{
+  sweep->row[sweep->next].result = result;
+  if (result != SMBUS_ERR_OK)
+    sweep->failed++;
+
+  sweep->next++;
+  sweep->state = (sweep->next < sweep->count) ? SBS_AT_RATE_SWEEP_WRITE : SBS_AT_RATE_SWEEP_RESTORE;
+}
+
+static int _SBSAtRateReadRow(sbs_smb_battery_t *battery, sbs_at_rate_row_t *row)
+{
+  int ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_AT_RATE_TIME_TO_FULL, NULL, 0, &row->timeToFull, sizeof(row->timeToFull));
+  if (ret == SMBUS_ERR_OK)
+    ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_AT_RATE_TIME_TO_EMPTY, NULL, 0, &row->timeToEmpty, sizeof(row->timeToEmpty));
+  if (ret == SMBUS_ERR_OK)
+    ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_AT_RATE_OK, NULL, 0, &row->ok, sizeof(row->ok));
+  return ret;
+}
+
+void SBSAtRateSweepInit(sbs_at_rate_sweep_t *sweep, sbs_smb_battery_t *battery, const int16_t rate[],
+                        sbs_at_rate_row_t row[], uint16_t count, uint16_t settleMs)
+{
+  if (!sweep)
+    return;
+
+  memset(sweep, 0, sizeof(*sweep));
+  sweep->battery = battery;
+  sweep->row = row;
+  sweep->count = (rate && row) ? count : 0;
+  sweep->settleMs = settleMs ? settleMs : SBS_AT_RATE_SETTLE_MS_DEFAULT;
+  sweep->state = sweep->count ? SBS_AT_RATE_SWEEP_SAVE : SBS_AT_RATE_SWEEP_DONE;
+
+  for (uint16_t i = 0; i < sweep->count; i++)
+  {
+    memset(&row[i], 0, sizeof(row[i]));
+    row[i].rate = rate[i];
+  }
+}
+
+bool SBSAtRateSweepPoll(sbs_at_rate_sweep_t *sweep)
+{
+  if (!sweep || !sweep->battery)
+    return false;
+
+  sweep->waitMs = 0;
+
+  switch (sweep->state)
+  {
+    case SBS_AT_RATE_SWEEP_SAVE:
+      // A gauge that can't say what it was set to is left at the last rate swept
+      sweep->saved = SBSRunCommand(sweep->battery, SBS_SMB_CMD_CODE_AT_RATE, NULL, 0,
+                                   &sweep->savedRate, sizeof(sweep->savedRate)) == SMBUS_ERR_OK;
+      sweep->state = SBS_AT_RATE_SWEEP_WRITE;
+      return true;
+
+    case SBS_AT_RATE_SWEEP_WRITE:
+    {
+      int16_t rate = sweep->row[sweep->next].rate;
+      int ret = SBSRunCommand(sweep->battery, SBS_SMB_CMD_CODE_AT_RATE, &rate, sizeof(rate), NULL, 0);
+      if (ret != SMBUS_ERR_OK)
+        _SBSAtRateFinishRow(sweep, ret);
+      else
+      {
+        sweep->dueMs = SMBusPlatformMillis() + sweep->settleMs;
+        sweep->state = SBS_AT_RATE_SWEEP_READ;
+      }
+      return true;
+    }
+
+    case SBS_AT_RATE_SWEEP_READ:
+    {
+      int32_t early = (int32_t)(sweep->dueMs - SMBusPlatformMillis());
+      if (early > 0)
+      {
+        sweep->waitMs = early;
+        return true;
+      }
+
+      _SBSAtRateFinishRow(sweep, _SBSAtRateReadRow(sweep->battery, &sweep->row[sweep->next]));
+      return true;
+    }
+
+    case SBS_AT_RATE_SWEEP_RESTORE:
+      if (sweep->saved)
+        SBSRunCommand(sweep->battery, SBS_SMB_CMD_CODE_AT_RATE, &sweep->savedRate, sizeof(sweep->savedRate), NULL, 0);
+      sweep->state = SBS_AT_RATE_SWEEP_DONE;
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+uint32_t SBSAtRateSweepRun(sbs_at_rate_sweep_t sweep[], uint16_t count)
+{
+  uint32_t failed = 0;
+
+  if (!sweep)
+    return 0;
+
+  while (true)
+  {
+    bool pending = false;
+    uint32_t waitMs = UINT32_MAX;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+      if (!SBSAtRateSweepPoll(&sweep[i]))
+        continue;
+
+      pending = true;
+      if (sweep[i].waitMs < waitMs)
+        waitMs = sweep[i].waitMs;
+    }
+
+    if (!pending)
+      break;
+    if (waitMs)
+      SMBusPlatformDelayMs(waitMs);
+  }
+
+  for (uint16_t i = 0; i < count; i++)
+    failed += sweep[i].failed;
+
+  return failed;
+}
+
+int SBSAtRateSweep(sbs_smb_battery_t *battery, const int16_t rate[], sbs_at_rate_row_t row[], uint16_t count,
+                   uint16_t settleMs)
+{
+  sbs_at_rate_sweep_t sweep;
+
+  if (!battery || !rate || !row)
+    return SMBUS_ERR_INVALID_ARG;
+
+  SBSAtRateSweepInit(&sweep, battery, rate, row, count, settleMs);
+  if (!SBSAtRateSweepRun(&sweep, 1))
+    return SMBUS_ERR_OK;
+
+  for (uint16_t i = 0; i < count; i++)
+    if (row[i].result != SMBUS_ERR_OK)
+      return row[i].result;
+
+  return SMBUS_ERR_FAIL;
+}
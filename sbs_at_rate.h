@@ -0,0 +1,82 @@
+/**
+ *
+ * @file:   sbs_at_rate.h - AtRate() what-if sweeps over a list of rates
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * For every rate a sweep writes AtRate(), gives the gauge settleMs to recompute, then reads AtRateTimeToFull(),
+ * AtRateTimeToEmpty() and AtRateOK() into a row of the table. The AtRate() found before the sweep is written back
+ * once it is done, since the host may be using it.
+ *
+ * A sweep is a small state machine, so SBSAtRateSweepRun() can step the sweeps of many packs together: while one
+ * pack settles the others are written and read, and the settle times overlap instead of adding up.
+ *
+ * */
+
+#ifndef _SBS_AT_RATE_H_
+#define _SBS_AT_RATE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sbs_smb.h"
+
+// Gauges that recompute the AtRate...() results on their 1 s update cycle need up to that long
+#define SBS_AT_RATE_SETTLE_MS_DEFAULT                   1000
+
+#define SBS_AT_RATE_TIME_NONE                           0xFFFF  // AtRate...() time that doesn't apply to the rate
+
+typedef struct
+{
+  int16_t rate;                                 // mA, or 10mW when CAPACITY_MODE is set. Negative to discharge.
+  uint16_t timeToFull;                          // min
+  uint16_t timeToEmpty;                         // min
+  bool ok;                                      // AtRateOK()
+  int result;                                   // Of the first transfer of the row that failed
+} sbs_at_rate_row_t;
+
+typedef enum
+{
+  SBS_AT_RATE_SWEEP_SAVE = 0,                   // Read the AtRate() to put back afterwards
+  SBS_AT_RATE_SWEEP_WRITE,
+  SBS_AT_RATE_SWEEP_READ,                       // Waiting for dueMs to read the results
+  SBS_AT_RATE_SWEEP_RESTORE,
+  SBS_AT_RATE_SWEEP_DONE,
+} sbs_at_rate_sweep_state_t;
+
+typedef struct
+{
+  sbs_smb_battery_t *battery;
+  sbs_at_rate_row_t *row;
+  uint16_t count;
+  uint16_t next;                                // Row being swept
+  uint16_t settleMs;
+  sbs_at_rate_sweep_state_t state;
+  bool saved;                                   // Whether savedRate was read
+  int16_t savedRate;
+  uint16_t failed;                              // Rows with a result other than SMBUS_ERR_OK
+  uint32_t dueMs;
+  uint32_t waitMs;                              // Set by SBSAtRateSweepPoll(): time until the sweep can go on
+} sbs_at_rate_sweep_t;
+
+/// @brief Set up a sweep. Nothing is sent until it is polled.
+/// @param rate     count rates, copied into the rows
+/// @param row      Storage for count rows
+/// @param settleMs 0 for SBS_AT_RATE_SETTLE_MS_DEFAULT
+void SBSAtRateSweepInit(sbs_at_rate_sweep_t *sweep, sbs_smb_battery_t *battery, const int16_t rate[],
+                        sbs_at_rate_row_t row[], uint16_t count, uint16_t settleMs);
+
+/// @brief Run at most one bus transfer and return without sleeping, for event loops
+/// @return false once the sweep is done. Otherwise sweep->waitMs is how long until it can go on.
+bool SBSAtRateSweepPoll(sbs_at_rate_sweep_t *sweep);
+
+/// @brief Poll every sweep until they are all done, sleeping only when none can go on
+/// @return The number of rows that failed
+uint32_t SBSAtRateSweepRun(sbs_at_rate_sweep_t sweep[], uint16_t count);
+
+/// @brief Sweep one pack
+/// @return The result of the first row that failed
+int SBSAtRateSweep(sbs_smb_battery_t *battery, const int16_t rate[], sbs_at_rate_row_t row[], uint16_t count,
+                   uint16_t settleMs);
+
+#endif
@@ -5,120 +5,76 @@
 
 #include "platform/smbus_platform.h"
 #include "sbs_bq.h"
+#include "sbs_bq_cmd.h"
 
-int SBSBqAccessSha1Hmac(sbs_smb_battery_t *battery, uint8_t accessCmd, uint8_t *key)
-{
-  if (!battery || !battery->bus || !key)
-    return SMBUS_ERR_INVALID_ARG;
-
-  uint8_t msgLen;
-  uint8_t dataBuff[256 + 1];
-  uint8_t flipBuff[20];
-
-  SHA1_HASH hash;
-  memset(dataBuff, 0, sizeof(dataBuff));
+#define _SBS_BQ_ACCESS_TIMING_DEFAULT   { SBS_BQ_ACCESS_HOLDOFF_MS, SBS_BQ_ACCESS_POLL_MS, SBS_BQ_ACCESS_TIMEOUT_MS, SBS_BQ_KEY_GAP_MS }
 
-  // Send the unseal command and receive a 20-byte challenge message
-  int ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_ACCESS, &accessCmd,
-                          sizeof(accessCmd), dataBuff + 16, sizeof(dataBuff) - 16);
-  if (ret != SMBUS_ERR_OK)
-    return ret;
-  msgLen = *(dataBuff + 16);  // The first value returned is the size of the data received
-  if (msgLen != 20)
-    return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
-  
-  for(uint8_t i = 0; i < msgLen; i++)
-    (dataBuff + 16)[i] = (dataBuff + 16)[i + 1];
+static sbs_bq_access_timing_t _sbsBqAccessTiming = _SBS_BQ_ACCESS_TIMING_DEFAULT;
 
-  // Data is transferred LSByte first but hash is calculated MSByte first so reverse the order of received bytes
-  for (int i = 20; i > 0; i--)
-    flipBuff[sizeof(flipBuff) - i] = (dataBuff + 16)[i - 1];
-
-  // H1 = H(K + M)
-  memcpy(dataBuff, key, 16);
-  memcpy(dataBuff + 16, flipBuff, sizeof(flipBuff));
-
-#ifdef SBS_BQ_LOG
-  printf("B1 : ");
-  for (int i = 0; i < 36; i++)
-    printf("%2.2X", dataBuff[i]);
-  printf("\n");
-#endif
-
-  Sha1Calculate(dataBuff, 36, &hash);
-
-#ifdef SBS_BQ_LOG
-  printf("H1 : ");
-  for (int i = 0; i < sizeof(hash); i++)
-    printf("%2.2X", hash.bytes[i]);
-  printf("\n");
-#endif
-
-  // H2 = H(K + H1)
-  memcpy(dataBuff + 16, hash.bytes, 20);
-
-#ifdef SBS_BQ_LOG
-  printf("B2 : ");
-  for (int i = 0; i < 36; i++)
-    printf("%2.2X", dataBuff[i]);
-  printf("\n");
-#endif
-
-  Sha1Calculate(dataBuff, 36, &hash);
+// Security mode the gauge should end up in after an access command
+static int _SBSBqAccessMode(uint8_t accessCmd, sbs_bq_security_mode_t *mode)
+{
+  if (accessCmd == SBS_BQ_COMMAND_UNSEAL_DEVICE)
+    *mode = SBS_BQ_SECURITY_MODE_UNSEALED;
+  else if (accessCmd == SBS_BQ_COMMAND_FULL_ACCESS_DEVICE)
+    *mode = SBS_BQ_SECURITY_MODE_FULL_ACCESS;
+  else
+    return SMBUS_ERR_INVALID_ARG;
 
-#ifdef SBS_BQ_LOG
-  printf("H2 : ");
-  for (int i = 0; i < sizeof(hash); i++)
-    printf("%2.2X", hash.bytes[i]);
-  printf("\n");
-#endif
+  return SMBUS_ERR_OK;
+}
 
-  // Data is transferred LSByte first but hash is calculated MSByte first so reverse the order before sending
+// Read OperationStatus() through ManufacturerAccess()/ManufacturerData(), or through ManufacturerBlockAccess()
+static int _SBSBqReadSecurityMode(sbs_smb_battery_t *battery, bool block, sbs_bq_security_mode_t *mode)
+{
+  if (block)
+    return SBSBqGetSecurityMode(battery, mode);
 
-  for (int i = 20; i > 0; i--)
-    flipBuff[sizeof(flipBuff) - i] = hash.bytes[i - 1];
+  uint8_t dataBuff[1 + 256];
+  uint16_t temp = SBS_BQ_COMMAND_OPERATION_STATUS;
 
-  ret = SMBusBlockWrite(battery->bus, battery->busAddress, SBS_COMMAND_OPTIONAL_MFG_FUNCTION5, hash.bytes, 20);
+  // [length][status bits 7:0][status bits 15:8]...
+  int ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_ACCESS,
+                          &temp, sizeof(temp), dataBuff, sizeof(dataBuff));
   if (ret != SMBUS_ERR_OK)
     return ret;
 
-  // Takes at least 250ms for the setting to take effect
-  SMBusPlatformDelayMs(500);
-
-  uint16_t temp = SBS_BQ_COMMAND_OPERATION_STATUS;
-  ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_ACCESS,
-                      &temp, sizeof(temp), dataBuff, sizeof(dataBuff));
-
-  msgLen = *dataBuff;
-  if (ret != SMBUS_ERR_OK || msgLen != 3)
+  if (dataBuff[0] < 2)
+  {
+    SBSLogError(SMBUS_ERR_UNEXPECTED_DATA_RECEIVED, dataBuff, 1);
     return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+  }
 
-  for(uint8_t i = 0; i < msgLen; i++)
-    dataBuff[i] = dataBuff[i + 1];
+  sbs_bq_operation_status_t operationStatus;
 
-  if (accessCmd == SBS_BQ_COMMAND_UNSEAL_DEVICE)
-    return ((dataBuff[1] & 1) && !(dataBuff[0] & 0x08)) ? SMBUS_ERR_OK : SMBUS_ERR_FAIL;
-  else if (accessCmd == SBS_BQ_COMMAND_FULL_ACCESS_DEVICE)
-    return (!(dataBuff[1] & 1) && (dataBuff[0] & 0x08)) ? SMBUS_ERR_OK : SMBUS_ERR_FAIL;
+  SBSBqDecodeOperationStatus(dataBuff[1] | (dataBuff[2] << 8), &operationStatus);
+  *mode = (sbs_bq_security_mode_t)operationStatus.securityMode;
+  return SMBUS_ERR_OK;
+}
 
-  return SMBUS_ERR_FAIL;
+void SBSBqSetAccessTiming(const sbs_bq_access_timing_t *timing)
+{
+  static const sbs_bq_access_timing_t defaultTiming = _SBS_BQ_ACCESS_TIMING_DEFAULT;
+
+  _sbsBqAccessTiming = timing ? *timing : defaultTiming;
 }
 
-int SBSBqBlockAccessSha1Hmac(sbs_smb_battery_t *battery, uint8_t accessCmd, uint8_t *key)
+// Send the access command, then answer the challenge with the HMAC-SHA1 of it
+static int _SBSBqSha1HmacRespond(sbs_smb_battery_t *battery, uint16_t accessCmd, const uint8_t *key, bool block)
 {
-  if (!battery->bus || !key)
+  if (!battery || !battery->bus || !key)
     return SMBUS_ERR_INVALID_ARG;
 
   uint8_t msgLen;
-  uint8_t dataBuff[256];
+  uint8_t dataBuff[256 + 1];
   uint8_t flipBuff[20];
 
   SHA1_HASH hash;
   memset(dataBuff, 0, sizeof(dataBuff));
 
   // Send the unseal command and receive a 20-byte challenge message
-  int ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_BLOCK_ACCESS, &accessCmd,
-                          sizeof(accessCmd), dataBuff + 16, sizeof(dataBuff) - 16);
+  int ret = SBSRunCommand(battery, block ? SBS_SMB_CMD_CODE_MANUFACTURER_BLOCK_ACCESS : SBS_SMB_CMD_CODE_MANUFACTURER_ACCESS,
+                          &accessCmd, sizeof(accessCmd), dataBuff + 16, sizeof(dataBuff) - 16);
   if (ret != SMBUS_ERR_OK)
     return ret;
   msgLen = *(dataBuff + 16);  // The first value returned is the size of the data received
@@ -172,141 +128,237 @@ int SBSBqBlockAccessSha1Hmac(sbs_smb_battery_t *battery, uint8_t accessCmd, uint
 #endif
 
   // Data is transferred LSByte first but hash is calculated MSByte first so reverse the order before sending
-
   for (int i = 20; i > 0; i--)
     flipBuff[sizeof(flipBuff) - i] = hash.bytes[i - 1];
 
-  ret = SMBusBlockWrite(battery->bus, battery->busAddress, SBS_COMMAND_OPTIONAL_MFG_FUNCTION5, hash.bytes, 20);
-  if (ret != SMBUS_ERR_OK)
-    return ret;
+  return SMBusBlockWrite(battery->bus, battery->busAddress, SBS_COMMAND_OPTIONAL_MFG_FUNCTION5, flipBuff, sizeof(flipBuff));
+}
 
-  // Takes at least 250ms for the setting to take effect
-  SMBusPlatformDelayMs(500);
+int SBSBqSha1HmacRespond(sbs_smb_battery_t *battery, uint8_t accessCmd, uint8_t *key)
+{
+  return _SBSBqSha1HmacRespond(battery, accessCmd, key, false);
+}
 
-  uint16_t temp = SBS_BQ_COMMAND_OPERATION_STATUS;
-  ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_BLOCK_ACCESS,
-                      &temp, sizeof(temp), dataBuff, sizeof(dataBuff));
+static void _SBSBqAccessInit(sbs_bq_access_t *access, sbs_smb_battery_t *battery, uint8_t accessCmd, bool block)
+{
+  if (!access)
+    return;
+
+  memset(access, 0, sizeof(*access));
+  access->battery = battery;
+  access->accessCmd = accessCmd;
+  access->block = block;
+  access->state = SBS_BQ_ACCESS_STATE_SEND;
+}
 
-  msgLen = *dataBuff;
-  if (ret != SMBUS_ERR_OK || msgLen != 3)
-    return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+void SBSBqAccessInit2WordKey(sbs_bq_access_t *access, sbs_smb_battery_t *battery, uint8_t accessCmd,
+                             const uint16_t *key, bool block)
+{
+  _SBSBqAccessInit(access, battery, accessCmd, block);
+  if (access)
+    access->key = key;
+}
 
-  for(uint8_t i = 0; i < msgLen; i++)
-    dataBuff[i] = dataBuff[i + 1];
+void SBSBqAccessInitSha1Hmac(sbs_bq_access_t *access, sbs_smb_battery_t *battery, uint8_t accessCmd,
+                             const uint8_t *key, bool block)
+{
+  _SBSBqAccessInit(access, battery, accessCmd, block);
+  if (access)
+    access->sha1Key = key;
+}
 
-  if (accessCmd == SBS_BQ_COMMAND_UNSEAL_DEVICE)
-    return ((dataBuff[1] & 1) && !(dataBuff[0] & 0x08)) ? SMBUS_ERR_OK : SMBUS_ERR_FAIL;
-  else if (accessCmd == SBS_BQ_COMMAND_FULL_ACCESS_DEVICE)
-    return (!(dataBuff[1] & 1) && (dataBuff[0] & 0x08)) ? SMBUS_ERR_OK : SMBUS_ERR_FAIL;
+void SBSBqAccessInitSeal(sbs_bq_access_t *access, sbs_smb_battery_t *battery, bool block)
+{
+  _SBSBqAccessInit(access, battery, SBS_BQ_COMMAND_SEAL_DEVICE, block);
+}
+
+static int _SBSBqAccessWriteWord(sbs_bq_access_t *access, uint16_t word)
+{
+  int ret = SBSSelectBattery(access->battery);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
 
-  return SMBUS_ERR_FAIL;
+  return SMBusWriteWord(access->battery->bus, access->battery->busAddress, SBS_COMMAND_MANUFACTURER_ACCESS, word);
 }
 
-int SBSBqAccess2WordKey(sbs_smb_battery_t *battery, uint8_t accessCmd, uint16_t *key)
+// Send the command, or the first word of the key
+static int _SBSBqAccessSend(sbs_bq_access_t *access)
 {
-  if (!battery->bus || !key)
+  const sbs_bq_access_timing_t *timing = &_sbsBqAccessTiming;
+
+  if (!access->battery || !access->battery->bus)
     return SMBUS_ERR_INVALID_ARG;
 
-  uint8_t recvCount;
-  uint8_t dataBuff[256];
+  if (access->accessCmd == SBS_BQ_COMMAND_SEAL_DEVICE)
+  {
+    access->mode = SBS_BQ_SECURITY_MODE_SEALED;
+    return _SBSBqAccessWriteWord(access, SBS_BQ_COMMAND_SEAL_DEVICE);
+  }
 
-  int ret = SMBusWriteWord(battery->bus, battery->busAddress, SBS_COMMAND_MANUFACTURER_ACCESS, key[0]);
+  int ret = _SBSBqAccessMode(access->accessCmd, &access->mode);
   if (ret != SMBUS_ERR_OK)
     return ret;
 
-  SMBusPlatformDelayMs(50);
-
-  ret = SMBusWriteWord(battery->bus, battery->busAddress, SBS_COMMAND_MANUFACTURER_ACCESS, key[1]);
-  if (ret != SMBUS_ERR_OK)
+  if (access->key)
+  {
+    ret = _SBSBqAccessWriteWord(access, access->key[0]);
+    if (ret == SMBUS_ERR_OK)
+    {
+      access->state = SBS_BQ_ACCESS_STATE_KEY2;
+      access->waitMs = timing->keyGapMs;
+    }
     return ret;
+  }
 
-  // Takes at least 250ms for the setting to take effect
-  SMBusPlatformDelayMs(500);
+  if (access->sha1Key)
+    return _SBSBqSha1HmacRespond(access->battery, access->accessCmd, access->sha1Key, access->block);
 
-  uint16_t temp = SBS_BQ_COMMAND_OPERATION_STATUS;
-  ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_ACCESS,
-                      &temp, sizeof(temp), dataBuff, sizeof(dataBuff));
+  return SMBUS_ERR_INVALID_ARG;
+}
+
+// Takes at least 250ms for the setting to take effect, poll for it after the holdoff
+static void _SBSBqAccessStartPoll(sbs_bq_access_t *access)
+{
+  access->state = SBS_BQ_ACCESS_STATE_POLL;
+  access->waitMs = _sbsBqAccessTiming.holdoffMs;
+  access->waitedMs = access->waitMs;
+}
+
+bool SBSBqAccessStep(sbs_bq_access_t *access)
+{
+  if (!access || access->state == SBS_BQ_ACCESS_STATE_IDLE || access->state >= SBS_BQ_ACCESS_STATE_DONE)
+    return false;
+
+  const sbs_bq_access_timing_t *timing = &_sbsBqAccessTiming;
+  uint16_t pollMs = timing->pollMs ? timing->pollMs : 1;
+  sbs_bq_security_mode_t mode;
+  int ret = SMBUS_ERR_OK;
+
+  access->waitMs = 0;
+
+  switch (access->state)
+  {
+    case SBS_BQ_ACCESS_STATE_SEND:
+      ret = _SBSBqAccessSend(access);
+      if (ret == SMBUS_ERR_OK && access->state != SBS_BQ_ACCESS_STATE_KEY2)
+        _SBSBqAccessStartPoll(access);
+      break;
+
+    case SBS_BQ_ACCESS_STATE_KEY2:
+      ret = _SBSBqAccessWriteWord(access, access->key[1]);
+      if (ret == SMBUS_ERR_OK)
+        _SBSBqAccessStartPoll(access);
+      break;
+
+    case SBS_BQ_ACCESS_STATE_POLL:
+      ret = _SBSBqReadSecurityMode(access->battery, access->block, &mode);
+      if (ret == SMBUS_ERR_OK && mode == access->mode)
+      {
+        access->state = SBS_BQ_ACCESS_STATE_DONE;
+        break;
+      }
+
+      // The gauge may not answer while it switches, so read errors only count once the wait times out
+      if (access->waitedMs >= timing->timeoutMs)
+      {
+        if (ret == SMBUS_ERR_OK)
+          ret = SMBUS_ERR_FAIL;
+        break;
+      }
+
+      ret = SMBUS_ERR_OK;
+      access->waitMs = pollMs;
+      access->waitedMs += pollMs;
+      break;
+
+    default:
+      break;
+  }
 
-  recvCount = *dataBuff;
   if (ret != SMBUS_ERR_OK)
   {
-    SBSLogError(SMBUS_ERR_UNEXPECTED_DATA_RECEIVED, &recvCount, sizeof(recvCount));
-    return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+    access->result = ret;
+    access->state = SBS_BQ_ACCESS_STATE_FAILED;
   }
 
-  for(uint8_t i = 0; i < recvCount; i++)
-    dataBuff[i] = dataBuff[i + 1];
+  return access->state < SBS_BQ_ACCESS_STATE_DONE;
+}
 
-  if (accessCmd == SBS_BQ_COMMAND_UNSEAL_DEVICE)
-    return ((dataBuff[1] & 1) && !(dataBuff[0] & 0x08)) ? SMBUS_ERR_OK : SMBUS_ERR_FAIL;
-  else if (accessCmd == SBS_BQ_COMMAND_FULL_ACCESS_DEVICE)
-    return (!(dataBuff[1] & 1) && (dataBuff[0] & 0x08)) ? SMBUS_ERR_OK : SMBUS_ERR_FAIL;
+static int _SBSBqAccessRun(sbs_bq_access_t *access)
+{
+  while (SBSBqAccessStep(access))
+    SMBusPlatformDelayMs(access->waitMs);
 
-  return SMBUS_ERR_FAIL;
+  return access->result;
 }
 
-int SBSBqBlockAccess2WordKey(sbs_smb_battery_t *battery, uint8_t accessCmd, uint16_t *key)
+int SBSBqAccessSha1Hmac(sbs_smb_battery_t *battery, uint8_t accessCmd, uint8_t *key)
 {
-  if (!battery->bus || !key)
-    return SMBUS_ERR_INVALID_ARG;
+  sbs_bq_access_t access;
 
-  uint8_t recvCount;
-  uint8_t dataBuff[256];
-
-  int ret = SMBusWriteWord(battery->bus, battery->busAddress, SBS_COMMAND_MANUFACTURER_ACCESS, key[0]);
-  if (ret != SMBUS_ERR_OK)
-    return ret;
+  SBSBqAccessInitSha1Hmac(&access, battery, accessCmd, key, false);
+  return _SBSBqAccessRun(&access);
+}
 
-  SMBusPlatformDelayMs(50);
+int SBSBqBlockAccessSha1Hmac(sbs_smb_battery_t *battery, uint8_t accessCmd, uint8_t *key)
+{
+  sbs_bq_access_t access;
 
-  ret = SMBusWriteWord(battery->bus, battery->busAddress, SBS_COMMAND_MANUFACTURER_ACCESS, key[1]);
-  if (ret != SMBUS_ERR_OK)
-    return ret;
+  SBSBqAccessInitSha1Hmac(&access, battery, accessCmd, key, true);
+  return _SBSBqAccessRun(&access);
+}
 
-  // Takes at least 250ms for the setting to take effect
-  SMBusPlatformDelayMs(500);
+int SBSBqAccess2WordKey(sbs_smb_battery_t *battery, uint8_t accessCmd, uint16_t *key)
+{
+  sbs_bq_access_t access;
 
-  uint16_t temp = SBS_BQ_COMMAND_OPERATION_STATUS;
-  ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_ACCESS,
-                      &temp, sizeof(temp), dataBuff, sizeof(dataBuff));
+  SBSBqAccessInit2WordKey(&access, battery, accessCmd, key, false);
+  return _SBSBqAccessRun(&access);
+}
 
-  recvCount = *dataBuff;
-  if (ret != SMBUS_ERR_OK)
-    return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+int SBSBqBlockAccess2WordKey(sbs_smb_battery_t *battery, uint8_t accessCmd, uint16_t *key)
+{
+  sbs_bq_access_t access;
 
-  for(uint8_t i = 0; i < recvCount; i++)
-    dataBuff[i] = dataBuff[i + 1];
+  SBSBqAccessInit2WordKey(&access, battery, accessCmd, key, true);
+  return _SBSBqAccessRun(&access);
+}
 
-  if (accessCmd == SBS_BQ_COMMAND_UNSEAL_DEVICE)
-    return ((dataBuff[1] & 1) && !(dataBuff[0] & 0x08)) ? SMBUS_ERR_OK : SMBUS_ERR_FAIL;
-  else if (accessCmd == SBS_BQ_COMMAND_FULL_ACCESS_DEVICE)
-    return (!(dataBuff[1] & 1) && (dataBuff[0] & 0x08)) ? SMBUS_ERR_OK : SMBUS_ERR_FAIL;
+int SBSBqSeal(sbs_smb_battery_t *battery)
+{
+  sbs_bq_access_t access;
 
-  return SMBUS_ERR_FAIL;
+  SBSBqAccessInitSeal(&access, battery, false);
+  return _SBSBqAccessRun(&access);
 }
 
-int SBSBqSeal(sbs_smb_battery_t *battery)
+int SBSBqEnterRomMode(sbs_smb_battery_t *battery)
 {
-  uint8_t recvCount;
-  uint8_t dataBuff[256];
+  int ret = SBSSelectBattery(battery);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
 
-  int ret = SMBusWriteWord(battery->bus, battery->busAddress, SBS_COMMAND_MANUFACTURER_ACCESS, SBS_BQ_COMMAND_SEAL_DEVICE);
+  ret = SMBusWriteWord(battery->bus, battery->busAddress, SBS_COMMAND_MANUFACTURER_ACCESS, SBS_BQ_COMMAND_ROM_MODE);
   if (ret != SMBUS_ERR_OK)
     return ret;
 
-  // Takes at least 250ms for the setting to take effect
-  SMBusPlatformDelayMs(500);
+  // Give the gauge time to restart into ROM mode before the first flash stream command
+  SMBusPlatformDelayMs(100);
+  return SMBUS_ERR_OK;
+}
 
-  uint16_t temp = SBS_BQ_COMMAND_OPERATION_STATUS;
-  ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_ACCESS,
-                      &temp, sizeof(temp), dataBuff, sizeof(dataBuff));
+int SBSBqGetSecurityMode(sbs_smb_battery_t *battery, sbs_bq_security_mode_t *mode)
+{
+  if (!battery || !mode)
+    return SMBUS_ERR_INVALID_ARG;
 
-  recvCount = *dataBuff;
-  if (ret != SMBUS_ERR_OK)
-    return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+  sbs_bq_operation_status_t operationStatus;
 
-  for(uint8_t i = 0; i < recvCount; i++)
-    dataBuff[i] = dataBuff[i + 1];
+  SBSBqBindCommands(battery);
+  int ret = SBSRunCommand(battery, SBS_BQ_CMD_CODE_OPERATION_STATUS, NULL, 0, &operationStatus, sizeof(operationStatus));
+  if (ret != SMBUS_ERR_OK)
+    return ret;
 
-  return ((dataBuff[1] & 1) && (dataBuff[0] & 0x08)) ? SMBUS_ERR_OK : SMBUS_ERR_FAIL;
+  *mode = (sbs_bq_security_mode_t)operationStatus.securityMode;
+  return SMBUS_ERR_OK;
 }
\ No newline at end of file
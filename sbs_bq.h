@@ -92,6 +92,62 @@
 #include "sbs_smb.h"
 #include "sbs_bq.h"
 
+#define SBS_BQ_KEY_GAP_MS                                               50    // Between the two words of a key
+
+#define SBS_BQ_ACCESS_HOLDOFF_MS                                        50
+#define SBS_BQ_ACCESS_POLL_MS                                           10
+#define SBS_BQ_ACCESS_TIMEOUT_MS                                        1000
+
+// SEC1:SEC0 of OperationStatus()
+typedef enum
+{
+  SBS_BQ_SECURITY_MODE_RESERVED = 0,
+  SBS_BQ_SECURITY_MODE_FULL_ACCESS,
+  SBS_BQ_SECURITY_MODE_UNSEALED,
+  SBS_BQ_SECURITY_MODE_SEALED,
+} sbs_bq_security_mode_t;
+
+// How the access functions wait for a security mode change. Instead of sleeping for a fixed time they poll
+// OperationStatus() and return as soon as the gauge reports the new mode.
+typedef struct
+{
+  uint16_t holdoffMs;               // Before the first poll
+  uint16_t pollMs;                  // Between polls
+  uint16_t timeoutMs;               // Fail if the mode hasn't changed this long after the command or key
+  uint16_t keyGapMs;                // Between the two words of a key
+} sbs_bq_access_timing_t;
+
+typedef enum
+{
+  SBS_BQ_ACCESS_STATE_IDLE = 0,
+  SBS_BQ_ACCESS_STATE_SEND,         // Send the command or first key word, or answer the challenge
+  SBS_BQ_ACCESS_STATE_KEY2,         // Send the second key word
+  SBS_BQ_ACCESS_STATE_POLL,         // Wait for OperationStatus() to report the new mode
+  SBS_BQ_ACCESS_STATE_DONE,
+  SBS_BQ_ACCESS_STATE_FAILED,
+} sbs_bq_access_state_t;
+
+// An UNSEAL, FULL ACCESS or SEAL in progress. Each SBSBqAccessStep() runs one step and returns without sleeping,
+// leaving the time to wait before the next step in waitMs, so one task can interleave the steps of many batteries.
+typedef struct
+{
+  sbs_smb_battery_t *battery;
+  uint8_t accessCmd;                // SBS_BQ_COMMAND_UNSEAL_DEVICE, _FULL_ACCESS_DEVICE or _SEAL_DEVICE
+  const uint16_t *key;              // Two-word key
+  const uint8_t *sha1Key;           // 128-bit HMAC-SHA1 key, used if key is NULL
+  bool block;                       // Go through ManufacturerBlockAccess() instead of ManufacturerAccess()
+  sbs_bq_security_mode_t mode;      // Mode waited for
+  sbs_bq_access_state_t state;
+  int result;                       // Error that failed the access
+  uint32_t waitMs;                  // Wait before the next step
+  uint32_t waitedMs;                // Waited for the mode so far, counted from the waitMs handed out
+} sbs_bq_access_t;
+
+/// @brief Set how the access and seal functions wait for the security mode to change
+/// @param timing NULL to go back to SBS_BQ_ACCESS_HOLDOFF_MS, SBS_BQ_ACCESS_POLL_MS, SBS_BQ_ACCESS_TIMEOUT_MS
+///               and SBS_BQ_KEY_GAP_MS
+void SBSBqSetAccessTiming(const sbs_bq_access_timing_t *timing);
+
 /// @brief Perform a SHA1 authentication handshake using a 128-bit key
 /// @param battery 
 /// @param accessCmd 
@@ -99,6 +155,10 @@
 /// @return 
 int SBSBqAccessSha1Hmac(sbs_smb_battery_t *battery, uint8_t accessCmd, uint8_t *key);
 
+/// @brief First half of SBSBqAccessSha1Hmac(): send the access command, then answer the challenge. The security mode
+///        changes at least 250ms later.
+int SBSBqSha1HmacRespond(sbs_smb_battery_t *battery, uint8_t accessCmd, uint8_t *key);
+
 int SBSBqBlockAccessSha1Hmac(sbs_smb_battery_t *battery, uint8_t accessCmd, uint8_t *key);
 
 int SBSBqAccess2WordKey(sbs_smb_battery_t *battery, uint8_t accessCmd, uint16_t *key);
@@ -107,4 +167,27 @@ int SBSBqBlockAccess2WordKey(sbs_smb_battery_t *battery, uint8_t accessCmd, uint
 
 int SBSBqSeal(sbs_smb_battery_t *battery);
 
+/// @brief Prepare a non-blocking SBSBqAccess2WordKey(), or SBSBqBlockAccess2WordKey() if block is set.
+///        The key must stay valid until the access is done.
+void SBSBqAccessInit2WordKey(sbs_bq_access_t *access, sbs_smb_battery_t *battery, uint8_t accessCmd,
+                             const uint16_t *key, bool block);
+
+/// @brief Prepare a non-blocking SBSBqAccessSha1Hmac(), or SBSBqBlockAccessSha1Hmac() if block is set
+void SBSBqAccessInitSha1Hmac(sbs_bq_access_t *access, sbs_smb_battery_t *battery, uint8_t accessCmd,
+                             const uint8_t *key, bool block);
+
+/// @brief Prepare a non-blocking SBSBqSeal()
+void SBSBqAccessInitSeal(sbs_bq_access_t *access, sbs_smb_battery_t *battery, bool block);
+
+/// @brief Run the next step of an access. Call again once access->waitMs has passed. The bus is free in between.
+/// @return false once the access is done or has failed, see access->state and access->result
+bool SBSBqAccessStep(sbs_bq_access_t *access);
+
+/// @brief Read the security mode from OperationStatus() through ManufacturerBlockAccess()
+int SBSBqGetSecurityMode(sbs_smb_battery_t *battery, sbs_bq_security_mode_t *mode);
+
+/// @brief Put the gauge in ROM mode, where it stops gauging and only takes flash stream (.bq.fs) commands
+/// @note  The gauge has to be unsealed first. It leaves ROM mode once the flash stream has been programmed.
+int SBSBqEnterRomMode(sbs_smb_battery_t *battery);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_bq_cal.h"
+
+// Rounded to the nearest, halves away from zero
+static int64_t _SBSBqCalDivide(int64_t num, int64_t den)
+{
+  return ((num < 0) == (den < 0)) ? (num + den / 2) / den : (num - den / 2) / den;
+}
+
+static void _SBSBqCalAdd(sbs_bq_cal_stat_t *stat, int16_t value)
+{
+  if (!stat->count || value < stat->min)
+    stat->min = value;
+  if (!stat->count || value > stat->max)
+    stat->max = value;
+
+  stat->count++;
+  stat->sum += value;
+  stat->sumSquares += (uint64_t)((int32_t)value * value);
+}
+
+static void _SBSBqCalAddSample(sbs_bq_cal_t *cal, const sbs_bq_cal_sample_t *sample)
+{
+  _SBSBqCalAdd(&cal->stat[SBS_BQ_CAL_CHANNEL_CC], sample->cc);
+  for (uint8_t i = 0; i < SBS_BQ_CELL_COUNT; i++)
+  {
+    _SBSBqCalAdd(&cal->stat[SBS_BQ_CAL_CHANNEL_CELL_VOLTAGE_1 + i], sample->cellVoltage[i]);
+    _SBSBqCalAdd(&cal->stat[SBS_BQ_CAL_CHANNEL_CELL_CURRENT_1 + i], sample->cellCurrent[i]);
+  }
+  _SBSBqCalAdd(&cal->stat[SBS_BQ_CAL_CHANNEL_PACK_VOLTAGE], sample->packVoltage);
+  _SBSBqCalAdd(&cal->stat[SBS_BQ_CAL_CHANNEL_BAT_VOLTAGE], sample->batVoltage);
+}
+
+void SBSBqCalInit(sbs_bq_cal_t *cal, sbs_smb_battery_t *battery, sbs_bq_cal_sample_t sample[], uint16_t capacity)
+{
+  if (!cal)
+    return;
+
+  memset(cal, 0, sizeof(*cal));
+  cal->battery = battery;
+  cal->sample = sample;
+  cal->capacity = sample ? capacity : 0;
+  SBSBqBindCommands(battery);
+}
+
+int SBSBqCalStart(sbs_bq_cal_t *cal, bool shorted)
+{
+  if (!cal || !cal->battery)
+    return SMBUS_ERR_INVALID_ARG;
+
+  int ret = SBSRunCommand(cal->battery, shorted ? SBS_BQ_CMD_CODE_CALIBRATION_OUTPUT_SHORTED : SBS_BQ_CMD_CODE_CALIBRATION_OUTPUT,
+                          NULL, 0, NULL, 0);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  cal->mode = shorted ? SBS_BQ_COMMAND_OUTPUT_SHORTED_CC_AND_ADC_OFFSET_FOR_CALIBRATION : SBS_BQ_COMMAND_OUTPUT_CC_AND_ADC_FOR_CALIBRATION;
+  cal->count = 0;
+  cal->samples = 0;
+  cal->reads = 0;
+  memset(cal->stat, 0, sizeof(cal->stat));
+  return SMBUS_ERR_OK;
+}
+
+int SBSBqCalPoll(sbs_bq_cal_t *cal)
+{
+  if (!cal || !cal->battery || !cal->mode)
+    return SMBUS_ERR_INVALID_ARG;
+
+  sbs_bq_cal_sample_t sample;
+
+  int ret = SBSRunCommand(cal->battery, SBS_BQ_CMD_CODE_CALIBRATION_SAMPLE, NULL, 0, &sample, sizeof(sample));
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  cal->reads++;
+  if (sample.command != cal->mode)
+    return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+  // Read faster than the gauge refreshes it
+  if (cal->samples && sample.counter == cal->counter)
+    return SMBUS_ERR_OK;
+
+  cal->counter = sample.counter;
+  cal->samples++;
+  _SBSBqCalAddSample(cal, &sample);
+  if (cal->count < cal->capacity)
+    cal->sample[cal->count++] = sample;
+
+  return SMBUS_ERR_OK;
+}
+
+int SBSBqCalStop(sbs_bq_cal_t *cal)
+{
+  if (!cal || !cal->battery)
+    return SMBUS_ERR_INVALID_ARG;
+
+  cal->mode = 0;
+  return SBSRunCommand(cal->battery, SBS_BQ_CMD_CODE_CALIBRATION_OUTPUT_EXIT, NULL, 0, NULL, 0);
+}
+
+int SBSBqCalCapture(sbs_bq_cal_t *cal, bool shorted, uint32_t samples, uint32_t maxReads)
+{
+  int ret = SBSBqCalStart(cal, shorted);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  while (ret == SMBUS_ERR_OK && cal->samples < samples)
+  {
+    if (cal->reads >= maxReads)
+    {
+      ret = SMBUS_ERR_TIMEOUT;
+      break;
+    }
+    ret = SBSBqCalPoll(cal);
+  }
+
+  // Leave the gauge in normal output even if the capture failed
+  int stopRet = SBSBqCalStop(cal);
+  return (ret != SMBUS_ERR_OK) ? ret : stopRet;
+}
+
+int32_t SBSBqCalMean(const sbs_bq_cal_stat_t *stat)
+{
+  if (!stat || !stat->count)
+    return 0;
+
+  return (int32_t)_SBSBqCalDivide(stat->sum * (1 << SBS_BQ_CAL_MEAN_FRAC_BITS), stat->count);
+}
+
+uint32_t SBSBqCalVariance(const sbs_bq_cal_stat_t *stat)
+{
+  if (!stat || stat->count < 2)
+    return 0;
+
+  // Sum of squared deviations from the whole count mean, which keeps every term in range
+  int64_t mean = _SBSBqCalDivide(stat->sum, stat->count);
+  int64_t deviations = (int64_t)stat->sumSquares - mean * (2 * stat->sum - (int64_t)stat->count * mean);
+  if (deviations <= 0)
+    return 0;
+
+  int64_t variance = _SBSBqCalDivide(deviations, stat->count - 1);
+  return (variance > UINT32_MAX) ? UINT32_MAX : (uint32_t)variance;
+}
+
+int32_t SBSBqCalGain(const sbs_bq_cal_stat_t *stat, int32_t offset, int32_t reference)
+{
+  if (!stat || !stat->count)
+    return 0;
+
+  int64_t span = (int64_t)SBSBqCalMean(stat) - offset;
+  if (!span)
+    return 0;
+
+  int64_t gain = _SBSBqCalDivide((int64_t)reference << (SBS_BQ_CAL_MEAN_FRAC_BITS + SBS_BQ_CAL_GAIN_FRAC_BITS), span);
+  return (gain > INT32_MAX) ? INT32_MAX : (gain < INT32_MIN) ? INT32_MIN : (int32_t)gain;
+}
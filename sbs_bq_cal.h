@@ -0,0 +1,104 @@
+/**
+ *
+ * @file:   sbs_bq_cal.h - bq40z50 calibration capture from the raw coulomb counter and ADC output
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * OutputCCandADCforCalibration() switches ManufacturerBlockAccess() to output the raw coulomb counter and ADC
+ * counts, refreshed by the gauge at its own rate, until ExitCalibrationOutputMode():
+ *
+ *  MBA read: [0x44][26][0x81][0xF0][counter][status][CC][cell 1 - 4][PACK][BAT][cell current 1 - 4]
+ *
+ * OutputShortedCCandADCOffsetforCalibration() outputs the same with the CC inputs shorted internally, which gives
+ * the offsets. A capture reads the output back to back and keeps every new sample, the ones where counter moved
+ * on, in running sums per channel. Offsets and gains can then be worked out at any point without going over the
+ * samples again:
+ *
+ *  offset = mean of a shorted capture
+ *  gain   = reference / (mean - offset), with the reference value applied to the pack during the capture
+ *
+ * Everything is integer maths, like sbs_units.h: means are in 1/256 counts and gains in 1/65536 units per count.
+ *
+ * */
+
+#ifndef _SBS_BQ_CAL_H_
+#define _SBS_BQ_CAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sbs_smb.h"
+#include "sbs_bq_cmd.h"
+
+#define SBS_BQ_CAL_MEAN_FRAC_BITS                       8
+#define SBS_BQ_CAL_GAIN_FRAC_BITS                       16
+
+typedef enum
+{
+  SBS_BQ_CAL_CHANNEL_CC = 0,
+  SBS_BQ_CAL_CHANNEL_CELL_VOLTAGE_1,
+  SBS_BQ_CAL_CHANNEL_CELL_VOLTAGE_2,
+  SBS_BQ_CAL_CHANNEL_CELL_VOLTAGE_3,
+  SBS_BQ_CAL_CHANNEL_CELL_VOLTAGE_4,
+  SBS_BQ_CAL_CHANNEL_PACK_VOLTAGE,
+  SBS_BQ_CAL_CHANNEL_BAT_VOLTAGE,
+  SBS_BQ_CAL_CHANNEL_CELL_CURRENT_1,
+  SBS_BQ_CAL_CHANNEL_CELL_CURRENT_2,
+  SBS_BQ_CAL_CHANNEL_CELL_CURRENT_3,
+  SBS_BQ_CAL_CHANNEL_CELL_CURRENT_4,
+  SBS_BQ_CAL_CHANNEL_COUNT,
+} sbs_bq_cal_channel_t;
+
+typedef struct
+{
+  uint32_t count;
+  int64_t sum;
+  uint64_t sumSquares;
+  int16_t min;
+  int16_t max;
+} sbs_bq_cal_stat_t;
+
+typedef struct
+{
+  sbs_smb_battery_t *battery;
+  sbs_bq_cal_sample_t *sample;                  // Storage for the first capacity samples, NULL to keep only the sums
+  uint16_t capacity;
+  uint16_t count;                               // Samples stored
+  uint16_t mode;                                // Command the output was started with, 0 when stopped
+  uint8_t counter;                              // Of the last sample
+  uint32_t samples;                             // New samples since SBSBqCalStart()
+  uint32_t reads;                               // Reads since SBSBqCalStart(), including repeats of a sample
+  sbs_bq_cal_stat_t stat[SBS_BQ_CAL_CHANNEL_COUNT];
+} sbs_bq_cal_t;
+
+/// @param sample   Storage for capacity samples, NULL to keep only the sums
+void SBSBqCalInit(sbs_bq_cal_t *cal, sbs_smb_battery_t *battery, sbs_bq_cal_sample_t sample[], uint16_t capacity);
+
+/// @brief Start the calibration output and clear the samples and sums. The gauge must be UNSEALED.
+/// @param shorted  Output with the CC inputs shorted, to capture offsets
+int SBSBqCalStart(sbs_bq_cal_t *cal, bool shorted);
+
+/// @brief Read the output once. cal->samples goes up if the gauge had refreshed it since the last read.
+/// @return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED if the gauge isn't outputting what cal was started with
+int SBSBqCalPoll(sbs_bq_cal_t *cal);
+
+/// @brief Return the gauge to normal output
+int SBSBqCalStop(sbs_bq_cal_t *cal);
+
+/// @brief Start, poll back to back until samples new samples are in, then stop
+/// @param maxReads Reads to give up after
+/// @return SMBUS_ERR_TIMEOUT if maxReads ran out first. The output is stopped either way.
+int SBSBqCalCapture(sbs_bq_cal_t *cal, bool shorted, uint32_t samples, uint32_t maxReads);
+
+/// @return The mean in 1/256 counts
+int32_t SBSBqCalMean(const sbs_bq_cal_stat_t *stat);
+
+/// @return The sample variance in counts²
+uint32_t SBSBqCalVariance(const sbs_bq_cal_stat_t *stat);
+
+/// @param offset     From SBSBqCalMean() of a shorted capture, in 1/256 counts
+/// @param reference  Value applied during the capture, e.g. in mV or mA
+/// @return Reference units per count in 1/65536, 0 if the mean doesn't differ from the offset
+int32_t SBSBqCalGain(const sbs_bq_cal_stat_t *stat, int32_t offset, int32_t reference);
+
+#endif
@@ -0,0 +1,416 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "sbs_bq_cmd.h"
+
+#define _SBS_BQ_BIT(raw, bit)   (((raw) >> (bit)) & 1)
+
+// Little endian register of up to 4 bytes, shorter on firmware that returns fewer
+static uint32_t _SBSBqRaw(const void *inPtr, size_t inSize)
+{
+  const uint8_t *data = (const uint8_t *)inPtr;
+  uint32_t raw = 0;
+
+  for (size_t i = 0; i < inSize && i < sizeof(raw); i++)
+    raw |= (uint32_t)data[i] << (8 * i);
+  return raw;
+}
+
+static void _SBSBqParseSafety(void *inPtr, size_t inSize, void *outPtr, size_t outSize)
+{
+  SBSBqDecodeSafety(_SBSBqRaw(inPtr, inSize), (sbs_bq_safety_t *)outPtr);
+}
+
+static void _SBSBqParsePf(void *inPtr, size_t inSize, void *outPtr, size_t outSize)
+{
+  SBSBqDecodePf(_SBSBqRaw(inPtr, inSize), (sbs_bq_pf_t *)outPtr);
+}
+
+static void _SBSBqParseOperationStatus(void *inPtr, size_t inSize, void *outPtr, size_t outSize)
+{
+  SBSBqDecodeOperationStatus(_SBSBqRaw(inPtr, inSize), (sbs_bq_operation_status_t *)outPtr);
+}
+
+static void _SBSBqParseChargingStatus(void *inPtr, size_t inSize, void *outPtr, size_t outSize)
+{
+  SBSBqDecodeChargingStatus(_SBSBqRaw(inPtr, inSize), (sbs_bq_charging_status_t *)outPtr);
+}
+
+static void _SBSBqParseGaugingStatus(void *inPtr, size_t inSize, void *outPtr, size_t outSize)
+{
+  SBSBqDecodeGaugingStatus(_SBSBqRaw(inPtr, inSize), (sbs_bq_gauging_status_t *)outPtr);
+}
+
+// Word i of a block, 0 past the end of what the gauge returned
+static uint16_t _SBSBqWord(const uint8_t *data, size_t size, uint8_t i)
+{
+  return (2 * i + 1u < size) ? (data[2 * i] | (data[2 * i + 1] << 8)) : 0;
+}
+
+static void _SBSBqParseDaStatus1(void *inPtr, size_t inSize, void *outPtr, size_t outSize)
+{
+  const uint8_t *data = (const uint8_t *)inPtr;
+  sbs_bq_da_status1_t *da = (sbs_bq_da_status1_t *)outPtr;
+
+  for (uint8_t i = 0; i < SBS_BQ_CELL_COUNT; i++)
+  {
+    da->cellVoltage[i] = _SBSBqWord(data, inSize, i);
+    da->cellCurrent[i] = (int16_t)_SBSBqWord(data, inSize, 6 + i);
+    da->cellPower[i] = (int16_t)_SBSBqWord(data, inSize, 10 + i);
+  }
+  da->batVoltage = _SBSBqWord(data, inSize, 4);
+  da->packVoltage = _SBSBqWord(data, inSize, 5);
+  da->power = (int16_t)_SBSBqWord(data, inSize, 14);
+  da->averagePower = (int16_t)_SBSBqWord(data, inSize, 15);
+}
+
+static void _SBSBqParseDaStatus2(void *inPtr, size_t inSize, void *outPtr, size_t outSize)
+{
+  const uint8_t *data = (const uint8_t *)inPtr;
+  sbs_bq_da_status2_t *da = (sbs_bq_da_status2_t *)outPtr;
+
+  da->internalTemp = _SBSBqWord(data, inSize, 0);
+  for (uint8_t i = 0; i < SBS_BQ_TS_COUNT; i++)
+    da->ts[i] = _SBSBqWord(data, inSize, 1 + i);
+  da->cellTemp = _SBSBqWord(data, inSize, 5);
+  da->fetTemp = _SBSBqWord(data, inSize, 6);
+  da->gaugingTemp = _SBSBqWord(data, inSize, 7);
+}
+
+static void _SBSBqParseCalSample(void *inPtr, size_t inSize, void *outPtr, size_t outSize)
+{
+  const uint8_t *data = (const uint8_t *)inPtr;
+  sbs_bq_cal_sample_t *sample = (sbs_bq_cal_sample_t *)outPtr;
+
+  sample->command = _SBSBqWord(data, inSize, 0);
+  sample->counter = (inSize > 2) ? data[2] : 0;
+  sample->status = (inSize > 3) ? data[3] : 0;
+  sample->cc = (int16_t)_SBSBqWord(data, inSize, 2);
+  for (uint8_t i = 0; i < SBS_BQ_CELL_COUNT; i++)
+  {
+    sample->cellVoltage[i] = (int16_t)_SBSBqWord(data, inSize, 3 + i);
+    sample->cellCurrent[i] = (int16_t)_SBSBqWord(data, inSize, 9 + i);
+  }
+  sample->packVoltage = (int16_t)_SBSBqWord(data, inSize, 7);
+  sample->batVoltage = (int16_t)_SBSBqWord(data, inSize, 8);
+}
+
+// ManufacturerBlockAccess() command. size is that of the response after the echoed command, 0 for a block.
+#define _SBS_BQ_MBA(command, size)                                                  \
+  {                                                                                 \
+    .writeCommand = SBS_BQ_COMMAND_MANUFACTURER_BLOCK_ACCESS,                       \
+    .readCommand = SBS_BQ_COMMAND_MANUFACTURER_BLOCK_ACCESS,                        \
+    .writeReadProtocol = SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_BLOCK_READ_BLOCK,        \
+    .subCommand = command,                                                          \
+    .subCommandEcho = true,                                                         \
+    .outSize = size,                                                                \
+  }
+
+// ManufacturerBlockAccess() register decoded by parse into a struct of type
+#define _SBS_BQ_MBA_PARSED(command, type, parse)                                    \
+  {                                                                                 \
+    .writeCommand = SBS_BQ_COMMAND_MANUFACTURER_BLOCK_ACCESS,                       \
+    .readCommand = SBS_BQ_COMMAND_MANUFACTURER_BLOCK_ACCESS,                        \
+    .writeReadProtocol = SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_BLOCK_READ_BLOCK,        \
+    .subCommand = command,                                                          \
+    .subCommandEcho = true,                                                         \
+    .outSize = sizeof(type),                                                        \
+    .retFunc = parse,                                                               \
+  }
+
+// Read of ManufacturerBlockAccess() without writing a command first, for output the gauge keeps refreshing
+#define _SBS_BQ_MBA_READ_PARSED(type, parse)                                        \
+  {                                                                                 \
+    .readCommand = SBS_BQ_COMMAND_MANUFACTURER_BLOCK_ACCESS,                        \
+    .readProtocol = SBS_SMB_SMBUS_PROTOCOL_BLOCK_READ,                              \
+    .outSize = sizeof(type),                                                        \
+    .retFunc = parse,                                                               \
+  }
+
+#define _SBS_BQ_WORD(command)                                                       \
+  {                                                                                 \
+    .readCommand = command,                                                         \
+    .readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,                               \
+    .outSize = sizeof(uint16_t),                                                    \
+  }
+
+#define _SBS_BQ_CMD(code)       [(code) - SBS_SMB_CMD_CODE_MAX]
+#define _SBS_BQ3060_CMD(code)   [(code) - SBS_BQ_CMD_CODE_MAX]
+
+static const sbs_smb_cmd_t bqCmd[SBS_BQ_CMD_CODE_MAX - SBS_SMB_CMD_CODE_MAX] SBS_SMB_CMD_TABLE_ATTR =
+{
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_DEVICE_TYPE)              = _SBS_BQ_MBA(SBS_BQ_COMMAND_DEVICE_TYPE, sizeof(uint16_t)),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_FIRMWARE_VERSION)         = _SBS_BQ_MBA(SBS_BQ_COMMAND_FIRMWARE_VERSION, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_HARDWARE_VERSION)         = _SBS_BQ_MBA(SBS_BQ_COMMAND_HARDWARE_VERSION, sizeof(uint16_t)),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_CHEMICAL_ID)              = _SBS_BQ_MBA(SBS_BQ_COMMAND_CHEMICAL_ID, sizeof(uint16_t)),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_SHUTDOWN_MODE)            = _SBS_BQ_MBA(SBS_BQ_COMMAND_SHUTDOWN_MODE, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_SLEEP_MODE)               = _SBS_BQ_MBA(SBS_BQ_COMMAND_SLEEP_MODE, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_DEVICE_RESET)             = _SBS_BQ_MBA(SBS_BQ_COMMAND_DEVICE_RESET, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_GAUGING)                  = _SBS_BQ_MBA(SBS_BQ_COMMAND_GAUGING, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_FET_CONTROL)              = _SBS_BQ_MBA(SBS_BQ_COMMAND_FET_CONTROL, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_LIFETIME_DATA_COLLECTION) = _SBS_BQ_MBA(SBS_BQ_COMMAND_LIFETIME_DATA_COLLECTION, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_SEAL_DEVICE)              = _SBS_BQ_MBA(SBS_BQ_COMMAND_SEAL_DEVICE, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_SAFETY_ALERT)             = _SBS_BQ_MBA_PARSED(SBS_BQ_COMMAND_SAFETY_ALERT, sbs_bq_safety_t, _SBSBqParseSafety),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_SAFETY_STATUS)            = _SBS_BQ_MBA_PARSED(SBS_BQ_COMMAND_SAFETY_STATUS, sbs_bq_safety_t, _SBSBqParseSafety),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_PF_ALERT)                 = _SBS_BQ_MBA_PARSED(SBS_BQ_COMMAND_PF_ALERT, sbs_bq_pf_t, _SBSBqParsePf),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_PF_STATUS)                = _SBS_BQ_MBA_PARSED(SBS_BQ_COMMAND_PF_STATUS, sbs_bq_pf_t, _SBSBqParsePf),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_OPERATION_STATUS)         = _SBS_BQ_MBA_PARSED(SBS_BQ_COMMAND_OPERATION_STATUS, sbs_bq_operation_status_t, _SBSBqParseOperationStatus),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_CHARGING_STATUS)          = _SBS_BQ_MBA_PARSED(SBS_BQ_COMMAND_CHARGING_STATUS, sbs_bq_charging_status_t, _SBSBqParseChargingStatus),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_GAUGING_STATUS)           = _SBS_BQ_MBA_PARSED(SBS_BQ_COMMAND_GAUGING_STATUS, sbs_bq_gauging_status_t, _SBSBqParseGaugingStatus),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_MANUFACTURING_STATUS)     = _SBS_BQ_MBA(SBS_BQ_COMMAND_MANUFACTURING_STATUS, sizeof(uint16_t)),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_LIFETIME_DATA_BLOCK_1)    = _SBS_BQ_MBA(SBS_BQ_COMMAND_LIFETIME_DATA_BLOCK_1, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_LIFETIME_DATA_BLOCK_2)    = _SBS_BQ_MBA(SBS_BQ_COMMAND_LIFETIME_DATA_BLOCK_2, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_LIFETIME_DATA_BLOCK_3)    = _SBS_BQ_MBA(SBS_BQ_COMMAND_LIFETIME_DATA_BLOCK_3, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_MANUFACTURER_INFO)        = _SBS_BQ_MBA(SBS_BQ_COMMAND_MANUFACTURER_INFO, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_DA_STATUS_1)              = _SBS_BQ_MBA_PARSED(SBS_BQ_COMMAND_VOLTAGES, sbs_bq_da_status1_t, _SBSBqParseDaStatus1),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_DA_STATUS_2)              = _SBS_BQ_MBA_PARSED(SBS_BQ_COMMAND_TEMPERATURES, sbs_bq_da_status2_t, _SBSBqParseDaStatus2),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_IT_STATUS_1)              = _SBS_BQ_MBA(SBS_BQ_COMMAND_IT_STATUS1, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_IT_STATUS_2)              = _SBS_BQ_MBA(SBS_BQ_COMMAND_IT_STATUS2, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_CALIBRATION_OUTPUT)       = _SBS_BQ_MBA(SBS_BQ_COMMAND_OUTPUT_CC_AND_ADC_FOR_CALIBRATION, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_CALIBRATION_OUTPUT_SHORTED) = _SBS_BQ_MBA(SBS_BQ_COMMAND_OUTPUT_SHORTED_CC_AND_ADC_OFFSET_FOR_CALIBRATION, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_CALIBRATION_OUTPUT_EXIT)  = _SBS_BQ_MBA(SBS_BQ_COMMAND_EXIT_CALIBRATION_OUTPUT_MODE, 0),
+  _SBS_BQ_CMD(SBS_BQ_CMD_CODE_CALIBRATION_SAMPLE)       = _SBS_BQ_MBA_READ_PARSED(sbs_bq_cal_sample_t, _SBSBqParseCalSample),
+};
+
+static const sbs_smb_cmd_t bq3060Cmd[SBS_BQ3060_CMD_CODE_MAX - SBS_BQ_CMD_CODE_MAX] SBS_SMB_CMD_TABLE_ATTR =
+{
+  _SBS_BQ3060_CMD(SBS_BQ3060_CMD_CODE_CELL_VOLTAGE_4)   = _SBS_BQ_WORD(0x3C),
+  _SBS_BQ3060_CMD(SBS_BQ3060_CMD_CODE_CELL_VOLTAGE_3)   = _SBS_BQ_WORD(0x3D),
+  _SBS_BQ3060_CMD(SBS_BQ3060_CMD_CODE_CELL_VOLTAGE_2)   = _SBS_BQ_WORD(0x3E),
+  _SBS_BQ3060_CMD(SBS_BQ3060_CMD_CODE_CELL_VOLTAGE_1)   = _SBS_BQ_WORD(0x3F),
+  _SBS_BQ3060_CMD(SBS_BQ3060_CMD_CODE_SAFETY_ALERT)     = _SBS_BQ_WORD(0x50),
+  _SBS_BQ3060_CMD(SBS_BQ3060_CMD_CODE_SAFETY_STATUS)    = _SBS_BQ_WORD(0x51),
+  _SBS_BQ3060_CMD(SBS_BQ3060_CMD_CODE_PF_ALERT)         = _SBS_BQ_WORD(0x52),
+  _SBS_BQ3060_CMD(SBS_BQ3060_CMD_CODE_PF_STATUS)        = _SBS_BQ_WORD(0x53),
+  _SBS_BQ3060_CMD(SBS_BQ3060_CMD_CODE_OPERATION_STATUS) = _SBS_BQ_WORD(0x54),
+  _SBS_BQ3060_CMD(SBS_BQ3060_CMD_CODE_CHARGING_STATUS)  = _SBS_BQ_WORD(0x55),
+  _SBS_BQ3060_CMD(SBS_BQ3060_CMD_CODE_PACK_VOLTAGE)     = _SBS_BQ_WORD(0x5A),
+  _SBS_BQ3060_CMD(SBS_BQ3060_CMD_CODE_AVERAGE_VOLTAGE)  = _SBS_BQ_WORD(0x5D),
+};
+
+const sbs_smb_cmd_set_t sbsBqCommands =
+{
+  .name = "bq40z50",
+  .deviceType = SBS_BQ_DEVICE_TYPE_BQ40Z50,
+  .firstCode = SBS_SMB_CMD_CODE_MAX,
+  .count = SBS_BQ_CMD_CODE_MAX - SBS_SMB_CMD_CODE_MAX,
+  .cmd = bqCmd,
+};
+
+const sbs_smb_cmd_set_t sbsBq3060Commands =
+{
+  .name = "bq3060",
+  .deviceType = SBS_BQ_DEVICE_TYPE_BQ3060,
+  .firstCode = SBS_BQ_CMD_CODE_MAX,
+  .count = SBS_BQ3060_CMD_CODE_MAX - SBS_BQ_CMD_CODE_MAX,
+  .cmd = bq3060Cmd,
+};
+
+void SBSBqBindCommands(sbs_smb_battery_t *battery)
+{
+  if (battery && !battery->cmdSet)
+    battery->cmdSet = &sbsBqCommands;
+}
+
+void SBSBqDecodeSafety(uint32_t raw, sbs_bq_safety_t *safety)
+{
+  safety->raw = raw;
+  safety->cellUnderVoltage = _SBS_BQ_BIT(raw, 0);
+  safety->cellOverVoltage = _SBS_BQ_BIT(raw, 1);
+  safety->overCurrentCharge1 = _SBS_BQ_BIT(raw, 2);
+  safety->overCurrentCharge2 = _SBS_BQ_BIT(raw, 3);
+  safety->overCurrentDischarge1 = _SBS_BQ_BIT(raw, 4);
+  safety->overCurrentDischarge2 = _SBS_BQ_BIT(raw, 5);
+  safety->overloadDischarge = _SBS_BQ_BIT(raw, 6);
+  safety->overloadDischargeLatch = _SBS_BQ_BIT(raw, 7);
+  safety->shortCircuitCharge = _SBS_BQ_BIT(raw, 8);
+  safety->shortCircuitChargeLatch = _SBS_BQ_BIT(raw, 9);
+  safety->shortCircuitDischarge = _SBS_BQ_BIT(raw, 10);
+  safety->shortCircuitDischargeLatch = _SBS_BQ_BIT(raw, 11);
+  safety->overTempCharge = _SBS_BQ_BIT(raw, 12);
+  safety->overTempDischarge = _SBS_BQ_BIT(raw, 13);
+  safety->cellUnderVoltageCompensated = _SBS_BQ_BIT(raw, 14);
+  safety->overTempFet = _SBS_BQ_BIT(raw, 16);
+  safety->prechargeTimeout = _SBS_BQ_BIT(raw, 18);
+  safety->prechargeTimeoutSuspend = _SBS_BQ_BIT(raw, 19);
+  safety->chargeTimeout = _SBS_BQ_BIT(raw, 20);
+  safety->chargeTimeoutSuspend = _SBS_BQ_BIT(raw, 21);
+  safety->overCharge = _SBS_BQ_BIT(raw, 22);
+  safety->overChargingCurrent = _SBS_BQ_BIT(raw, 23);
+  safety->overChargingVoltage = _SBS_BQ_BIT(raw, 24);
+  safety->overPrechargeCurrent = _SBS_BQ_BIT(raw, 25);
+  safety->underTempCharge = _SBS_BQ_BIT(raw, 26);
+  safety->underTempDischarge = _SBS_BQ_BIT(raw, 27);
+}
+
+void SBSBqDecodePf(uint32_t raw, sbs_bq_pf_t *pf)
+{
+  pf->raw = raw;
+  pf->safetyCellUnderVoltage = _SBS_BQ_BIT(raw, 0);
+  pf->safetyCellOverVoltage = _SBS_BQ_BIT(raw, 1);
+  pf->safetyOverCurrentCharge = _SBS_BQ_BIT(raw, 2);
+  pf->safetyOverCurrentDischarge = _SBS_BQ_BIT(raw, 3);
+  pf->safetyOverTempCell = _SBS_BQ_BIT(raw, 4);
+  pf->safetyOverTempFet = _SBS_BQ_BIT(raw, 6);
+  pf->voltageImbalanceAtRest = _SBS_BQ_BIT(raw, 8);
+  pf->voltageImbalanceActive = _SBS_BQ_BIT(raw, 9);
+  pf->chargeFetFailure = _SBS_BQ_BIT(raw, 12);
+  pf->dischargeFetFailure = _SBS_BQ_BIT(raw, 13);
+  pf->fuseFailure = _SBS_BQ_BIT(raw, 15);
+  pf->afeRegisterFailure = _SBS_BQ_BIT(raw, 16);
+  pf->afeCommunicationFailure = _SBS_BQ_BIT(raw, 17);
+  pf->secondLevelProtector = _SBS_BQ_BIT(raw, 18);
+  pf->instructionFlashChecksum = _SBS_BQ_BIT(raw, 20);
+  pf->dataFlashWearout = _SBS_BQ_BIT(raw, 22);
+  pf->openCellTab = _SBS_BQ_BIT(raw, 24);
+  pf->thermistor1 = _SBS_BQ_BIT(raw, 25);
+  pf->thermistor2 = _SBS_BQ_BIT(raw, 26);
+  pf->thermistor3 = _SBS_BQ_BIT(raw, 27);
+  pf->thermistor4 = _SBS_BQ_BIT(raw, 28);
+}
+
+void SBSBqDecodeOperationStatus(uint32_t raw, sbs_bq_operation_status_t *status)
+{
+  status->raw = raw;
+  status->systemPresent = _SBS_BQ_BIT(raw, 0);
+  status->dischargeFet = _SBS_BQ_BIT(raw, 1);
+  status->chargeFet = _SBS_BQ_BIT(raw, 2);
+  status->prechargeFet = _SBS_BQ_BIT(raw, 3);
+  status->fuse = _SBS_BQ_BIT(raw, 5);
+  status->batteryTripPoint = _SBS_BQ_BIT(raw, 7);
+  status->securityMode = (raw >> 8) & 0x03;
+  status->shutdownLowVoltage = _SBS_BQ_BIT(raw, 10);
+  status->safetyStatus = _SBS_BQ_BIT(raw, 11);
+  status->permanentFailure = _SBS_BQ_BIT(raw, 12);
+  status->dischargeDisabled = _SBS_BQ_BIT(raw, 13);
+  status->chargeDisabled = _SBS_BQ_BIT(raw, 14);
+  status->sleep = _SBS_BQ_BIT(raw, 15);
+  status->shutdownMac = _SBS_BQ_BIT(raw, 16);
+  status->ledDisplay = _SBS_BQ_BIT(raw, 17);
+  status->authenticating = _SBS_BQ_BIT(raw, 18);
+  status->autoCalibration = _SBS_BQ_BIT(raw, 19);
+  status->calibration = _SBS_BQ_BIT(raw, 20);
+  status->calibrationOffset = _SBS_BQ_BIT(raw, 21);
+  status->fastSmbus = _SBS_BQ_BIT(raw, 22);
+  status->sleepMac = _SBS_BQ_BIT(raw, 23);
+  status->initializing = _SBS_BQ_BIT(raw, 24);
+  status->smbusLowCalibration = _SBS_BQ_BIT(raw, 25);
+  status->sleepAdc = _SBS_BQ_BIT(raw, 26);
+  status->sleepCoulombCounter = _SBS_BQ_BIT(raw, 27);
+  status->cellBalancing = _SBS_BQ_BIT(raw, 28);
+  status->emergencyShutdown = _SBS_BQ_BIT(raw, 29);
+}
+
+void SBSBqDecodeChargingStatus(uint32_t raw, sbs_bq_charging_status_t *status)
+{
+  status->raw = raw;
+  status->underTemp = _SBS_BQ_BIT(raw, 0);
+  status->lowTemp = _SBS_BQ_BIT(raw, 1);
+  status->standardTempLow = _SBS_BQ_BIT(raw, 2);
+  status->recommendedTemp = _SBS_BQ_BIT(raw, 3);
+  status->standardTempHigh = _SBS_BQ_BIT(raw, 4);
+  status->highTemp = _SBS_BQ_BIT(raw, 5);
+  status->overTemp = _SBS_BQ_BIT(raw, 6);
+  status->prechargeVoltage = _SBS_BQ_BIT(raw, 8);
+  status->lowVoltage = _SBS_BQ_BIT(raw, 9);
+  status->midVoltage = _SBS_BQ_BIT(raw, 10);
+  status->highVoltage = _SBS_BQ_BIT(raw, 11);
+  status->chargeInhibit = _SBS_BQ_BIT(raw, 12);
+  status->chargeSuspend = _SBS_BQ_BIT(raw, 13);
+  status->maintenanceCharge = _SBS_BQ_BIT(raw, 14);
+  status->validChargeTermination = _SBS_BQ_BIT(raw, 15);
+  status->currentRateOfChange = _SBS_BQ_BIT(raw, 16);
+  status->voltageRateOfChange = _SBS_BQ_BIT(raw, 17);
+  status->chargingLossCompensation = _SBS_BQ_BIT(raw, 18);
+}
+
+void SBSBqDecodeGaugingStatus(uint32_t raw, sbs_bq_gauging_status_t *status)
+{
+  status->raw = raw;
+  status->fullyDischarged = _SBS_BQ_BIT(raw, 0);
+  status->fullyCharged = _SBS_BQ_BIT(raw, 1);
+  status->terminateDischarge = _SBS_BQ_BIT(raw, 2);
+  status->terminateCharge = _SBS_BQ_BIT(raw, 3);
+  status->balancingPossible = _SBS_BQ_BIT(raw, 4);
+  status->endOfDischargeVoltage = _SBS_BQ_BIT(raw, 5);
+  status->discharging = _SBS_BQ_BIT(raw, 6);
+  status->conditionFlag = _SBS_BQ_BIT(raw, 7);
+  status->rest = _SBS_BQ_BIT(raw, 8);
+  status->resistanceUpdatesDisabled = _SBS_BQ_BIT(raw, 10);
+  status->voltageOk = _SBS_BQ_BIT(raw, 11);
+  status->impedanceTrack = _SBS_BQ_BIT(raw, 12);
+  status->sleepQmax = _SBS_BQ_BIT(raw, 13);
+  status->negativeScaleFactor = _SBS_BQ_BIT(raw, 15);
+  status->qmaxVoltageDelta = _SBS_BQ_BIT(raw, 16);
+  status->qmaxUpdated = _SBS_BQ_BIT(raw, 17);
+  status->resistanceUpdated = _SBS_BQ_BIT(raw, 18);
+  status->loadMode = _SBS_BQ_BIT(raw, 19);
+  status->ocvFlatRegion = _SBS_BQ_BIT(raw, 20);
+}
+
+typedef struct
+{
+  sbs_bq_cmd_code_t code;
+  uint8_t offset;                   // Of the register in sbs_bq_status_t
+  uint8_t size;
+} _sbs_bq_status_reg_t;
+
+#define _SBS_BQ_STATUS_REG(code, member)  { code, offsetof(sbs_bq_status_t, member), sizeof(((sbs_bq_status_t *)0)->member) }
+
+// In the order SBSBqReadStatus() reads them
+static const _sbs_bq_status_reg_t statusRegs[] =
+{
+  _SBS_BQ_STATUS_REG(SBS_BQ_CMD_CODE_OPERATION_STATUS, operationStatus),
+  _SBS_BQ_STATUS_REG(SBS_BQ_CMD_CODE_SAFETY_ALERT, safetyAlert),
+  _SBS_BQ_STATUS_REG(SBS_BQ_CMD_CODE_SAFETY_STATUS, safetyStatus),
+  _SBS_BQ_STATUS_REG(SBS_BQ_CMD_CODE_PF_ALERT, pfAlert),
+  _SBS_BQ_STATUS_REG(SBS_BQ_CMD_CODE_PF_STATUS, pfStatus),
+  _SBS_BQ_STATUS_REG(SBS_BQ_CMD_CODE_CHARGING_STATUS, chargingStatus),
+  _SBS_BQ_STATUS_REG(SBS_BQ_CMD_CODE_GAUGING_STATUS, gaugingStatus),
+};
+
+#define _SBS_BQ_STATUS_REG_COUNT  (sizeof(statusRegs) / sizeof(statusRegs[0]))
+
+int SBSBqReadStatus(sbs_smb_battery_t *battery, sbs_bq_status_t *status)
+{
+  if (!battery || !status)
+    return SMBUS_ERR_INVALID_ARG;
+
+  memset(status, 0, sizeof(*status));
+  SBSBqBindCommands(battery);
+
+  for (uint8_t i = 0; i < _SBS_BQ_STATUS_REG_COUNT; i++)
+  {
+    const _sbs_bq_status_reg_t *reg = &statusRegs[i];
+
+    // Nothing to read unless OperationStatus() flags it
+    if ((reg->code == SBS_BQ_CMD_CODE_SAFETY_STATUS && !status->operationStatus.safetyStatus) ||
+        (reg->code == SBS_BQ_CMD_CODE_PF_STATUS && !status->operationStatus.permanentFailure))
+      continue;
+
+    int ret = SBSRunCommand(battery, reg->code, NULL, 0, (uint8_t *)status + reg->offset, reg->size);
+    if (ret != SMBUS_ERR_OK)
+      return ret;
+  }
+
+  return SMBUS_ERR_OK;
+}
+
+int SBSBqSchedStatus(sbs_sched_t *sched, sbs_smb_battery_t *battery, sbs_bq_status_t *status)
+{
+  if (!sched || !battery || !status)
+    return SMBUS_ERR_INVALID_ARG;
+
+  if ((size_t)(sched->capacity - sched->count) < _SBS_BQ_STATUS_REG_COUNT)
+    return SMBUS_ERR_FAIL;
+
+  memset(status, 0, sizeof(*status));
+  SBSBqBindCommands(battery);
+
+  for (uint8_t i = 0; i < _SBS_BQ_STATUS_REG_COUNT; i++)
+    SBSSchedAdd(sched, battery, statusRegs[i].code, 0, 0, (uint8_t *)status + statusRegs[i].offset, statusRegs[i].size);
+
+  return SMBUS_ERR_OK;
+}
@@ -0,0 +1,309 @@
+/**
+ *
+ * @file:   sbs_bq_cmd.h - Command sets of TI gauge families for the SBS command registry
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * Each family gets a range of sbs_smb_cmd_id_t values after the standard commands, run with SBSRunCommand()
+ * once the set is bound to the battery, either directly:
+ *
+ *  battery.cmdSet = &sbsBqCommands;
+ *  SBSRunCommand(&battery, SBS_BQ_CMD_CODE_OPERATION_STATUS, NULL, 0, &operationStatus, sizeof(operationStatus));
+ *
+ * or by registering the sets with SBSRegisterCommandSet() and letting SBSProfileGet() bind the one that matches
+ * DeviceType().
+ *
+ * The bq40z50 set goes through ManufacturerBlockAccess(). The echoed command is checked and dropped, so values
+ * decode straight into the type next to their code, and variable length blocks keep the [length][data...] layout
+ * of the standard block reads. Entries without a response are run with outPtr NULL and only send the command.
+ *
+ * The bq3060 has no ManufacturerBlockAccess(). Its status registers are plain SBS words at 0x50 onwards.
+ *
+ * The bq40z50 status registers decode into the structs below, one bit field per flag in the bit order of the
+ * technical reference manual, with the register as read kept in raw. SBSBqReadStatus() reads the whole group.
+ *
+ * */
+
+#ifndef _SBS_BQ_CMD_H_
+#define _SBS_BQ_CMD_H_
+
+#include <stdint.h>
+
+#include "sbs_smb.h"
+#include "sbs_bq.h"
+#include "sbs_sched.h"
+
+#define SBS_BQ_DEVICE_TYPE_BQ40Z50                      0x4500
+#define SBS_BQ_DEVICE_TYPE_BQ3060                       0x3060
+
+#define SBS_BQ_CELL_COUNT                               4       // Cells a bq40z50 measures
+#define SBS_BQ_TS_COUNT                                 4       // Thermistor inputs TS1 - TS4
+
+typedef enum
+{
+  SBS_BQ_CMD_CODE_DEVICE_TYPE = SBS_SMB_CMD_CODE_MAX,   // uint16_t
+  SBS_BQ_CMD_CODE_FIRMWARE_VERSION,                     // Block
+  SBS_BQ_CMD_CODE_HARDWARE_VERSION,                     // uint16_t
+  SBS_BQ_CMD_CODE_CHEMICAL_ID,                          // uint16_t
+  SBS_BQ_CMD_CODE_SHUTDOWN_MODE,                        // Command only
+  SBS_BQ_CMD_CODE_SLEEP_MODE,                           // Command only
+  SBS_BQ_CMD_CODE_DEVICE_RESET,                         // Command only
+  SBS_BQ_CMD_CODE_GAUGING,                              // Command only, toggles Impedance Track
+  SBS_BQ_CMD_CODE_FET_CONTROL,                          // Command only, toggles FW control of the FETs
+  SBS_BQ_CMD_CODE_LIFETIME_DATA_COLLECTION,             // Command only, toggles lifetime data collection
+  SBS_BQ_CMD_CODE_SEAL_DEVICE,                          // Command only
+  SBS_BQ_CMD_CODE_SAFETY_ALERT,                         // sbs_bq_safety_t
+  SBS_BQ_CMD_CODE_SAFETY_STATUS,                        // sbs_bq_safety_t
+  SBS_BQ_CMD_CODE_PF_ALERT,                             // sbs_bq_pf_t
+  SBS_BQ_CMD_CODE_PF_STATUS,                            // sbs_bq_pf_t
+  SBS_BQ_CMD_CODE_OPERATION_STATUS,                     // sbs_bq_operation_status_t
+  SBS_BQ_CMD_CODE_CHARGING_STATUS,                      // sbs_bq_charging_status_t
+  SBS_BQ_CMD_CODE_GAUGING_STATUS,                       // sbs_bq_gauging_status_t
+  SBS_BQ_CMD_CODE_MANUFACTURING_STATUS,                 // uint16_t
+  SBS_BQ_CMD_CODE_LIFETIME_DATA_BLOCK_1,                // Block
+  SBS_BQ_CMD_CODE_LIFETIME_DATA_BLOCK_2,                // Block
+  SBS_BQ_CMD_CODE_LIFETIME_DATA_BLOCK_3,                // Block
+  SBS_BQ_CMD_CODE_MANUFACTURER_INFO,                    // Block
+  SBS_BQ_CMD_CODE_DA_STATUS_1,                          // sbs_bq_da_status1_t
+  SBS_BQ_CMD_CODE_DA_STATUS_2,                          // sbs_bq_da_status2_t
+  SBS_BQ_CMD_CODE_IT_STATUS_1,                          // Block
+  SBS_BQ_CMD_CODE_IT_STATUS_2,                          // Block
+  SBS_BQ_CMD_CODE_CALIBRATION_OUTPUT,                   // Command only, start raw CC and ADC output. See sbs_bq_cal.h
+  SBS_BQ_CMD_CODE_CALIBRATION_OUTPUT_SHORTED,           // Command only, the same with the CC inputs shorted, for offsets
+  SBS_BQ_CMD_CODE_CALIBRATION_OUTPUT_EXIT,              // Command only
+  SBS_BQ_CMD_CODE_CALIBRATION_SAMPLE,                   // sbs_bq_cal_sample_t, read without writing a command
+  SBS_BQ_CMD_CODE_MAX
+} sbs_bq_cmd_code_t;
+
+typedef enum
+{
+  SBS_BQ3060_CMD_CODE_CELL_VOLTAGE_4 = SBS_BQ_CMD_CODE_MAX, // uint16_t mV
+  SBS_BQ3060_CMD_CODE_CELL_VOLTAGE_3,                   // uint16_t mV
+  SBS_BQ3060_CMD_CODE_CELL_VOLTAGE_2,                   // uint16_t mV
+  SBS_BQ3060_CMD_CODE_CELL_VOLTAGE_1,                   // uint16_t mV
+  SBS_BQ3060_CMD_CODE_SAFETY_ALERT,                     // uint16_t
+  SBS_BQ3060_CMD_CODE_SAFETY_STATUS,                    // uint16_t
+  SBS_BQ3060_CMD_CODE_PF_ALERT,                         // uint16_t
+  SBS_BQ3060_CMD_CODE_PF_STATUS,                        // uint16_t
+  SBS_BQ3060_CMD_CODE_OPERATION_STATUS,                 // uint16_t
+  SBS_BQ3060_CMD_CODE_CHARGING_STATUS,                  // uint16_t
+  SBS_BQ3060_CMD_CODE_PACK_VOLTAGE,                     // uint16_t mV
+  SBS_BQ3060_CMD_CODE_AVERAGE_VOLTAGE,                  // uint16_t mV
+  SBS_BQ3060_CMD_CODE_MAX
+} sbs_bq3060_cmd_code_t;
+
+// SafetyAlert() and SafetyStatus()
+typedef struct
+{
+  uint32_t raw;
+  uint32_t cellUnderVoltage               : 1;  // CUV
+  uint32_t cellOverVoltage                : 1;  // COV
+  uint32_t overCurrentCharge1             : 1;  // OCC1
+  uint32_t overCurrentCharge2             : 1;  // OCC2
+  uint32_t overCurrentDischarge1          : 1;  // OCD1
+  uint32_t overCurrentDischarge2          : 1;  // OCD2
+  uint32_t overloadDischarge              : 1;  // AOLD
+  uint32_t overloadDischargeLatch         : 1;  // AOLDL
+  uint32_t shortCircuitCharge             : 1;  // ASCC
+  uint32_t shortCircuitChargeLatch        : 1;  // ASCCL
+  uint32_t shortCircuitDischarge          : 1;  // ASCD
+  uint32_t shortCircuitDischargeLatch     : 1;  // ASCDL
+  uint32_t overTempCharge                 : 1;  // OTC
+  uint32_t overTempDischarge              : 1;  // OTD
+  uint32_t cellUnderVoltageCompensated    : 1;  // CUVC
+  uint32_t overTempFet                    : 1;  // OTF, bit 16
+  uint32_t prechargeTimeout               : 1;  // PTO, bit 18
+  uint32_t prechargeTimeoutSuspend        : 1;  // PTOS, SafetyAlert() only
+  uint32_t chargeTimeout                  : 1;  // CTO
+  uint32_t chargeTimeoutSuspend           : 1;  // CTOS, SafetyAlert() only
+  uint32_t overCharge                     : 1;  // OC
+  uint32_t overChargingCurrent            : 1;  // CHGC
+  uint32_t overChargingVoltage            : 1;  // CHGV
+  uint32_t overPrechargeCurrent           : 1;  // PCHGC
+  uint32_t underTempCharge                : 1;  // UTC
+  uint32_t underTempDischarge             : 1;  // UTD
+} sbs_bq_safety_t;
+
+// PFAlert() and PFStatus()
+typedef struct
+{
+  uint32_t raw;
+  uint32_t safetyCellUnderVoltage         : 1;  // SUV
+  uint32_t safetyCellOverVoltage          : 1;  // SOV
+  uint32_t safetyOverCurrentCharge        : 1;  // SOCC
+  uint32_t safetyOverCurrentDischarge     : 1;  // SOCD
+  uint32_t safetyOverTempCell             : 1;  // SOT
+  uint32_t safetyOverTempFet              : 1;  // SOTF, bit 6
+  uint32_t voltageImbalanceAtRest         : 1;  // VIMR, bit 8
+  uint32_t voltageImbalanceActive         : 1;  // VIMA
+  uint32_t chargeFetFailure               : 1;  // CFETF, bit 12
+  uint32_t dischargeFetFailure            : 1;  // DFETF
+  uint32_t fuseFailure                    : 1;  // FUSE, bit 15
+  uint32_t afeRegisterFailure             : 1;  // AFER
+  uint32_t afeCommunicationFailure        : 1;  // AFEC
+  uint32_t secondLevelProtector           : 1;  // 2LVL
+  uint32_t instructionFlashChecksum       : 1;  // IFC, bit 20
+  uint32_t dataFlashWearout               : 1;  // DFW, bit 22
+  uint32_t openCellTab                    : 1;  // OPNCELL, bit 24
+  uint32_t thermistor1                    : 1;  // TS1
+  uint32_t thermistor2                    : 1;  // TS2
+  uint32_t thermistor3                    : 1;  // TS3
+  uint32_t thermistor4                    : 1;  // TS4
+} sbs_bq_pf_t;
+
+// OperationStatus()
+typedef struct
+{
+  uint32_t raw;
+  uint32_t systemPresent                  : 1;  // PRES, set when the system present pin is low
+  uint32_t dischargeFet                   : 1;  // DSG
+  uint32_t chargeFet                      : 1;  // CHG
+  uint32_t prechargeFet                   : 1;  // PCHG
+  uint32_t fuse                           : 1;  // FUSE, bit 5
+  uint32_t batteryTripPoint               : 1;  // BTP_INT, bit 7
+  uint32_t securityMode                   : 2;  // SEC1:SEC0, sbs_bq_security_mode_t
+  uint32_t shutdownLowVoltage             : 1;  // SDV
+  uint32_t safetyStatus                   : 1;  // SS, SafetyStatus() has a flag set
+  uint32_t permanentFailure               : 1;  // PF, PFStatus() has a flag set
+  uint32_t dischargeDisabled              : 1;  // XDSG
+  uint32_t chargeDisabled                 : 1;  // XCHG
+  uint32_t sleep                          : 1;  // SLEEP
+  uint32_t shutdownMac                    : 1;  // SDM
+  uint32_t ledDisplay                     : 1;  // LED
+  uint32_t authenticating                 : 1;  // AUTH
+  uint32_t autoCalibration                : 1;  // AUTOCALM
+  uint32_t calibration                    : 1;  // CAL
+  uint32_t calibrationOffset              : 1;  // CAL_OFFSET
+  uint32_t fastSmbus                      : 1;  // XL, 400 kHz mode
+  uint32_t sleepMac                       : 1;  // SLEEPM
+  uint32_t initializing                   : 1;  // INIT
+  uint32_t smbusLowCalibration            : 1;  // SMBLCAL
+  uint32_t sleepAdc                       : 1;  // SLPAD
+  uint32_t sleepCoulombCounter            : 1;  // SLPCC
+  uint32_t cellBalancing                  : 1;  // CB
+  uint32_t emergencyShutdown              : 1;  // EMSHUT
+} sbs_bq_operation_status_t;
+
+// ChargingStatus()
+typedef struct
+{
+  uint32_t raw;
+  uint32_t underTemp                      : 1;  // UT
+  uint32_t lowTemp                        : 1;  // LT
+  uint32_t standardTempLow                : 1;  // STL
+  uint32_t recommendedTemp                : 1;  // RT
+  uint32_t standardTempHigh               : 1;  // STH
+  uint32_t highTemp                       : 1;  // HT
+  uint32_t overTemp                       : 1;  // OT
+  uint32_t prechargeVoltage               : 1;  // PV, bit 8
+  uint32_t lowVoltage                     : 1;  // LV
+  uint32_t midVoltage                     : 1;  // MV
+  uint32_t highVoltage                    : 1;  // HV
+  uint32_t chargeInhibit                  : 1;  // IN
+  uint32_t chargeSuspend                  : 1;  // SU
+  uint32_t maintenanceCharge              : 1;  // MCHG
+  uint32_t validChargeTermination         : 1;  // VCT
+  uint32_t currentRateOfChange            : 1;  // CCR, 3 byte firmware only
+  uint32_t voltageRateOfChange            : 1;  // CVR, 3 byte firmware only
+  uint32_t chargingLossCompensation       : 1;  // CCC, 3 byte firmware only
+} sbs_bq_charging_status_t;
+
+// GaugingStatus()
+typedef struct
+{
+  uint32_t raw;
+  uint32_t fullyDischarged                : 1;  // FD
+  uint32_t fullyCharged                   : 1;  // FC
+  uint32_t terminateDischarge             : 1;  // TD
+  uint32_t terminateCharge                : 1;  // TC
+  uint32_t balancingPossible              : 1;  // BAL_EN
+  uint32_t endOfDischargeVoltage          : 1;  // EDV
+  uint32_t discharging                    : 1;  // DSG, clear when charging or relaxing
+  uint32_t conditionFlag                  : 1;  // CF
+  uint32_t rest                           : 1;  // REST
+  uint32_t resistanceUpdatesDisabled      : 1;  // R_DIS, bit 10
+  uint32_t voltageOk                      : 1;  // VOK
+  uint32_t impedanceTrack                 : 1;  // QEN
+  uint32_t sleepQmax                      : 1;  // SLPQMax
+  uint32_t negativeScaleFactor            : 1;  // NSFM, bit 15
+  uint32_t qmaxVoltageDelta               : 1;  // VDQ
+  uint32_t qmaxUpdated                    : 1;  // QMax
+  uint32_t resistanceUpdated              : 1;  // RX
+  uint32_t loadMode                       : 1;  // LDMD
+  uint32_t ocvFlatRegion                  : 1;  // OCVFR
+} sbs_bq_gauging_status_t;
+
+// DAStatus1(): cell and pack measurements
+typedef struct
+{
+  uint16_t cellVoltage[SBS_BQ_CELL_COUNT];        // mV
+  uint16_t batVoltage;                            // mV at the BAT pin
+  uint16_t packVoltage;                           // mV at the PACK pin
+  int16_t cellCurrent[SBS_BQ_CELL_COUNT];         // mA, measured at the time of each cell voltage
+  int16_t cellPower[SBS_BQ_CELL_COUNT];           // cW
+  int16_t power;                                  // cW
+  int16_t averagePower;                           // cW
+} sbs_bq_da_status1_t;
+
+// DAStatus2(): temperatures, all 0.1K
+typedef struct
+{
+  uint16_t internalTemp;
+  uint16_t ts[SBS_BQ_TS_COUNT];
+  uint16_t cellTemp;
+  uint16_t fetTemp;
+  uint16_t gaugingTemp;
+} sbs_bq_da_status2_t;
+
+// Raw counts output in calibration mode. counter moves on every time the gauge refreshes them.
+typedef struct
+{
+  uint16_t command;                             // Echoed mode, anything else means the gauge isn't in calibration mode
+  uint8_t counter;
+  uint8_t status;                               // 1 for CC and ADC output, 2 for shorted CC offset output
+  int16_t cc;                                   // Coulomb counter
+  int16_t cellVoltage[SBS_BQ_CELL_COUNT];
+  int16_t packVoltage;
+  int16_t batVoltage;
+  int16_t cellCurrent[SBS_BQ_CELL_COUNT];
+} sbs_bq_cal_sample_t;
+
+typedef struct
+{
+  sbs_bq_operation_status_t operationStatus;
+  sbs_bq_safety_t safetyAlert;
+  sbs_bq_safety_t safetyStatus;
+  sbs_bq_pf_t pfAlert;
+  sbs_bq_pf_t pfStatus;
+  sbs_bq_charging_status_t chargingStatus;
+  sbs_bq_gauging_status_t gaugingStatus;
+} sbs_bq_status_t;
+
+extern const sbs_smb_cmd_set_t sbsBqCommands;         // bq40z50
+extern const sbs_smb_cmd_set_t sbsBq3060Commands;
+
+/// @brief Bind sbsBqCommands to a battery that has no command set yet, so the bq40z50 codes run on batteries that
+///        were never profiled.
+/// @note  SBSBqGetSecurityMode(), SBSBqReadStatus(), SBSBqSchedStatus(), SBSBqStreamInit(), SBSBqCalInit() and
+///        SBSBqLifetimeSched() call it, so they leave battery->cmdSet pointing at sbsBqCommands for good if it was
+///        NULL. Bind the set that matches the chip first, e.g. with SBSProfileGet(), to keep it. A battery bound to
+///        another family is left alone, and those functions then fail with SMBUS_ERR_INVALID_ARG.
+void SBSBqBindCommands(sbs_smb_battery_t *battery);
+
+void SBSBqDecodeSafety(uint32_t raw, sbs_bq_safety_t *safety);
+void SBSBqDecodePf(uint32_t raw, sbs_bq_pf_t *pf);
+void SBSBqDecodeOperationStatus(uint32_t raw, sbs_bq_operation_status_t *status);
+void SBSBqDecodeChargingStatus(uint32_t raw, sbs_bq_charging_status_t *status);
+void SBSBqDecodeGaugingStatus(uint32_t raw, sbs_bq_gauging_status_t *status);
+
+/// @brief Read and decode the status group: OperationStatus() first, then the alerts, ChargingStatus() and
+///        GaugingStatus(). SafetyStatus() and PFStatus() are only read when OperationStatus() reports SS or PF,
+///        and are left zero otherwise, so a healthy pack costs five MAC reads instead of seven.
+int SBSBqReadStatus(sbs_smb_battery_t *battery, sbs_bq_status_t *status);
+
+/// @brief Queue the reads of all seven registers of the group on a scheduler, for a scan of many packs in one
+///        SBSSchedRun(). status is filled in as the jobs finish.
+/// @return SMBUS_ERR_FAIL, with nothing queued, if the scheduler doesn't have room for all seven
+int SBSBqSchedStatus(sbs_sched_t *sched, sbs_smb_battery_t *battery, sbs_bq_status_t *status);
+
+#endif
@@ -0,0 +1,366 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "platform/smbus_platform.h"
+#include "sbs_bq.h"
+#include "sbs_cache.h"
+#include "sbs_bq_df.h"
+
+static void _SBSBqDfSetBit(uint8_t *bitmap, uint16_t bit, bool value)
+{
+  if (value)
+    bitmap[bit / 8] |= (1 << (bit % 8));
+  else
+    bitmap[bit / 8] &= ~(1 << (bit % 8));
+}
+
+static bool _SBSBqDfGetBit(const uint8_t *bitmap, uint16_t bit)
+{
+  return bitmap[bit / 8] & (1 << (bit % 8));
+}
+
+static bool _SBSBqDfInRange(const sbs_bq_df_image_t *image, uint16_t address, uint16_t len)
+{
+  return len && address >= image->startAddress &&
+         (uint32_t)address + len <= (uint32_t)image->startAddress + image->size;
+}
+
+int SBSBqDfImageInit(sbs_bq_df_image_t *image, uint16_t startAddress, uint16_t size,
+                     uint8_t *data, uint8_t *valid, uint8_t *dirty)
+{
+  if (!image || !data || !valid || !dirty || !size ||
+      startAddress % SBS_BQ_DF_ROW_SIZE || size % SBS_BQ_DF_ROW_SIZE ||
+      startAddress < SBS_BQ_DF_ADDRESS_START || (uint32_t)startAddress + size > SBS_BQ_DF_ADDRESS_END)
+    return SMBUS_ERR_INVALID_ARG;
+
+  image->startAddress = startAddress;
+  image->size = size;
+  image->data = data;
+  image->valid = valid;
+  image->dirty = dirty;
+  image->rowsRead = 0;
+  SBSBqDfImageInvalidate(image);
+
+  return SMBUS_ERR_OK;
+}
+
+void SBSBqDfImageInvalidate(sbs_bq_df_image_t *image)
+{
+  if (!image)
+    return;
+
+  memset(image->valid, 0, SBS_BQ_DF_BITMAP_SIZE(image->size));
+  memset(image->dirty, 0, SBS_BQ_DF_BITMAP_SIZE(image->size));
+}
+
+bool SBSBqDfImageRowValid(const sbs_bq_df_image_t *image, uint16_t row)
+{
+  return row < SBS_BQ_DF_ROW_COUNT(image->size) && _SBSBqDfGetBit(image->valid, row);
+}
+
+bool SBSBqDfImageRowDirty(const sbs_bq_df_image_t *image, uint16_t row)
+{
+  return row < SBS_BQ_DF_ROW_COUNT(image->size) && _SBSBqDfGetBit(image->dirty, row);
+}
+
+int SBSBqDfImageWrite(sbs_bq_df_image_t *image, uint16_t address, const void *data, uint16_t len)
+{
+  if (!image || !data || !_SBSBqDfInRange(image, address, len))
+    return SMBUS_ERR_INVALID_ARG;
+
+  uint16_t offset = address - image->startAddress;
+  uint16_t firstRow = offset / SBS_BQ_DF_ROW_SIZE;
+  uint16_t lastRow = (offset + len - 1) / SBS_BQ_DF_ROW_SIZE;
+
+  // Check every row before changing any, a row that is only partly overwritten has to be known already
+  for (uint16_t row = firstRow; row <= lastRow; row++)
+  {
+    uint16_t rowStart = row * SBS_BQ_DF_ROW_SIZE;
+    bool whole = offset <= rowStart && offset + len >= rowStart + SBS_BQ_DF_ROW_SIZE;
+    if (!whole && !_SBSBqDfGetBit(image->valid, row))
+      return SMBUS_ERR_INVALID_ARG;
+  }
+
+  const uint8_t *src = (const uint8_t *)data;
+  for (uint16_t i = 0; i < len; i++)
+  {
+    uint16_t row = (offset + i) / SBS_BQ_DF_ROW_SIZE;
+    if (image->data[offset + i] != src[i] || !_SBSBqDfGetBit(image->valid, row))
+      _SBSBqDfSetBit(image->dirty, row, true);
+    image->data[offset + i] = src[i];
+  }
+
+  for (uint16_t row = firstRow; row <= lastRow; row++)
+    _SBSBqDfSetBit(image->valid, row, true);
+
+  return SMBUS_ERR_OK;
+}
+
+int SBSBqDfReadRow(sbs_smb_battery_t *battery, uint16_t address, uint8_t *row)
+{
+  if (!battery || !battery->bus || !row || address < SBS_BQ_DF_ADDRESS_START || address >= SBS_BQ_DF_ADDRESS_END)
+    return SMBUS_ERR_INVALID_ARG;
+
+  uint8_t dataBuff[256];
+  uint8_t recvLen = 0;
+
+  // No delay is needed between the address write and the read, the gauge stretches the clock until the row is ready
+  int ret = SMBusWriteWordBlockReadBlock(battery->bus, battery->busAddress, SBS_BQ_COMMAND_MANUFACTURER_BLOCK_ACCESS,
+                                         address, SBS_BQ_COMMAND_MANUFACTURER_BLOCK_ACCESS, dataBuff, &recvLen, 0);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  // The row at the end of the data flash may come back short
+  if (recvLen < 2 || (dataBuff[0] | (dataBuff[1] << 8)) != address)
+    return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+  recvLen -= 2;
+  if (recvLen > SBS_BQ_DF_ROW_SIZE)
+    recvLen = SBS_BQ_DF_ROW_SIZE;
+
+  memcpy(row, &dataBuff[2], recvLen);
+  memset(row + recvLen, 0xFF, SBS_BQ_DF_ROW_SIZE - recvLen);
+
+  return SMBUS_ERR_OK;
+}
+
+int SBSBqDfFetch(sbs_smb_battery_t *battery, sbs_bq_df_image_t *image, uint16_t address, uint16_t len, bool refresh)
+{
+  if (!battery || !image || !_SBSBqDfInRange(image, address, len))
+    return SMBUS_ERR_INVALID_ARG;
+
+  uint16_t offset = address - image->startAddress;
+  uint16_t firstRow = offset / SBS_BQ_DF_ROW_SIZE;
+  uint16_t lastRow = (offset + len - 1) / SBS_BQ_DF_ROW_SIZE;
+  bool selected = false;
+  int ret = SMBUS_ERR_OK;
+
+  // Keep other users of the battery from slipping their own ManufacturerBlockAccess() between ours
+  if (battery->cache)
+    SBSCacheLock(battery->cache);
+
+  for (uint16_t row = firstRow; row <= lastRow; row++)
+  {
+    if (_SBSBqDfGetBit(image->dirty, row) || (!refresh && _SBSBqDfGetBit(image->valid, row)))
+      continue;
+
+    // Only select the battery once there is something to read, a range that is already known costs nothing
+    if (!selected)
+    {
+      ret = SBSSelectBattery(battery);
+      if (ret != SMBUS_ERR_OK)
+        break;
+      selected = true;
+    }
+
+    uint16_t rowOffset = row * SBS_BQ_DF_ROW_SIZE;
+    ret = SBSBqDfReadRow(battery, image->startAddress + rowOffset, &image->data[rowOffset]);
+    if (ret != SMBUS_ERR_OK)
+    {
+      _SBSBqDfSetBit(image->valid, row, false);
+      break;
+    }
+
+    _SBSBqDfSetBit(image->valid, row, true);
+    image->rowsRead++;
+  }
+
+  if (battery->cache)
+    SBSCacheUnlock(battery->cache);
+
+  return ret;
+}
+
+int SBSBqDfRead(sbs_smb_battery_t *battery, sbs_bq_df_image_t *image, uint16_t address, void *data, uint16_t len)
+{
+  if (!data)
+    return SMBUS_ERR_INVALID_ARG;
+
+  int ret = SBSBqDfFetch(battery, image, address, len, false);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  memcpy(data, &image->data[address - image->startAddress], len);
+  return SMBUS_ERR_OK;
+}
+
+int SBSBqDfDump(sbs_smb_battery_t *battery, sbs_bq_df_image_t *image)
+{
+  if (!image)
+    return SMBUS_ERR_INVALID_ARG;
+
+  return SBSBqDfFetch(battery, image, image->startAddress, image->size, false);
+}
+
+int SBSBqDfRequestChecksum(sbs_smb_battery_t *battery)
+{
+  if (!battery || !battery->bus)
+    return SMBUS_ERR_INVALID_ARG;
+
+  int ret = SBSSelectBattery(battery);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  return SMBusWrite16Block(battery->bus, battery->busAddress, SBS_BQ_COMMAND_MANUFACTURER_BLOCK_ACCESS,
+                           SBS_BQ_COMMAND_DATA_FLASH_CHECKSUM);
+}
+
+int SBSBqDfCollectChecksum(sbs_smb_battery_t *battery, uint32_t *checksum)
+{
+  if (!battery || !battery->bus || !checksum)
+    return SMBUS_ERR_INVALID_ARG;
+
+  uint8_t dataBuff[256];
+  uint8_t recvLen = 0;
+
+  int ret = SBSSelectBattery(battery);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  ret = SMBusBlockRead(battery->bus, battery->busAddress, SBS_BQ_COMMAND_MANUFACTURER_BLOCK_ACCESS, dataBuff, &recvLen);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  // The response is the command followed by the checksum, LSB first
+  if (recvLen < 4 || recvLen > 6 || (dataBuff[0] | (dataBuff[1] << 8)) != SBS_BQ_COMMAND_DATA_FLASH_CHECKSUM)
+    return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+  *checksum = 0;
+  for (uint8_t i = recvLen; i > 2; i--)
+    *checksum = (*checksum << 8) | dataBuff[i - 1];
+
+  return SMBUS_ERR_OK;
+}
+
+int SBSBqDfReadChecksum(sbs_smb_battery_t *battery, uint32_t *checksum)
+{
+  if (!battery || !battery->bus || !checksum)
+    return SMBUS_ERR_INVALID_ARG;
+
+  if (battery->cache)
+    SBSCacheLock(battery->cache);
+
+  int ret = SBSBqDfRequestChecksum(battery);
+  if (ret == SMBUS_ERR_OK)
+  {
+    SMBusPlatformDelayMs(SBS_BQ_DF_CHECKSUM_DELAY_MS);
+    ret = SBSBqDfCollectChecksum(battery, checksum);
+  }
+
+  if (battery->cache)
+    SBSCacheUnlock(battery->cache);
+
+  return ret;
+}
+
+int SBSBqDfFlush(sbs_smb_battery_t *battery, sbs_bq_df_image_t *image, uint16_t *rowsWritten)
+{
+  return SBSBqDfFlushRows(battery, image, UINT16_MAX, rowsWritten);
+}
+
+int SBSBqDfFlushRows(sbs_smb_battery_t *battery, sbs_bq_df_image_t *image, uint16_t maxRows, uint16_t *rowsWritten)
+{
+  if (!battery || !battery->bus || !image)
+    return SMBUS_ERR_INVALID_ARG;
+
+  uint8_t dataBuff[2 + SBS_BQ_DF_ROW_SIZE];
+  uint16_t written = 0;
+  bool selected = false;
+  int ret = SMBUS_ERR_OK;
+
+  if (battery->cache)
+    SBSCacheLock(battery->cache);
+
+  for (uint16_t row = 0; row < SBS_BQ_DF_ROW_COUNT(image->size) && written < maxRows; row++)
+  {
+    if (!_SBSBqDfGetBit(image->dirty, row))
+      continue;
+
+    if (!selected)
+    {
+      ret = SBSSelectBattery(battery);
+      if (ret != SMBUS_ERR_OK)
+        break;
+      selected = true;
+    }
+
+    uint16_t rowOffset = row * SBS_BQ_DF_ROW_SIZE;
+    uint16_t address = image->startAddress + rowOffset;
+
+    dataBuff[0] = address & 0xFF;
+    dataBuff[1] = address >> 8;
+    memcpy(&dataBuff[2], &image->data[rowOffset], SBS_BQ_DF_ROW_SIZE);
+
+    ret = SMBusBlockWrite(battery->bus, battery->busAddress, SBS_BQ_COMMAND_MANUFACTURER_BLOCK_ACCESS,
+                          dataBuff, sizeof(dataBuff));
+    if (ret != SMBUS_ERR_OK)
+      break;
+
+    _SBSBqDfSetBit(image->dirty, row, false);
+    written++;
+  }
+
+  // Data flash holds the design values and configuration SBS commands report, so cached reads may be stale now
+  if (battery->cache)
+  {
+    if (written)
+      SBSCacheClear(battery->cache);
+    SBSCacheUnlock(battery->cache);
+  }
+
+  if (rowsWritten)
+    *rowsWritten = written;
+
+  return ret;
+}
+
+int SBSBqDfApply(sbs_smb_battery_t *battery, sbs_bq_df_image_t *image, const sbs_bq_df_image_t *target,
+                 const uint32_t *checksum, uint16_t *rowsWritten)
+{
+  if (!battery || !image || !target ||
+      !_SBSBqDfInRange(image, target->startAddress, target->size))
+    return SMBUS_ERR_INVALID_ARG;
+
+  uint32_t gaugeChecksum;
+  int ret;
+
+  if (rowsWritten)
+    *rowsWritten = 0;
+
+  if (checksum)
+  {
+    ret = SBSBqDfReadChecksum(battery, &gaugeChecksum);
+    if (ret != SMBUS_ERR_OK)
+      return ret;
+    if (gaugeChecksum == *checksum)
+      return SMBUS_ERR_OK;
+  }
+
+  // Copying a target row over the image only marks it dirty if a byte actually changes
+  for (uint16_t row = 0; row < SBS_BQ_DF_ROW_COUNT(target->size); row++)
+  {
+    if (!_SBSBqDfGetBit(target->valid, row))
+      continue;
+
+    uint16_t rowOffset = row * SBS_BQ_DF_ROW_SIZE;
+    uint16_t address = target->startAddress + rowOffset;
+
+    ret = SBSBqDfFetch(battery, image, address, SBS_BQ_DF_ROW_SIZE, false);
+    if (ret != SMBUS_ERR_OK)
+      return ret;
+
+    ret = SBSBqDfImageWrite(image, address, &target->data[rowOffset], SBS_BQ_DF_ROW_SIZE);
+    if (ret != SMBUS_ERR_OK)
+      return ret;
+  }
+
+  ret = SBSBqDfFlush(battery, image, rowsWritten);
+  if (ret != SMBUS_ERR_OK || !checksum)
+    return ret;
+
+  ret = SBSBqDfReadChecksum(battery, &gaugeChecksum);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  return (gaugeChecksum == *checksum) ? SMBUS_ERR_OK : SMBUS_ERR_FAIL;
+}
@@ -0,0 +1,117 @@
+/**
+ *
+ * @file:   sbs_bq_df.h - bq40z50 data flash reader and writer backed by a local row image
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * The data flash of the bq40z50 lives at 0x4000 - 0x5FFF and is read through ManufacturerBlockAccess():
+ * a block write of the 16-bit address to 0x44 followed by a block read of 0x44, which returns the address
+ * back followed by the 32 bytes starting at it.
+ *
+ *  MBA write: [0x44][2][addr_lo][addr_hi]
+ *  MBA read:  [0x44][34][addr_lo][addr_hi][data 0]...[data 31]
+ *
+ * Reads land in an sbs_bq_df_image_t, a copy of (part of) the data flash kept one 32-byte row at a time.
+ * Each row has a valid bit, set once the row holds what the gauge returned, and a dirty bit, set when the row
+ * was changed locally and hasn't been written back yet. Reads of valid rows are served from the image, so only
+ * the first read of a range goes to the gauge and a full dump is 256 back to back row reads.
+ *
+ * Writes go the other way: rows changed in the image are marked dirty and SBSBqDfFlush() writes only those,
+ * each as one MBA block write of the address followed by the 32 data bytes.
+ *
+ *  MBA write: [0x44][34][addr_lo][addr_hi][data 0]...[data 31]
+ *
+ * SBSBqDfApply() provisions a gauge from a target image: a gauge whose DataFlashChecksum() already matches the
+ * one expected for the target is left alone without reading anything, otherwise only the rows that differ from
+ * the image are written.
+ *
+ * The image storage is provided by the caller: static arrays on MCUs, or a memory mapped file on Linux
+ * (see platform/sbs_bq_df_file.h) so the image outlives the process.
+ *
+ * The gauge only allows data flash access when UNSEALED or in FULL ACCESS mode.
+ *
+ * */
+
+#ifndef _SBS_BQ_DF_H_
+#define _SBS_BQ_DF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sbs_smb.h"
+
+#define SBS_BQ_DF_ADDRESS_START                         0x4000
+#define SBS_BQ_DF_ADDRESS_END                           0x6000      // One past the last data flash address
+#define SBS_BQ_DF_SIZE                                  (SBS_BQ_DF_ADDRESS_END - SBS_BQ_DF_ADDRESS_START)
+#define SBS_BQ_DF_ROW_SIZE                              32          // Data bytes returned by one MBA read
+
+#define SBS_BQ_DF_CHECKSUM_DELAY_MS                     250         // Time the gauge takes to checksum the data flash
+
+#define SBS_BQ_DF_ROW_COUNT(size)                       (((size) + SBS_BQ_DF_ROW_SIZE - 1) / SBS_BQ_DF_ROW_SIZE)
+#define SBS_BQ_DF_BITMAP_SIZE(size)                     ((SBS_BQ_DF_ROW_COUNT(size) + 7) / 8)
+
+typedef struct
+{
+  uint16_t startAddress;        // Data flash address of data[0], a multiple of SBS_BQ_DF_ROW_SIZE
+  uint16_t size;                // A multiple of SBS_BQ_DF_ROW_SIZE
+  uint8_t *data;                // size bytes
+  uint8_t *valid;               // SBS_BQ_DF_BITMAP_SIZE(size) bytes, bit n for row n
+  uint8_t *dirty;               // SBS_BQ_DF_BITMAP_SIZE(size) bytes, bit n for row n
+  uint32_t rowsRead;            // Rows read from the gauge since SBSBqDfImageInit()
+} sbs_bq_df_image_t;
+
+/// @brief Set up an image over caller-provided storage. Nothing is marked valid or dirty.
+/// @return SMBUS_ERR_INVALID_ARG if the range isn't row aligned or falls outside the data flash
+int SBSBqDfImageInit(sbs_bq_df_image_t *image, uint16_t startAddress, uint16_t size,
+                     uint8_t *data, uint8_t *valid, uint8_t *dirty);
+
+/// @brief Forget every row so the next reads go to the gauge again, discarding local changes
+void SBSBqDfImageInvalidate(sbs_bq_df_image_t *image);
+
+bool SBSBqDfImageRowValid(const sbs_bq_df_image_t *image, uint16_t row);
+bool SBSBqDfImageRowDirty(const sbs_bq_df_image_t *image, uint16_t row);
+
+/// @brief Change bytes of the image without touching the gauge. Rows whose contents change are marked dirty.
+/// @return SMBUS_ERR_INVALID_ARG if a row that is only partly overwritten hasn't been read yet
+int SBSBqDfImageWrite(sbs_bq_df_image_t *image, uint16_t address, const void *data, uint16_t len);
+
+/// @brief Read one 32-byte row straight from the gauge, without selecting the battery first
+/// @return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED if the gauge answered for a different address
+int SBSBqDfReadRow(sbs_smb_battery_t *battery, uint16_t address, uint8_t *row);
+
+/// @brief Bring the rows covering a range into the image, reading back to back only the rows that aren't valid yet
+/// @param refresh  Read valid rows again as well. Dirty rows are never overwritten.
+int SBSBqDfFetch(sbs_smb_battery_t *battery, sbs_bq_df_image_t *image, uint16_t address, uint16_t len, bool refresh);
+
+/// @brief Read a range of data flash, from the image where possible
+int SBSBqDfRead(sbs_smb_battery_t *battery, sbs_bq_df_image_t *image, uint16_t address, void *data, uint16_t len);
+
+/// @brief Read everything the image covers that isn't valid yet
+int SBSBqDfDump(sbs_smb_battery_t *battery, sbs_bq_df_image_t *image);
+
+/// @brief Read the checksum the gauge computes over its data flash with DataFlashChecksum()
+int SBSBqDfReadChecksum(sbs_smb_battery_t *battery, uint32_t *checksum);
+
+/// @brief The two halves of SBSBqDfReadChecksum(), for callers with other work to do during the
+///        SBS_BQ_DF_CHECKSUM_DELAY_MS in between. Nothing else may be sent to the gauge meanwhile.
+int SBSBqDfRequestChecksum(sbs_smb_battery_t *battery);
+int SBSBqDfCollectChecksum(sbs_smb_battery_t *battery, uint32_t *checksum);
+
+/// @brief Write the dirty rows of the image to the gauge and mark them clean
+/// @param rowsWritten  Optional, number of rows written
+int SBSBqDfFlush(sbs_smb_battery_t *battery, sbs_bq_df_image_t *image, uint16_t *rowsWritten);
+
+/// @brief Write at most maxRows of the dirty rows, lowest address first
+int SBSBqDfFlushRows(sbs_smb_battery_t *battery, sbs_bq_df_image_t *image, uint16_t maxRows, uint16_t *rowsWritten);
+
+/// @brief Make the data flash of a gauge match the valid rows of a target image, writing only the rows that differ
+/// @param image        What is known of the gauge's data flash. Rows the target covers are read first if not valid yet.
+/// @param target       Rows to program, only valid rows are compared and written. Must fall within the image range.
+/// @param checksum     Optional DataFlashChecksum() of a gauge programmed with the target. If the gauge already
+///                     reports it nothing is read or written, otherwise it is checked again after writing.
+/// @param rowsWritten  Optional, number of rows written
+/// @return SMBUS_ERR_FAIL if the checksum doesn't match after writing
+int SBSBqDfApply(sbs_smb_battery_t *battery, sbs_bq_df_image_t *image, const sbs_bq_df_image_t *target,
+                 const uint32_t *checksum, uint16_t *rowsWritten);
+
+#endif
@@ -0,0 +1,269 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "platform/smbus_platform.h"
+#include "sbs_bq_gang.h"
+
+static sbs_bq_gang_phase_t _SBSBqGangPhase(sbs_bq_gang_state_t state)
+{
+  if (state <= SBS_BQ_GANG_STATE_UNSEAL_WAIT)
+    return SBS_BQ_GANG_PHASE_UNSEAL;
+  if (state <= SBS_BQ_GANG_STATE_WRITE)
+    return SBS_BQ_GANG_PHASE_PROGRAM;
+  if (state <= SBS_BQ_GANG_STATE_VERIFY_CHECK)
+    return SBS_BQ_GANG_PHASE_VERIFY;
+  if (state <= SBS_BQ_GANG_STATE_SEAL_WAIT)
+    return SBS_BQ_GANG_PHASE_SEAL;
+  return SBS_BQ_GANG_PHASE_COUNT;
+}
+
+// Move to the next state, due waitMs from now, and account the time spent in the phase being left
+static void _SBSBqGangGoto(sbs_bq_gang_pack_t *pack, sbs_bq_gang_state_t state, uint32_t waitMs)
+{
+  uint32_t now = SMBusPlatformMillis();
+  sbs_bq_gang_phase_t phase = _SBSBqGangPhase(pack->state);
+
+  if (phase != _SBSBqGangPhase(state))
+  {
+    if (phase < SBS_BQ_GANG_PHASE_COUNT)
+      pack->phaseMs[phase] += now - pack->phaseStartMs;
+    pack->phaseStartMs = now;
+  }
+
+  if (state == SBS_BQ_GANG_STATE_DONE || state == SBS_BQ_GANG_STATE_FAILED)
+    pack->totalMs = now - pack->startMs;
+
+  pack->state = state;
+  pack->wakeMs = now + waitMs;
+}
+
+static void _SBSBqGangFail(sbs_bq_gang_pack_t *pack, int result)
+{
+  pack->failedState = pack->state;
+  pack->result = result;
+  _SBSBqGangGoto(pack, SBS_BQ_GANG_STATE_FAILED, 0);
+}
+
+static void _SBSBqGangFinish(const sbs_bq_gang_config_t *config, sbs_bq_gang_pack_t *pack)
+{
+  _SBSBqGangGoto(pack, config->seal ? SBS_BQ_GANG_STATE_SEAL : SBS_BQ_GANG_STATE_DONE, 0);
+}
+
+// Step the unseal or seal in pack->access, and move on to next once the gauge reports the new mode
+static int _SBSBqGangAccess(sbs_bq_gang_pack_t *pack, sbs_bq_gang_state_t state, sbs_bq_gang_state_t next)
+{
+  if (SBSBqAccessStep(&pack->access))
+  {
+    _SBSBqGangGoto(pack, state, pack->access.waitMs);
+    return SMBUS_ERR_OK;
+  }
+
+  if (pack->access.state == SBS_BQ_ACCESS_STATE_FAILED)
+    return pack->access.result;
+
+  _SBSBqGangGoto(pack, next, 0);
+  return SMBUS_ERR_OK;
+}
+
+// Stage or verify the next few valid rows of the target. Returns SMBUS_ERR_OK with pack->row at the end once all are done.
+static int _SBSBqGangRows(const sbs_bq_gang_config_t *config, sbs_bq_gang_pack_t *pack, bool verify)
+{
+  const sbs_bq_df_image_t *target = config->target;
+  uint16_t rowCount = SBS_BQ_DF_ROW_COUNT(target->size);
+  uint16_t done = 0;
+
+  for (; pack->row < rowCount && done < SBS_BQ_GANG_ROWS_PER_STEP; pack->row++)
+  {
+    if (!SBSBqDfImageRowValid(target, pack->row))
+      continue;
+
+    uint16_t rowOffset = pack->row * SBS_BQ_DF_ROW_SIZE;
+    uint16_t address = target->startAddress + rowOffset;
+
+    int ret = SBSBqDfFetch(pack->battery, pack->image, address, SBS_BQ_DF_ROW_SIZE, verify);
+    if (ret != SMBUS_ERR_OK)
+      return ret;
+
+    if (verify)
+    {
+      if (memcmp(&pack->image->data[address - pack->image->startAddress], &target->data[rowOffset], SBS_BQ_DF_ROW_SIZE))
+        return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+    }
+    else
+    {
+      ret = SBSBqDfImageWrite(pack->image, address, &target->data[rowOffset], SBS_BQ_DF_ROW_SIZE);
+      if (ret != SMBUS_ERR_OK)
+        return ret;
+    }
+
+    done++;
+  }
+
+  return SMBUS_ERR_OK;
+}
+
+void SBSBqGangInitPack(sbs_bq_gang_pack_t *pack, sbs_smb_battery_t *battery, sbs_bq_df_image_t *image)
+{
+  if (!pack)
+    return;
+
+  memset(pack, 0, sizeof(*pack));
+  pack->battery = battery;
+  pack->image = image;
+  pack->state = SBS_BQ_GANG_STATE_UNSEAL;
+  pack->startMs = pack->phaseStartMs = pack->wakeMs = SMBusPlatformMillis();
+}
+
+bool SBSBqGangStep(const sbs_bq_gang_config_t *config, sbs_bq_gang_pack_t *pack)
+{
+  if (!pack || pack->state >= SBS_BQ_GANG_STATE_DONE)
+    return false;
+
+  if (!config || !config->target || !pack->battery || !pack->image)
+  {
+    _SBSBqGangFail(pack, SMBUS_ERR_INVALID_ARG);
+    return false;
+  }
+
+  sbs_bq_security_mode_t mode;
+  uint32_t checksum;
+  uint16_t written;
+  int ret = SMBUS_ERR_OK;
+
+  switch (pack->state)
+  {
+    case SBS_BQ_GANG_STATE_UNSEAL:
+      if (config->unsealKey || config->unsealSha1Key)
+      {
+        if (config->unsealKey)
+          SBSBqAccessInit2WordKey(&pack->access, pack->battery, SBS_BQ_COMMAND_UNSEAL_DEVICE, config->unsealKey, true);
+        else
+          SBSBqAccessInitSha1Hmac(&pack->access, pack->battery, SBS_BQ_COMMAND_UNSEAL_DEVICE, config->unsealSha1Key, true);
+        _SBSBqGangGoto(pack, SBS_BQ_GANG_STATE_UNSEAL_WAIT, 0);
+        break;
+      }
+
+      // No key, the pack has to be unsealed already
+      ret = SBSBqGetSecurityMode(pack->battery, &mode);
+      if (ret == SMBUS_ERR_OK && mode != SBS_BQ_SECURITY_MODE_UNSEALED && mode != SBS_BQ_SECURITY_MODE_FULL_ACCESS)
+        ret = SMBUS_ERR_FAIL;
+      if (ret == SMBUS_ERR_OK)
+        _SBSBqGangGoto(pack, config->checksum ? SBS_BQ_GANG_STATE_CHECKSUM : SBS_BQ_GANG_STATE_STAGE, 0);
+      break;
+
+    case SBS_BQ_GANG_STATE_UNSEAL_WAIT:
+      ret = _SBSBqGangAccess(pack, SBS_BQ_GANG_STATE_UNSEAL_WAIT,
+                             config->checksum ? SBS_BQ_GANG_STATE_CHECKSUM : SBS_BQ_GANG_STATE_STAGE);
+      break;
+
+    case SBS_BQ_GANG_STATE_CHECKSUM:
+      ret = SBSBqDfRequestChecksum(pack->battery);
+      if (ret == SMBUS_ERR_OK)
+        _SBSBqGangGoto(pack, SBS_BQ_GANG_STATE_CHECKSUM_CHECK, SBS_BQ_DF_CHECKSUM_DELAY_MS);
+      break;
+
+    case SBS_BQ_GANG_STATE_CHECKSUM_CHECK:
+      ret = SBSBqDfCollectChecksum(pack->battery, &checksum);
+      if (ret != SMBUS_ERR_OK)
+        break;
+      if (checksum == *config->checksum)
+      {
+        pack->skipped = true;
+        _SBSBqGangFinish(config, pack);
+      }
+      else
+        _SBSBqGangGoto(pack, SBS_BQ_GANG_STATE_STAGE, 0);
+      break;
+
+    case SBS_BQ_GANG_STATE_STAGE:
+      ret = _SBSBqGangRows(config, pack, false);
+      if (ret == SMBUS_ERR_OK && pack->row >= SBS_BQ_DF_ROW_COUNT(config->target->size))
+        _SBSBqGangGoto(pack, SBS_BQ_GANG_STATE_WRITE, 0);
+      break;
+
+    case SBS_BQ_GANG_STATE_WRITE:
+      ret = SBSBqDfFlushRows(pack->battery, pack->image, SBS_BQ_GANG_ROWS_PER_STEP, &written);
+      pack->rowsWritten += written;
+      if (ret == SMBUS_ERR_OK && written < SBS_BQ_GANG_ROWS_PER_STEP)
+      {
+        pack->row = 0;
+        _SBSBqGangGoto(pack, SBS_BQ_GANG_STATE_VERIFY, 0);
+      }
+      break;
+
+    case SBS_BQ_GANG_STATE_VERIFY:
+      if (config->checksum)
+      {
+        ret = SBSBqDfRequestChecksum(pack->battery);
+        if (ret == SMBUS_ERR_OK)
+          _SBSBqGangGoto(pack, SBS_BQ_GANG_STATE_VERIFY_CHECK, SBS_BQ_DF_CHECKSUM_DELAY_MS);
+        break;
+      }
+
+      // Without a checksum read back every row of the target
+      ret = _SBSBqGangRows(config, pack, true);
+      if (ret == SMBUS_ERR_OK && pack->row >= SBS_BQ_DF_ROW_COUNT(config->target->size))
+        _SBSBqGangFinish(config, pack);
+      break;
+
+    case SBS_BQ_GANG_STATE_VERIFY_CHECK:
+      ret = SBSBqDfCollectChecksum(pack->battery, &checksum);
+      if (ret == SMBUS_ERR_OK && checksum != *config->checksum)
+        ret = SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+      if (ret == SMBUS_ERR_OK)
+        _SBSBqGangFinish(config, pack);
+      break;
+
+    case SBS_BQ_GANG_STATE_SEAL:
+      SBSBqAccessInitSeal(&pack->access, pack->battery, true);
+      _SBSBqGangGoto(pack, SBS_BQ_GANG_STATE_SEAL_WAIT, 0);
+      break;
+
+    case SBS_BQ_GANG_STATE_SEAL_WAIT:
+      ret = _SBSBqGangAccess(pack, SBS_BQ_GANG_STATE_SEAL_WAIT, SBS_BQ_GANG_STATE_DONE);
+      break;
+
+    default:
+      break;
+  }
+
+  if (ret != SMBUS_ERR_OK)
+    _SBSBqGangFail(pack, ret);
+
+  return pack->state < SBS_BQ_GANG_STATE_DONE;
+}
+
+uint16_t SBSBqGangRun(const sbs_bq_gang_config_t *config, sbs_bq_gang_pack_t pack[], uint16_t count)
+{
+  uint16_t failed = 0;
+
+  if (!pack)
+    return count;
+
+  for (;;)
+  {
+    sbs_bq_gang_pack_t *next = NULL;
+
+    // The pack that wakes first, compared by difference since the millisecond count wraps
+    for (uint16_t i = 0; i < count; i++)
+    {
+      if (pack[i].state < SBS_BQ_GANG_STATE_DONE && (!next || (int32_t)(pack[i].wakeMs - next->wakeMs) < 0))
+        next = &pack[i];
+    }
+
+    if (!next)
+      break;
+
+    // Sleep only when every pack is waiting on its gauge
+    int32_t waitMs = (int32_t)(next->wakeMs - SMBusPlatformMillis());
+    if (waitMs > 0)
+      SMBusPlatformDelayMs(waitMs);
+
+    SBSBqGangStep(config, next);
+  }
+
+  for (uint16_t i = 0; i < count; i++)
+    failed += (pack[i].state != SBS_BQ_GANG_STATE_DONE);
+
+  return failed;
+}
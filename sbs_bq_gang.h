@@ -0,0 +1,99 @@
+/**
+ *
+ * @file:   sbs_bq_gang.h - Provisioning of many bq40z50 packs at once
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * Each pack goes through its own state machine: unseal, data flash write, verify and seal. Most of the time
+ * a single pack takes is spent waiting on the gauge, e.g. for every security mode change to show in OperationStatus()
+ * and SBS_BQ_DF_CHECKSUM_DELAY_MS for every checksum, so SBSBqGangRun() always steps whichever pack is due next
+ * and the waits of one pack are spent on the transactions of the others.
+ *
+ * Packs on the same bus, e.g. behind the channels of a mux, are run by one SBSBqGangRun() call. Packs on different
+ * buses are independent, so run one SBSBqGangRun() per bus from its own thread or task and throughput grows with
+ * the number of buses.
+ *
+ *  UNSEAL -> [UNSEAL_WAIT] -> [CHECKSUM -> CHECKSUM_CHECK] -> STAGE -> WRITE -> VERIFY
+ *         -> [VERIFY_CHECK] -> [SEAL -> SEAL_WAIT] -> DONE
+ *
+ * A pack whose checksum already matches the target skips straight from CHECKSUM_CHECK to SEAL.
+ *
+ * */
+
+#ifndef _SBS_BQ_GANG_H_
+#define _SBS_BQ_GANG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sbs_smb.h"
+#include "sbs_bq.h"
+#include "sbs_bq_df.h"
+
+#define SBS_BQ_GANG_ROWS_PER_STEP                       8           // Rows staged, written or verified per step
+
+typedef enum
+{
+  SBS_BQ_GANG_STATE_UNSEAL = 0,
+  SBS_BQ_GANG_STATE_UNSEAL_WAIT,    // Step the unseal until the pack reports it
+  SBS_BQ_GANG_STATE_CHECKSUM,
+  SBS_BQ_GANG_STATE_CHECKSUM_CHECK,
+  SBS_BQ_GANG_STATE_STAGE,          // Read the rows the target covers and mark those that differ dirty
+  SBS_BQ_GANG_STATE_WRITE,
+  SBS_BQ_GANG_STATE_VERIFY,         // Request the checksum, or read the written rows back without one
+  SBS_BQ_GANG_STATE_VERIFY_CHECK,
+  SBS_BQ_GANG_STATE_SEAL,
+  SBS_BQ_GANG_STATE_SEAL_WAIT,
+  SBS_BQ_GANG_STATE_DONE,
+  SBS_BQ_GANG_STATE_FAILED,
+} sbs_bq_gang_state_t;
+
+typedef enum
+{
+  SBS_BQ_GANG_PHASE_UNSEAL = 0,
+  SBS_BQ_GANG_PHASE_PROGRAM,
+  SBS_BQ_GANG_PHASE_VERIFY,
+  SBS_BQ_GANG_PHASE_SEAL,
+  SBS_BQ_GANG_PHASE_COUNT,
+} sbs_bq_gang_phase_t;
+
+typedef struct
+{
+  uint16_t *unsealKey;              // Two-word UNSEAL key, or NULL
+  uint8_t *unsealSha1Key;           // 128-bit HMAC-SHA1 UNSEAL key used if unsealKey is NULL. Neither if already unsealed.
+  const sbs_bq_df_image_t *target;  // Rows to program
+  const uint32_t *checksum;         // Optional DataFlashChecksum() of a pack programmed with the target
+  bool seal;                        // Seal the pack once verified
+} sbs_bq_gang_config_t;
+
+typedef struct
+{
+  sbs_smb_battery_t *battery;
+  sbs_bq_df_image_t *image;         // Storage for what is read from the pack, must cover the target range
+
+  sbs_bq_gang_state_t state;
+  sbs_bq_access_t access;           // Unseal or seal in progress
+  sbs_bq_gang_state_t failedState;  // Step that failed if state is SBS_BQ_GANG_STATE_FAILED
+  int result;                       // Error of the failed step
+  uint16_t row;                     // Progress through the target rows in STAGE and VERIFY
+  uint16_t rowsWritten;
+  bool skipped;                     // The checksum already matched, nothing was written
+  uint32_t wakeMs;                  // Not due before this SMBusPlatformMillis()
+
+  uint32_t startMs;
+  uint32_t phaseStartMs;
+  uint32_t phaseMs[SBS_BQ_GANG_PHASE_COUNT];
+  uint32_t totalMs;
+} sbs_bq_gang_pack_t;
+
+void SBSBqGangInitPack(sbs_bq_gang_pack_t *pack, sbs_smb_battery_t *battery, sbs_bq_df_image_t *image);
+
+/// @brief Run the next step of a pack, however early. Waits the step starts are left in pack->wakeMs.
+/// @return false once the pack is done or has failed
+bool SBSBqGangStep(const sbs_bq_gang_config_t *config, sbs_bq_gang_pack_t *pack);
+
+/// @brief Step all the packs until each is done or has failed, always stepping the one due first
+/// @return The number of packs that failed
+uint16_t SBSBqGangRun(const sbs_bq_gang_config_t *config, sbs_bq_gang_pack_t pack[], uint16_t count);
+
+#endif
@@ -0,0 +1,244 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_bq_lifetime.h"
+
+#define _SBS_BQ_LIFETIME_HEADER_SIZE    4
+
+// Commands of the sections read as chip commands, in section order
+static const sbs_smb_cmd_id_t sectionCmd[] =
+{
+  SBS_BQ_CMD_CODE_LIFETIME_DATA_BLOCK_1,
+  SBS_BQ_CMD_CODE_LIFETIME_DATA_BLOCK_2,
+  SBS_BQ_CMD_CODE_LIFETIME_DATA_BLOCK_3,
+  SBS_BQ_CMD_CODE_IT_STATUS_1,
+  SBS_BQ_CMD_CODE_IT_STATUS_2,
+};
+
+#define _SBS_BQ_LIFETIME_CMD_COUNT      (sizeof(sectionCmd) / sizeof(sectionCmd[0]))
+
+// Fields past the end of what the gauge returned read as 0
+static uint8_t _SBSBqLifetimeU8(const uint8_t *section, uint8_t offset)
+{
+  return (offset < section[0]) ? section[1 + offset] : 0;
+}
+
+static uint16_t _SBSBqLifetimeU16(const uint8_t *section, uint8_t offset)
+{
+  return _SBSBqLifetimeU8(section, offset) | (_SBSBqLifetimeU8(section, offset + 1) << 8);
+}
+
+static uint32_t _SBSBqLifetimeU32(const uint8_t *section, uint8_t offset)
+{
+  return _SBSBqLifetimeU16(section, offset) | ((uint32_t)_SBSBqLifetimeU16(section, offset + 2) << 16);
+}
+
+static void _SBSBqLifetimeDecode1(const uint8_t *s, sbs_bq_lifetime1_t *lt)
+{
+  for (uint8_t i = 0; i < SBS_BQ_CELL_COUNT; i++)
+  {
+    lt->cellVoltageMax[i] = _SBSBqLifetimeU16(s, 2 * i);
+    lt->cellVoltageMin[i] = _SBSBqLifetimeU16(s, 8 + 2 * i);
+  }
+  lt->cellDeltaMax = _SBSBqLifetimeU16(s, 16);
+  lt->chargeCurrentMax = (int16_t)_SBSBqLifetimeU16(s, 18);
+  lt->dischargeCurrentMax = (int16_t)_SBSBqLifetimeU16(s, 20);
+  lt->averageDischargeCurrentMax = (int16_t)_SBSBqLifetimeU16(s, 22);
+  lt->averageDischargePowerMax = (int16_t)_SBSBqLifetimeU16(s, 24);
+  lt->cellTempMax = (int8_t)_SBSBqLifetimeU8(s, 26);
+  lt->cellTempMin = (int8_t)_SBSBqLifetimeU8(s, 27);
+  lt->cellTempDeltaMax = (int8_t)_SBSBqLifetimeU8(s, 28);
+  lt->internalTempMax = (int8_t)_SBSBqLifetimeU8(s, 29);
+  lt->internalTempMin = (int8_t)_SBSBqLifetimeU8(s, 30);
+  lt->fetTempMax = (int8_t)_SBSBqLifetimeU8(s, 31);
+}
+
+static void _SBSBqLifetimeDecode2(const uint8_t *s, sbs_bq_lifetime2_t *lt)
+{
+  lt->shutdowns = _SBSBqLifetimeU8(s, 0);
+  lt->partialResets = _SBSBqLifetimeU8(s, 1);
+  lt->fullResets = _SBSBqLifetimeU8(s, 2);
+  lt->watchdogResets = _SBSBqLifetimeU8(s, 3);
+  for (uint8_t i = 0; i < SBS_BQ_CELL_COUNT; i++)
+    lt->balancingTime[i] = _SBSBqLifetimeU8(s, 4 + i);
+}
+
+static void _SBSBqLifetimeDecode3(const uint8_t *s, sbs_bq_lifetime3_t *lt)
+{
+  lt->totalRuntime = _SBSBqLifetimeU16(s, 0);
+  lt->underTemp = _SBSBqLifetimeU16(s, 2);
+  lt->lowTemp = _SBSBqLifetimeU16(s, 4);
+  lt->standardTempLow = _SBSBqLifetimeU16(s, 6);
+  lt->recommendedTemp = _SBSBqLifetimeU16(s, 8);
+  lt->standardTempHigh = _SBSBqLifetimeU16(s, 10);
+  lt->highTemp = _SBSBqLifetimeU16(s, 12);
+  lt->overTemp = _SBSBqLifetimeU16(s, 14);
+}
+
+static void _SBSBqLifetimeDecodeIt1(const uint8_t *s, sbs_bq_it_status1_t *it)
+{
+  it->trueRemainingCapacity = (int16_t)_SBSBqLifetimeU16(s, 0);
+  it->trueRemainingEnergy = (int16_t)_SBSBqLifetimeU16(s, 2);
+  it->initialCapacity = (int16_t)_SBSBqLifetimeU16(s, 4);
+  it->initialEnergy = (int16_t)_SBSBqLifetimeU16(s, 6);
+  it->trueFullChargeCapacity = (int16_t)_SBSBqLifetimeU16(s, 8);
+  it->trueFullChargeEnergy = (int16_t)_SBSBqLifetimeU16(s, 10);
+  it->simulationTemp = _SBSBqLifetimeU16(s, 12);
+  it->ambientTemp = _SBSBqLifetimeU16(s, 14);
+  for (uint8_t i = 0; i < SBS_BQ_CELL_COUNT; i++)
+  {
+    it->raScale[i] = _SBSBqLifetimeU16(s, 16 + 2 * i);
+    it->compensatedResistance[i] = _SBSBqLifetimeU16(s, 24 + 2 * i);
+  }
+}
+
+static void _SBSBqLifetimeDecodeIt2(const uint8_t *s, sbs_bq_it_status2_t *it)
+{
+  it->packGrid = _SBSBqLifetimeU8(s, 0);
+  it->learnStatus = _SBSBqLifetimeU8(s, 1);
+  for (uint8_t i = 0; i < SBS_BQ_CELL_COUNT; i++)
+  {
+    it->cellGrid[i] = _SBSBqLifetimeU8(s, 2 + i);
+    it->dod0[i] = _SBSBqLifetimeU16(s, 10 + 2 * i);
+    it->dodEoc[i] = _SBSBqLifetimeU16(s, 24 + 2 * i);
+  }
+  it->stateTime = _SBSBqLifetimeU32(s, 6);
+  it->dod0PassedCapacity = _SBSBqLifetimeU16(s, 18);
+  it->dod0PassedEnergy = _SBSBqLifetimeU16(s, 20);
+  it->dod0Time = _SBSBqLifetimeU16(s, 22);
+}
+
+int SBSBqLifetimeSched(sbs_sched_t *sched, sbs_smb_battery_t *battery, uint16_t blackBoxAddress,
+                       sbs_bq_lifetime_t *lifetime)
+{
+  if (!sched || !battery || !lifetime)
+    return SMBUS_ERR_INVALID_ARG;
+
+  // Serial number, the chip commands and the black box
+  if ((size_t)(sched->capacity - sched->count) < 1 + _SBS_BQ_LIFETIME_CMD_COUNT + (blackBoxAddress != 0))
+    return SMBUS_ERR_FAIL;
+
+  memset(lifetime, 0, sizeof(*lifetime));
+  lifetime->blackBoxAddress = blackBoxAddress;
+  SBSBqBindCommands(battery);
+
+  SBSSchedAdd(sched, battery, SBS_SMB_CMD_CODE_SERIAL_NUMBER, 0, 0, &lifetime->serialNumber, sizeof(lifetime->serialNumber));
+  for (uint8_t i = 0; i < _SBS_BQ_LIFETIME_CMD_COUNT; i++)
+    SBSSchedAdd(sched, battery, sectionCmd[i], 0, 0, lifetime->section[i], sizeof(lifetime->section[i]));
+
+  // A data flash row, returned after its address
+  if (blackBoxAddress)
+    SBSSchedAdd(sched, battery, SBS_SMB_CMD_CODE_MANUFACTURER_BLOCK_ACCESS, blackBoxAddress, 0,
+                lifetime->section[SBS_BQ_LIFETIME_SECTION_BLACK_BOX], sizeof(lifetime->section[SBS_BQ_LIFETIME_SECTION_BLACK_BOX]));
+
+  return SMBUS_ERR_OK;
+}
+
+int SBSBqLifetimeRead(sbs_smb_battery_t *battery, uint16_t blackBoxAddress, sbs_bq_lifetime_t *lifetime)
+{
+  sbs_sched_job_t job[1 + _SBS_BQ_LIFETIME_CMD_COUNT + 1];
+  sbs_sched_t sched;
+
+  SBSSchedInit(&sched, job, sizeof(job) / sizeof(job[0]));
+
+  int ret = SBSBqLifetimeSched(&sched, battery, blackBoxAddress, lifetime);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  if (!SBSSchedRun(&sched))
+    return SMBUS_ERR_OK;
+
+  for (uint16_t i = 0; i < sched.count; i++)
+    if (job[i].state == SBS_SCHED_JOB_FAILED)
+      return job[i].result;
+
+  return SMBUS_ERR_FAIL;
+}
+
+int SBSBqLifetimeDecode(const sbs_bq_lifetime_t *lifetime, sbs_bq_lifetime_data_t *data)
+{
+  if (!lifetime || !data)
+    return SMBUS_ERR_INVALID_ARG;
+
+  memset(data, 0, sizeof(*data));
+  data->serialNumber = lifetime->serialNumber;
+  for (uint8_t i = 0; i < SBS_BQ_LIFETIME_SECTION_COUNT; i++)
+    if (lifetime->section[i][0])
+      data->present |= 1 << i;
+
+  _SBSBqLifetimeDecode1(lifetime->section[SBS_BQ_LIFETIME_SECTION_BLOCK_1], &data->lifetime1);
+  _SBSBqLifetimeDecode2(lifetime->section[SBS_BQ_LIFETIME_SECTION_BLOCK_2], &data->lifetime2);
+  _SBSBqLifetimeDecode3(lifetime->section[SBS_BQ_LIFETIME_SECTION_BLOCK_3], &data->lifetime3);
+  _SBSBqLifetimeDecodeIt1(lifetime->section[SBS_BQ_LIFETIME_SECTION_IT_STATUS_1], &data->itStatus1);
+  _SBSBqLifetimeDecodeIt2(lifetime->section[SBS_BQ_LIFETIME_SECTION_IT_STATUS_2], &data->itStatus2);
+
+  const uint8_t *blackBox = lifetime->section[SBS_BQ_LIFETIME_SECTION_BLACK_BOX];
+  if (!blackBox[0])
+    return SMBUS_ERR_OK;
+
+  if (blackBox[0] < sizeof(uint16_t))
+    return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+  data->blackBox.address = _SBSBqLifetimeU16(blackBox, 0);
+  data->blackBox.size = blackBox[0] - sizeof(uint16_t);
+  memcpy(data->blackBox.data, &blackBox[1 + sizeof(uint16_t)], data->blackBox.size);
+
+  // The gauge answers ManufacturerBlockAccess() with the address of the row it returned
+  if (lifetime->blackBoxAddress && data->blackBox.address != lifetime->blackBoxAddress)
+    return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+  return SMBUS_ERR_OK;
+}
+
+size_t SBSBqLifetimeEncode(const sbs_bq_lifetime_t *lifetime, uint8_t *buff, size_t size)
+{
+  if (!lifetime || !buff || size < _SBS_BQ_LIFETIME_HEADER_SIZE)
+    return 0;
+
+  size_t len = _SBS_BQ_LIFETIME_HEADER_SIZE;
+  uint8_t mask = 0;
+
+  for (uint8_t i = 0; i < SBS_BQ_LIFETIME_SECTION_COUNT; i++)
+  {
+    const uint8_t *section = lifetime->section[i];
+    if (!section[0])
+      continue;
+
+    if (len + 1 + section[0] > size)
+      return 0;
+
+    memcpy(&buff[len], section, 1 + section[0]);
+    len += 1 + section[0];
+    mask |= 1 << i;
+  }
+
+  buff[0] = SBS_BQ_LIFETIME_RECORD_VERSION;
+  buff[1] = lifetime->serialNumber & 0xFF;
+  buff[2] = lifetime->serialNumber >> 8;
+  buff[3] = mask;
+  return len;
+}
+
+size_t SBSBqLifetimeParse(const uint8_t *buff, size_t len, sbs_bq_lifetime_t *lifetime)
+{
+  if (!buff || !lifetime || len < _SBS_BQ_LIFETIME_HEADER_SIZE || buff[0] != SBS_BQ_LIFETIME_RECORD_VERSION)
+    return 0;
+
+  memset(lifetime, 0, sizeof(*lifetime));
+  lifetime->serialNumber = buff[1] | (buff[2] << 8);
+
+  size_t used = _SBS_BQ_LIFETIME_HEADER_SIZE;
+  for (uint8_t i = 0; i < SBS_BQ_LIFETIME_SECTION_COUNT; i++)
+  {
+    if (!(buff[3] & (1 << i)))
+      continue;
+
+    if (used >= len || buff[used] > SBS_BQ_LIFETIME_SECTION_SIZE || used + 1 + buff[used] > len)
+      return 0;
+
+    memcpy(lifetime->section[i], &buff[used], 1 + buff[used]);
+    used += 1 + buff[used];
+  }
+
+  return used;
+}
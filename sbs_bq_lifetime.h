@@ -0,0 +1,173 @@
+/**
+ *
+ * @file:   sbs_bq_lifetime.h - Bulk extraction of bq40z50 lifetime data, IT status and black box for returns analysis
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * One extraction reads, through ManufacturerBlockAccess():
+ *  LifetimeDataBlock1() - LifetimeDataBlock3(), ITStatus1(), ITStatus2()
+ *  the black box recorder, one data flash row at an address that depends on the firmware. See its TRM.
+ *
+ * The reads are queued on a scheduler, so the extraction of many packs runs as one SBSSchedRun() with each
+ * response collected while the other packs are read. The blocks are kept as the gauge returned them, which is
+ * already the most compact form, and decoded into structs on demand.
+ *
+ * A record holds the extraction of one pack, all values little-endian:
+ *
+ *  [version][serial(2)][section mask][length][data...] for every set bit in the mask, in bit order
+ *
+ * The black box section starts with its data flash address. The gauge only returns these blocks when UNSEALED
+ * or in FULL ACCESS mode.
+ *
+ * */
+
+#ifndef _SBS_BQ_LIFETIME_H_
+#define _SBS_BQ_LIFETIME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sbs_smb.h"
+#include "sbs_sched.h"
+#include "sbs_bq_cmd.h"
+
+#define SBS_BQ_LIFETIME_RECORD_VERSION                  1
+
+typedef enum
+{
+  SBS_BQ_LIFETIME_SECTION_BLOCK_1 = 0,
+  SBS_BQ_LIFETIME_SECTION_BLOCK_2,
+  SBS_BQ_LIFETIME_SECTION_BLOCK_3,
+  SBS_BQ_LIFETIME_SECTION_IT_STATUS_1,
+  SBS_BQ_LIFETIME_SECTION_IT_STATUS_2,
+  SBS_BQ_LIFETIME_SECTION_BLACK_BOX,
+  SBS_BQ_LIFETIME_SECTION_COUNT,
+} sbs_bq_lifetime_section_t;
+
+#define SBS_BQ_LIFETIME_SECTION_SIZE                    34          // A 32-byte block after a 2-byte address
+
+// Largest output of SBSBqLifetimeEncode()
+#define SBS_BQ_LIFETIME_RECORD_MAX_SIZE                 (4 + SBS_BQ_LIFETIME_SECTION_COUNT * (1 + SBS_BQ_LIFETIME_SECTION_SIZE))
+
+// Blocks as read. Each section is [length][data...], length 0 if it wasn't read.
+typedef struct
+{
+  uint16_t serialNumber;
+  uint16_t blackBoxAddress;                       // Requested by SBSBqLifetimeSched(). Not stored in a record, so 0 after SBSBqLifetimeParse().
+  uint8_t section[SBS_BQ_LIFETIME_SECTION_COUNT][1 + SBS_BQ_LIFETIME_SECTION_SIZE];
+} sbs_bq_lifetime_t;
+
+// LifetimeDataBlock1(): extremes seen over the life of the pack
+typedef struct
+{
+  uint16_t cellVoltageMax[SBS_BQ_CELL_COUNT];     // mV
+  uint16_t cellVoltageMin[SBS_BQ_CELL_COUNT];     // mV
+  uint16_t cellDeltaMax;                          // mV
+  int16_t chargeCurrentMax;                       // mA
+  int16_t dischargeCurrentMax;                    // mA
+  int16_t averageDischargeCurrentMax;             // mA
+  int16_t averageDischargePowerMax;               // cW
+  int8_t cellTempMax;                             // °C
+  int8_t cellTempMin;
+  int8_t cellTempDeltaMax;
+  int8_t internalTempMax;
+  int8_t internalTempMin;
+  int8_t fetTempMax;
+} sbs_bq_lifetime1_t;
+
+// LifetimeDataBlock2(): event counts
+typedef struct
+{
+  uint8_t shutdowns;
+  uint8_t partialResets;
+  uint8_t fullResets;
+  uint8_t watchdogResets;
+  uint8_t balancingTime[SBS_BQ_CELL_COUNT];       // Cell balancing time of each cell, 2 h units
+} sbs_bq_lifetime2_t;
+
+// LifetimeDataBlock3(): time spent in each temperature range, h
+typedef struct
+{
+  uint16_t totalRuntime;
+  uint16_t underTemp;                             // UT
+  uint16_t lowTemp;                               // LT
+  uint16_t standardTempLow;                       // STL
+  uint16_t recommendedTemp;                       // RT
+  uint16_t standardTempHigh;                      // STH
+  uint16_t highTemp;                              // HT
+  uint16_t overTemp;                              // OT
+} sbs_bq_lifetime3_t;
+
+// ITStatus1(): Impedance Track capacities and resistance scaling
+typedef struct
+{
+  int16_t trueRemainingCapacity;                  // mAh
+  int16_t trueRemainingEnergy;                    // cWh
+  int16_t initialCapacity;                        // mAh
+  int16_t initialEnergy;                          // cWh
+  int16_t trueFullChargeCapacity;                 // mAh
+  int16_t trueFullChargeEnergy;                   // cWh
+  uint16_t simulationTemp;                        // 0.1K
+  uint16_t ambientTemp;                           // 0.1K
+  uint16_t raScale[SBS_BQ_CELL_COUNT];
+  uint16_t compensatedResistance[SBS_BQ_CELL_COUNT];  // mΩ
+} sbs_bq_it_status1_t;
+
+// ITStatus2(): Impedance Track state of the cells
+typedef struct
+{
+  uint8_t packGrid;
+  uint8_t learnStatus;                            // LStatus
+  uint8_t cellGrid[SBS_BQ_CELL_COUNT];
+  uint32_t stateTime;                             // s
+  uint16_t dod0[SBS_BQ_CELL_COUNT];
+  uint16_t dod0PassedCapacity;                    // mAh
+  uint16_t dod0PassedEnergy;                      // cWh
+  uint16_t dod0Time;                              // s / 2^12
+  uint16_t dodEoc[SBS_BQ_CELL_COUNT];
+} sbs_bq_it_status2_t;
+
+// The layout of the black box depends on the firmware, so it is kept as read
+typedef struct
+{
+  uint16_t address;
+  uint8_t size;
+  uint8_t data[SBS_BQ_LIFETIME_SECTION_SIZE - sizeof(uint16_t)];
+} sbs_bq_black_box_t;
+
+typedef struct
+{
+  uint16_t serialNumber;
+  uint8_t present;                                // Bit n set if section n was read
+  sbs_bq_lifetime1_t lifetime1;
+  sbs_bq_lifetime2_t lifetime2;
+  sbs_bq_lifetime3_t lifetime3;
+  sbs_bq_it_status1_t itStatus1;
+  sbs_bq_it_status2_t itStatus2;
+  sbs_bq_black_box_t blackBox;
+} sbs_bq_lifetime_data_t;
+
+/// @brief Queue the reads of one pack. Run the scheduler to read them.
+/// @param blackBoxAddress  Data flash address of the black box recorder, 0 to skip it
+/// @return SMBUS_ERR_FAIL if the scheduler doesn't have room for all of them
+int SBSBqLifetimeSched(sbs_sched_t *sched, sbs_smb_battery_t *battery, uint16_t blackBoxAddress,
+                       sbs_bq_lifetime_t *lifetime);
+
+/// @brief Read one pack in one scheduler run
+/// @return The result of the first read that failed. Sections read before it are kept.
+int SBSBqLifetimeRead(sbs_smb_battery_t *battery, uint16_t blackBoxAddress, sbs_bq_lifetime_t *lifetime);
+
+/// @brief Every section is decoded even if the black box doesn't check out
+/// @return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED if the black box is shorter than its address or was answered for a
+///         different address than lifetime->blackBoxAddress. A parsed record has no requested address to compare.
+int SBSBqLifetimeDecode(const sbs_bq_lifetime_t *lifetime, sbs_bq_lifetime_data_t *data);
+
+/// @return Bytes written, 0 if they don't fit in size
+size_t SBSBqLifetimeEncode(const sbs_bq_lifetime_t *lifetime, uint8_t *buff, size_t size);
+
+/// @brief Read back a record written by SBSBqLifetimeEncode()
+/// @return Bytes of buff used, 0 if it doesn't hold a whole record of a known version
+size_t SBSBqLifetimeParse(const uint8_t *buff, size_t len, sbs_bq_lifetime_t *lifetime);
+
+#endif
@@ -0,0 +1,176 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "platform/smbus_platform.h"
+#include "sbs_bq_stream.h"
+
+#define _SBS_BQ_STREAM_MIN(a, b)    (((a) < (b)) ? (a) : (b))
+#define _SBS_BQ_STREAM_MAX(a, b)    (((a) > (b)) ? (a) : (b))
+
+// Spread between the highest and lowest cell. Cells reading 0 mV aren't connected, e.g. cell 4 of a 3S pack.
+static uint16_t _SBSBqStreamSpread(const sbs_bq_da_status1_t *voltages)
+{
+  uint16_t lo = UINT16_MAX, hi = 0;
+
+  for (uint8_t i = 0; i < SBS_BQ_CELL_COUNT; i++)
+  {
+    uint16_t mv = voltages->cellVoltage[i];
+    lo = mv ? _SBS_BQ_STREAM_MIN(lo, mv) : lo;
+    hi = _SBS_BQ_STREAM_MAX(hi, mv);
+  }
+
+  return (hi > lo) ? hi - lo : 0;
+}
+
+void SBSBqStreamInit(sbs_bq_stream_t *stream, sbs_smb_battery_t *battery, sbs_bq_stream_sample_t sample[],
+                     uint16_t capacity, uint16_t periodMs, uint8_t temperatureDivider)
+{
+  if (!stream)
+    return;
+
+  memset(stream, 0, sizeof(*stream));
+  stream->battery = battery;
+  stream->sample = sample;
+  stream->capacity = sample ? capacity : 0;
+  stream->periodMs = periodMs;
+  stream->temperatureDivider = temperatureDivider ? temperatureDivider : 1;
+  stream->nextMs = SMBusPlatformMillis();
+  SBSBqBindCommands(battery);
+}
+
+bool SBSBqStreamPoll(sbs_bq_stream_t *stream)
+{
+  if (!stream || !stream->battery || !stream->capacity)
+    return false;
+
+  uint32_t now = SMBusPlatformMillis();
+  int32_t early = (int32_t)(stream->nextMs - now);
+
+  if (early > 0)
+  {
+    stream->waitMs = early;
+    return false;
+  }
+
+  // Keep to the period, but don't try to catch up on samples missed while the task was busy elsewhere
+  stream->nextMs += stream->periodMs;
+  if ((int32_t)(stream->nextMs - now) <= 0)
+    stream->nextMs = now + stream->periodMs;
+  stream->waitMs = stream->nextMs - now;
+
+  sbs_bq_stream_sample_t *sample = &stream->sample[stream->head];
+
+  int ret = SBSRunCommand(stream->battery, SBS_BQ_CMD_CODE_DA_STATUS_1, NULL, 0, &sample->voltages, sizeof(sample->voltages));
+  if (ret == SMBUS_ERR_OK && !stream->untilTemperatures)
+  {
+    ret = SBSRunCommand(stream->battery, SBS_BQ_CMD_CODE_DA_STATUS_2, NULL, 0, &stream->temperatures, sizeof(stream->temperatures));
+    if (ret == SMBUS_ERR_OK)
+      stream->untilTemperatures = stream->temperatureDivider;
+  }
+
+  stream->result = ret;
+  if (ret != SMBUS_ERR_OK)
+  {
+    stream->failed++;
+    return false;
+  }
+
+  stream->untilTemperatures--;
+  sample->temperatures = stream->temperatures;
+  sample->timeMs = now;
+
+  stream->head = (stream->head + 1) % stream->capacity;
+  if (stream->count < stream->capacity)
+    stream->count++;
+
+  return true;
+}
+
+uint32_t SBSBqStreamRun(sbs_bq_stream_t stream[], uint16_t count, uint32_t durationMs)
+{
+  uint32_t added = 0;
+  uint32_t startMs = SMBusPlatformMillis();
+  uint32_t elapsedMs;
+
+  if (!stream)
+    return 0;
+
+  while ((elapsedMs = SMBusPlatformMillis() - startMs) < durationMs)
+  {
+    uint32_t waitMs = UINT32_MAX;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+      added += SBSBqStreamPoll(&stream[i]);
+      if (stream[i].capacity)
+        waitMs = _SBS_BQ_STREAM_MIN(waitMs, stream[i].waitMs);
+    }
+
+    if (waitMs == UINT32_MAX)
+      break;
+
+    waitMs = _SBS_BQ_STREAM_MIN(waitMs, durationMs - elapsedMs);
+    if (waitMs)
+      SMBusPlatformDelayMs(waitMs);
+  }
+
+  return added;
+}
+
+const sbs_bq_stream_sample_t *SBSBqStreamSample(const sbs_bq_stream_t *stream, uint16_t back)
+{
+  if (!stream || back >= stream->count)
+    return NULL;
+
+  return &stream->sample[(stream->head + stream->capacity - 1 - back) % stream->capacity];
+}
+
+void SBSBqStreamClear(sbs_bq_stream_t *stream)
+{
+  if (!stream)
+    return;
+
+  stream->head = 0;
+  stream->count = 0;
+}
+
+void SBSBqStreamStats(const sbs_bq_stream_t *stream, sbs_bq_stream_stats_t *stats)
+{
+  if (!stats)
+    return;
+
+  memset(stats, 0, sizeof(*stats));
+  if (!stream || !stream->count)
+    return;
+
+  stats->samples = stream->count;
+  for (uint8_t c = 0; c < SBS_BQ_CELL_COUNT; c++)
+    stats->cellMinMv[c] = UINT16_MAX;
+  for (uint8_t t = 0; t < SBS_BQ_TS_COUNT; t++)
+    stats->tsMinDeciK[t] = UINT16_MAX;
+
+  // The order of the samples doesn't matter, so walk the storage straight through
+  for (uint16_t i = 0; i < stream->count; i++)
+  {
+    const sbs_bq_stream_sample_t *sample = &stream->sample[i];
+
+    for (uint8_t c = 0; c < SBS_BQ_CELL_COUNT; c++)
+    {
+      stats->cellMinMv[c] = _SBS_BQ_STREAM_MIN(stats->cellMinMv[c], sample->voltages.cellVoltage[c]);
+      stats->cellMaxMv[c] = _SBS_BQ_STREAM_MAX(stats->cellMaxMv[c], sample->voltages.cellVoltage[c]);
+    }
+    for (uint8_t t = 0; t < SBS_BQ_TS_COUNT; t++)
+    {
+      stats->tsMinDeciK[t] = _SBS_BQ_STREAM_MIN(stats->tsMinDeciK[t], sample->temperatures.ts[t]);
+      stats->tsMaxDeciK[t] = _SBS_BQ_STREAM_MAX(stats->tsMaxDeciK[t], sample->temperatures.ts[t]);
+    }
+
+    uint16_t spread = _SBSBqStreamSpread(&sample->voltages);
+    stats->imbalanceMaxMv = _SBS_BQ_STREAM_MAX(stats->imbalanceMaxMv, spread);
+  }
+
+  for (uint8_t c = 0; c < SBS_BQ_CELL_COUNT; c++)
+    stats->cellDeltaMv[c] = stats->cellMaxMv[c] - stats->cellMinMv[c];
+
+  stats->imbalanceMv = _SBSBqStreamSpread(&SBSBqStreamSample(stream, 0)->voltages);
+}
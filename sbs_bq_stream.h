@@ -0,0 +1,88 @@
+/**
+ *
+ * @file:   sbs_bq_stream.h - Per-cell voltage and temperature streaming from bq40z50 DAStatus1() and DAStatus2()
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * One DAStatus1() read returns every cell voltage and current along with the BAT and PACK voltages, and one
+ * DAStatus2() read returns every thermistor, so a sample of the whole pack costs one or two MAC reads instead of
+ * a read per cell. A stream reads a pack at a fixed period into a ring of samples provided by the caller, keeping
+ * the newest capacity samples, and SBSBqStreamStats() reduces the ring to per-cell minimum, maximum and spread for
+ * balancing analytics.
+ *
+ * Temperatures change much slower than cell voltages, so DAStatus2() is only read every temperatureDivider
+ * samples and the samples in between carry the last temperatures read.
+ *
+ * Streaming at 10 Hz is 10 to 20 MAC reads per second per pack. Polls only touch the bus when a sample is due, so
+ * one task can stream many packs on the same bus with SBSBqStreamRun().
+ *
+ * */
+
+#ifndef _SBS_BQ_STREAM_H_
+#define _SBS_BQ_STREAM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sbs_smb.h"
+#include "sbs_bq_cmd.h"
+
+typedef struct
+{
+  uint32_t timeMs;                              // SMBusPlatformMillis() when read
+  sbs_bq_da_status1_t voltages;
+  sbs_bq_da_status2_t temperatures;             // From the latest DAStatus2() read
+} sbs_bq_stream_sample_t;
+
+// Over the samples in the ring
+typedef struct
+{
+  uint16_t samples;
+  uint16_t cellMinMv[SBS_BQ_CELL_COUNT];
+  uint16_t cellMaxMv[SBS_BQ_CELL_COUNT];
+  uint16_t cellDeltaMv[SBS_BQ_CELL_COUNT];      // Max - min of each cell
+  uint16_t imbalanceMv;                         // Spread between the highest and lowest cell in the latest sample
+  uint16_t imbalanceMaxMv;                      // Largest spread in any one sample
+  uint16_t tsMinDeciK[SBS_BQ_TS_COUNT];
+  uint16_t tsMaxDeciK[SBS_BQ_TS_COUNT];
+} sbs_bq_stream_stats_t;
+
+typedef struct
+{
+  sbs_smb_battery_t *battery;
+  sbs_bq_stream_sample_t *sample;
+  uint16_t capacity;
+  uint16_t head;                                // Slot the next sample goes in
+  uint16_t count;                               // Samples in the ring
+  uint16_t periodMs;
+  uint8_t temperatureDivider;                   // Read DAStatus2() every this many samples, at least 1
+  uint8_t untilTemperatures;                    // Samples until the next DAStatus2() read
+  sbs_bq_da_status2_t temperatures;
+  uint32_t nextMs;                              // Time the next sample is due
+  uint32_t waitMs;                              // Set by SBSBqStreamPoll(): time until the next sample is due
+  int result;                                   // Of the last read
+  uint32_t failed;                              // Reads that failed since SBSBqStreamInit()
+} sbs_bq_stream_t;
+
+/// @param sample   Ring storage for capacity samples
+void SBSBqStreamInit(sbs_bq_stream_t *stream, sbs_smb_battery_t *battery, sbs_bq_stream_sample_t sample[],
+                     uint16_t capacity, uint16_t periodMs, uint8_t temperatureDivider);
+
+/// @brief Read a sample if one is due and return without sleeping
+/// @return true if a sample was added. stream->waitMs is then the time until the next one is due.
+bool SBSBqStreamPoll(sbs_bq_stream_t *stream);
+
+/// @brief Poll every stream for durationMs, sleeping only when no sample is due
+/// @return The number of samples added
+uint32_t SBSBqStreamRun(sbs_bq_stream_t stream[], uint16_t count, uint32_t durationMs);
+
+/// @param back     0 for the latest sample, 1 for the one before it and so on
+/// @return NULL if the ring doesn't hold that many samples
+const sbs_bq_stream_sample_t *SBSBqStreamSample(const sbs_bq_stream_t *stream, uint16_t back);
+
+/// @brief Drop every sample, e.g. to start a new statistics window
+void SBSBqStreamClear(sbs_bq_stream_t *stream);
+
+void SBSBqStreamStats(const sbs_bq_stream_t *stream, sbs_bq_stream_stats_t *stats);
+
+#endif
@@ -0,0 +1,333 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "platform/smbus_platform.h"
+#include "sbs_bqfs.h"
+
+enum
+{
+  _SBS_BQFS_STATE_LINE_START = 0,
+  _SBS_BQFS_STATE_COLON,        // Got the command letter, expecting ':'
+  _SBS_BQFS_STATE_FIELDS,
+  _SBS_BQFS_STATE_COMMENT,      // Skipping to the end of the line
+  _SBS_BQFS_STATE_TRAILER,      // Comment after the fields of a command
+};
+
+static int _SBSBqfsDigit(char c, uint8_t base)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (base == 16 && c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (base == 16 && c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// Store the value that just ended in the command being built
+static int _SBSBqfsEndField(sbs_bqfs_parser_t *parser)
+{
+  sbs_bqfs_cmd_t *cmd = &parser->cmd;
+
+  if (!parser->digits)
+    return SMBUS_ERR_OK;
+
+  if (cmd->type == SBS_BQFS_CMD_WAIT)
+  {
+    if (parser->fields)
+      return SMBUS_ERR_INVALID_ARG;
+    cmd->waitMs = parser->value;
+  }
+  else
+  {
+    if (parser->value > 0xFF)
+      return SMBUS_ERR_INVALID_ARG;
+
+    if (parser->fields == 0)
+      cmd->devAddr = parser->value >> 1;
+    else if (parser->fields == 1)
+      cmd->reg = parser->value;
+    else if (cmd->len < SBS_BQFS_MAX_DATA)
+      cmd->data[cmd->len++] = parser->value;
+    else
+      return SMBUS_ERR_INVALID_ARG;
+  }
+
+  parser->fields++;
+  parser->digits = 0;
+  parser->value = 0;
+  return SMBUS_ERR_OK;
+}
+
+static int _SBSBqfsEndLine(sbs_bqfs_parser_t *parser, sbs_bqfs_cmd_t *cmd)
+{
+  uint8_t state = parser->state;
+
+  parser->state = _SBS_BQFS_STATE_LINE_START;
+
+  if (state == _SBS_BQFS_STATE_LINE_START || state == _SBS_BQFS_STATE_COMMENT)
+    return SMBUS_ERR_OK;
+  if (state == _SBS_BQFS_STATE_COLON)
+    return SMBUS_ERR_INVALID_ARG;
+
+  int ret = _SBSBqfsEndField(parser);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  // A write needs at least the address and register, a compare at least one byte to compare and a wait its time
+  if ((parser->cmd.type == SBS_BQFS_CMD_WRITE && parser->fields < 2) ||
+      (parser->cmd.type == SBS_BQFS_CMD_COMPARE && parser->fields < 3) ||
+      (parser->cmd.type == SBS_BQFS_CMD_WAIT && parser->fields != 1))
+    return SMBUS_ERR_INVALID_ARG;
+
+  memcpy(cmd, &parser->cmd, sizeof(*cmd));
+  cmd->line = parser->line;
+  return SMBUS_ERR_OK;
+}
+
+void SBSBqfsParserInit(sbs_bqfs_parser_t *parser)
+{
+  if (!parser)
+    return;
+
+  memset(parser, 0, sizeof(*parser));
+  parser->line = 1;
+}
+
+int SBSBqfsParse(sbs_bqfs_parser_t *parser, const char *text, size_t len, size_t *consumed, sbs_bqfs_cmd_t *cmd)
+{
+  if (!parser || !cmd)
+    return SMBUS_ERR_INVALID_ARG;
+
+  cmd->type = SBS_BQFS_CMD_NONE;
+  if (consumed)
+    *consumed = 0;
+
+  // End of the script, finish a last line that has no line break
+  if (!text || !len)
+    return _SBSBqfsEndLine(parser, cmd);
+
+  for (size_t i = 0; i < len; i++)
+  {
+    char c = text[i];
+
+    if (c == '\n')
+    {
+      int ret = _SBSBqfsEndLine(parser, cmd);
+      if (ret != SMBUS_ERR_OK)
+        return ret;
+
+      parser->line++;
+      if (cmd->type != SBS_BQFS_CMD_NONE)
+      {
+        if (consumed)
+          *consumed = i + 1;
+        return SMBUS_ERR_OK;
+      }
+      continue;
+    }
+
+    switch (parser->state)
+    {
+      case _SBS_BQFS_STATE_LINE_START:
+        if (c == ' ' || c == '\t' || c == '\r')
+          break;
+
+        memset(&parser->cmd, 0, sizeof(parser->cmd));
+        parser->fields = 0;
+        parser->digits = 0;
+        parser->value = 0;
+        parser->state = _SBS_BQFS_STATE_COLON;
+
+        if (c == 'W' || c == 'w')
+          parser->cmd.type = SBS_BQFS_CMD_WRITE;
+        else if (c == 'C' || c == 'c')
+          parser->cmd.type = SBS_BQFS_CMD_COMPARE;
+        else if (c == 'X' || c == 'x')
+          parser->cmd.type = SBS_BQFS_CMD_WAIT;
+        else if (c == ';')
+          parser->state = _SBS_BQFS_STATE_COMMENT;
+        else
+          return SMBUS_ERR_INVALID_ARG;
+        break;
+
+      case _SBS_BQFS_STATE_COLON:
+        if (c == ':')
+          parser->state = _SBS_BQFS_STATE_FIELDS;
+        else if (c != ' ' && c != '\t')
+          return SMBUS_ERR_INVALID_ARG;
+        break;
+
+      case _SBS_BQFS_STATE_FIELDS:
+      {
+        uint8_t base = (parser->cmd.type == SBS_BQFS_CMD_WAIT) ? 10 : 16;
+        int digit = _SBSBqfsDigit(c, base);
+
+        if (digit >= 0)
+        {
+          if (parser->value > (UINT32_MAX - digit) / base)
+            return SMBUS_ERR_INVALID_ARG;
+          parser->value = parser->value * base + digit;
+          parser->digits++;
+        }
+        else if (c == ' ' || c == '\t' || c == '\r' || c == ',')
+        {
+          int ret = _SBSBqfsEndField(parser);
+          if (ret != SMBUS_ERR_OK)
+            return ret;
+        }
+        else if (c == ';')
+        {
+          // Trailing comment, the command is still complete at the end of the line
+          int ret = _SBSBqfsEndField(parser);
+          if (ret != SMBUS_ERR_OK)
+            return ret;
+          parser->state = _SBS_BQFS_STATE_TRAILER;
+        }
+        else
+          return SMBUS_ERR_INVALID_ARG;
+        break;
+      }
+
+      default:
+        break;
+    }
+  }
+
+  if (consumed)
+    *consumed = len;
+  return SMBUS_ERR_OK;
+}
+
+void SBSBqfsPlayerInit(sbs_bqfs_player_t *player, sbs_smb_battery_t *battery)
+{
+  if (!player)
+    return;
+
+  memset(player, 0, sizeof(*player));
+  player->battery = battery;
+  player->pollIntervalMs = SBS_BQFS_DEFAULT_POLL_INTERVAL_MS;
+}
+
+static int _SBSBqfsCompare(sbs_bqfs_player_t *player, const sbs_bqfs_cmd_t *cmd)
+{
+  uint8_t dataBuff[SBS_BQFS_MAX_DATA];
+
+  int ret = SMBusReadRaw(player->battery->bus, cmd->devAddr, cmd->reg, dataBuff, cmd->len);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  return memcmp(dataBuff, cmd->data, cmd->len) ? SMBUS_ERR_UNEXPECTED_DATA_RECEIVED : SMBUS_ERR_OK;
+}
+
+int SBSBqfsPlayerRun(sbs_bqfs_player_t *player, const sbs_bqfs_cmd_t *cmd)
+{
+  if (!player || !player->battery || !player->battery->bus || !cmd)
+    return SMBUS_ERR_INVALID_ARG;
+
+  if (cmd->type == SBS_BQFS_CMD_NONE)
+    return SMBUS_ERR_OK;
+
+  player->line = cmd->line;
+
+  if (cmd->type == SBS_BQFS_CMD_WAIT)
+  {
+    player->pendingWaitMs += cmd->waitMs;
+    player->waitMs += cmd->waitMs;
+    return SMBUS_ERR_OK;
+  }
+
+  // Flash streams are raw I2C, often to a gauge in ROM mode, so only the route is set up. PEC is never negotiated.
+  int ret = SBSRouteBattery(player->battery);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  if (cmd->type == SBS_BQFS_CMD_WRITE)
+  {
+    uint8_t dataBuff[1 + SBS_BQFS_MAX_DATA];
+
+    SBSBqfsPlayerFinish(player);
+
+    dataBuff[0] = cmd->reg;
+    memcpy(&dataBuff[1], cmd->data, cmd->len);
+    player->writes++;
+    return SMBusWriteRaw(player->battery->bus, cmd->devAddr, dataBuff, 1 + cmd->len);
+  }
+
+  player->compares++;
+
+  // Poll the compare through the wait instead of sleeping all of it. The time slept is counted rather than measured,
+  // so a wait is never cut short on platforms without a millisecond clock.
+  if (player->pendingWaitMs && player->pollIntervalMs)
+  {
+    uint32_t waited = 0;
+
+    while (waited < player->pendingWaitMs)
+    {
+      uint32_t delayMs = player->pendingWaitMs - waited;
+      if (delayMs > player->pollIntervalMs)
+        delayMs = player->pollIntervalMs;
+
+      SMBusPlatformDelayMs(delayMs);
+      waited += delayMs;
+
+      if (waited < player->pendingWaitMs && _SBSBqfsCompare(player, cmd) == SMBUS_ERR_OK)
+      {
+        player->savedMs += player->pendingWaitMs - waited;
+        player->pendingWaitMs = 0;
+        return SMBUS_ERR_OK;
+      }
+    }
+
+    player->pendingWaitMs = 0;
+  }
+
+  SBSBqfsPlayerFinish(player);
+  return _SBSBqfsCompare(player, cmd);
+}
+
+void SBSBqfsPlayerFinish(sbs_bqfs_player_t *player)
+{
+  if (!player || !player->pendingWaitMs)
+    return;
+
+  SMBusPlatformDelayMs(player->pendingWaitMs);
+  player->pendingWaitMs = 0;
+}
+
+int SBSBqfsPlay(sbs_bqfs_player_t *player, const char *text, size_t len)
+{
+  if (!player || !text)
+    return SMBUS_ERR_INVALID_ARG;
+
+  sbs_bqfs_parser_t parser;
+  sbs_bqfs_cmd_t cmd;
+  size_t consumed;
+  int ret;
+
+  bool done = false;
+
+  SBSBqfsParserInit(&parser);
+
+  while (!done)
+  {
+    // Once the text runs out, one more call with a len of 0 finishes a last line that has no line break
+    done = !len;
+
+    ret = SBSBqfsParse(&parser, text, len, &consumed, &cmd);
+    if (ret != SMBUS_ERR_OK)
+    {
+      player->line = parser.line;
+      return ret;
+    }
+    text += consumed;
+    len -= consumed;
+
+    ret = SBSBqfsPlayerRun(player, &cmd);
+    if (ret != SMBUS_ERR_OK)
+      return ret;
+  }
+
+  SBSBqfsPlayerFinish(player);
+  return SMBUS_ERR_OK;
+}
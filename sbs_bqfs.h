@@ -0,0 +1,101 @@
+/**
+ *
+ * @file:   sbs_bqfs.h - Streaming parser and player for TI .bq.fs/.df.fs gauge programming scripts
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * Flash stream files are plain text, one command per line:
+ *
+ *  W: AA RR DD DD ...    Write the data bytes DD to register RR of the device at 8-bit address AA
+ *  C: AA RR DD DD ...    Read as many bytes from register RR and fail if they differ from DD
+ *  X: ms                 Wait for a number of milliseconds
+ *  ; ...                 Comment
+ *
+ * All values except the wait are hex. The parser is fed any number of bytes at a time, e.g. chunks read from a file
+ * or a whole memory mapped file, and keeps only the command being parsed, so memory use doesn't depend on the file size.
+ *
+ * The player runs the commands as plain I2C transactions with no PEC, like the gauge expects in ROM mode:
+ *  - Consecutive writes go out back to back. They are never merged into one transaction, since each W line is
+ *    a separate command to the gauge, e.g. a flash row program.
+ *  - Consecutive waits add up, and a wait is only served when the next transaction is due.
+ *  - A wait followed by a compare polls the compare every pollIntervalMs instead of sleeping, and moves on as soon
+ *    as the gauge returns the expected data. Waits followed by a write are always served in full.
+ *
+ * */
+
+#ifndef _SBS_BQFS_H_
+#define _SBS_BQFS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sbs_smb.h"
+
+#define SBS_BQFS_MAX_DATA                               128         // Data bytes of the longest W or C line
+#define SBS_BQFS_DEFAULT_POLL_INTERVAL_MS               5
+
+typedef enum
+{
+  SBS_BQFS_CMD_NONE = 0,        // No complete command yet
+  SBS_BQFS_CMD_WRITE,
+  SBS_BQFS_CMD_COMPARE,
+  SBS_BQFS_CMD_WAIT,
+} sbs_bqfs_cmd_type_t;
+
+typedef struct
+{
+  sbs_bqfs_cmd_type_t type;
+  uint8_t devAddr;              // 7-bit address
+  uint8_t reg;
+  uint8_t len;                  // Number of data bytes
+  uint32_t waitMs;
+  uint32_t line;                // Line of the script the command was parsed from
+  uint8_t data[SBS_BQFS_MAX_DATA];
+} sbs_bqfs_cmd_t;
+
+typedef struct
+{
+  uint8_t state;
+  uint32_t line;                // Line being parsed, 1-based
+  uint16_t fields;              // Values parsed on the current line
+  uint8_t digits;               // Digits of the value being parsed
+  uint32_t value;
+  sbs_bqfs_cmd_t cmd;
+} sbs_bqfs_parser_t;
+
+typedef struct
+{
+  sbs_smb_battery_t *battery;   // Bus to play on. Its mux channel is selected before every transaction.
+  uint16_t pollIntervalMs;      // 0 serves every wait in full
+  uint32_t pendingWaitMs;       // Wait still to be served before the next transaction
+  uint32_t line;                // Line of the last command run, to report where playback stopped
+
+  uint32_t writes;
+  uint32_t compares;
+  uint32_t waitMs;              // Total of the waits in the script
+  uint32_t savedMs;             // Part of that cut short by polling
+} sbs_bqfs_player_t;
+
+void SBSBqfsParserInit(sbs_bqfs_parser_t *parser);
+
+/// @brief Parse until a command is complete or the text runs out
+/// @param text      Next bytes of the script. A len of 0 marks the end of the script.
+/// @param consumed  Number of bytes of text used. Pass the rest back in on the next call.
+/// @param cmd       Type is SBS_BQFS_CMD_NONE if more text is needed
+/// @return SMBUS_ERR_INVALID_ARG for a malformed line, see parser->line
+int SBSBqfsParse(sbs_bqfs_parser_t *parser, const char *text, size_t len, size_t *consumed, sbs_bqfs_cmd_t *cmd);
+
+void SBSBqfsPlayerInit(sbs_bqfs_player_t *player, sbs_smb_battery_t *battery);
+
+/// @brief Run one command. Waits are held back until the next transaction.
+/// @return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED if a compare fails
+int SBSBqfsPlayerRun(sbs_bqfs_player_t *player, const sbs_bqfs_cmd_t *cmd);
+
+/// @brief Serve a wait left at the end of the script
+void SBSBqfsPlayerFinish(sbs_bqfs_player_t *player);
+
+/// @brief Parse and play a whole script held in memory, e.g. a memory mapped file or a script embedded in flash
+int SBSBqfsPlay(sbs_bqfs_player_t *player, const char *text, size_t len);
+
+#endif
@@ -0,0 +1,138 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_cache.h"
+
+static bool _SBSCacheIsBypassed(sbs_smb_cmd_code_t code)
+{
+  return code == SBS_SMB_CMD_CODE_MANUFACTURER_ACCESS ||
+         code == SBS_SMB_CMD_CODE_MANUFACTURER_BLOCK_ACCESS ||
+         code == SBS_SMB_CMD_CODE_MANUFACTURER_DATA;
+}
+
+static bool _SBSCacheIsFixed(sbs_smb_cmd_code_t code)
+{
+  switch (code)
+  {
+    case SBS_SMB_CMD_CODE_DESIGN_CAPACITY:
+    case SBS_SMB_CMD_CODE_DESIGN_VOLTAGE:
+    case SBS_SMB_CMD_CODE_SPECIFICATION_INFO:
+    case SBS_SMB_CMD_CODE_MANUFACTURE_DATE:
+    case SBS_SMB_CMD_CODE_SERIAL_NUMBER:
+    case SBS_SMB_CMD_CODE_MANUFACTURER_NAME:
+    case SBS_SMB_CMD_CODE_DEVICE_NAME:
+    case SBS_SMB_CMD_CODE_DEVICE_CHEMISTRY:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+int SBSCacheInit(sbs_cache_t *cache)
+{
+  if (!cache)
+    return SMBUS_ERR_INVALID_ARG;
+
+  memset(cache, 0, sizeof(*cache));
+
+  cache->lock = SMBusPlatformMutexCreate();
+  if (!cache->lock)
+    return SMBUS_ERR_FAIL;
+
+  for (int code = 0; code < SBS_SMB_CMD_CODE_MAX; code++)
+  {
+    if (_SBSCacheIsBypassed(code))
+      cache->ttlMs[code] = SBS_CACHE_TTL_NONE;
+    else if (_SBSCacheIsFixed(code))
+      cache->ttlMs[code] = SBS_CACHE_TTL_FOREVER;
+    else
+      cache->ttlMs[code] = SBS_CACHE_DEFAULT_TTL_MS;
+  }
+
+  return SMBUS_ERR_OK;
+}
+
+void SBSCacheDeinit(sbs_cache_t *cache)
+{
+  if (!cache || !cache->lock)
+    return;
+
+  SMBusPlatformMutexDelete(cache->lock);
+  cache->lock = NULL;
+}
+
+int SBSCacheSetTtl(sbs_cache_t *cache, sbs_smb_cmd_code_t code, uint32_t ttlMs)
+{
+  if (!cache || code >= SBS_SMB_CMD_CODE_MAX || _SBSCacheIsBypassed(code))
+    return SMBUS_ERR_INVALID_ARG;
+
+  SBSCacheLock(cache);
+  cache->ttlMs[code] = ttlMs;
+  cache->entry[code].valid = false;
+  SBSCacheUnlock(cache);
+
+  return SMBUS_ERR_OK;
+}
+
+void SBSCacheInvalidate(sbs_cache_t *cache)
+{
+  if (!cache)
+    return;
+
+  SBSCacheLock(cache);
+  SBSCacheClear(cache);
+  SBSCacheUnlock(cache);
+}
+
+void SBSCacheLock(sbs_cache_t *cache)
+{
+  SMBusPlatformMutexLock(cache->lock);
+}
+
+void SBSCacheUnlock(sbs_cache_t *cache)
+{
+  SMBusPlatformMutexUnlock(cache->lock);
+}
+
+bool SBSCacheIsCacheable(sbs_cache_t *cache, sbs_smb_cmd_code_t code, void *inPtr)
+{
+  return !inPtr && code < SBS_SMB_CMD_CODE_MAX && cache->ttlMs[code] != SBS_CACHE_TTL_NONE;
+}
+
+bool SBSCacheLookup(sbs_cache_t *cache, sbs_smb_cmd_code_t code, void *data, uint8_t *len)
+{
+  sbs_cache_entry_t *entry = &cache->entry[code];
+
+  // Unsigned subtraction keeps working across a wrap around of the millisecond count
+  if (!entry->valid ||
+      (cache->ttlMs[code] != SBS_CACHE_TTL_FOREVER && (uint32_t)(SMBusPlatformMillis() - entry->readMs) >= cache->ttlMs[code]))
+  {
+    cache->misses++;
+    return false;
+  }
+
+  memcpy(data, entry->data, entry->len);
+  *len = entry->len;
+  cache->hits++;
+  return true;
+}
+
+void SBSCacheStore(sbs_cache_t *cache, sbs_smb_cmd_code_t code, const void *data, uint8_t len)
+{
+  sbs_cache_entry_t *entry = &cache->entry[code];
+
+  if (len > SBS_CACHE_MAX_DATA)
+    return;
+
+  memcpy(entry->data, data, len);
+  entry->len = len;
+  entry->readMs = SMBusPlatformMillis();
+  entry->valid = true;
+}
+
+void SBSCacheClear(sbs_cache_t *cache)
+{
+  for (int code = 0; code < SBS_SMB_CMD_CODE_MAX; code++)
+    cache->entry[code].valid = false;
+}
@@ -0,0 +1,84 @@
+/**
+ *
+ * @file:   sbs_cache.h - Optional per-battery cache of SBSRunCommand() reads
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * Point a battery's cache field at an initialized sbs_cache_t and plain reads through SBSRunCommand()
+ * are served from the cache for as long as the command's TTL allows. Only the raw bytes read from the
+ * bus are kept, so every caller still gets the value decoded into its own output.
+ *
+ * All transactions with the battery are serialized on the cache mutex. A caller that finds a value
+ * missing or expired reads it while holding the mutex, so other callers asking for the same value at the
+ * same time wait for that one read and then find it in the cache instead of reading it again.
+ *
+ * Never cached:
+ *  - Commands with side effects or whose result depends on a previous write: ManufacturerAccess(),
+ *    ManufacturerBlockAccess() and ManufacturerData().
+ *  - Any call that writes i.e. has an inPtr. A write also invalidates the whole cache since it may change
+ *    what other commands return, e.g. BatteryMode() switching capacity units.
+ *
+ * */
+
+#ifndef _SBS_CACHE_H_
+#define _SBS_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sbs_smb.h"
+
+#define SBS_CACHE_TTL_NONE                              0           // Always read from the battery
+#define SBS_CACHE_TTL_FOREVER                           UINT32_MAX  // Only read again after SBSCacheInvalidate()
+
+#define SBS_CACHE_DEFAULT_TTL_MS                        1000        // Measurements e.g. Voltage(), Current()
+#define SBS_CACHE_MAX_DATA                              32          // Longer block reads are not cached
+
+typedef struct
+{
+  uint32_t readMs;              // SMBusPlatformMillis() when the value was read
+  uint8_t len;
+  bool valid;
+  uint8_t data[SBS_CACHE_MAX_DATA];
+} sbs_cache_entry_t;
+
+struct sbs_cache
+{
+  smbus_mutex_t lock;
+  uint32_t ttlMs[SBS_SMB_CMD_CODE_MAX];
+  sbs_cache_entry_t entry[SBS_SMB_CMD_CODE_MAX];
+  uint32_t hits;
+  uint32_t misses;
+};
+
+/// @brief Initialize a cache with the default TTLs: SBS_CACHE_TTL_FOREVER for values fixed at manufacture
+///        such as DeviceName() or SerialNumber(), SBS_CACHE_DEFAULT_TTL_MS for everything else that can be cached
+/// @return SMBUS_ERR_FAIL if the mutex could not be created
+int SBSCacheInit(sbs_cache_t *cache);
+
+void SBSCacheDeinit(sbs_cache_t *cache);
+
+/// @brief Change how long the result of a command stays valid
+/// @return SMBUS_ERR_INVALID_ARG for commands that are never cached
+int SBSCacheSetTtl(sbs_cache_t *cache, sbs_smb_cmd_code_t code, uint32_t ttlMs);
+
+/// @brief Drop all cached values e.g. after talking to the battery without going through SBSRunCommand()
+void SBSCacheInvalidate(sbs_cache_t *cache);
+
+/****************************** Used by SBSRunCommand() with the cache lock held ******************************/
+
+void SBSCacheLock(sbs_cache_t *cache);
+void SBSCacheUnlock(sbs_cache_t *cache);
+
+/// @brief Whether a call to SBSRunCommand() may be served from the cache
+bool SBSCacheIsCacheable(sbs_cache_t *cache, sbs_smb_cmd_code_t code, void *inPtr);
+
+/// @brief Copy out the cached raw result of a command if it hasn't expired
+/// @return true on a hit
+bool SBSCacheLookup(sbs_cache_t *cache, sbs_smb_cmd_code_t code, void *data, uint8_t *len);
+
+void SBSCacheStore(sbs_cache_t *cache, sbs_smb_cmd_code_t code, const void *data, uint8_t len);
+
+void SBSCacheClear(sbs_cache_t *cache);
+
+#endif
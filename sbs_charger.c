@@ -0,0 +1,134 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "platform/smbus_platform.h"
+#include "sbs_charger.h"
+#include "sbs_mux.h"
+
+// Route the bus to the charger and set the PEC it uses, as SBSSelectBattery() does for batteries
+static int _SBSChargerSelect(sbs_charger_t *charger)
+{
+  int ret;
+
+  if (charger->mux && (ret = SBSMuxSelect(charger->mux, charger->muxChannel)) != SMBUS_ERR_OK)
+    return ret;
+
+  return SMBusSetPec(charger->bus, charger->pec);
+}
+
+static int _SBSChargerWrite(sbs_charger_t *charger, uint8_t command, uint16_t value)
+{
+  if (!charger || !charger->bus)
+    return SMBUS_ERR_INVALID_ARG;
+
+  int ret = _SBSChargerSelect(charger);
+  if (ret == SMBUS_ERR_OK)
+    ret = SMBusWriteWord(charger->bus, charger->busAddress, command, value);
+
+  if (ret == SMBUS_ERR_OK)
+    charger->writes++;
+  return ret;
+}
+
+void SBSChargerInit(sbs_charger_t *charger, smbus_handle_t bus, uint8_t busAddress, sbs_smb_battery_t *battery,
+                    uint32_t periodMs)
+{
+  if (!charger)
+    return;
+
+  memset(charger, 0, sizeof(*charger));
+  charger->bus = bus;
+  charger->busAddress = busAddress;
+  charger->battery = battery;
+  charger->periodMs = periodMs;
+  charger->refreshMs = SBS_CHARGER_REFRESH_MS_DEFAULT;
+  charger->nextMs = SMBusPlatformMillis();
+}
+
+int SBSChargerWriteVoltage(sbs_charger_t *charger, uint16_t voltage)
+{
+  return _SBSChargerWrite(charger, SBS_CHARGER_COMMAND_CHARGING_VOLTAGE, voltage);
+}
+
+int SBSChargerWriteCurrent(sbs_charger_t *charger, uint16_t current)
+{
+  return _SBSChargerWrite(charger, SBS_CHARGER_COMMAND_CHARGING_CURRENT, current);
+}
+
+int SBSChargerReadStatus(sbs_charger_t *charger, uint16_t *status)
+{
+  if (!charger || !charger->bus || !status)
+    return SMBUS_ERR_INVALID_ARG;
+
+  int ret = _SBSChargerSelect(charger);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  return SMBusReadWord(charger->bus, charger->busAddress, SBS_CHARGER_COMMAND_STATUS, status);
+}
+
+bool SBSChargerPoll(sbs_charger_t *charger)
+{
+  if (!charger || !charger->battery)
+    return false;
+
+  uint32_t now = SMBusPlatformMillis();
+  int32_t early = (int32_t)(charger->nextMs - now);
+
+  if (early > 0)
+  {
+    charger->waitMs = early;
+    return false;
+  }
+
+  charger->nextMs += charger->periodMs;
+  if ((int32_t)(charger->nextMs - now) <= 0)
+    charger->nextMs = now + charger->periodMs;
+  charger->waitMs = charger->nextMs - now;
+
+  sbs_smb_battery_t *battery = charger->battery;
+  uint16_t voltage, current;
+
+  int ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_CHARGING_VOLTAGE, NULL, 0, &voltage, sizeof(voltage));
+  if (ret == SMBUS_ERR_OK)
+    ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_CHARGING_CURRENT, NULL, 0, &current, sizeof(current));
+
+  if (ret != SMBUS_ERR_OK)
+  {
+    charger->result = ret;
+    return true;
+  }
+
+  battery->chargingVoltage = voltage;
+  battery->chargingCurrent = current;
+
+  bool refresh = !charger->written ||
+                 (charger->refreshMs && (uint32_t)(now - charger->writtenMs) >= charger->refreshMs);
+
+  // Voltage first so the charger never charges at a new current to the old voltage
+  if (refresh || voltage != charger->voltage)
+  {
+    ret = SBSChargerWriteVoltage(charger, voltage);
+    if (ret == SMBUS_ERR_OK)
+      charger->voltage = voltage;
+  }
+  if (ret == SMBUS_ERR_OK && (refresh || current != charger->current))
+  {
+    ret = SBSChargerWriteCurrent(charger, current);
+    if (ret == SMBUS_ERR_OK)
+      charger->current = current;
+  }
+
+  // A failed write leaves what the charger holds unknown
+  charger->written = (ret == SMBUS_ERR_OK);
+  if (refresh && charger->written)
+    charger->writtenMs = now;
+  charger->result = ret;
+  return true;
+}
+
+void SBSChargerInvalidate(sbs_charger_t *charger)
+{
+  if (charger)
+    charger->written = false;
+}
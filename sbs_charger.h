@@ -0,0 +1,101 @@
+/**
+ *
+ * @file:   sbs_charger.h - Smart Battery Charger driven by the requests of a battery
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * A Smart Battery Charger (address 0x09) charges at the ChargingVoltage() and ChargingCurrent() written to it.
+ * The battery requests those values in its own ChargingVoltage() and ChargingCurrent(), and can broadcast them to
+ * the charger as a bus master. Hosts that would rather not have batteries mastering the bus set CHARGER_MODE in
+ * BatteryMode() to stop the broadcasts and relay the requests themselves, which is what this does:
+ *
+ *  every periodMs:  read the battery's requests, then write the ones that changed to the charger
+ *
+ * The charger stops charging if it isn't written within its watchdog time (140 s at least), so unchanged values
+ * are written again every refreshMs. The charger is a separate device on the bus and can sit behind a mux like a
+ * battery.
+ *
+ * Both periods are timed with SMBusPlatformMillis(), so the platform clock has to advance between polls. On AVR
+ * without Arduino it only counts the time slept in SMBusPlatformDelayMs(), so the task polling the charger has to
+ * sleep through the library or replace both with a timer of its own. With a clock that doesn't move the battery is
+ * read once and never again, and the charger stops charging at its watchdog time.
+ *
+ * */
+
+#ifndef _SBS_CHARGER_H_
+#define _SBS_CHARGER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sbs_smb.h"
+
+#define SBS_CHARGER_DEFAULT_ADDRESS                     0x09
+
+#define SBS_CHARGER_COMMAND_SPEC_INFO                   0x11
+#define SBS_CHARGER_COMMAND_MODE                        0x12
+#define SBS_CHARGER_COMMAND_STATUS                      0x13
+#define SBS_CHARGER_COMMAND_CHARGING_CURRENT            0x14
+#define SBS_CHARGER_COMMAND_CHARGING_VOLTAGE            0x15
+#define SBS_CHARGER_COMMAND_ALARM_WARNING               0x16
+
+#define SBS_CHARGER_REFRESH_MS_DEFAULT                  100000  // Well within the 140 s minimum watchdog time
+
+// ChargerStatus()
+#define SBS_CHARGER_STATUS_CHARGE_INHIBITED             (1 << 0)
+#define SBS_CHARGER_STATUS_POLLING_ENABLED              (1 << 1)
+#define SBS_CHARGER_STATUS_VOLTAGE_NOT_REG              (1 << 2)
+#define SBS_CHARGER_STATUS_CURRENT_NOT_REG              (1 << 3)
+#define SBS_CHARGER_STATUS_LEVEL_2                      (1 << 4)
+#define SBS_CHARGER_STATUS_LEVEL_3                      (1 << 5)
+#define SBS_CHARGER_STATUS_CURRENT_OR                   (1 << 6)  // Requested current out of range
+#define SBS_CHARGER_STATUS_VOLTAGE_OR                   (1 << 7)  // Requested voltage out of range
+#define SBS_CHARGER_STATUS_THERMISTOR_OR                (1 << 8)
+#define SBS_CHARGER_STATUS_THERMISTOR_COLD              (1 << 9)
+#define SBS_CHARGER_STATUS_THERMISTOR_HOT               (1 << 10)
+#define SBS_CHARGER_STATUS_THERMISTOR_UR                (1 << 11)
+#define SBS_CHARGER_STATUS_ALARM_INHIBITED              (1 << 12)
+#define SBS_CHARGER_STATUS_POWER_FAIL                   (1 << 13)
+#define SBS_CHARGER_STATUS_BATTERY_PRESENT              (1 << 14)
+#define SBS_CHARGER_STATUS_AC_PRESENT                   (1 << 15)
+
+typedef struct
+{
+  smbus_handle_t bus;
+  uint8_t busAddress;
+  sbs_mux_t *mux;               // I2C mux the charger sits behind, NULL if it is connected directly to the bus
+  uint8_t muxChannel;
+  bool pec;
+  sbs_smb_battery_t *battery;   // Battery whose requests the charger follows
+  uint32_t periodMs;            // Between reads of the battery's requests
+  uint32_t refreshMs;           // Between writes of unchanged values, 0 to only write changes
+  bool written;                 // Whether voltage and current are what the charger was last sent
+  uint16_t voltage;             // mV
+  uint16_t current;             // mA
+  uint32_t nextMs;              // Time the next read is due
+  uint32_t writtenMs;           // Time both values were last written
+  uint32_t waitMs;              // Set by SBSChargerPoll(): time until the next read is due
+  uint32_t writes;              // Writes to the charger since SBSChargerInit()
+  int result;                   // Of the last poll that touched the bus
+} sbs_charger_t;
+
+/// @brief Set up a charger following battery. refreshMs starts as SBS_CHARGER_REFRESH_MS_DEFAULT.
+void SBSChargerInit(sbs_charger_t *charger, smbus_handle_t bus, uint8_t busAddress, sbs_smb_battery_t *battery,
+                    uint32_t periodMs);
+
+int SBSChargerWriteVoltage(sbs_charger_t *charger, uint16_t voltage);
+
+int SBSChargerWriteCurrent(sbs_charger_t *charger, uint16_t current);
+
+/// @param status   SBS_CHARGER_STATUS_... bits
+int SBSChargerReadStatus(sbs_charger_t *charger, uint16_t *status);
+
+/// @brief Read the battery's requests if they are due and write the changes, without sleeping. Needs an advancing
+///        SMBusPlatformMillis(), see above.
+/// @return true if the bus was used. charger->waitMs is then how long until the next read is due.
+bool SBSChargerPoll(sbs_charger_t *charger);
+
+/// @brief Forget what the charger was sent, e.g. after it was power cycled, so the next poll writes both values
+void SBSChargerInvalidate(sbs_charger_t *charger);
+
+#endif
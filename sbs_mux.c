@@ -0,0 +1,145 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "sbs_mux.h"
+#include "sbs_selector.h"
+
+// Only the SMB nibble changes. The rest is written back as read so the power and charge routing stay as they are.
+static int _SBSMuxSelectorWrite(sbs_mux_t *mux, uint8_t channelMask)
+{
+  smbus_info_t info;
+  uint16_t state;
+
+  // The selector is addressed without PEC, then the bus is left as it was for batteries that keep the bus setting
+  int ret = SMBusGetInfo(mux->bus, &info);
+  if (ret == SMBUS_ERR_OK)
+    ret = SMBusSetPec(mux->bus, false);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  ret = SMBusReadWord(mux->bus, mux->busAddress, SBS_SELECTOR_COMMAND_STATE, &state);
+  if (ret == SMBUS_ERR_OK)
+    ret = SMBusWriteWord(mux->bus, mux->busAddress, SBS_SELECTOR_COMMAND_STATE,
+                         (state & ~(SBS_SELECTOR_NIBBLE_MASK << SBS_SELECTOR_SMB_SHIFT)) |
+                         ((channelMask & SBS_SELECTOR_NIBBLE_MASK) << SBS_SELECTOR_SMB_SHIFT));
+
+  SMBusSetPec(mux->bus, info.usePEC);
+  return ret;
+}
+
+static int _SBSMuxWrite(sbs_mux_t *mux, uint8_t channelMask, int8_t channel)
+{
+  int ret;
+
+  // A selector always connects the bus to one of its batteries, so there is nothing to disable
+  if (mux->type == SBS_MUX_TYPE_SELECTOR && channel == SBS_MUX_CHANNEL_NONE)
+    return SMBUS_ERR_OK;
+
+  // A plain I2C mux would take a PEC byte as the new channel mask, so it is written raw
+  if (mux->type == SBS_MUX_TYPE_SELECTOR)
+    ret = _SBSMuxSelectorWrite(mux, channelMask);
+  else
+    ret = SMBusWriteRaw(mux->bus, mux->busAddress, &channelMask, 1);
+
+  // If the write failed the state of the mux is unknown, so make sure the next select or disable is sent
+  mux->activeChannel = (ret == SMBUS_ERR_OK) ? channel : SBS_MUX_CHANNEL_UNKNOWN;
+  return ret;
+}
+
+static int _SBSMuxCompare(const void *a, const void *b)
+{
+  const sbs_smb_battery_t *battA = *(const sbs_smb_battery_t **)a;
+  const sbs_smb_battery_t *battB = *(const sbs_smb_battery_t **)b;
+
+  if (battA->bus != battB->bus)
+    return (battA->bus < battB->bus) ? -1 : 1;
+  if (battA->mux != battB->mux)
+    return (battA->mux < battB->mux) ? -1 : 1;
+  if (battA->muxChannel != battB->muxChannel)
+    return (battA->muxChannel < battB->muxChannel) ? -1 : 1;
+
+  return battA->busAddress - battB->busAddress;
+}
+
+void SBSMuxInit(sbs_mux_t *mux, smbus_handle_t bus, uint8_t busAddress, sbs_mux_t *sharesBusWith)
+{
+  if (!mux)
+    return;
+
+  mux->bus = bus;
+  mux->busAddress = busAddress;
+  mux->type = SBS_MUX_TYPE_I2C;
+  mux->activeChannel = SBS_MUX_CHANNEL_UNKNOWN;
+  mux->nextOnBus = mux;
+
+  if (sharesBusWith)
+  {
+    mux->nextOnBus = sharesBusWith->nextOnBus;
+    sharesBusWith->nextOnBus = mux;
+  }
+}
+
+int SBSMuxSelect(sbs_mux_t *mux, uint8_t channel)
+{
+  if (!mux || !mux->bus || channel >= SBS_MUX_MAX_CHANNELS ||
+      (mux->type == SBS_MUX_TYPE_SELECTOR && channel >= SBS_SELECTOR_MAX_BATTERIES))
+    return SMBUS_ERR_INVALID_ARG;
+
+  if (mux->activeChannel == channel)
+    return SMBUS_ERR_OK;
+
+  for (sbs_mux_t *other = mux->nextOnBus; other && other != mux; other = other->nextOnBus)
+  {
+    if (other->activeChannel == SBS_MUX_CHANNEL_NONE)
+      continue;
+
+    int ret = SBSMuxDisable(other);
+    if (ret != SMBUS_ERR_OK)
+      return ret;
+  }
+
+  return _SBSMuxWrite(mux, 1 << channel, channel);
+}
+
+int SBSMuxDisable(sbs_mux_t *mux)
+{
+  if (!mux || !mux->bus)
+    return SMBUS_ERR_INVALID_ARG;
+
+  return _SBSMuxWrite(mux, 0, SBS_MUX_CHANNEL_NONE);
+}
+
+void SBSMuxInvalidate(sbs_mux_t *mux)
+{
+  if (mux)
+    mux->activeChannel = SBS_MUX_CHANNEL_UNKNOWN;
+}
+
+void SBSMuxSortBatteries(sbs_smb_battery_t *battery[], uint16_t count)
+{
+  if (!battery || count < 2)
+    return;
+
+  qsort(battery, count, sizeof(battery[0]), _SBSMuxCompare);
+}
+
+uint16_t SBSMuxGetBatteryInfo(sbs_smb_battery_t *battery[], uint16_t count, int ret[])
+{
+  if (!battery)
+    return count;
+
+  uint16_t failed = 0;
+
+  SBSMuxSortBatteries(battery, count);
+
+  for (uint16_t i = 0; i < count; i++)
+  {
+    int err = SBSGetBatteryInfo(battery[i]);
+    if (err != SMBUS_ERR_OK)
+      failed++;
+    if (ret)
+      ret[i] = err;
+  }
+
+  return failed;
+}
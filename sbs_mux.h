@@ -0,0 +1,67 @@
+/**
+ *
+ * @file:   sbs_mux.h - Support for batteries behind PCA9548-style I2C multiplexers
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * A battery behind a mux is addressed by (bus, mux address, channel, device address). Set the battery's
+ * mux and muxChannel fields and SBSRunCommand() enables the right channel before talking to it.
+ * The mux remembers which channel is enabled so the channel-select write is only sent when it changes.
+ *
+ * A Smart Battery Selector is handled as a mux too, whose channels are the batteries it can connect the bus to.
+ * See sbs_selector.h.
+ *
+ * */
+
+#ifndef _SBS_MUX_H_
+#define _SBS_MUX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sbs_smb.h"
+
+#define SBS_MUX_DEFAULT_ADDRESS                         0x70
+#define SBS_MUX_MAX_CHANNELS                            8
+#define SBS_MUX_CHANNEL_NONE                            -1
+#define SBS_MUX_CHANNEL_UNKNOWN                         -2
+
+typedef enum
+{
+  SBS_MUX_TYPE_I2C = 0,           // PCA9548-style, one bit per channel written raw
+  SBS_MUX_TYPE_SELECTOR,          // Smart Battery Selector, switched through the SMB nibble of SelectorState()
+} sbs_mux_type_t;
+
+struct sbs_mux
+{
+  smbus_handle_t bus;
+  uint8_t busAddress;
+  sbs_mux_type_t type;
+  int8_t activeChannel;           // Channel currently enabled, SBS_MUX_CHANNEL_NONE or SBS_MUX_CHANNEL_UNKNOWN
+  struct sbs_mux *nextOnBus;      // Ring of muxes on the same bus whose channels must not be enabled together
+};
+
+/// @brief Initialize a mux handle
+/// @param sharesBusWith Another mux on the same bus, or NULL. Muxes that share a bus form a ring and selecting a
+///                      channel on one disables the others so that batteries at the same address don't collide.
+void SBSMuxInit(sbs_mux_t *mux, smbus_handle_t bus, uint8_t busAddress, sbs_mux_t *sharesBusWith);
+
+/// @brief Enable a single channel on the mux. Nothing is sent if the channel is already enabled.
+int SBSMuxSelect(sbs_mux_t *mux, uint8_t channel);
+
+/// @brief Disable all channels on the mux
+int SBSMuxDisable(sbs_mux_t *mux);
+
+/// @brief Forget the enabled channel e.g. after the mux was reset, so that the next select is always sent
+void SBSMuxInvalidate(sbs_mux_t *mux);
+
+/// @brief Reorder the batteries so that those on the same bus, mux and channel are next to each other
+void SBSMuxSortBatteries(sbs_smb_battery_t *battery[], uint16_t count);
+
+/// @brief Read SBSGetBatteryInfo() for each battery, grouped by mux channel so that each channel is selected once
+/// @note  The battery array is reordered by SBSMuxSortBatteries()
+/// @param ret If not NULL, ret[i] is set to the result for battery[i] after reordering
+/// @return The number of batteries that could not be read
+uint16_t SBSMuxGetBatteryInfo(sbs_smb_battery_t *battery[], uint16_t count, int ret[]);
+
+#endif
@@ -0,0 +1,384 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "platform/smbus_platform.h"
+#include "sbs_bq.h"
+#include "sbs_profile.h"
+
+#define _SBS_PROFILE_BLOB_VERSION       1
+#define _SBS_PROFILE_HEADER_SIZE        8           // Magic, version, entry size, count
+#define _SBS_PROFILE_ENTRY_SIZE         (13 + SBS_PROFILE_CMD_BYTES)
+
+static const uint8_t _sbsProfileMagic[4] = { 'S', 'B', 'P', 'F' };
+
+static uint8_t _SBSProfileCrc8(const uint8_t *data, size_t len)
+{
+  uint8_t crc = 0;
+
+  while (len--)
+  {
+    crc ^= *data++;
+    for (uint8_t k = 0; k < 8; k++)
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+
+  return crc;
+}
+
+static void _SBSProfilePut16(uint8_t *p, uint16_t value)
+{
+  p[0] = value & 0xFF;
+  p[1] = value >> 8;
+}
+
+static uint16_t _SBSProfileGet16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+void SBSProfileStoreInit(sbs_profile_store_t *store, sbs_profile_t profile[], uint16_t capacity)
+{
+  if (!store)
+    return;
+
+  store->profile = profile;
+  store->capacity = profile ? capacity : 0;
+  store->count = 0;
+}
+
+sbs_profile_t *SBSProfileStoreFind(sbs_profile_store_t *store, uint16_t serialNumber, uint16_t manufactureDate)
+{
+  if (!store)
+    return NULL;
+
+  for (uint16_t i = 0; i < store->count; i++)
+  {
+    if (store->profile[i].serialNumber == serialNumber && store->profile[i].manufactureDate == manufactureDate)
+      return &store->profile[i];
+  }
+
+  return NULL;
+}
+
+sbs_profile_t *SBSProfileStorePut(sbs_profile_store_t *store, const sbs_profile_t *profile)
+{
+  if (!store || !profile)
+    return NULL;
+
+  sbs_profile_t *stored = SBSProfileStoreFind(store, profile->serialNumber, profile->manufactureDate);
+  if (!stored)
+  {
+    if (store->count >= store->capacity)
+      return NULL;
+    stored = &store->profile[store->count++];
+  }
+
+  if (stored != profile)
+    memcpy(stored, profile, sizeof(*stored));
+  stored->changed = true;
+  return stored;
+}
+
+bool SBSProfileStoreChanged(const sbs_profile_store_t *store)
+{
+  if (!store)
+    return false;
+
+  for (uint16_t i = 0; i < store->count; i++)
+  {
+    if (store->profile[i].changed)
+      return true;
+  }
+
+  return false;
+}
+
+void SBSProfileStoreSaved(sbs_profile_store_t *store)
+{
+  if (!store)
+    return;
+
+  for (uint16_t i = 0; i < store->count; i++)
+    store->profile[i].changed = false;
+}
+
+size_t SBSProfileStoreBlobSize(const sbs_profile_store_t *store)
+{
+  return _SBS_PROFILE_HEADER_SIZE + (store ? store->count : 0) * _SBS_PROFILE_ENTRY_SIZE + 1;
+}
+
+size_t SBSProfileStoreSerialize(const sbs_profile_store_t *store, uint8_t *blob, size_t size)
+{
+  size_t len = SBSProfileStoreBlobSize(store);
+
+  if (!store || !blob || size < len)
+    return 0;
+
+  uint8_t *p = blob;
+
+  memcpy(p, _sbsProfileMagic, sizeof(_sbsProfileMagic));
+  p[4] = _SBS_PROFILE_BLOB_VERSION;
+  p[5] = _SBS_PROFILE_ENTRY_SIZE;
+  _SBSProfilePut16(&p[6], store->count);
+  p += _SBS_PROFILE_HEADER_SIZE;
+
+  for (uint16_t i = 0; i < store->count; i++, p += _SBS_PROFILE_ENTRY_SIZE)
+  {
+    const sbs_profile_t *profile = &store->profile[i];
+
+    _SBSProfilePut16(&p[0], profile->serialNumber);
+    _SBSProfilePut16(&p[2], profile->manufactureDate);
+    _SBSProfilePut16(&p[4], profile->specInfo);
+    _SBSProfilePut16(&p[6], profile->deviceType);
+    _SBSProfilePut16(&p[8], profile->chemicalId);
+    p[10] = profile->pec;
+    p[11] = profile->mac;
+    p[12] = profile->auth;
+    memcpy(&p[13], profile->supported, SBS_PROFILE_CMD_BYTES);
+  }
+
+  *p = _SBSProfileCrc8(blob, len - 1);
+  return len;
+}
+
+int SBSProfileStoreDeserialize(sbs_profile_store_t *store, const uint8_t *blob, size_t len)
+{
+  if (!store || !blob)
+    return SMBUS_ERR_INVALID_ARG;
+
+  store->count = 0;
+
+  if (len < _SBS_PROFILE_HEADER_SIZE + 1 || memcmp(blob, _sbsProfileMagic, sizeof(_sbsProfileMagic)) ||
+      blob[4] != _SBS_PROFILE_BLOB_VERSION || blob[5] != _SBS_PROFILE_ENTRY_SIZE)
+    return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+  uint16_t count = _SBSProfileGet16(&blob[6]);
+  size_t blobLen = _SBS_PROFILE_HEADER_SIZE + (size_t)count * _SBS_PROFILE_ENTRY_SIZE + 1;
+
+  if (len < blobLen || _SBSProfileCrc8(blob, blobLen - 1) != blob[blobLen - 1])
+    return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+  const uint8_t *p = blob + _SBS_PROFILE_HEADER_SIZE;
+
+  for (uint16_t i = 0; i < count && store->count < store->capacity; i++, p += _SBS_PROFILE_ENTRY_SIZE)
+  {
+    sbs_profile_t *profile = &store->profile[store->count++];
+
+    memset(profile, 0, sizeof(*profile));
+    profile->serialNumber = _SBSProfileGet16(&p[0]);
+    profile->manufactureDate = _SBSProfileGet16(&p[2]);
+    profile->specInfo = _SBSProfileGet16(&p[4]);
+    profile->deviceType = _SBSProfileGet16(&p[6]);
+    profile->chemicalId = _SBSProfileGet16(&p[8]);
+    profile->pec = p[10];
+    profile->mac = (sbs_profile_mac_t)p[11];
+    profile->auth = (sbs_profile_auth_t)p[12];
+    memcpy(profile->supported, &p[13], SBS_PROFILE_CMD_BYTES);
+  }
+
+  return (store->count < count) ? SMBUS_ERR_FAIL : SMBUS_ERR_OK;
+}
+
+// Read a word without PEC, which every battery answers, so recognizing a battery doesn't first negotiate its PEC
+static int _SBSProfileReadWord(sbs_smb_battery_t *battery, uint8_t command, uint16_t *value)
+{
+  smbus_info_t info;
+
+  int ret = SBSRouteBattery(battery);
+  if (ret == SMBUS_ERR_OK)
+    ret = SMBusGetInfo(battery->bus, &info);
+  if (ret == SMBUS_ERR_OK)
+    ret = SMBusSetPec(battery->bus, false);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  ret = SMBusReadWord(battery->bus, battery->busAddress, command, value);
+  SMBusSetPec(battery->bus, info.usePEC);
+  return ret;
+}
+
+// A battery left to negotiate PEC takes what the profile knows instead of asking
+static void _SBSProfileApplyPec(sbs_smb_battery_t *battery, const sbs_profile_t *profile)
+{
+  if (battery->pec == SBS_SMB_PEC_AUTO && profile->specInfo)
+    battery->pec = profile->pec ? SBS_SMB_PEC_ON : SBS_SMB_PEC_OFF;
+}
+
+// Read a manufacturer command through the given path. Returns the first data word of the response.
+static int _SBSProfileReadMac(sbs_smb_battery_t *battery, sbs_profile_mac_t mac, uint16_t command, uint16_t *value)
+{
+  uint8_t dataBuff[1 + 256];
+
+  if (mac == SBS_PROFILE_MAC_BLOCK_ACCESS)
+  {
+    // [length][command LSB][command MSB][data LSB][data MSB]...
+    int ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_BLOCK_ACCESS, &command, sizeof(command),
+                            dataBuff, sizeof(dataBuff));
+    if (ret != SMBUS_ERR_OK)
+      return ret;
+    if (dataBuff[0] < 4 || _SBSProfileGet16(&dataBuff[1]) != command)
+      return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+    *value = _SBSProfileGet16(&dataBuff[3]);
+    return SMBUS_ERR_OK;
+  }
+
+  if (mac == SBS_PROFILE_MAC_ACCESS)
+  {
+    // [length][data LSB][data MSB]...
+    int ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_ACCESS, &command, sizeof(command),
+                            dataBuff, sizeof(dataBuff));
+    if (ret != SMBUS_ERR_OK)
+      return ret;
+    if (dataBuff[0] < 2)
+      return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+
+    *value = _SBSProfileGet16(&dataBuff[1]);
+    return SMBUS_ERR_OK;
+  }
+
+  return SMBUS_ERR_INVALID_ARG;
+}
+
+int SBSProfileProbe(sbs_smb_battery_t *battery, sbs_profile_t *profile)
+{
+  if (!battery || !battery->bus || !profile)
+    return SMBUS_ERR_INVALID_ARG;
+
+  uint8_t dataBuff[1 + 256];
+
+  memset(profile, 0, sizeof(*profile));
+
+  int ret = _SBSProfileReadWord(battery, SBS_COMMAND_SERIAL_NUMBER, &profile->serialNumber);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  ret = _SBSProfileReadWord(battery, SBS_COMMAND_MANUFACTURE_DATE, &profile->manufactureDate);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  if (_SBSProfileReadWord(battery, SBS_COMMAND_SPECIFICATION_INFO, &profile->specInfo) != SMBUS_ERR_OK)
+    profile->specInfo = 0;
+  profile->pec = SBS_SMB_SPEC_INFO_VERSION_MASK(profile->specInfo) == SBS_SMB_SPEC_INFO_VERSION_1V1_PEC;
+  _SBSProfileApplyPec(battery, profile);
+
+  // Optional commands simply don't answer
+  for (uint16_t code = 0; code < SBS_SMB_CMD_CODE_MAX; code++)
+  {
+    if (SBSIsReadCommand(battery, code) && SBSRunCommand(battery, code, NULL, 0, dataBuff, sizeof(dataBuff)) == SMBUS_ERR_OK)
+      profile->supported[code / 8] |= 1 << (code % 8);
+  }
+
+  // The path that returns DeviceType() is the one to use for the rest of the manufacturer commands
+  if (_SBSProfileReadMac(battery, SBS_PROFILE_MAC_BLOCK_ACCESS, SBS_BQ_COMMAND_DEVICE_TYPE, &profile->deviceType) == SMBUS_ERR_OK)
+    profile->mac = SBS_PROFILE_MAC_BLOCK_ACCESS;
+  else if (_SBSProfileReadMac(battery, SBS_PROFILE_MAC_ACCESS, SBS_BQ_COMMAND_DEVICE_TYPE, &profile->deviceType) == SMBUS_ERR_OK)
+    profile->mac = SBS_PROFILE_MAC_ACCESS;
+  else
+    profile->deviceType = 0;
+
+  if (profile->mac != SBS_PROFILE_MAC_NONE &&
+      _SBSProfileReadMac(battery, profile->mac, SBS_BQ_COMMAND_CHEMICAL_ID, &profile->chemicalId) != SMBUS_ERR_OK)
+    profile->chemicalId = 0;
+
+  profile->changed = true;
+  return SMBUS_ERR_OK;
+}
+
+int SBSProfileGet(sbs_smb_battery_t *battery, sbs_profile_store_t *store, sbs_profile_t **profile)
+{
+  if (!battery || !battery->bus || !store || !profile)
+    return SMBUS_ERR_INVALID_ARG;
+
+  uint16_t serialNumber, manufactureDate;
+
+  int ret = _SBSProfileReadWord(battery, SBS_COMMAND_SERIAL_NUMBER, &serialNumber);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  ret = _SBSProfileReadWord(battery, SBS_COMMAND_MANUFACTURE_DATE, &manufactureDate);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  *profile = SBSProfileStoreFind(store, serialNumber, manufactureDate);
+  if (!*profile)
+  {
+    sbs_profile_t probed;
+
+    ret = SBSProfileProbe(battery, &probed);
+    if (ret != SMBUS_ERR_OK)
+      return ret;
+
+    *profile = SBSProfileStorePut(store, &probed);
+    if (!*profile)
+      return SMBUS_ERR_FAIL;
+  }
+
+  _SBSProfileApplyPec(battery, *profile);
+  if (!battery->cmdSet && (*profile)->deviceType)
+    battery->cmdSet = SBSFindCommandSet((*profile)->deviceType);
+  return SMBUS_ERR_OK;
+}
+
+bool SBSProfileSupports(const sbs_profile_t *profile, sbs_smb_cmd_code_t code)
+{
+  return profile && code < SBS_SMB_CMD_CODE_MAX && (profile->supported[code / 8] & (1 << (code % 8)));
+}
+
+static int _SBSProfileRunAccess(sbs_bq_access_t *access)
+{
+  while (SBSBqAccessStep(access))
+    SMBusPlatformDelayMs(access->waitMs);
+
+  return access->result;
+}
+
+int SBSProfileAccess(sbs_smb_battery_t *battery, sbs_profile_t *profile, uint8_t accessCmd,
+                     uint8_t *sha1Key, uint16_t *key)
+{
+  if (!profile || (!sha1Key && !key))
+    return SMBUS_ERR_INVALID_ARG;
+
+  bool block = profile->mac == SBS_PROFILE_MAC_BLOCK_ACCESS;
+  sbs_bq_access_t access;
+  int ret = SMBUS_ERR_INVALID_ARG;
+
+  if (sha1Key && profile->auth != SBS_PROFILE_AUTH_TWO_WORD_KEY)
+  {
+    SBSBqAccessInitSha1Hmac(&access, battery, accessCmd, sha1Key, block);
+    ret = _SBSProfileRunAccess(&access);
+    if (ret == SMBUS_ERR_OK || profile->auth == SBS_PROFILE_AUTH_SHA1_HMAC)
+    {
+      if (ret == SMBUS_ERR_OK && profile->auth != SBS_PROFILE_AUTH_SHA1_HMAC)
+      {
+        profile->auth = SBS_PROFILE_AUTH_SHA1_HMAC;
+        profile->changed = true;
+      }
+      return ret;
+    }
+  }
+
+  if (key && profile->auth != SBS_PROFILE_AUTH_SHA1_HMAC)
+  {
+    SBSBqAccessInit2WordKey(&access, battery, accessCmd, key, block);
+    ret = _SBSProfileRunAccess(&access);
+    if (ret == SMBUS_ERR_OK && profile->auth != SBS_PROFILE_AUTH_TWO_WORD_KEY)
+    {
+      profile->auth = SBS_PROFILE_AUTH_TWO_WORD_KEY;
+      profile->changed = true;
+    }
+  }
+
+  return ret;
+}
+
+int SBSProfileSeal(sbs_smb_battery_t *battery, const sbs_profile_t *profile)
+{
+  if (!profile)
+    return SMBUS_ERR_INVALID_ARG;
+
+  sbs_bq_access_t access;
+
+  SBSBqAccessInitSeal(&access, battery, profile->mac == SBS_PROFILE_MAC_BLOCK_ACCESS);
+  return _SBSProfileRunAccess(&access);
+}
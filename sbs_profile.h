@@ -0,0 +1,111 @@
+/**
+ *
+ * @file:   sbs_profile.h - Probe-once device profiles: what a battery supports and how to talk to it
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * The first time a battery is seen, SBSProfileGet() probes it for:
+ *  - The optional SBS commands it answers
+ *  - PEC support, from the version in SpecificationInfo(). A battery set to SBS_SMB_PEC_AUTO uses it without asking.
+ *  - Whether manufacturer commands go through ManufacturerBlockAccess() or ManufacturerAccess()
+ *  - DeviceType() and ChemicalID() through that path
+ * SBSProfileAccess() then records which authentication method unsealed it the first time.
+ *
+ * Profiles are kept in a store keyed by SerialNumber() and ManufactureDate(), which serializes to a blob that
+ * platform/sbs_profile_file.c or platform/sbs_profile_nvs.c keep across restarts. A battery with a stored profile
+ * costs two word reads to recognize and is never probed again.
+ *
+ * */
+
+#ifndef _SBS_PROFILE_H_
+#define _SBS_PROFILE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sbs_smb.h"
+
+#define SBS_PROFILE_CMD_BYTES                           ((SBS_SMB_CMD_CODE_MAX + 7) / 8)
+
+typedef enum
+{
+  SBS_PROFILE_MAC_NONE = 0,         // No manufacturer commands
+  SBS_PROFILE_MAC_ACCESS,           // ManufacturerAccess() and ManufacturerData()
+  SBS_PROFILE_MAC_BLOCK_ACCESS,     // ManufacturerBlockAccess()
+} sbs_profile_mac_t;
+
+typedef enum
+{
+  SBS_PROFILE_AUTH_UNKNOWN = 0,
+  SBS_PROFILE_AUTH_SHA1_HMAC,
+  SBS_PROFILE_AUTH_TWO_WORD_KEY,
+} sbs_profile_auth_t;
+
+typedef struct
+{
+  uint16_t serialNumber;
+  uint16_t manufactureDate;         // Raw ManufactureDate()
+  uint16_t specInfo;                // Raw SpecificationInfo(), 0 if it didn't answer
+  uint16_t deviceType;              // DeviceType(), 0 if unknown
+  uint16_t chemicalId;              // ChemicalID(), 0 if unknown
+  bool pec;
+  sbs_profile_mac_t mac;
+  sbs_profile_auth_t auth;
+  uint8_t supported[SBS_PROFILE_CMD_BYTES];   // Bit per sbs_smb_cmd_code_t that answered a read
+
+  bool changed;                     // Learned something since the store was last saved. Not serialized.
+} sbs_profile_t;
+
+typedef struct
+{
+  sbs_profile_t *profile;
+  uint16_t capacity;
+  uint16_t count;
+} sbs_profile_store_t;
+
+void SBSProfileStoreInit(sbs_profile_store_t *store, sbs_profile_t profile[], uint16_t capacity);
+
+sbs_profile_t *SBSProfileStoreFind(sbs_profile_store_t *store, uint16_t serialNumber, uint16_t manufactureDate);
+
+/// @brief Add a profile, replacing the one stored for the same battery
+/// @return The stored copy, NULL if the store is full
+sbs_profile_t *SBSProfileStorePut(sbs_profile_store_t *store, const sbs_profile_t *profile);
+
+/// @brief Whether any profile changed since the store was loaded or last saved
+bool SBSProfileStoreChanged(const sbs_profile_store_t *store);
+
+/// @brief Mark every profile as saved
+void SBSProfileStoreSaved(sbs_profile_store_t *store);
+
+/// @brief Bytes SBSProfileStoreSerialize() needs for the store as it is
+size_t SBSProfileStoreBlobSize(const sbs_profile_store_t *store);
+
+/// @return The number of bytes written to blob, 0 if it is too small
+size_t SBSProfileStoreSerialize(const sbs_profile_store_t *store, uint8_t *blob, size_t size);
+
+/// @brief Replace the contents of the store with a serialized one
+/// @return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED if the blob is corrupt or from a different version, leaving the
+///         store empty. SMBUS_ERR_FAIL if it has more profiles than the store holds; the ones that fit are kept.
+int SBSProfileStoreDeserialize(sbs_profile_store_t *store, const uint8_t *blob, size_t len);
+
+/// @brief Probe a battery from scratch
+/// @return An error only if the battery doesn't answer SerialNumber() and ManufactureDate()
+int SBSProfileProbe(sbs_smb_battery_t *battery, sbs_profile_t *profile);
+
+/// @brief Look the battery up in the store, and probe and add it if it isn't there. A battery without a command
+///        set is bound to the one registered for its DeviceType(), if any.
+/// @param profile Set to the stored profile
+int SBSProfileGet(sbs_smb_battery_t *battery, sbs_profile_store_t *store, sbs_profile_t **profile);
+
+bool SBSProfileSupports(const sbs_profile_t *profile, sbs_smb_cmd_code_t code);
+
+/// @brief UNSEAL or FULL ACCESS with the method that worked before. The first time, try the SHA1 key and then
+///        the two-word key, and record the one that worked. Either key may be NULL.
+int SBSProfileAccess(sbs_smb_battery_t *battery, sbs_profile_t *profile, uint8_t accessCmd,
+                     uint8_t *sha1Key, uint16_t *key);
+
+/// @brief SBSBqSeal() through the MAC path of the profile
+int SBSProfileSeal(sbs_smb_battery_t *battery, const sbs_profile_t *profile);
+
+#endif
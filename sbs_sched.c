@@ -0,0 +1,172 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "platform/smbus_platform.h"
+#include "sbs_sched.h"
+#include "sbs_mux.h"
+
+// Two batteries are the same gauge if they are reached at the same address over the same route
+static bool _SBSSchedSameGauge(const sbs_smb_battery_t *a, const sbs_smb_battery_t *b)
+{
+  return a == b || (a->bus == b->bus && a->busAddress == b->busAddress && a->mux == b->mux &&
+                    (!a->mux || a->muxChannel == b->muxChannel));
+}
+
+// Whether the bus already reaches the battery without switching a mux channel or selector battery
+static bool _SBSSchedRouted(const sbs_smb_battery_t *battery)
+{
+  return !battery->mux || battery->mux->activeChannel == battery->muxChannel;
+}
+
+static void _SBSSchedFinish(sbs_sched_job_t *job, int result)
+{
+  job->result = result;
+  job->state = (result == SMBUS_ERR_OK) ? SBS_SCHED_JOB_DONE : SBS_SCHED_JOB_FAILED;
+}
+
+void SBSSchedInit(sbs_sched_t *sched, sbs_sched_job_t job[], uint16_t capacity)
+{
+  if (!sched)
+    return;
+
+  memset(sched, 0, sizeof(*sched));
+  sched->job = job;
+  sched->capacity = job ? capacity : 0;
+}
+
+void SBSSchedReset(sbs_sched_t *sched)
+{
+  if (!sched)
+    return;
+
+  sched->count = 0;
+  sched->first = 0;
+  sched->waitMs = 0;
+}
+
+sbs_sched_job_t *SBSSchedAdd(sbs_sched_t *sched, sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code,
+                             uint16_t subCommand, uint16_t delayMs, void *outPtr, size_t outSize)
+{
+  if (!sched || !battery || sched->count >= sched->capacity || (outPtr && !outSize))
+    return NULL;
+
+  sbs_smb_cmd_t cmd;
+
+  // An unknown command fails when it is run. One with more output than outSize holds is refused now, as
+  // SBSRunCommand() would refuse it, rather than decoded past the end of outPtr when it is collected.
+  if (SBSGetCommand(battery, code, &cmd) == SMBUS_ERR_OK)
+  {
+    if (outPtr && cmd.outSize && outSize < cmd.outSize)
+      return NULL;
+    if (!delayMs)
+      delayMs = cmd.readWriteDelayMs;
+  }
+
+  sbs_sched_job_t *job = &sched->job[sched->count++];
+
+  memset(job, 0, sizeof(*job));
+  job->battery = battery;
+  job->code = code;
+  job->subCommand = subCommand;
+  job->delayMs = delayMs;
+  job->outPtr = outPtr;
+  job->outSize = outSize;
+  job->state = SBS_SCHED_JOB_QUEUED;
+  return job;
+}
+
+bool SBSSchedPoll(sbs_sched_t *sched)
+{
+  if (!sched)
+    return false;
+
+  uint32_t now = SMBusPlatformMillis();
+  sbs_sched_job_t *due = NULL;
+  sbs_sched_job_t *next = NULL;
+  bool pending = false;
+
+  sched->waitMs = 0;
+
+  while (sched->first < sched->count && sched->job[sched->first].state >= SBS_SCHED_JOB_DONE)
+    sched->first++;
+
+  // Find the response due first and the oldest job that can be started
+  for (uint16_t i = sched->first; i < sched->count; i++)
+  {
+    sbs_sched_job_t *job = &sched->job[i];
+
+    if (job->state == SBS_SCHED_JOB_WAITING)
+    {
+      pending = true;
+      // Unsigned differences keep the ordering right across a wrap around of the millisecond count
+      if (!due || (int32_t)(job->dueMs - due->dueMs) < 0)
+        due = job;
+    }
+    else if (job->state == SBS_SCHED_JOB_QUEUED)
+    {
+      pending = true;
+      if (next && _SBSSchedRouted(next->battery))
+        continue;
+
+      // Earlier unfinished jobs for the same gauge go first
+      bool blocked = false;
+      for (uint16_t j = sched->first; j < i && !blocked; j++)
+        blocked = sched->job[j].state < SBS_SCHED_JOB_DONE && _SBSSchedSameGauge(sched->job[j].battery, job->battery);
+
+      // A later job that needs no switch goes before the oldest one that does
+      if (!blocked && (!next || _SBSSchedRouted(job->battery)))
+        next = job;
+    }
+  }
+
+  if (!pending)
+    return false;
+
+  if (due && (int32_t)(now - due->dueMs) >= 0)
+  {
+    _SBSSchedFinish(due, SBSCollectCommand(due->battery, due->code, due->outPtr, due->outSize));
+    return true;
+  }
+
+  if (next)
+  {
+    if (!SBSIsSplitCommand(next->battery, next->code))
+    {
+      _SBSSchedFinish(next, SBSRunCommand(next->battery, next->code, NULL, 0, next->outPtr, next->outSize));
+      return true;
+    }
+
+    int ret = SBSSubmitCommand(next->battery, next->code, next->subCommand);
+    if (ret != SMBUS_ERR_OK)
+      _SBSSchedFinish(next, ret);
+    else
+    {
+      next->state = SBS_SCHED_JOB_WAITING;
+      next->dueMs = SMBusPlatformMillis() + next->delayMs;
+    }
+    return true;
+  }
+
+  // Nothing can run until the next response is due
+  sched->waitMs = (uint32_t)(due->dueMs - now);
+  return true;
+}
+
+uint16_t SBSSchedRun(sbs_sched_t *sched)
+{
+  uint16_t failed = 0;
+
+  if (!sched)
+    return 0;
+
+  while (SBSSchedPoll(sched))
+  {
+    if (sched->waitMs)
+      SMBusPlatformDelayMs(sched->waitMs);
+  }
+
+  for (uint16_t i = 0; i < sched->count; i++)
+    failed += (sched->job[i].state == SBS_SCHED_JOB_FAILED);
+
+  return failed;
+}
@@ -0,0 +1,82 @@
+/**
+ *
+ * @file:   sbs_sched.h - Scheduler that overlaps the response delays of ManufacturerAccess() style commands
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * A MAC read writes a subcommand, waits for the gauge to prepare the response and then reads it. Run through
+ * SBSRunCommand() the bus sits idle for the whole wait. The scheduler runs the two halves as separate jobs
+ * with SBSSubmitCommand() and SBSCollectCommand(), and serves other jobs on the bus in between:
+ *  - A job whose response is due is collected first.
+ *  - Otherwise the oldest queued job is started, unless its gauge still has a response outstanding. A gauge
+ *    only holds one MAC response at a time, so its jobs are run in the order they were added.
+ *  - Jobs for batteries the mux or selector already routes to are started before those that need a switch.
+ *  - Plain reads, e.g. Voltage(), are run in one go whenever the bus is free.
+ *
+ * Jobs can be for batteries on different mux channels of the same bus. While jobs are outstanding the scheduler
+ * has to be the only one writing to their gauges, or the responses will be overwritten.
+ *
+ * */
+
+#ifndef _SBS_SCHED_H_
+#define _SBS_SCHED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sbs_smb.h"
+
+typedef enum
+{
+  SBS_SCHED_JOB_QUEUED = 0,
+  SBS_SCHED_JOB_WAITING,            // Submitted, response not due yet
+  SBS_SCHED_JOB_DONE,
+  SBS_SCHED_JOB_FAILED,
+} sbs_sched_job_state_t;
+
+typedef struct
+{
+  sbs_smb_battery_t *battery;
+  sbs_smb_cmd_id_t code;
+  uint16_t subCommand;              // Written by split commands, see SBSIsSplitCommand()
+  uint16_t delayMs;                 // Between submitting and collecting a split command
+  void *outPtr;
+  size_t outSize;
+
+  sbs_sched_job_state_t state;
+  int result;
+  uint32_t dueMs;                   // Scheduler time the response can be collected
+} sbs_sched_job_t;
+
+typedef struct
+{
+  sbs_sched_job_t *job;
+  uint16_t capacity;
+  uint16_t count;
+  uint16_t first;                   // Jobs before this one are all finished
+  uint32_t waitMs;                  // Set by SBSSchedPoll(): time until the next job can run
+} sbs_sched_t;
+
+/// @param job      Storage for up to capacity jobs
+void SBSSchedInit(sbs_sched_t *sched, sbs_sched_job_t job[], uint16_t capacity);
+
+/// @brief Drop all jobs, e.g. to reuse the scheduler for the next round of reads
+void SBSSchedReset(sbs_sched_t *sched);
+
+/// @brief Queue a job. outPtr and outSize are as for SBSRunCommand() and must stay valid until the job is finished.
+/// @param subCommand Ignored for commands that aren't split, and for chip commands that have their own
+/// @param delayMs    0 for the delay in the table entry of the command
+/// @return The job, NULL if the scheduler is full or outSize is smaller than the output of the command
+sbs_sched_job_t *SBSSchedAdd(sbs_sched_t *sched, sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code,
+                             uint16_t subCommand, uint16_t delayMs, void *outPtr, size_t outSize);
+
+/// @brief Run at most one bus transaction and return without sleeping, for event loops
+/// @return false once every job is finished. Otherwise sched->waitMs is how long until there is work to do.
+bool SBSSchedPoll(sbs_sched_t *sched);
+
+/// @brief Poll until every job is finished, sleeping only when no job can run
+/// @return The number of failed jobs
+uint16_t SBSSchedRun(sbs_sched_t *sched);
+
+#endif
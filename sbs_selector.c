@@ -0,0 +1,88 @@
+#include <stdint.h>
+
+#include "sbs_selector.h"
+
+// The battery the SMB nibble connects, SBS_MUX_CHANNEL_UNKNOWN unless exactly one bit is set
+static int8_t _SBSSelectorChannel(uint8_t smb)
+{
+  for (int8_t i = 0; i < SBS_SELECTOR_MAX_BATTERIES; i++)
+    if (smb == (1 << i))
+      return i;
+
+  return SBS_MUX_CHANNEL_UNKNOWN;
+}
+
+static int _SBSSelectorRead(sbs_mux_t *selector, uint8_t command, uint16_t *value)
+{
+  if (!selector || !selector->bus || selector->type != SBS_MUX_TYPE_SELECTOR || !value)
+    return SMBUS_ERR_INVALID_ARG;
+
+  smbus_info_t info;
+
+  // The selector is addressed without PEC, as when it is switched by SBSMuxSelect(), and the bus setting kept
+  int ret = SMBusGetInfo(selector->bus, &info);
+  if (ret == SMBUS_ERR_OK)
+    ret = SMBusSetPec(selector->bus, false);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  ret = SMBusReadWord(selector->bus, selector->busAddress, command, value);
+  SMBusSetPec(selector->bus, info.usePEC);
+  return ret;
+}
+
+void SBSSelectorInit(sbs_mux_t *selector, smbus_handle_t bus, uint8_t busAddress)
+{
+  if (!selector)
+    return;
+
+  SBSMuxInit(selector, bus, busAddress, NULL);
+  selector->type = SBS_MUX_TYPE_SELECTOR;
+}
+
+int SBSSelectorReadState(sbs_mux_t *selector, sbs_selector_state_t *state)
+{
+  uint16_t value;
+
+  if (!state)
+    return SMBUS_ERR_INVALID_ARG;
+
+  int ret = _SBSSelectorRead(selector, SBS_SELECTOR_COMMAND_STATE, &value);
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  state->smb = (value >> SBS_SELECTOR_SMB_SHIFT) & SBS_SELECTOR_NIBBLE_MASK;
+  state->powerBy = (value >> SBS_SELECTOR_POWER_BY_SHIFT) & SBS_SELECTOR_NIBBLE_MASK;
+  state->charge = (value >> SBS_SELECTOR_CHARGE_SHIFT) & SBS_SELECTOR_NIBBLE_MASK;
+  state->present = (value >> SBS_SELECTOR_PRESENT_SHIFT) & SBS_SELECTOR_NIBBLE_MASK;
+  selector->activeChannel = _SBSSelectorChannel(state->smb);
+  return SMBUS_ERR_OK;
+}
+
+int SBSSelectorWriteState(sbs_mux_t *selector, const sbs_selector_state_t *state)
+{
+  if (!selector || !selector->bus || selector->type != SBS_MUX_TYPE_SELECTOR || !state)
+    return SMBUS_ERR_INVALID_ARG;
+
+  uint16_t value = ((state->smb & SBS_SELECTOR_NIBBLE_MASK) << SBS_SELECTOR_SMB_SHIFT) |
+                   ((state->powerBy & SBS_SELECTOR_NIBBLE_MASK) << SBS_SELECTOR_POWER_BY_SHIFT) |
+                   ((state->charge & SBS_SELECTOR_NIBBLE_MASK) << SBS_SELECTOR_CHARGE_SHIFT);
+
+  smbus_info_t info;
+
+  int ret = SMBusGetInfo(selector->bus, &info);
+  if (ret == SMBUS_ERR_OK && (ret = SMBusSetPec(selector->bus, false)) == SMBUS_ERR_OK)
+  {
+    ret = SMBusWriteWord(selector->bus, selector->busAddress, SBS_SELECTOR_COMMAND_STATE, value);
+    SMBusSetPec(selector->bus, info.usePEC);
+  }
+
+  // If the write failed the SMB nibble is unknown, so make sure the next select is sent
+  selector->activeChannel = (ret == SMBUS_ERR_OK) ? _SBSSelectorChannel(state->smb) : SBS_MUX_CHANNEL_UNKNOWN;
+  return ret;
+}
+
+int SBSSelectorReadInfo(sbs_mux_t *selector, uint16_t *info)
+{
+  return _SBSSelectorRead(selector, SBS_SELECTOR_COMMAND_INFO, info);
+}
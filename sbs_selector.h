@@ -0,0 +1,65 @@
+/**
+ *
+ * @file:   sbs_selector.h - Smart Battery Selector for systems with several packs
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * A Smart Battery Selector (address 0x0A) connects the SMBus, the system power and the charger to one of up to four
+ * batteries, all at the same address. SelectorState() holds one nibble for each, bit n for battery n:
+ *
+ *  [15:12 SMB][11:8 POWER_BY][7:4 CHARGE][3:0 PRESENT]
+ *
+ * A selector is a kind of sbs_mux_t whose channels are its batteries. Set a battery's mux to the selector and its
+ * muxChannel to the battery number, and SBSRunCommand() switches the SMB nibble to it when needed, like it enables
+ * a mux channel. Everything built on muxes groups by selector battery the same way: SBSMuxGetBatteryInfo() reads
+ * each battery with one switch, and the scheduler runs the jobs for the battery already selected before those
+ * that need a switch.
+ *
+ * */
+
+#ifndef _SBS_SELECTOR_H_
+#define _SBS_SELECTOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sbs_smb.h"
+#include "sbs_mux.h"
+
+#define SBS_SELECTOR_DEFAULT_ADDRESS                    0x0A
+
+#define SBS_SELECTOR_COMMAND_STATE                      0x01
+#define SBS_SELECTOR_COMMAND_PRESETS                    0x02
+#define SBS_SELECTOR_COMMAND_INFO                       0x04
+
+#define SBS_SELECTOR_MAX_BATTERIES                      4
+#define SBS_SELECTOR_NIBBLE_MASK                        0x0F
+
+// Position of each nibble in SelectorState()
+#define SBS_SELECTOR_SMB_SHIFT                          12
+#define SBS_SELECTOR_POWER_BY_SHIFT                     8
+#define SBS_SELECTOR_CHARGE_SHIFT                       4
+#define SBS_SELECTOR_PRESENT_SHIFT                      0
+
+// SelectorState(), bit n of each nibble for battery n
+typedef struct
+{
+  uint8_t smb;                  // Connected to the SMBus
+  uint8_t powerBy;              // Powering the system
+  uint8_t charge;               // Connected to the charger
+  uint8_t present;              // Read only
+} sbs_selector_state_t;
+
+/// @brief Initialize a selector as a mux. It shouldn't share a ring with other muxes since it can't be disabled.
+void SBSSelectorInit(sbs_mux_t *selector, smbus_handle_t bus, uint8_t busAddress);
+
+/// @brief Read SelectorState(). The SMB nibble also updates which battery the selector is known to have selected.
+int SBSSelectorReadState(sbs_mux_t *selector, sbs_selector_state_t *state);
+
+/// @brief Write the SMB, POWER_BY and CHARGE nibbles of SelectorState(). PRESENT is ignored.
+int SBSSelectorWriteState(sbs_mux_t *selector, const sbs_selector_state_t *state);
+
+/// @param info     SelectorInfo(), with the batteries the selector supports in the low nibble
+int SBSSelectorReadInfo(sbs_mux_t *selector, uint16_t *info);
+
+#endif
@@ -1,286 +1,341 @@
+#include <stdio.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 
 #include "sbs_smb.h"
 #include "sbs_bq.h"
+#include "sbs_mux.h"
+#include "sbs_cache.h"
+#include "sbs_units.h"
 
 #define MIN(x,y)	((x < y) ? x : y)
 
 static void _SBSParseBatteryMode(void *inPtr, size_t inSize, void *outPtr, size_t outSize);
+#ifndef SBS_SMB_EXCLUDE_AT_RATE
 static void _SBSParseAtRateOk(void *inPtr, size_t inSize, void *outPtr, size_t outSize);
-static void _SBSParseTemperature(void *inPtr, size_t inSize, void *outPtr, size_t outSize);
+#endif
 static void _SBSParseBatteryStatus(void *inPtr, size_t inSize, void *outPtr, size_t outSize);
 static void _SBSParseSpecificationInfo(void *inPtr, size_t inSize, void *outPtr, size_t outSize);
 static void _SBSParseManufactureDate(void *inPtr, size_t inSize, void *outPtr, size_t outSize);
 
-static sbs_smb_cmd_t cmdLUT[] =
+// Indexed by sbs_smb_cmd_code_t. Entries that were left out of the build are all zero.
+static const sbs_smb_cmd_t cmdLUT[SBS_SMB_CMD_CODE_MAX] SBS_SMB_CMD_TABLE_ATTR =
 {
-	{// SBS_SMB_CMD_CODE_MANUFACTURER_ACCESS
-
+#ifndef SBS_SMB_EXCLUDE_MANUFACTURER
+	[SBS_SMB_CMD_CODE_MANUFACTURER_ACCESS] =
+	{
 		.writeCommand = SBS_COMMAND_MANUFACTURER_ACCESS,
 		.readCommand = SBS_COMMAND_MANUFACTURER_DATA,
 		.writeReadProtocol = SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_READ_BLOCK,
 		.inSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_MANUFACTURER_BLOCK_ACCESS
-
+	[SBS_SMB_CMD_CODE_MANUFACTURER_BLOCK_ACCESS] =
+	{
 		.writeCommand = SBS_BQ_COMMAND_MANUFACTURER_BLOCK_ACCESS,
 		.readCommand = SBS_BQ_COMMAND_MANUFACTURER_BLOCK_ACCESS,
 		.writeReadProtocol = SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_BLOCK_READ_BLOCK,
 		.inSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_REMAINING_CAPACITY_ALARM
-
+#endif
+#ifndef SBS_SMB_EXCLUDE_ALARMS
+	[SBS_SMB_CMD_CODE_REMAINING_CAPACITY_ALARM] =
+	{
 		.writeCommand = SBS_COMMAND_REMAINING_CAPACITY_ALARM,
 		.readCommand = SBS_COMMAND_REMAINING_CAPACITY_ALARM,
 		.writeProtocol = SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.inSize	= sizeof(uint16_t),
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_REMAINING_TIME_ALARM
-
+	[SBS_SMB_CMD_CODE_REMAINING_TIME_ALARM] =
+	{
 		.writeCommand = SBS_COMMAND_REMAINING_TIME_ALARM,
 		.readCommand = SBS_COMMAND_REMAINING_TIME_ALARM,
 		.writeProtocol = SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.inSize	= sizeof(uint16_t),
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_BATTERY_MODE
-
+#endif
+	[SBS_SMB_CMD_CODE_BATTERY_MODE] =
+	{
 		.writeCommand = SBS_COMMAND_BATTERY_MODE,
 		.readCommand = SBS_COMMAND_BATTERY_MODE,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
-		.writeProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
+		.writeProtocol = SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD,
+		.inSize	= sizeof(uint16_t),
 		.outSize = sizeof(sbs_smb_battery_mode_t),
 		.retFunc = _SBSParseBatteryMode,
-
 	},
-	{// SBS_SMB_CMD_CODE_AT_RATE
-
+#ifndef SBS_SMB_EXCLUDE_AT_RATE
+	[SBS_SMB_CMD_CODE_AT_RATE] =
+	{
 		.writeCommand = SBS_COMMAND_AT_RATE,
 		.readCommand = SBS_COMMAND_AT_RATE,
 		.writeProtocol = SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.inSize	= sizeof(int16_t),
 		.outSize	= sizeof(int16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_AT_RATE_TIME_TO_FULL
-
+	[SBS_SMB_CMD_CODE_AT_RATE_TIME_TO_FULL] =
+	{
 		.readCommand = SBS_COMMAND_AT_RATE_TIME_TO_FULL,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_AT_RATE_TIME_TO_EMPTY
-
+	[SBS_SMB_CMD_CODE_AT_RATE_TIME_TO_EMPTY] =
+	{
 		.readCommand = SBS_COMMAND_AT_RATE_TIME_TO_EMPTY,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_AT_RATE_OK
-
+	[SBS_SMB_CMD_CODE_AT_RATE_OK] =
+	{
 		.readCommand = SBS_COMMAND_AT_RATE_OK,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(bool),
 		.retFunc = _SBSParseAtRateOk,
-
 	},
-	{// SBS_SMB_CMD_CODE_TEMPERATURE
-
-		.writeCommand = SBS_COMMAND_TEMPERATURE,
+#endif
+	[SBS_SMB_CMD_CODE_TEMPERATURE] =
+	{
+		.readCommand = SBS_COMMAND_TEMPERATURE,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
-		.outSize	= sizeof(float),
-		.retFunc = _SBSParseTemperature,
-
+		.outSize	= sizeof(uint16_t),
 	},
-	{// SBS_SMB_CMD_CODE_VOLTAGE
-
+	[SBS_SMB_CMD_CODE_VOLTAGE] =
+	{
 		.readCommand = SBS_COMMAND_VOLTAGE,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_CURRENT
-
+	[SBS_SMB_CMD_CODE_CURRENT] =
+	{
 		.readCommand = SBS_COMMAND_CURRENT,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(int16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_AVERAGE_CURRENT
-
+	[SBS_SMB_CMD_CODE_AVERAGE_CURRENT] =
+	{
 		.readCommand = SBS_COMMAND_AVERAGE_CURRENT,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(int16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_MAX_ERROR
-
+	[SBS_SMB_CMD_CODE_MAX_ERROR] =
+	{
 		.readCommand = SBS_COMMAND_MAX_ERROR,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_RELATIVE_STATE_OF_CHARGE
-
+	[SBS_SMB_CMD_CODE_RELATIVE_STATE_OF_CHARGE] =
+	{
 		.readCommand = SBS_COMMAND_RELATIVE_STATE_OF_CHARGE,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_ABSOLUTE_STATE_OF_CHARGE
-
+	[SBS_SMB_CMD_CODE_ABSOLUTE_STATE_OF_CHARGE] =
+	{
 		.readCommand = SBS_COMMAND_ABSOLUTE_STATE_OF_CHARGE,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_REMAINING_CAPACITY
-
+	[SBS_SMB_CMD_CODE_REMAINING_CAPACITY] =
+	{
 		.readCommand = SBS_COMMAND_REMAINING_CAPACITY,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_FULL_CHARGE_CAPACITY
-
+	[SBS_SMB_CMD_CODE_FULL_CHARGE_CAPACITY] =
+	{
 		.readCommand = SBS_COMMAND_FULL_CHARGE_CAPACITY,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_RUN_TIME_TO_EMPTY
-
+	[SBS_SMB_CMD_CODE_RUN_TIME_TO_EMPTY] =
+	{
 		.readCommand = SBS_COMMAND_RUN_TIME_TO_EMPTY,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_AVERAGE_TIME_TO_EMPTY
-
+	[SBS_SMB_CMD_CODE_AVERAGE_TIME_TO_EMPTY] =
+	{
 		.readCommand = SBS_COMMAND_AVERAGE_TIME_TO_EMPTY,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_AVERAGE_TIME_TO_FULL
-
+	[SBS_SMB_CMD_CODE_AVERAGE_TIME_TO_FULL] =
+	{
 		.readCommand = SBS_COMMAND_AVERAGE_TIME_TO_FULL,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_BATTERY_STATUS
-
+	[SBS_SMB_CMD_CODE_BATTERY_STATUS] =
+	{
 		.readCommand = SBS_COMMAND_BATTERY_STATUS,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize = sizeof(sbs_smb_battery_state_t),
 		.retFunc = _SBSParseBatteryStatus,
-
 	},
-	{// SBS_SMB_CMD_CODE_CYCLE_COUNT
-
+	[SBS_SMB_CMD_CODE_CYCLE_COUNT] =
+	{
 		.readCommand = SBS_COMMAND_CYCLE_COUNT,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_DESIGN_CAPACITY
-
+	[SBS_SMB_CMD_CODE_DESIGN_CAPACITY] =
+	{
 		.readCommand = SBS_COMMAND_DESIGN_CAPACITY,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_DESIGN_VOLTAGE
-
+	[SBS_SMB_CMD_CODE_DESIGN_VOLTAGE] =
+	{
 		.readCommand = SBS_COMMAND_DESIGN_VOLTAGE,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_SPECIFICATION_INFO
-
+	[SBS_SMB_CMD_CODE_SPECIFICATION_INFO] =
+	{
 		.readCommand = SBS_COMMAND_SPECIFICATION_INFO,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(sbs_smb_spec_info_t),
 		.retFunc = _SBSParseSpecificationInfo,
-
 	},
-	{// SBS_SMB_CMD_CODE_MANUFACTURE_DATE
-
+	[SBS_SMB_CMD_CODE_MANUFACTURE_DATE] =
+	{
 		.readCommand = SBS_COMMAND_MANUFACTURE_DATE,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(sbs_smb_date_t),
 		.retFunc = _SBSParseManufactureDate,
-
 	},
-	{// SBS_SMB_CMD_CODE_SERIAL_NUMBER
-
+	[SBS_SMB_CMD_CODE_SERIAL_NUMBER] =
+	{
 		.readCommand = SBS_COMMAND_SERIAL_NUMBER,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_MANUFACTURER_NAME
-
+#ifndef SBS_SMB_EXCLUDE_STRINGS
+	[SBS_SMB_CMD_CODE_MANUFACTURER_NAME] =
+	{
 		.readCommand = SBS_COMMAND_MANUFACTURER_NAME,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_BLOCK_READ,
-
 	},
-	{// SBS_SMB_CMD_CODE_DEVICE_NAME
-
+	[SBS_SMB_CMD_CODE_DEVICE_NAME] =
+	{
 		.readCommand = SBS_COMMAND_DEVICE_NAME,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_BLOCK_READ,
-
 	},
-	{// SBS_SMB_CMD_CODE_DEVICE_CHEMISTRY
-
+	[SBS_SMB_CMD_CODE_DEVICE_CHEMISTRY] =
+	{
 		.readCommand = SBS_COMMAND_DEVICE_CHEMISTRY,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_BLOCK_READ,
-
 	},
-	{// SBS_SMB_CMD_CODE_MANUFACTURER_DATA
-
+#endif
+#ifndef SBS_SMB_EXCLUDE_MANUFACTURER
+	[SBS_SMB_CMD_CODE_MANUFACTURER_DATA] =
+	{
 		.writeCommand = SBS_COMMAND_MANUFACTURER_DATA,
 		.readCommand = SBS_COMMAND_MANUFACTURER_DATA,
 		.writeProtocol = SBS_SMB_SMBUS_PROTOCOL_BLOCK_READ,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_BLOCK_READ,
-
 	},
-	{// SBS_SMB_CMD_CODE_CHARGING_CURRENT
-
+#endif
+	[SBS_SMB_CMD_CODE_CHARGING_CURRENT] =
+	{
 		.readCommand = SBS_COMMAND_CHARGING_CURRENT,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_CHARGING_VOLTAGE
-
+	[SBS_SMB_CMD_CODE_CHARGING_VOLTAGE] =
+	{
 		.readCommand = SBS_COMMAND_CHARGING_VOLTAGE,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(uint16_t),
-
 	},
-	{// SBS_SMB_CMD_CODE_ALARM_WARNING
-
+#ifndef SBS_SMB_EXCLUDE_ALARMS
+	[SBS_SMB_CMD_CODE_ALARM_WARNING] =
+	{
 		.readCommand = SBS_COMMAND_ALARM_WARNING,
 		.readProtocol = SBS_SMB_SMBUS_PROTOCOL_READ_WORD,
 		.outSize	= sizeof(sbs_smb_battery_state_t),
 		.retFunc = _SBSParseBatteryStatus,
-
 	},
+#endif
 };
 
+static const sbs_smb_cmd_set_t *cmdSets[SBS_SMB_CMD_SET_MAX];
+
+// Entry of a standard command, or of one in the command set of the battery. NULL if there is no such command
+// or it was left out of the build. Entries can't be read in place from flash on AVR, so they are copied to copy
+// there. Elsewhere copy is unused.
+static const sbs_smb_cmd_t *_SBSGetCmd(const sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code, sbs_smb_cmd_t *copy)
+{
+	const sbs_smb_cmd_t *cmd;
+
+	if(code < SBS_SMB_CMD_CODE_MAX)
+		cmd = &cmdLUT[code];
+	else
+	{
+		const sbs_smb_cmd_set_t *set = battery ? battery->cmdSet : NULL;
+
+		if(!set || code < set->firstCode || code - set->firstCode >= set->count)
+			return NULL;
+		cmd = &set->cmd[code - set->firstCode];
+	}
+
+#ifdef __AVR__
+	memcpy_P(copy, cmd, sizeof(*copy));
+	cmd = copy;
+#endif
+
+	if(!cmd->readProtocol && !cmd->writeProtocol && !cmd->writeReadProtocol)
+		return NULL;
+	return cmd;
+}
+
+int SBSRegisterCommandSet(const sbs_smb_cmd_set_t *set)
+{
+	if(!set || !set->cmd || set->firstCode < SBS_SMB_CMD_CODE_MAX)
+		return SMBUS_ERR_INVALID_ARG;
+
+	for(uint8_t i = 0; i < SBS_SMB_CMD_SET_MAX; i++)
+	{
+		if(cmdSets[i] == set)
+			return SMBUS_ERR_OK;
+		if(!cmdSets[i])
+		{
+			cmdSets[i] = set;
+			return SMBUS_ERR_OK;
+		}
+	}
+	return SMBUS_ERR_FAIL;
+}
+
+const sbs_smb_cmd_set_t *SBSFindCommandSet(uint16_t deviceType)
+{
+	for(uint8_t i = 0; i < SBS_SMB_CMD_SET_MAX && cmdSets[i]; i++)
+	{
+		if(cmdSets[i]->deviceType == deviceType)
+			return cmdSets[i];
+	}
+	return NULL;
+}
+
+int SBSGetCommand(const sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code, sbs_smb_cmd_t *cmd)
+{
+	if(!cmd)
+		return SMBUS_ERR_INVALID_ARG;
+
+	sbs_smb_cmd_t copy;
+	const sbs_smb_cmd_t *entry = _SBSGetCmd(battery, code, &copy);
+	if(!entry)
+		return SMBUS_ERR_INVALID_ARG;
+
+	*cmd = *entry;
+	return SMBUS_ERR_OK;
+}
+
 static void _SBSParseBatteryMode(void *inPtr, size_t inSize, void *outPtr, size_t outSize)
 {
 	uint16_t* modeVal = (uint16_t*)inPtr;
@@ -296,20 +351,17 @@ static void _SBSParseBatteryMode(void *inPtr, size_t inSize, void *outPtr, size_
 	mode->capacityUnit = (*modeVal & SBS_SMB_BATTERY_MODE_CAPACITY_MODE) ? true : false;
 }
 
+#ifndef SBS_SMB_EXCLUDE_AT_RATE
 static void _SBSParseAtRateOk(void *inPtr, size_t inSize, void *outPtr, size_t outSize)
 {
 	*((bool *)outPtr) = (*((uint16_t *)inPtr) == 0) ? 0 : 1;
 }
-
-static void _SBSParseTemperature(void *inPtr, size_t inSize, void *outPtr, size_t outSize)
-{
-	*((float *)outPtr) = *((int16_t *)inPtr) / 10.0f;
-}
+#endif
 
 static void _SBSParseBatteryStatus(void *inPtr, size_t inSize, void *outPtr, size_t outSize)
 {
 	uint16_t* status = ((uint16_t*)inPtr);
-	sbs_smb_battery_state_t *battStat = (sbs_smb_battery_state_t*)inPtr;
+	sbs_smb_battery_state_t *battStat = (sbs_smb_battery_state_t*)outPtr;
 
 	battStat->overChargeAlarm = (*status & SBS_SMB_BATTERY_ALARM_OVER_CHARGED) ? 1 : 0;
 	battStat->terminateChargeAlarm = (*status & SBS_SMB_BATTERY_ALARM_TERMINATE_CHARGE) ? 1 : 0;
@@ -336,7 +388,7 @@ static void _SBSParseSpecificationInfo(void* inPtr, size_t inSize, void* outPtr,
 	uint8_t revision = SBS_SMB_SPEC_INFO_REVISION_MASK(*spec);
 	uint8_t version = SBS_SMB_SPEC_INFO_VERSION_MASK(*spec);
 	uint8_t vScale = SBS_SMB_SPEC_INFO_VSCALE_MASK(*spec);
-	uint8_t iScale = SBS_SMB_SPEC_INFO_VSCALE_MASK(*spec);
+	uint8_t iScale = SBS_SMB_SPEC_INFO_ISCALE_MASK(*spec);
 
 	switch(version)
 	{
@@ -360,11 +412,11 @@ static void _SBSParseSpecificationInfo(void* inPtr, size_t inSize, void* outPtr,
 	switch (revision)
 	{
 		case SBS_SMB_SPEC_INFO_REVISION_1V0_1V1:
-			sprintf(specInfo->version, "1.0/1.1");
+			sprintf(specInfo->revision, "1.0/1.1");
 			break;
 
 		default:
-			sprintf(specInfo->version, "Unknown");
+			sprintf(specInfo->revision, "Unknown");
 			break;
 	}
 
@@ -454,69 +506,143 @@ void SBSLogError(smbus_err_t errCode, uint8_t* msg, uint8_t msgLen)
 	printf("\n");
 }
 
-int SBSRunCommand(sbs_smb_battery_t* battery, sbs_smb_cmd_code_t code,
-									void *inPtr, size_t inSize, void *outPtr, size_t outSize)
+// Ask the battery whether it supports PEC. The query is sent without PEC, which every battery answers.
+// The answer is kept. A battery that doesn't answer, e.g. one that isn't inserted yet, stays AUTO and is asked again.
+static int _SBSNegotiatePec(sbs_smb_battery_t *battery)
 {
-	if(!battery || !battery->bus || code >= SBS_SMB_CMD_CODE_MAX || (inPtr  && !inSize) || (outPtr && !outSize))
+	uint16_t spec;
+
+	int ret = SMBusSetPec(battery->bus, false);
+	if(ret == SMBUS_ERR_OK)
+		ret = SMBusReadWord(battery->bus, battery->busAddress, SBS_COMMAND_SPECIFICATION_INFO, &spec);
+	if(ret != SMBUS_ERR_OK)
+		return ret;
+
+	battery->pec = (SBS_SMB_SPEC_INFO_VERSION_MASK(spec) == SBS_SMB_SPEC_INFO_VERSION_1V1_PEC) ? SBS_SMB_PEC_ON : SBS_SMB_PEC_OFF;
+	return SMBUS_ERR_OK;
+}
+
+int SBSRouteBattery(sbs_smb_battery_t *battery)
+{
+	if(!battery || !battery->bus)
 		return SMBUS_ERR_INVALID_ARG;
-	
-	if(cmdLUT[code].inSize && inSize)
-		if(inSize < cmdLUT[code].inSize)
-			return SMBUS_ERR_INVALID_ARG;
-	
-	if(cmdLUT[code].outSize && outSize)
-		if(outSize < cmdLUT[code].outSize)
-			return SMBUS_ERR_INVALID_ARG;
-		
+
+	if(battery->mux)
+		return SBSMuxSelect(battery->mux, battery->muxChannel);
+
+	return SMBUS_ERR_OK;
+}
+
+int SBSSelectBattery(sbs_smb_battery_t *battery)
+{
+	int ret = SBSRouteBattery(battery);
+	if(ret != SMBUS_ERR_OK)
+		return ret;
+
+	if(battery->pec == SBS_SMB_PEC_AUTO && (ret = _SBSNegotiatePec(battery)) != SMBUS_ERR_OK)
+		return ret;
+
+	// Other batteries, a charger or a selector may have left PEC set their way
+	if(battery->pec == SBS_SMB_PEC_BUS)
+	{
+		smbus_info_t info;
+
+		ret = SMBusGetInfo(battery->bus, &info);
+		return (ret == SMBUS_ERR_OK) ? SMBusSetPec(battery->bus, info.initPEC) : ret;
+	}
+
+	return SMBusSetPec(battery->bus, battery->pec == SBS_SMB_PEC_ON);
+}
+
+typedef union
+{
+	uint8_t u8;
+	uint16_t u16;
+	uint32_t u32;
+	uint64_t u64;
+	uint8_t block[256];
+}sbs_smb_read_buff_t;	// Holds the result of a read operation
+
+// Whether the request and the response of the command are separate transactions
+static bool _SBSIsSplit(const sbs_smb_cmd_t *cmd)
+{
+	return cmd->writeReadProtocol == SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_READ_BLOCK ||
+				 cmd->writeReadProtocol == SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_BLOCK_READ_BLOCK;
+}
+
+#ifndef SBS_SMB_EXCLUDE_MANUFACTURER
+// Write the request of a split command
+static int _SBSWriteSubCommand(sbs_smb_battery_t *battery, const sbs_smb_cmd_t *cmd, uint16_t subCommand)
+{
+	if(cmd->writeReadProtocol == SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_READ_BLOCK)
+	{
+		if(cmd->writeFlipEndianness)
+			subCommand = (subCommand << 8) | (subCommand >> 8);
+		return SMBusWriteWord(battery->bus, battery->busAddress, cmd->writeCommand, subCommand);
+	}
+	return SMBusWrite16Block(battery->bus, battery->busAddress, cmd->writeCommand, subCommand);
+}
+#endif
+
+// Run the bus transactions of a command. The raw result of a read, if any, is left in readBuff
+static int _SBSTransact(sbs_smb_battery_t* battery, const sbs_smb_cmd_t *cmd, void *inPtr, size_t inSize,
+												bool read, sbs_smb_read_buff_t *readBuff, uint8_t *readLen)
+{
+	int selected = SBSSelectBattery(battery);
+	if(selected != SMBUS_ERR_OK)
+		return selected;
+
+	// Only a transaction that was sent can report success
 	int ret = SMBUS_ERR_FAIL;
-	uint8_t readLen = 0;
-	uint8_t read8buff = 0;
-	uint16_t read16Buff = 0;
-	uint32_t read32Buff = 0;
-	uint64_t read64Buff = 0;
-	uint8_t readBlockBuff[256];
-	void* readBuff = NULL;	// Holds the result of a read operation
 
-	if(cmdLUT[code].writeReadProtocol && inPtr && outPtr)
+#ifndef SBS_SMB_EXCLUDE_MANUFACTURER
+	// A split command that only sends its subcommand e.g. a ManufacturerAccess() reset or a chip command's toggle
+	if(_SBSIsSplit(cmd) && !read && (inPtr || cmd->subCommand))
+		return _SBSWriteSubCommand(battery, cmd, inPtr ? *(uint16_t *)inPtr : cmd->subCommand);
+#endif
+
+	if(cmd->writeReadProtocol && (inPtr || cmd->subCommand) && read)
 	{
-		switch(cmdLUT[code].writeReadProtocol)
+		switch(cmd->writeReadProtocol)
 		{
+#ifndef SBS_SMB_EXCLUDE_UNUSED_PROTOCOLS
 			case SBS_SMB_SMBUS_PROTOCOL_PROCESS_CALL:
-				readBuff = &read16Buff;
-				readLen = sizeof(read16Buff);
-				ret = SMBusProcessCall(battery->bus, battery->busAddress, cmdLUT[code].writeCommand, *((uint16_t*)inPtr), (uint16_t *)readBuff);
+				*readLen = sizeof(readBuff->u16);
+				ret = SMBusProcessCall(battery->bus, battery->busAddress, cmd->writeCommand, *((uint16_t*)inPtr), &readBuff->u16);
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_BLOCK_WRITE_BLOCK_READ_PROCESS_CALL:
-				readBuff = readBlockBuff;
-				ret = SMBusBlockWriteBlockReadProcessCall(battery->bus, battery->busAddress, cmdLUT[code].writeCommand, (uint8_t*)inPtr, inSize, (uint8_t *)readBuff, &readLen);
+				ret = SMBusBlockWriteBlockReadProcessCall(battery->bus, battery->busAddress, cmd->writeCommand, (uint8_t*)inPtr, inSize, readBuff->block, readLen);
 				break;
+#endif
 
+#ifndef SBS_SMB_EXCLUDE_MANUFACTURER
 			case SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_READ_BLOCK:
-				readBuff = readBlockBuff;
-				ret = SMBusWriteWordReadBlock(battery->bus, battery->busAddress, cmdLUT[code].writeCommand, *(uint16_t *)inPtr, cmdLUT[code].writeFlipEndianness,
-																			cmdLUT[code].readCommand, (uint8_t *)readBuff, &readLen, cmdLUT[code].readWriteDelayMs);
+				ret = SMBusWriteWordReadBlock(battery->bus, battery->busAddress, cmd->writeCommand, inPtr ? *(uint16_t *)inPtr : cmd->subCommand, cmd->writeFlipEndianness,
+																			cmd->readCommand, readBuff->block, readLen, cmd->readWriteDelayMs);
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_BLOCK_READ_BLOCK:
-				readBuff = readBlockBuff;
-				ret = SMBusWriteWordBlockReadBlock(battery->bus, battery->busAddress, cmdLUT[code].writeCommand, *(uint16_t *)inPtr, cmdLUT[code].readCommand,
-																					 (uint8_t *)readBuff, &readLen, cmdLUT[code].readWriteDelayMs);
+				ret = SMBusWriteWordBlockReadBlock(battery->bus, battery->busAddress, cmd->writeCommand, inPtr ? *(uint16_t *)inPtr : cmd->subCommand, cmd->readCommand,
+																					 readBuff->block, readLen, cmd->readWriteDelayMs);
 				break;
+#endif
 
 			default:
 				break;
 		}
-		if(ret != SMBUS_ERR_OK)
-			return ret;
-	
-		goto exit;
+
+		return ret;
 	}
 
-	if (cmdLUT[code].writeProtocol && inPtr)
+	if (cmd->writeProtocol && inPtr)
 	{
-		switch (cmdLUT[code].writeProtocol)
+#ifdef SBS_SMB_EXCLUDE_WRITES
+		return SMBUS_ERR_INVALID_ARG;
+#else
+		switch (cmd->writeProtocol)
 		{
+#ifndef SBS_SMB_EXCLUDE_UNUSED_PROTOCOLS
 			case SBS_SMB_SMBUS_PROTOCOL_QUICK_COMMAND:
 				ret = SMBusQuickCommand(battery->bus, battery->busAddress, *(bool*)inPtr);
 				break;
@@ -526,15 +652,17 @@ int SBSRunCommand(sbs_smb_battery_t* battery, sbs_smb_cmd_code_t code,
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_WRITE_BYTE:
-				ret = SMBusWriteByte(battery->bus, battery->busAddress, cmdLUT[code].writeCommand, *(uint8_t*)inPtr);
+				ret = SMBusWriteByte(battery->bus, battery->busAddress, cmd->writeCommand, *(uint8_t*)inPtr);
 				break;
+#endif
 
 			case SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD:
-				ret = SMBusWriteWord(battery->bus, battery->busAddress, cmdLUT[code].writeCommand, *(uint16_t *)inPtr);
+				ret = SMBusWriteWord(battery->bus, battery->busAddress, cmd->writeCommand, *(uint16_t *)inPtr);
 				break;
 
+#ifndef SBS_SMB_EXCLUDE_UNUSED_PROTOCOLS
 			case SBS_SMB_SMBUS_PROTOCOL_BLOCK_WRITE:
-				ret = SMBusBlockWrite(battery->bus, battery->busAddress, cmdLUT[code].writeCommand, (uint8_t *)inPtr, inSize);
+				ret = SMBusBlockWrite(battery->bus, battery->busAddress, cmd->writeCommand, (uint8_t *)inPtr, inSize);
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_HOST_NOTIFY:
@@ -542,23 +670,23 @@ int SBSRunCommand(sbs_smb_battery_t* battery, sbs_smb_cmd_code_t code,
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_WRITE_32:
-				ret = SMBusWrite32(battery->bus, battery->busAddress, cmdLUT[code].writeCommand, *(uint32_t *)inPtr);
+				ret = SMBusWrite32(battery->bus, battery->busAddress, cmd->writeCommand, *(uint32_t *)inPtr);
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_WRITE_64:
-				ret = SMBusWrite64(battery->bus, battery->busAddress, cmdLUT[code].writeCommand, *(uint64_t *)inPtr);
+				ret = SMBusWrite64(battery->bus, battery->busAddress, cmd->writeCommand, *(uint64_t *)inPtr);
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_WRITE_16_BLOCK:
-				ret = SMBusWrite16Block(battery->bus, battery->busAddress, cmdLUT[code].writeCommand, *(uint16_t *)inPtr);
+				ret = SMBusWrite16Block(battery->bus, battery->busAddress, cmd->writeCommand, *(uint16_t *)inPtr);
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_WRITE_32_BLOCK:
-				ret = SMBusWrite32Block(battery->bus, battery->busAddress, cmdLUT[code].writeCommand, *(uint32_t *)inPtr);
+				ret = SMBusWrite32Block(battery->bus, battery->busAddress, cmd->writeCommand, *(uint32_t *)inPtr);
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_WRITE_64_BLOCK:
-				ret = SMBusWrite64Block(battery->bus, battery->busAddress, cmdLUT[code].writeCommand, *(uint64_t *)inPtr);
+				ret = SMBusWrite64Block(battery->bus, battery->busAddress, cmd->writeCommand, *(uint64_t *)inPtr);
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_WRITE_RAW:
@@ -566,99 +694,256 @@ int SBSRunCommand(sbs_smb_battery_t* battery, sbs_smb_cmd_code_t code,
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_WRITE_BLOCK:
-				ret = SMBusWriteWordWriteBlock(battery->bus, battery->busAddress, cmdLUT[code].writeCommand, cmdLUT[code].subCommand, cmdLUT[code].writeFlipEndianness,
-																			 *(uint8_t *)inPtr, (uint8_t *)(inPtr + sizeof(uint8_t)), inSize, cmdLUT[code].readWriteDelayMs);
+				ret = SMBusWriteWordWriteBlock(battery->bus, battery->busAddress, cmd->writeCommand, cmd->subCommand, cmd->writeFlipEndianness,
+																			 *(uint8_t *)inPtr, (uint8_t *)(inPtr + sizeof(uint8_t)), inSize, cmd->readWriteDelayMs);
 				break;
+#endif
 
 			default:
 				break;
 		}
 		if (ret != SMBUS_ERR_OK)
 			return ret;
+#endif
 	}
 
-	if (cmdLUT[code].readProtocol && outPtr)
+	if (cmd->readProtocol && read)
 	{
-		switch (cmdLUT[code].readProtocol)
+		switch (cmd->readProtocol)
 		{
+#ifndef SBS_SMB_EXCLUDE_UNUSED_PROTOCOLS
 			case SBS_SMB_SMBUS_PROTOCOL_RECEIVE_BYTE:
-				readBuff = &read8buff;
-				readLen = sizeof(read8buff);
-				ret = SMBusReceiveByte(battery->bus, battery->busAddress, (uint8_t *)readBuff);
+				*readLen = sizeof(readBuff->u8);
+				ret = SMBusReceiveByte(battery->bus, battery->busAddress, &readBuff->u8);
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_READ_BYTE:
-				readBuff = &read8buff;
-				readLen = sizeof(read8buff);
-				ret = SMBusReadByte(battery->bus, battery->busAddress, cmdLUT[code].readCommand, (uint8_t *)readBuff);
+				*readLen = sizeof(readBuff->u8);
+				ret = SMBusReadByte(battery->bus, battery->busAddress, cmd->readCommand, &readBuff->u8);
 				break;
+#endif
 
 			case SBS_SMB_SMBUS_PROTOCOL_READ_WORD:
-				readBuff = &read16Buff;
-				readLen = sizeof(read16Buff);
-				ret = SMBusReadWord(battery->bus, battery->busAddress, cmdLUT[code].readCommand, (uint16_t *)readBuff);
+				*readLen = sizeof(readBuff->u16);
+				ret = SMBusReadWord(battery->bus, battery->busAddress, cmd->readCommand, &readBuff->u16);
 				break;
 
+#if !defined(SBS_SMB_EXCLUDE_STRINGS) || !defined(SBS_SMB_EXCLUDE_MANUFACTURER)
 			case SBS_SMB_SMBUS_PROTOCOL_BLOCK_READ:
-				readBuff = readBlockBuff;
-				ret = SMBusBlockRead(battery->bus, battery->busAddress, cmdLUT[code].readCommand, (uint8_t *)readBuff, &readLen);
+				ret = SMBusBlockRead(battery->bus, battery->busAddress, cmd->readCommand, readBuff->block, readLen);
 				break;
+#endif
 
+#ifndef SBS_SMB_EXCLUDE_UNUSED_PROTOCOLS
 			case SBS_SMB_SMBUS_PROTOCOL_READ_32:
-				readBuff = &read32Buff;
-				readLen = sizeof(read32Buff);
-				ret = SMBusRead32(battery->bus, battery->busAddress, cmdLUT[code].readCommand, (uint32_t *)readBuff);
+				*readLen = sizeof(readBuff->u32);
+				ret = SMBusRead32(battery->bus, battery->busAddress, cmd->readCommand, &readBuff->u32);
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_READ_64:
-				readBuff = &read64Buff;
-				readLen = sizeof(read64Buff);
-				ret = SMBusRead64(battery->bus, battery->busAddress, cmdLUT[code].readCommand, (uint64_t *)readBuff);
+				*readLen = sizeof(readBuff->u64);
+				ret = SMBusRead64(battery->bus, battery->busAddress, cmd->readCommand, &readBuff->u64);
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_READ_16_BLOCK:
-				readBuff = &read16Buff;
-				readLen = sizeof(read16Buff);
-				ret = SMBusRead16Block(battery->bus, battery->busAddress, cmdLUT[code].readCommand, (uint16_t *)readBuff);
+				*readLen = sizeof(readBuff->u16);
+				ret = SMBusRead16Block(battery->bus, battery->busAddress, cmd->readCommand, &readBuff->u16);
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_READ_32_BLOCK:
-				readBuff = &read32Buff;
-				readLen = sizeof(read32Buff);
-				ret = SMBusRead32Block(battery->bus, battery->busAddress, cmdLUT[code].readCommand, (uint32_t *)readBuff);
+				*readLen = sizeof(readBuff->u32);
+				ret = SMBusRead32Block(battery->bus, battery->busAddress, cmd->readCommand, &readBuff->u32);
 				break;
 
 			case SBS_SMB_SMBUS_PROTOCOL_READ_64_BLOCK:
-				readBuff = &read64Buff;
-				readLen = sizeof(read64Buff);
-				ret = SMBusRead64Block(battery->bus, battery->busAddress, cmdLUT[code].readCommand, (uint64_t *)readBuff);
+				*readLen = sizeof(readBuff->u64);
+				ret = SMBusRead64Block(battery->bus, battery->busAddress, cmd->readCommand, &readBuff->u64);
 				break;
+#endif
 
 			default:
 				break;
 		}
+	}
 
-		if (ret != SMBUS_ERR_OK)
-			return ret;
+	return ret;
+}
+
+// Decode the raw result of a read into outPtr
+static int _SBSDecode(const sbs_smb_cmd_t *cmd, sbs_smb_read_buff_t *readBuff, uint8_t readLen, void *outPtr, size_t outSize)
+{
+	if(!outPtr)
+		return SMBUS_ERR_OK;
+
+	if(cmd->subCommandEcho)
+	{
+		if(readLen < sizeof(uint16_t) || (readBuff->block[0] | (readBuff->block[1] << 8)) != cmd->subCommand)
+			return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+		readLen -= sizeof(uint16_t);
+		memmove(readBuff->block, &readBuff->block[sizeof(uint16_t)], readLen);
 	}
 
-exit:
-	if(cmdLUT[code].retFunc)
-		cmdLUT[code].retFunc(readBuff, readLen, outPtr, outSize);
-	else if(readLen)
+	if(!readLen)
+		return SMBUS_ERR_OK;
+
+	if(cmd->retFunc)
+		cmd->retFunc(readBuff, readLen, outPtr, outSize);
+	else if(cmd->outSize)
+	{
+		if(readLen < cmd->outSize)
+			return SMBUS_ERR_UNEXPECTED_DATA_RECEIVED;
+		memcpy(outPtr, readBuff, cmd->outSize);
+	}
+	else
 	{
-		if (cmdLUT[code].readProtocol == SBS_SMB_SMBUS_PROTOCOL_BLOCK_READ ||
-				cmdLUT[code].writeReadProtocol == SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_READ_BLOCK ||
-				cmdLUT[code].writeReadProtocol == SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_BLOCK_READ_BLOCK)
+		if (cmd->readProtocol == SBS_SMB_SMBUS_PROTOCOL_BLOCK_READ ||
+				cmd->writeReadProtocol == SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_READ_BLOCK ||
+				cmd->writeReadProtocol == SBS_SMB_SMBUS_PROTOCOL_WRITE_WORD_BLOCK_READ_BLOCK)
 		{
 			*(uint8_t*)outPtr++ = readLen;
 			outSize--;
 		}
 		memcpy(outPtr, readBuff, MIN(outSize, readLen));
 	}
+	return SMBUS_ERR_OK;
+}
+
+int SBSRunCommand(sbs_smb_battery_t* battery, sbs_smb_cmd_id_t code,
+									void *inPtr, size_t inSize, void *outPtr, size_t outSize)
+{
+	if(!battery || !battery->bus || (inPtr  && !inSize) || (outPtr && !outSize))
+		return SMBUS_ERR_INVALID_ARG;
+
+	sbs_smb_cmd_t copy;
+	const sbs_smb_cmd_t *cmd = _SBSGetCmd(battery, code, &copy);
+	if(!cmd)
+		return SMBUS_ERR_INVALID_ARG;
+	
+	if(cmd->inSize && inSize)
+		if(inSize < cmd->inSize)
+			return SMBUS_ERR_INVALID_ARG;
+	
+	if(cmd->outSize && outSize)
+		if(outSize < cmd->outSize)
+			return SMBUS_ERR_INVALID_ARG;
+		
+	int ret = SMBUS_ERR_FAIL;
+	uint8_t readLen = 0;
+	sbs_smb_read_buff_t readBuff;
+	sbs_cache_t *cache = battery->cache;
+
+	if(!cache)
+		ret = _SBSTransact(battery, cmd, inPtr, inSize, outPtr != NULL, &readBuff, &readLen);
+	else
+	{
+		SBSCacheLock(cache);
+
+		if(!SBSCacheIsCacheable(cache, code, inPtr))
+		{
+			ret = _SBSTransact(battery, cmd, inPtr, inSize, outPtr != NULL, &readBuff, &readLen);
+			// Anything but a read may have changed what the battery returns for other commands
+			if(inPtr || !outPtr)
+				SBSCacheClear(cache);
+		}
+		else if(SBSCacheLookup(cache, code, &readBuff, &readLen))
+			ret = SMBUS_ERR_OK;
+		else
+		{
+			ret = _SBSTransact(battery, cmd, inPtr, inSize, outPtr != NULL, &readBuff, &readLen);
+			if(ret == SMBUS_ERR_OK)
+				SBSCacheStore(cache, code, &readBuff, readLen);
+		}
+
+		SBSCacheUnlock(cache);
+	}
+
+	if(ret != SMBUS_ERR_OK)
+		return ret;
+
+	return _SBSDecode(cmd, &readBuff, readLen, outPtr, outSize);
+}
+
+bool SBSIsReadCommand(const sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code)
+{
+	sbs_smb_cmd_t copy;
+	const sbs_smb_cmd_t *cmd = _SBSGetCmd(battery, code, &copy);
+
+	return cmd && cmd->readProtocol;
+}
+
+bool SBSIsSplitCommand(const sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code)
+{
+	sbs_smb_cmd_t copy;
+	const sbs_smb_cmd_t *cmd = _SBSGetCmd(battery, code, &copy);
+
+	return cmd && _SBSIsSplit(cmd);
+}
+
+int SBSSubmitCommand(sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code, uint16_t subCommand)
+{
+	if(!battery || !battery->bus || !SBSIsSplitCommand(battery, code))
+		return SMBUS_ERR_INVALID_ARG;
+
+#ifdef SBS_SMB_EXCLUDE_MANUFACTURER
+	return SMBUS_ERR_INVALID_ARG;
+#else
+	sbs_smb_cmd_t copy;
+	const sbs_smb_cmd_t *cmd = _SBSGetCmd(battery, code, &copy);
+	sbs_cache_t *cache = battery->cache;
+
+	if(cache)
+		SBSCacheLock(cache);
+
+	int ret = SBSSelectBattery(battery);
+	if(ret == SMBUS_ERR_OK)
+		ret = _SBSWriteSubCommand(battery, cmd, cmd->subCommand ? cmd->subCommand : subCommand);
+
+	// Like any other write, the command may change what the battery returns for others
+	if(cache)
+	{
+		SBSCacheClear(cache);
+		SBSCacheUnlock(cache);
+	}
+
 	return ret;
+#endif
 }
 
+int SBSCollectCommand(sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code, void *outPtr, size_t outSize)
+{
+	if(!battery || !battery->bus || !SBSIsSplitCommand(battery, code) || (outPtr && !outSize))
+		return SMBUS_ERR_INVALID_ARG;
+
+#ifdef SBS_SMB_EXCLUDE_MANUFACTURER
+	return SMBUS_ERR_INVALID_ARG;
+#else
+	sbs_smb_cmd_t copy;
+	const sbs_smb_cmd_t *cmd = _SBSGetCmd(battery, code, &copy);
+
+	if(cmd->outSize && outSize)
+		if(outSize < cmd->outSize)
+			return SMBUS_ERR_INVALID_ARG;
+
+	uint8_t readLen = 0;
+	sbs_smb_read_buff_t readBuff;
+	sbs_cache_t *cache = battery->cache;
+
+	if(cache)
+		SBSCacheLock(cache);
+
+	int ret = SBSSelectBattery(battery);
+	if(ret == SMBUS_ERR_OK)
+		ret = SMBusBlockRead(battery->bus, battery->busAddress, cmd->readCommand, readBuff.block, &readLen);
+
+	if(cache)
+		SBSCacheUnlock(cache);
+
+	if(ret != SMBUS_ERR_OK)
+		return ret;
+
+	return _SBSDecode(cmd, &readBuff, readLen, outPtr, outSize);
+#endif
+}
 
 int SBSRunCommandBulk(sbs_smb_battery_t *battery, sbs_smb_cmd_code_t code[], uint8_t codeCount,
 									void *inPtr[], size_t inSize[], void *outPtr[], size_t outSize[])
@@ -687,10 +972,13 @@ int SBSGetBatteryInfo(sbs_smb_battery_t* battery)
 		SBS_SMB_CMD_CODE_BATTERY_STATUS,
 		SBS_SMB_CMD_CODE_MANUFACTURE_DATE,
 		SBS_SMB_CMD_CODE_SERIAL_NUMBER,
+#ifndef SBS_SMB_EXCLUDE_STRINGS
 		SBS_SMB_CMD_CODE_DEVICE_NAME,
 		SBS_SMB_CMD_CODE_DEVICE_CHEMISTRY,
 		SBS_SMB_CMD_CODE_MANUFACTURER_NAME,
+#endif
 		SBS_SMB_CMD_CODE_SPECIFICATION_INFO,
+		SBS_SMB_CMD_CODE_BATTERY_MODE,
 		SBS_SMB_CMD_CODE_TEMPERATURE,
 		SBS_SMB_CMD_CODE_CYCLE_COUNT,
 		SBS_SMB_CMD_CODE_VOLTAGE,
@@ -699,18 +987,21 @@ int SBSGetBatteryInfo(sbs_smb_battery_t* battery)
 	};
 	uint8_t codeCount = sizeof(code) / sizeof(code[0]);
 
-	void *inPtr[] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
-	size_t inSize[] = { 	 0, 	 0, 	 0, 	 0, 	 0, 	 0, 	 0, 	 0, 	 0, 	 0, 	 0, 	 0};
+	void *inPtr[sizeof(code) / sizeof(code[0])] = { NULL };
+	size_t inSize[sizeof(code) / sizeof(code[0])] = { 0 };
 	void *outPtr[] = 
 	{
 		&battery->status,
 		&battery->manufactureDate,
 		&battery->serialNumber,
+#ifndef SBS_SMB_EXCLUDE_STRINGS
 		&battery->name,
 		&battery->chemistry,
 		&battery->manufacturer,
+#endif
 		&battery->specInfo,
-		&battery->temperatureK,
+		&battery->mode,
+		&battery->temperatureDeciK,
 		&battery->cycleCount,
 		&battery->terminalVoltage,
 		&battery->relativeStateOfCharge,
@@ -722,11 +1013,14 @@ int SBSGetBatteryInfo(sbs_smb_battery_t* battery)
 		sizeof(battery->status),
 		sizeof(battery->manufactureDate),
 		sizeof(battery->serialNumber),
+#ifndef SBS_SMB_EXCLUDE_STRINGS
 		sizeof(battery->name),
 		sizeof(battery->chemistry),
 		sizeof(battery->manufacturer),
+#endif
 		sizeof(battery->specInfo),
-		sizeof(battery->temperatureK),
+		sizeof(battery->mode),
+		sizeof(battery->temperatureDeciK),
 		sizeof(battery->cycleCount),
 		sizeof(battery->terminalVoltage),
 		sizeof(battery->relativeStateOfCharge),
@@ -735,13 +1029,24 @@ int SBSGetBatteryInfo(sbs_smb_battery_t* battery)
 
 	int ret = SBSRunCommandBulk(battery, code, codeCount, inPtr, inSize, outPtr, outSize);
 	if(ret == SMBUS_ERR_OK)
-		battery->temeratureC = battery->temperatureK - 273.15;
+	{
+		battery->temperatureCentiC = SBSUnitsTemperatureCentiC(battery->temperatureDeciK);
+#ifdef SBS_SMB_FLOAT_TEMPERATURE
+		battery->temperatureK = battery->temperatureDeciK / 10.0f;
+		battery->temeratureC = battery->temperatureCentiC / 100.0f;
+#endif
+		battery->terminalVoltageMv = SBSUnitsVoltageMv(battery->terminalVoltage, &battery->specInfo);
+		battery->remainingCapacityScaled = SBSUnitsCapacity(battery->remainingCapacity, &battery->specInfo, battery->mode.capacityUnit);
+	}
 
 	return ret;
 }
 
 void SBSPrintBatteryInfo(sbs_smb_battery_t* battery)
 {
+	int32_t centiC = battery->temperatureCentiC;
+	uint32_t absCentiC = (centiC < 0) ? -centiC : centiC;
+
 	printf("|------------------Smart Battery Info------------------|\n"
 				 "|------------------------------------------------------|\n"
 				 "|- SMBus Address:      0x%02X\n"
@@ -751,14 +1056,17 @@ void SBSPrintBatteryInfo(sbs_smb_battery_t* battery)
 				 "|- Manufcture Date:    %02d-%02d-%04d (DD-MM-YYYY)\n"
 				 "|- Manufacturer:       %s\n"
 				 "|- SBS version:        %s\n"
-				 "|- Temerature:         %.02fC / %.02fK\n"
+				 "|- Temerature:         %s%lu.%02luC / %u.%uK\n"
 				 "|- Cycle Count:        %d\n"
 				 "|- Voltage:            %dmV\n"
 				 "|- State of Charge:    %d%%\n"
-				 "|- Remaining Capacity: %dmAH\n"
+				 "|- Remaining Capacity: %ld%s\n"
 				 "|------------------------------------------------------|\n\n",
 				 battery->busAddress, battery->name, battery->chemistry, battery->serialNumber,
 				 battery->manufactureDate.day, battery->manufactureDate.month, battery->manufactureDate.year, 
-				 battery->manufacturer, battery->specInfo.version, battery->temeratureC, battery->temperatureK, battery->cycleCount,
-				 battery->terminalVoltage *  battery->specInfo.vScale, battery->relativeStateOfCharge, battery->remainingCapacity);
+				 battery->manufacturer, battery->specInfo.version,
+				 (centiC < 0) ? "-" : "", (unsigned long)(absCentiC / 100), (unsigned long)(absCentiC % 100),
+				 battery->temperatureDeciK / 10, battery->temperatureDeciK % 10, battery->cycleCount,
+				 (int)battery->terminalVoltageMv, battery->relativeStateOfCharge, (long)battery->remainingCapacityScaled,
+				 (battery->mode.capacityUnit == SBS_SMB_CAPACITY_UNIT_POWER) ? "mWH" : "mAH");
 }
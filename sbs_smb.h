@@ -11,11 +11,32 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "platform/smbus_platform.h"
 
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#endif
+
 #define SBS_BATTERY_DEFAULT_ADDRESS                     0x0B
 
+/*
+ * Build options that leave commands and the protocol handlers only they use out of the image, e.g. on AVR.
+ * Define them on the compiler command line. A command that was left out fails with SMBUS_ERR_INVALID_ARG.
+ *  SBS_SMB_EXCLUDE_MANUFACTURER        ManufacturerAccess(), ManufacturerBlockAccess() and ManufacturerData(), which
+ *                                      sbs_bq.c and the modules built on it need
+ *  SBS_SMB_EXCLUDE_ALARMS              RemainingCapacityAlarm(), RemainingTimeAlarm() and AlarmWarning()
+ *  SBS_SMB_EXCLUDE_AT_RATE             AtRate() and the AtRate...() results
+ *  SBS_SMB_EXCLUDE_STRINGS             ManufacturerName(), DeviceName() and DeviceChemistry()
+ *  SBS_SMB_EXCLUDE_WRITES              Every plain write, BatteryMode() included. Reads still work.
+ *  SBS_SMB_EXCLUDE_UNUSED_PROTOCOLS    Protocols no command in the table uses e.g. process calls and 32/64-bit transfers
+ *
+ * SBS_SMB_FLOAT_TEMPERATURE brings back the float temperatureK and temeratureC fields of sbs_smb_battery_t for code
+ * written against them. They are deprecated in favour of temperatureDeciK and temperatureCentiC, and without the
+ * option such code no longer builds.
+ */
+
 /***********************************SBS Command definitions*********************************************/
 
 #define SBS_COMMAND_MANUFACTURER_ACCESS                 0x00
@@ -72,7 +93,7 @@
 typedef enum
 {
   SBS_SMB_CAPACITY_UNIT_CURRENT = 0,  // mAH
-  SBS_SMB_CAPACITY_UNIT_POWER,        // mW
+  SBS_SMB_CAPACITY_UNIT_POWER,        // 10mWH as reported, mWH once scaled by sbs_units.h
 } sbs_smb_capacity_unit_t;
 
 typedef struct 
@@ -159,6 +180,14 @@ typedef struct
   uint16_t iScale;
 }sbs_smb_spec_info_t;
 
+typedef enum
+{
+  SBS_SMB_PEC_BUS = 0,          // The usePec of SMBusInit(), whatever other devices on the bus were last set to
+  SBS_SMB_PEC_OFF,
+  SBS_SMB_PEC_ON,
+  SBS_SMB_PEC_AUTO,             // Read SpecificationInfo() on SBSSelectBattery() until it answers, and use PEC if it reports 1.1 with PEC
+}sbs_smb_pec_t;
+
 #define SBS_SMB_DATE_DAY_MASK(d)                      (d & 0x1F)
 #define SBS_SMB_DATE_MONTH_MASK(d)                    ((d >> 5) & 0x0F)
 #define SBS_SMB_DATE_YEAR_MASK(d)                     ((d >> 9) & 0x7F)
@@ -212,6 +241,8 @@ typedef enum
   SBS_SMB_CMD_CODE_MAX
 } sbs_smb_cmd_code_t;
 
+typedef uint16_t sbs_smb_cmd_id_t;  // An sbs_smb_cmd_code_t, or a code of a command set e.g. an sbs_bq_cmd_code_t
+
 typedef enum
 {
   SBS_SMB_SMBUS_PROTOCOL_QUICK_COMMAND = 1,
@@ -244,27 +275,57 @@ typedef enum
 
 typedef void (*SBSReturnFuction_t)(void *inPtr, size_t inSize, void *outPtr, size_t outSize);
 
+// An entry of the command table. Narrow fields ordered widest first, so there is no padding on AVR and little elsewhere.
 typedef struct
 {
+  SBSReturnFuction_t retFunc;
+  uint16_t readWriteDelayMs;
+  uint16_t subCommand;     // Written by a split command run without inPtr, e.g. a ManufacturerBlockAccess() command
   uint8_t writeCommand;    // Actual command code sent to the SBS
-  uint8_t subCommand;
   uint8_t readCommand;     // Actual command code sent to the SBS
-  sbs_smb_smbus_protocol_t readProtocol;
-  sbs_smb_smbus_protocol_t writeProtocol;
-  sbs_smb_smbus_protocol_t writeReadProtocol;
+  uint8_t readProtocol;    // sbs_smb_smbus_protocol_t
+  uint8_t writeProtocol;   // sbs_smb_smbus_protocol_t
+  uint8_t writeReadProtocol;  // sbs_smb_smbus_protocol_t
   bool writeFlipEndianness;
-  uint16_t readWriteDelayMs;
-  size_t inSize;
-  size_t outSize;
-  void *inPtr;
-  void *outPtr;
-  SBSReturnFuction_t retFunc;
+  bool subCommandEcho;     // The response starts with subCommand, which is checked and dropped before decoding
+  uint8_t inSize;
+  uint8_t outSize;         // A block read with outSize set is decoded as a fixed size value, without the length byte
 } sbs_smb_cmd_t;
 
+// Keep command tables in flash on AVR, where const data would otherwise be copied to RAM
+#ifdef __AVR__
+#define SBS_SMB_CMD_TABLE_ATTR  PROGMEM
+#else
+#define SBS_SMB_CMD_TABLE_ATTR
+#endif
+
+// Commands of a chip family, e.g. the ManufacturerBlockAccess() commands of a gauge, given codes of their own
+// from SBS_SMB_CMD_CODE_MAX on. Families take consecutive ranges so a code means the same command everywhere.
+// SBSRunCommand() runs cmd[code - firstCode] on a battery the set is bound to, through the same path as the
+// standard commands.
+typedef struct
+{
+  const char *name;
+  uint16_t deviceType;          // DeviceType() of the chips, looked up by SBSFindCommandSet()
+  uint16_t firstCode;
+  uint16_t count;
+  const sbs_smb_cmd_t *cmd;     // Declared with SBS_SMB_CMD_TABLE_ATTR
+} sbs_smb_cmd_set_t;
+
+#define SBS_SMB_CMD_SET_MAX                             4       // Sets SBSRegisterCommandSet() holds
+
+typedef struct sbs_mux sbs_mux_t;
+typedef struct sbs_cache sbs_cache_t;
+
 typedef struct
 {
   smbus_handle_t bus;
   uint8_t busAddress;
+  sbs_mux_t *mux;               // I2C mux the battery sits behind, NULL if it is connected directly to the bus
+  uint8_t muxChannel;           // Mux channel the battery is connected to
+  sbs_cache_t *cache;           // Cache of recent reads, NULL to always read from the battery. See sbs_cache.h
+  sbs_smb_pec_t pec;            // SBS_SMB_PEC_AUTO is replaced by the result of the negotiation, SBS_SMB_PEC_BUS if it failed
+  const sbs_smb_cmd_set_t *cmdSet;  // Chip commands the battery answers, NULL for the standard ones only
   sbs_smb_battery_state_t status;
   sbs_smb_date_t manufactureDate;
   uint16_t serialNumber;
@@ -272,21 +333,61 @@ typedef struct
   char chemistry[64];
   char manufacturer[64];
   sbs_smb_spec_info_t specInfo;
-  float temperatureK;
-  float temeratureC;
+  sbs_smb_battery_mode_t mode;
+  uint16_t temperatureDeciK;        // 0.1K as reported
+  int32_t temperatureCentiC;        // 0.01C
+#ifdef SBS_SMB_FLOAT_TEMPERATURE
+  float temperatureK;               // Deprecated, temperatureDeciK / 10
+  float temeratureC;                // Deprecated, temperatureCentiC / 100
+#endif
   uint16_t cycleCount;
-  uint16_t terminalVoltage;
+  uint16_t terminalVoltage;         // As reported, before applying specInfo.vScale
+  int32_t terminalVoltageMv;
   uint16_t relativeStateOfCharge;
-  uint16_t remainingCapacity;
+  uint16_t remainingCapacity;       // As reported, before applying specInfo.iScale and the capacity mode
+  int32_t remainingCapacityScaled;  // mAH or mWH depending on mode.capacityUnit
   uint16_t chargingVoltage;
   uint16_t chargingCurrent;
 }sbs_smb_battery_t;
 
 void SBSLogError(smbus_err_t errCode, uint8_t* msg, uint8_t msgLen);
 
-int SBSRunCommand(sbs_smb_battery_t *battery, sbs_smb_cmd_code_t code,
+/// @brief Route the bus to the battery e.g. by enabling its mux channel, and set the bus PEC to what the battery
+///        supports. Called by SBSRunCommand() and needed before talking to the battery with the SMBus functions directly.
+int SBSSelectBattery(sbs_smb_battery_t *battery);
+
+/// @brief Only route the bus to the battery, leaving PEC alone, e.g. for raw I2C to a gauge in ROM mode
+int SBSRouteBattery(sbs_smb_battery_t *battery);
+
+int SBSRunCommand(sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code,
                   void *inPtr, size_t inSize, void *outPtr, size_t outSize);
 
+/// @brief Add a chip family for SBSFindCommandSet(). Sets are registered once at start-up and never removed.
+/// @return SMBUS_ERR_FAIL if SBS_SMB_CMD_SET_MAX sets are registered already
+int SBSRegisterCommandSet(const sbs_smb_cmd_set_t *set);
+
+/// @return The registered set for chips that report deviceType in DeviceType(), NULL if there is none
+const sbs_smb_cmd_set_t *SBSFindCommandSet(uint16_t deviceType);
+
+/// @brief Copy the table entry of a command, standard or from the command set of the battery
+/// @return SMBUS_ERR_INVALID_ARG if the battery has no such command or it was left out of the build
+int SBSGetCommand(const sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code, sbs_smb_cmd_t *cmd);
+
+/// @brief Whether the command can be read on its own, without writing anything first
+bool SBSIsReadCommand(const sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code);
+
+/// @brief Whether the command writes a request and reads the response in a separate transaction, e.g.
+///        ManufacturerAccess(), and can be run in two halves with SBSSubmitCommand() and SBSCollectCommand()
+bool SBSIsSplitCommand(const sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code);
+
+/// @brief First half of SBSRunCommand() for a split command: write the request and return without waiting
+///        for the response. The bus is free for other devices until SBSCollectCommand().
+/// @param subCommand e.g. the ManufacturerAccess() command. Ignored by commands with a subCommand of their own.
+int SBSSubmitCommand(sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code, uint16_t subCommand);
+
+/// @brief Second half: read the response to the last SBSSubmitCommand() and decode it into outPtr
+int SBSCollectCommand(sbs_smb_battery_t *battery, sbs_smb_cmd_id_t code, void *outPtr, size_t outSize);
+
 int SBSRunCommandBulk(sbs_smb_battery_t *battery, sbs_smb_cmd_code_t code[], uint8_t codeCount,
 									void *inPtr[], size_t inSize[], void *outPtr[], size_t outSize[]);
 
@@ -294,4 +395,4 @@ int SBSGetBatteryInfo(sbs_smb_battery_t* battery);
 
 void SBSPrintBatteryInfo(sbs_smb_battery_t* battery);
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_telemetry.h"
+
+#define MIN(x,y)	((x < y) ? x : y)
+
+#define SBS_TELEMETRY_MAX_STRING_LEN    63
+
+static uint8_t *_SBSTelemetryPut16(uint8_t *p, uint16_t value)
+{
+  *p++ = value & 0xFF;
+  *p++ = value >> 8;
+  return p;
+}
+
+static uint8_t *_SBSTelemetryPutString(uint8_t *p, const char *str, size_t maxLen)
+{
+  uint8_t len = 0;
+  while (len < MIN(maxLen, SBS_TELEMETRY_MAX_STRING_LEN) && str[len])
+    len++;
+
+  *p++ = len;
+  memcpy(p, str, len);
+  return p + len;
+}
+
+// Rebuild the BatteryStatus() word from its decoded form so the receiver sees the standard SBS layout
+static uint16_t _SBSTelemetryPackStatus(const sbs_smb_battery_state_t *status)
+{
+  uint16_t word = SBS_SMB_BATTERY_ERROR_MASK(status->error);
+
+  word |= status->overChargeAlarm ? SBS_SMB_BATTERY_ALARM_OVER_CHARGED : 0;
+  word |= status->terminateChargeAlarm ? SBS_SMB_BATTERY_ALARM_TERMINATE_CHARGE : 0;
+  word |= status->overTempAlarm ? SBS_SMB_BATTERY_ALARM_OVER_TEMPERATURE : 0;
+  word |= status->terminateDischargeAlarm ? SBS_SMB_BATTERY_ALARM_TERMINATE_DISCHARGE : 0;
+  word |= status->remainingCapacityAlarm ? SBS_SMB_BATTERY_ALARM_REMAINING_CAPACITY : 0;
+  word |= status->remainingTimeAlarm ? SBS_SMB_BATTERY_ALARM_REMAINING_TIME : 0;
+  word |= status->initialized ? SBS_SMB_BATTERY_STATUS_INITIALIZED : 0;
+  word |= status->discharging ? SBS_SMB_BATTERY_STATUS_DISCHARGING : 0;
+  word |= status->fullyCharged ? SBS_SMB_BATTERY_STATUS_FULLY_CHARGED : 0;
+  word |= status->fullyDischarged ? SBS_SMB_BATTERY_STATUS_BATTERY_DEPLETED : 0;
+
+  return word;
+}
+
+static void _SBSTelemetryGetFields(const sbs_smb_battery_t *battery, uint16_t value[SBS_TELEMETRY_FIELD_COUNT])
+{
+  value[0] = _SBSTelemetryPackStatus(&battery->status);
+  value[1] = battery->temperatureDeciK;
+  value[2] = battery->terminalVoltage;
+  value[3] = battery->relativeStateOfCharge;
+  value[4] = battery->remainingCapacity;
+  value[5] = battery->cycleCount;
+  value[6] = battery->chargingVoltage;
+  value[7] = battery->chargingCurrent;
+}
+
+static size_t _SBSTelemetryEncodeSession(const sbs_telemetry_t *ctx, const sbs_smb_battery_t *battery, uint8_t *buff)
+{
+  uint8_t *p = buff + SBS_TELEMETRY_FRAME_HEADER_SIZE;
+
+  uint16_t date = (battery->manufactureDate.day & 0x1F) |
+                  ((battery->manufactureDate.month & 0x0F) << 5) |
+                  (((battery->manufactureDate.year - SBS_SMB_DATE_BASE_YEAR) & 0x7F) << 9);
+
+  p = _SBSTelemetryPut16(p, battery->serialNumber);
+  p = _SBSTelemetryPut16(p, date);
+  p = _SBSTelemetryPut16(p, battery->specInfo.vScale);
+  p = _SBSTelemetryPut16(p, battery->specInfo.iScale);
+  p = _SBSTelemetryPutString(p, battery->name, sizeof(battery->name));
+  p = _SBSTelemetryPutString(p, battery->chemistry, sizeof(battery->chemistry));
+  p = _SBSTelemetryPutString(p, battery->manufacturer, sizeof(battery->manufacturer));
+
+  buff[0] = SBS_TELEMETRY_FRAME_SESSION;
+  buff[1] = ctx->id;
+  buff[2] = p - buff - SBS_TELEMETRY_FRAME_HEADER_SIZE;
+
+  return p - buff;
+}
+
+static size_t _SBSTelemetryEncodeData(uint8_t id, uint8_t mask, const uint16_t value[SBS_TELEMETRY_FIELD_COUNT], uint8_t *buff)
+{
+  uint8_t *p = buff + SBS_TELEMETRY_FRAME_HEADER_SIZE;
+
+  *p++ = mask;
+  for (uint8_t i = 0; i < SBS_TELEMETRY_FIELD_COUNT; i++)
+  {
+    if (!(mask & (1 << i)))
+      continue;
+
+    if ((1 << i) == SBS_TELEMETRY_FIELD_RELATIVE_SOC)
+      *p++ = (uint8_t)value[i];
+    else
+      p = _SBSTelemetryPut16(p, value[i]);
+  }
+
+  buff[0] = SBS_TELEMETRY_FRAME_DATA;
+  buff[1] = id;
+  buff[2] = p - buff - SBS_TELEMETRY_FRAME_HEADER_SIZE;
+
+  return p - buff;
+}
+
+void SBSTelemetryInit(sbs_telemetry_t *ctx, uint8_t id)
+{
+  if (!ctx)
+    return;
+
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->id = id;
+}
+
+void SBSTelemetryReset(sbs_telemetry_t *ctx)
+{
+  if (!ctx)
+    return;
+
+  ctx->sessionSent = false;
+  ctx->validFields = 0;
+}
+
+int SBSTelemetryEncode(sbs_telemetry_t *ctx, const sbs_smb_battery_t *battery, uint8_t *buff, size_t buffSize, size_t *len)
+{
+  if (!ctx || !battery || !buff || !len)
+    return SMBUS_ERR_INVALID_ARG;
+
+  // Frames are built on the stack so that the caller's buffer and the context are untouched if they don't fit
+  uint8_t frame[SBS_TELEMETRY_MAX_SNAPSHOT_SIZE];
+  size_t frameLen = 0;
+  uint16_t value[SBS_TELEMETRY_FIELD_COUNT];
+  uint8_t mask = 0;
+
+  _SBSTelemetryGetFields(battery, value);
+
+  for (uint8_t i = 0; i < SBS_TELEMETRY_FIELD_COUNT; i++)
+    if (!(ctx->validFields & (1 << i)) || value[i] != ctx->lastValue[i])
+      mask |= (1 << i);
+
+  if (!ctx->sessionSent)
+    frameLen += _SBSTelemetryEncodeSession(ctx, battery, frame);
+
+  if (mask)
+    frameLen += _SBSTelemetryEncodeData(ctx->id, mask, value, frame + frameLen);
+
+  *len = 0;
+  if (frameLen > buffSize)
+    return SMBUS_ERR_FAIL;
+
+  memcpy(buff, frame, frameLen);
+  *len = frameLen;
+
+  ctx->sessionSent = true;
+  ctx->validFields = SBS_TELEMETRY_FIELD_ALL;
+  memcpy(ctx->lastValue, value, sizeof(value));
+
+  return SMBUS_ERR_OK;
+}
+
+int SBSTelemetryEncodeBatch(sbs_telemetry_t *ctx[], const sbs_smb_battery_t *battery[], uint16_t count,
+                            uint8_t *buff, size_t buffSize, size_t *len, uint16_t *encodedCount)
+{
+  if (!ctx || !battery || !buff || !len)
+    return SMBUS_ERR_INVALID_ARG;
+
+  int ret = SMBUS_ERR_OK;
+  size_t used = 0;
+  uint16_t i;
+
+  for (i = 0; i < count; i++)
+  {
+    size_t frameLen;
+    ret = SBSTelemetryEncode(ctx[i], battery[i], buff + used, buffSize - used, &frameLen);
+    if (ret != SMBUS_ERR_OK)
+      break;
+    used += frameLen;
+  }
+
+  *len = used;
+  if (encodedCount)
+    *encodedCount = i;
+
+  return ret;
+}
@@ -0,0 +1,82 @@
+/**
+ *
+ * @file:   sbs_telemetry.h - Compact binary serialization of battery snapshots for streaming
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * A stream is a sequence of self-delimiting frames, all values little-endian:
+ *
+ *  [type][id][payload length][payload...]
+ *
+ * SESSION frame: sent once per session, or after SBSTelemetryReset(). Carries the values that never change.
+ *  serial(2), manufacture date in SBS format(2), vScale(2), iScale(2),
+ *  then name, chemistry and manufacturer each as [length][chars...] without a terminator
+ *
+ * DATA frame: sent for every snapshot in which at least one field changed.
+ *  field mask(1), then one value for every set bit in the mask, in bit order.
+ *  A field is always 2 bytes except SBS_TELEMETRY_FIELD_RELATIVE_SOC which is 1 byte.
+ *
+ * Frames of unknown type can be skipped using the payload length.
+ *
+ * */
+
+#ifndef _SBS_TELEMETRY_H_
+#define _SBS_TELEMETRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sbs_smb.h"
+
+#define SBS_TELEMETRY_FRAME_SESSION                     0x01
+#define SBS_TELEMETRY_FRAME_DATA                        0x02
+
+#define SBS_TELEMETRY_FRAME_HEADER_SIZE                 3
+
+#define SBS_TELEMETRY_FIELD_STATUS                      (1 << 0)  // BatteryStatus() word as defined by the SBS spec
+#define SBS_TELEMETRY_FIELD_TEMPERATURE                 (1 << 1)  // 0.1K
+#define SBS_TELEMETRY_FIELD_VOLTAGE                     (1 << 2)  // mV, before applying vScale
+#define SBS_TELEMETRY_FIELD_RELATIVE_SOC                (1 << 3)  // %
+#define SBS_TELEMETRY_FIELD_REMAINING_CAPACITY          (1 << 4)  // mAH or 10mWH, before applying scaling
+#define SBS_TELEMETRY_FIELD_CYCLE_COUNT                 (1 << 5)
+#define SBS_TELEMETRY_FIELD_CHARGING_VOLTAGE            (1 << 6)  // mV
+#define SBS_TELEMETRY_FIELD_CHARGING_CURRENT            (1 << 7)  // mA
+
+#define SBS_TELEMETRY_FIELD_COUNT                       8
+#define SBS_TELEMETRY_FIELD_ALL                         0xFF
+
+// Largest output of SBSTelemetryEncode() for one battery: a SESSION frame followed by a DATA frame with all fields
+#define SBS_TELEMETRY_MAX_SNAPSHOT_SIZE                 ((SBS_TELEMETRY_FRAME_HEADER_SIZE + 8 + 3 * (1 + 63)) + \
+                                                         (SBS_TELEMETRY_FRAME_HEADER_SIZE + 1 + 2 * SBS_TELEMETRY_FIELD_COUNT))
+
+typedef struct
+{
+  uint8_t id;                                 // Identifies the battery within the stream
+  bool sessionSent;                           // Whether the SESSION frame has been sent
+  uint8_t validFields;                        // Fields whose last sent value is held in lastValue
+  uint16_t lastValue[SBS_TELEMETRY_FIELD_COUNT];
+} sbs_telemetry_t;
+
+/// @brief Prepare an encoder context for a battery. The first encoded snapshot includes the SESSION frame and all fields.
+/// @param id Value used to tell apart frames of different batteries in the same stream
+void SBSTelemetryInit(sbs_telemetry_t *ctx, uint8_t id);
+
+/// @brief Force the next encoded snapshot to resend the SESSION frame and all fields e.g. after the receiver reconnects
+void SBSTelemetryReset(sbs_telemetry_t *ctx);
+
+/// @brief Encode a snapshot of the battery into the provided buffer
+/// @param len Set to the number of bytes written. Zero if nothing changed since the last encoded snapshot
+/// @return SMBUS_ERR_OK on success, SMBUS_ERR_FAIL if the frames don't fit in the buffer, in which case nothing
+///         is written and the context is left unchanged
+int SBSTelemetryEncode(sbs_telemetry_t *ctx, const sbs_smb_battery_t *battery, uint8_t *buff, size_t buffSize, size_t *len);
+
+/// @brief Encode snapshots of several batteries back to back into the provided buffer
+/// @param len Set to the number of bytes written.
+/// @param encodedCount If not NULL, set to the number of batteries whose snapshot was encoded.
+/// @return SMBUS_ERR_OK if all snapshots were encoded, SMBUS_ERR_FAIL if the buffer filled up. The snapshots that
+///         didn't fit keep their context unchanged so they can be encoded into the next buffer.
+int SBSTelemetryEncodeBatch(sbs_telemetry_t *ctx[], const sbs_smb_battery_t *battery[], uint16_t count,
+                            uint8_t *buff, size_t buffSize, size_t *len, uint16_t *encodedCount);
+
+#endif
@@ -0,0 +1,87 @@
+#include <stdint.h>
+
+#include "sbs_units.h"
+
+sbs_units_class_t SBSUnitsClass(sbs_smb_cmd_code_t code)
+{
+  switch (code)
+  {
+    case SBS_SMB_CMD_CODE_VOLTAGE:
+    case SBS_SMB_CMD_CODE_CHARGING_VOLTAGE:
+    case SBS_SMB_CMD_CODE_DESIGN_VOLTAGE:
+      return SBS_UNITS_CLASS_VOLTAGE;
+
+    case SBS_SMB_CMD_CODE_CURRENT:
+    case SBS_SMB_CMD_CODE_AVERAGE_CURRENT:
+    case SBS_SMB_CMD_CODE_CHARGING_CURRENT:
+      return SBS_UNITS_CLASS_CURRENT;
+
+    case SBS_SMB_CMD_CODE_REMAINING_CAPACITY_ALARM:
+    case SBS_SMB_CMD_CODE_REMAINING_CAPACITY:
+    case SBS_SMB_CMD_CODE_FULL_CHARGE_CAPACITY:
+    case SBS_SMB_CMD_CODE_DESIGN_CAPACITY:
+      return SBS_UNITS_CLASS_CAPACITY;
+
+    case SBS_SMB_CMD_CODE_TEMPERATURE:
+      return SBS_UNITS_CLASS_TEMPERATURE;
+
+    default:
+      return SBS_UNITS_CLASS_NONE;
+  }
+}
+
+int32_t SBSUnitsConvert(sbs_smb_cmd_code_t code, uint16_t raw, const sbs_smb_spec_info_t *spec,
+                        sbs_smb_capacity_unit_t capacityUnit)
+{
+  switch (SBSUnitsClass(code))
+  {
+    case SBS_UNITS_CLASS_VOLTAGE:
+      return SBSUnitsVoltageMv(raw, spec);
+
+    case SBS_UNITS_CLASS_CURRENT:
+      // ChargingCurrent() is unsigned, 0xFFFF asks for the charger's maximum current
+      if (code == SBS_SMB_CMD_CODE_CHARGING_CURRENT)
+        return (int32_t)raw * (spec->iScale ? spec->iScale : 1);
+      return SBSUnitsCurrentMa(raw, spec);
+
+    case SBS_UNITS_CLASS_CAPACITY:
+      return SBSUnitsCapacity(raw, spec, capacityUnit);
+
+    case SBS_UNITS_CLASS_TEMPERATURE:
+      return SBSUnitsTemperatureCentiC(raw);
+
+    default:
+      return raw;
+  }
+}
+
+int SBSReadScaled(sbs_smb_battery_t *battery, sbs_smb_cmd_code_t code, int32_t *value)
+{
+  if (!battery || !value || SBSUnitsClass(code) == SBS_UNITS_CLASS_NONE)
+    return SMBUS_ERR_INVALID_ARG;
+
+  int ret;
+  uint16_t raw;
+
+  // The scaling factors are never 0 once SpecificationInfo() has been parsed
+  if (!battery->specInfo.vScale)
+  {
+    ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_SPECIFICATION_INFO, NULL, 0, &battery->specInfo, sizeof(battery->specInfo));
+    if (ret != SMBUS_ERR_OK)
+      return ret;
+  }
+
+  if (SBSUnitsClass(code) == SBS_UNITS_CLASS_CAPACITY)
+  {
+    ret = SBSRunCommand(battery, SBS_SMB_CMD_CODE_BATTERY_MODE, NULL, 0, &battery->mode, sizeof(battery->mode));
+    if (ret != SMBUS_ERR_OK)
+      return ret;
+  }
+
+  ret = SBSRunCommand(battery, code, NULL, 0, &raw, sizeof(raw));
+  if (ret != SMBUS_ERR_OK)
+    return ret;
+
+  *value = SBSUnitsConvert(code, raw, &battery->specInfo, battery->mode.capacityUnit);
+  return SMBUS_ERR_OK;
+}
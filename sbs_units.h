@@ -0,0 +1,73 @@
+/**
+ *
+ * @file:   sbs_units.h - Integer conversion of raw SBS values to engineering units
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * SBS reports voltages, currents and capacities as 16-bit values that have to be multiplied by the scaling factors
+ * in SpecificationInfo(), and capacities are in mAH or 10mWH depending on the CAPACITY_MODE bit of BatteryMode().
+ * Everything here is done with integer maths so that no soft-float code gets linked in on FPU-less MCUs.
+ *
+ *  Voltage:      mV    = raw * VScale
+ *  Current:      mA    = (int16_t)raw * IPScale
+ *  Capacity:     mAH   = raw * IPScale               (CAPACITY_MODE = 0)
+ *                mWH   = raw * 10 * IPScale          (CAPACITY_MODE = 1)
+ *  Temperature:  0.01C = raw(0.1K) * 10 - 27315
+ *
+ * */
+
+#ifndef _SBS_UNITS_H_
+#define _SBS_UNITS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sbs_smb.h"
+
+#define SBS_UNITS_ZERO_CELSIUS_CENTI_K                  27315
+
+typedef enum
+{
+  SBS_UNITS_CLASS_NONE = 0,     // Not scaled e.g. percentages, minutes and counts
+  SBS_UNITS_CLASS_VOLTAGE,      // mV
+  SBS_UNITS_CLASS_CURRENT,      // mA, signed
+  SBS_UNITS_CLASS_CAPACITY,     // mAH or mWH
+  SBS_UNITS_CLASS_TEMPERATURE,  // 0.01C
+} sbs_units_class_t;
+
+/// @brief The kind of value returned by a command, which determines how it is scaled
+sbs_units_class_t SBSUnitsClass(sbs_smb_cmd_code_t code);
+
+/// @brief Scale a raw word returned by a command
+/// @param spec         Scaling factors as parsed from SpecificationInfo()
+/// @param capacityUnit Unit selected by the CAPACITY_MODE bit of BatteryMode(), only used for capacities
+int32_t SBSUnitsConvert(sbs_smb_cmd_code_t code, uint16_t raw, const sbs_smb_spec_info_t *spec,
+                        sbs_smb_capacity_unit_t capacityUnit);
+
+static inline int32_t SBSUnitsVoltageMv(uint16_t raw, const sbs_smb_spec_info_t *spec)
+{
+  return (int32_t)raw * (spec->vScale ? spec->vScale : 1);
+}
+
+static inline int32_t SBSUnitsCurrentMa(uint16_t raw, const sbs_smb_spec_info_t *spec)
+{
+  return (int32_t)(int16_t)raw * (spec->iScale ? spec->iScale : 1);
+}
+
+static inline int32_t SBSUnitsCapacity(uint16_t raw, const sbs_smb_spec_info_t *spec, sbs_smb_capacity_unit_t capacityUnit)
+{
+  int32_t value = (int32_t)raw * (spec->iScale ? spec->iScale : 1);
+  return (capacityUnit == SBS_SMB_CAPACITY_UNIT_POWER) ? value * 10 : value;
+}
+
+static inline int32_t SBSUnitsTemperatureCentiC(uint16_t deciK)
+{
+  return (int32_t)deciK * 10 - SBS_UNITS_ZERO_CELSIUS_CENTI_K;
+}
+
+/// @brief Read a word command and scale it with the battery's SpecificationInfo() and BatteryMode()
+/// @note  SpecificationInfo() is read first if the battery's specInfo hasn't been read yet, and BatteryMode()
+///        is read along with every capacity since the host may change it at any time
+int SBSReadScaled(sbs_smb_battery_t *battery, sbs_smb_cmd_code_t code, int32_t *value);
+
+#endif
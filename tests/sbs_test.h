@@ -0,0 +1,44 @@
+/**
+ *
+ * @file:   sbs_test.h - Checks shared by the tests of the library
+ * @author: skuodi
+ * @date:   18 October, 2026
+ *
+ * Every test is a program that runs its checks, prints the ones that failed and returns non-zero if any did.
+ * Tests that need a bus open the simulated one of platform/smbus_sim.h, so they run without hardware.
+ *
+ * */
+
+#ifndef _SBS_TEST_H_
+#define _SBS_TEST_H_
+
+#include <stdio.h>
+
+static int sbsTestFailed;
+
+#define SBS_TEST_CHECK(cond)                                                                      \
+  do                                                                                              \
+  {                                                                                               \
+    if (!(cond))                                                                                  \
+    {                                                                                             \
+      printf("%s:%d: %s\n", __FILE__, __LINE__, #cond);                                           \
+      sbsTestFailed++;                                                                            \
+    }                                                                                             \
+  } while (0)
+
+// Integer values, printed on failure
+#define SBS_TEST_CHECK_EQ(actual, expected)                                                       \
+  do                                                                                              \
+  {                                                                                               \
+    long _actual = (long)(actual), _expected = (long)(expected);                                  \
+    if (_actual != _expected)                                                                     \
+    {                                                                                             \
+      printf("%s:%d: %s is %ld, expected %ld\n", __FILE__, __LINE__, #actual, _actual, _expected); \
+      sbsTestFailed++;                                                                            \
+    }                                                                                             \
+  } while (0)
+
+// Return value of main()
+#define SBS_TEST_RESULT()       (printf("%s: %s\n", __FILE__, sbsTestFailed ? "FAILED" : "passed"), sbsTestFailed != 0)
+
+#endif
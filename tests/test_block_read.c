@@ -0,0 +1,124 @@
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sbs_test.h"
+#include "smbus_platform.h"
+#include "smbus_sim.h"
+
+#define TEST_PEC_ADDRESS        0x0B    // Simulated batteries at odd addresses support PEC
+#define TEST_NO_PEC_ADDRESS     0x0C
+
+// DeviceName() through the platform, with and without PEC
+static void TestBlockRead(void)
+{
+  smbus_handle_t bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, true);
+  uint8_t data[I2C_SMBUS_BLOCK_MAX];
+  uint8_t len = 0;
+
+  SBS_TEST_CHECK(bus != NULL);
+  if (!bus)
+    return;
+
+  SBS_TEST_CHECK_EQ(SMBusBlockRead(bus, TEST_PEC_ADDRESS, 0x21, data, &len), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(len, 8);
+  SBS_TEST_CHECK(!memcmp(data, "SIM-PACK", 8));
+
+  SBS_TEST_CHECK_EQ(SMBusSetPec(bus, false), SMBUS_ERR_OK);
+  len = 0;
+  SBS_TEST_CHECK_EQ(SMBusBlockRead(bus, TEST_NO_PEC_ADDRESS, 0x20, data, &len), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(len, 7);
+  SBS_TEST_CHECK(!memcmp(data, "SimCorp", 7));
+
+  SMBusDeinit(bus);
+}
+
+// The simulated bus holds I2C_M_RECV_LEN reads to the rules of i2c-dev
+static void TestRecvLenRules(void)
+{
+  smbus_sim_t *sim = SMBusSimCreate(0);
+  uint8_t command = 0x21;
+  uint8_t buff[2 + I2C_SMBUS_BLOCK_MAX];
+  struct i2c_msg msgs[] = {
+    { .addr = TEST_PEC_ADDRESS, .flags = 0, .len = 1, .buf = &command },
+    { .addr = TEST_PEC_ADDRESS, .flags = I2C_M_RD | I2C_M_RECV_LEN, .len = sizeof(buff), .buf = buff },
+  };
+
+  // buf[0] has to say how many bytes come besides the data
+  buff[0] = 0;
+  SBS_TEST_CHECK_EQ(SMBusSimTransfer(sim, msgs, 2), -EINVAL);
+
+  // and len has to leave room for the longest block after them
+  buff[0] = 2;
+  msgs[1].len = 1 + I2C_SMBUS_BLOCK_MAX;
+  SBS_TEST_CHECK_EQ(SMBusSimTransfer(sim, msgs, 2), -EINVAL);
+
+  // The count, the block, then the PEC asked for
+  msgs[1].len = sizeof(buff);
+  SBS_TEST_CHECK_EQ(SMBusSimTransfer(sim, msgs, 2), 2);
+  SBS_TEST_CHECK_EQ(buff[0], 8);
+  SBS_TEST_CHECK_EQ(msgs[1].len, 1 + 8 + 1);
+
+  buff[0] = 1;
+  msgs[1].len = sizeof(buff);
+  SBS_TEST_CHECK_EQ(SMBusSimTransfer(sim, msgs, 2), 2);
+  SBS_TEST_CHECK_EQ(msgs[1].len, 1 + 8);
+
+  SMBusSimDestroy(sim);
+}
+
+// A ManufacturerBlockAccess() data flash row is 2 address bytes and 32 data bytes, longer than a RECV_LEN read takes
+static void TestLongBlockRead(void)
+{
+  smbus_handle_t bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, true);
+  uint8_t address[] = {0x20, 0x40};
+  uint8_t data[2 + 32];
+  uint8_t len = 0;
+
+  SBS_TEST_CHECK(bus != NULL);
+  if (!bus)
+    return;
+
+  SBS_TEST_CHECK_EQ(SMBusBlockWrite(bus, TEST_PEC_ADDRESS, 0x44, address, sizeof(address)), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(SMBusBlockRead(bus, TEST_PEC_ADDRESS, 0x44, data, &len), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(len, sizeof(data));
+  SBS_TEST_CHECK_EQ(data[0] | (data[1] << 8), 0x4020);
+
+  SBS_TEST_CHECK_EQ(SMBusSetPec(bus, false), SMBUS_ERR_OK);
+  len = 0;
+  SBS_TEST_CHECK_EQ(SMBusBlockWrite(bus, TEST_NO_PEC_ADDRESS, 0x44, address, sizeof(address)), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(SMBusBlockRead(bus, TEST_NO_PEC_ADDRESS, 0x44, data, &len), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(len, sizeof(data));
+
+  SMBusDeinit(bus);
+}
+
+// Like adapters, the simulated bus refuses a RECV_LEN count over I2C_SMBUS_BLOCK_MAX
+static void TestRecvLenTooLong(void)
+{
+  smbus_sim_t *sim = SMBusSimCreate(0);
+  uint8_t write[] = {0x44, 2, 0x00, 0x40};
+  uint8_t command = 0x44;
+  uint8_t buff[1 + I2C_SMBUS_BLOCK_MAX] = {1};
+  struct i2c_msg msgs[] = {
+    { .addr = TEST_NO_PEC_ADDRESS, .flags = 0, .len = sizeof(write), .buf = write },
+    { .addr = TEST_NO_PEC_ADDRESS, .flags = I2C_M_RD | I2C_M_RECV_LEN, .len = sizeof(buff), .buf = buff },
+  };
+
+  SBS_TEST_CHECK_EQ(SMBusSimTransfer(sim, msgs, 1), 1);
+
+  msgs[0].len = 1;
+  msgs[0].buf = &command;
+  SBS_TEST_CHECK_EQ(SMBusSimTransfer(sim, msgs, 2), -EPROTO);
+
+  SMBusSimDestroy(sim);
+}
+
+int main(void)
+{
+  TestBlockRead();
+  TestRecvLenRules();
+  TestLongBlockRead();
+  TestRecvLenTooLong();
+  return SBS_TEST_RESULT();
+}
@@ -0,0 +1,113 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_bq_cal.h"
+#include "smbus_sim.h"
+
+#define TEST_MEAN(counts)       ((int32_t)(counts) * (1 << SBS_BQ_CAL_MEAN_FRAC_BITS))
+
+static void TestStat(sbs_bq_cal_stat_t *stat, const int16_t value[], uint32_t count)
+{
+  memset(stat, 0, sizeof(*stat));
+  for (uint32_t i = 0; i < count; i++)
+  {
+    stat->sum += value[i];
+    stat->sumSquares += (uint64_t)((int32_t)value[i] * value[i]);
+  }
+  stat->count = count;
+}
+
+static void TestMeanVariance(void)
+{
+  static const int16_t even[] = {10, 12, 14};
+  static const int16_t thirds[] = {1, 2, 2};
+  static const int16_t negative[] = {-1, -2, -2};
+  static const int16_t large[] = {32000, 32002, 31998, 32000};
+  sbs_bq_cal_stat_t stat;
+
+  TestStat(&stat, even, 3);
+  SBS_TEST_CHECK_EQ(SBSBqCalMean(&stat), TEST_MEAN(12));
+  SBS_TEST_CHECK_EQ(SBSBqCalVariance(&stat), 4);
+
+  // Means round to the nearest 1/256 count on both sides of 0
+  TestStat(&stat, thirds, 3);
+  SBS_TEST_CHECK_EQ(SBSBqCalMean(&stat), 427);
+  TestStat(&stat, negative, 3);
+  SBS_TEST_CHECK_EQ(SBSBqCalMean(&stat), -427);
+
+  // Counts near full scale don't overflow the sums
+  TestStat(&stat, large, 4);
+  SBS_TEST_CHECK_EQ(SBSBqCalMean(&stat), TEST_MEAN(32000));
+  SBS_TEST_CHECK_EQ(SBSBqCalVariance(&stat), 3);
+
+  // Nothing to work out from fewer samples than it takes
+  TestStat(&stat, even, 1);
+  SBS_TEST_CHECK_EQ(SBSBqCalVariance(&stat), 0);
+  TestStat(&stat, even, 0);
+  SBS_TEST_CHECK_EQ(SBSBqCalMean(&stat), 0);
+}
+
+static void TestGain(void)
+{
+  static const int16_t value[] = {10, 12, 14};
+  sbs_bq_cal_stat_t stat;
+
+  TestStat(&stat, value, 3);
+
+  // 1000 units over 10 counts above the offset
+  SBS_TEST_CHECK_EQ(SBSBqCalGain(&stat, TEST_MEAN(2), 1000), 100 << SBS_BQ_CAL_GAIN_FRAC_BITS);
+  SBS_TEST_CHECK_EQ(SBSBqCalGain(&stat, TEST_MEAN(2), -1000), -(100 << SBS_BQ_CAL_GAIN_FRAC_BITS));
+  SBS_TEST_CHECK_EQ(SBSBqCalGain(&stat, TEST_MEAN(22), 1000), -(100 << SBS_BQ_CAL_GAIN_FRAC_BITS));
+  SBS_TEST_CHECK_EQ(SBSBqCalGain(&stat, 0, 3), 16384);
+  SBS_TEST_CHECK_EQ(SBSBqCalGain(&stat, TEST_MEAN(12), 1000), 0);
+
+  // Saturates rather than wrapping
+  SBS_TEST_CHECK_EQ(SBSBqCalGain(&stat, TEST_MEAN(12) - 1, 1000000), INT32_MAX);
+}
+
+// The simulated gauge outputs a CC of -12 counts shorted and 8192 otherwise, with a few counts of noise
+static void TestCapture(void)
+{
+  sbs_smb_battery_t battery;
+  sbs_bq_cal_sample_t sample[16];
+  sbs_bq_cal_t cal;
+
+  memset(&battery, 0, sizeof(battery));
+  battery.bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, true);
+  battery.busAddress = 0x0B;
+  SBS_TEST_CHECK(battery.bus != NULL);
+  if (!battery.bus)
+    return;
+
+  SBSBqCalInit(&cal, &battery, sample, 16);
+  SBS_TEST_CHECK_EQ(SBSBqCalCapture(&cal, true, 50, 1000), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(cal.samples, 50);
+  SBS_TEST_CHECK(cal.reads > cal.samples);
+  SBS_TEST_CHECK_EQ(cal.count, 16);
+  SBS_TEST_CHECK_EQ(cal.mode, 0);
+  SBS_TEST_CHECK_EQ(cal.stat[SBS_BQ_CAL_CHANNEL_CC].count, 50);
+  SBS_TEST_CHECK(cal.stat[SBS_BQ_CAL_CHANNEL_CC].min >= -14 && cal.stat[SBS_BQ_CAL_CHANNEL_CC].max <= -10);
+
+  int32_t offset = SBSBqCalMean(&cal.stat[SBS_BQ_CAL_CHANNEL_CC]);
+  SBS_TEST_CHECK(offset >= TEST_MEAN(-14) && offset <= TEST_MEAN(-10));
+
+  // A new capture starts the sums over
+  SBS_TEST_CHECK_EQ(SBSBqCalCapture(&cal, false, 20, 1000), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(cal.stat[SBS_BQ_CAL_CHANNEL_CC].count, 20);
+  int32_t gain = SBSBqCalGain(&cal.stat[SBS_BQ_CAL_CHANNEL_CC], offset, 2000);
+  SBS_TEST_CHECK(gain > 15900 && gain < 16050);
+
+  SBS_TEST_CHECK_EQ(SBSBqCalCapture(&cal, false, 50, 10), SMBUS_ERR_TIMEOUT);
+  SBS_TEST_CHECK_EQ(cal.mode, 0);
+
+  SMBusDeinit(battery.bus);
+}
+
+int main(void)
+{
+  TestMeanVariance();
+  TestGain();
+  TestCapture();
+  return SBS_TEST_RESULT();
+}
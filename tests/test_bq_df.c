@@ -0,0 +1,138 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_bq.h"
+#include "sbs_bq_cmd.h"
+#include "sbs_bq_df.h"
+#include "smbus_sim.h"
+
+#define TEST_DF_START           SBS_BQ_DF_ADDRESS_START
+#define TEST_DF_SIZE            (4 * SBS_BQ_DF_ROW_SIZE)
+
+typedef struct
+{
+  sbs_bq_df_image_t image;
+  uint8_t data[TEST_DF_SIZE];
+  uint8_t valid[SBS_BQ_DF_BITMAP_SIZE(TEST_DF_SIZE)];
+  uint8_t dirty[SBS_BQ_DF_BITMAP_SIZE(TEST_DF_SIZE)];
+}test_df_t;
+
+static void TestImage(test_df_t *df)
+{
+  SBS_TEST_CHECK_EQ(SBSBqDfImageInit(&df->image, TEST_DF_START, TEST_DF_SIZE, df->data, df->valid, df->dirty),
+                    SMBUS_ERR_OK);
+}
+
+// Only rows not yet in the image are read, and only bytes that change make a row dirty
+static void TestImageRows(sbs_smb_battery_t *battery)
+{
+  test_df_t df;
+  uint8_t buff[40], same;
+
+  TestImage(&df);
+  SBS_TEST_CHECK_EQ(SBSBqDfImageInit(&df.image, TEST_DF_START + 1, TEST_DF_SIZE, df.data, df.valid, df.dirty),
+                    SMBUS_ERR_INVALID_ARG);
+
+  SBS_TEST_CHECK_EQ(SBSBqDfRead(battery, &df.image, TEST_DF_START + 16, buff, sizeof(buff)), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(df.image.rowsRead, 2);
+  SBS_TEST_CHECK_EQ(SBSBqDfRead(battery, &df.image, TEST_DF_START, buff, 8), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(df.image.rowsRead, 2);
+  SBS_TEST_CHECK(SBSBqDfImageRowValid(&df.image, 1) && !SBSBqDfImageRowValid(&df.image, 2));
+
+  // Part of a row that hasn't been read can't be written without losing the rest of it
+  SBS_TEST_CHECK_EQ(SBSBqDfImageWrite(&df.image, TEST_DF_START + 2 * SBS_BQ_DF_ROW_SIZE, buff, 1),
+                    SMBUS_ERR_INVALID_ARG);
+
+  same = df.data[3];
+  SBS_TEST_CHECK_EQ(SBSBqDfImageWrite(&df.image, TEST_DF_START + 3, &same, 1), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(!SBSBqDfImageRowDirty(&df.image, 0));
+
+  SBS_TEST_CHECK_EQ(SBSBqDfDump(battery, &df.image), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(df.image.rowsRead, 4);
+}
+
+// Dirty rows go to the gauge and nothing else, and read back as written
+static void TestFlush(sbs_smb_battery_t *battery)
+{
+  test_df_t df, readBack;
+  uint16_t rowsWritten = 0;
+  uint8_t value;
+
+  TestImage(&df);
+  SBS_TEST_CHECK_EQ(SBSBqDfDump(battery, &df.image), SMBUS_ERR_OK);
+  value = df.data[SBS_BQ_DF_ROW_SIZE + 5] ^ 0x5A;
+  SBS_TEST_CHECK_EQ(SBSBqDfImageWrite(&df.image, TEST_DF_START + SBS_BQ_DF_ROW_SIZE + 5, &value, 1), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(SBSBqDfImageRowDirty(&df.image, 1));
+
+  SBS_TEST_CHECK_EQ(SBSBqDfFlush(battery, &df.image, &rowsWritten), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(rowsWritten, 1);
+  SBS_TEST_CHECK(!SBSBqDfImageRowDirty(&df.image, 1));
+  SBS_TEST_CHECK_EQ(SBSBqDfFlush(battery, &df.image, &rowsWritten), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(rowsWritten, 0);
+
+  TestImage(&readBack);
+  SBS_TEST_CHECK_EQ(SBSBqDfDump(battery, &readBack.image), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(memcmp(readBack.data, df.data, TEST_DF_SIZE) == 0);
+}
+
+// A gauge already reporting the target's checksum is left alone, otherwise only the differing rows are written
+static void TestApply(sbs_smb_battery_t *battery)
+{
+  test_df_t target, df;
+  uint32_t before = 0, checksum, wrong;
+  uint16_t rowsWritten = 0;
+
+  TestImage(&target);
+  SBS_TEST_CHECK_EQ(SBSBqDfDump(battery, &target.image), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(SBSBqDfReadChecksum(battery, &before), SMBUS_ERR_OK);
+
+  // The simulated gauge sums the data flash bytes into 16 bits
+  checksum = before;
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    uint8_t *byte = &target.data[2 * SBS_BQ_DF_ROW_SIZE + i];
+    checksum -= *byte;
+    *byte += 1 + i;
+    checksum += *byte;
+  }
+  checksum &= 0xFFFF;
+  wrong = (checksum + 1) & 0xFFFF;
+
+  TestImage(&df);
+  SBS_TEST_CHECK_EQ(SBSBqDfApply(battery, &df.image, &target.image, &checksum, &rowsWritten), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(rowsWritten, 1);
+  SBS_TEST_CHECK_EQ(df.image.rowsRead, 4);
+
+  TestImage(&df);
+  SBS_TEST_CHECK_EQ(SBSBqDfApply(battery, &df.image, &target.image, &checksum, &rowsWritten), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(rowsWritten, 0);
+  SBS_TEST_CHECK_EQ(df.image.rowsRead, 0);
+
+  // Nothing differs, so nothing is written, and the checksum it then reports isn't the one asked for
+  TestImage(&df);
+  SBS_TEST_CHECK_EQ(SBSBqDfApply(battery, &df.image, &target.image, &wrong, &rowsWritten), SMBUS_ERR_FAIL);
+  SBS_TEST_CHECK_EQ(rowsWritten, 0);
+}
+
+int main(void)
+{
+  sbs_smb_battery_t battery;
+  uint16_t unsealKey[2] = { 0x0414, 0x3672 };
+
+  memset(&battery, 0, sizeof(battery));
+  battery.bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+  battery.busAddress = 0x0B;
+  SBS_TEST_CHECK(battery.bus != NULL);
+  if (battery.bus)
+  {
+    SBSBqBindCommands(&battery);
+    TestImageRows(&battery);
+    SBS_TEST_CHECK_EQ(SBSBqAccess2WordKey(&battery, SBS_BQ_COMMAND_UNSEAL_DEVICE, unsealKey), SMBUS_ERR_OK);
+    TestFlush(&battery);
+    TestApply(&battery);
+    SMBusDeinit(battery.bus);
+  }
+
+  return SBS_TEST_RESULT();
+}
@@ -0,0 +1,144 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_bq.h"
+#include "sbs_bq_cmd.h"
+#include "sbs_bq_df.h"
+#include "sbs_bq_gang.h"
+#include "smbus_sim.h"
+
+#define TEST_GANG_PACKS         3
+#define TEST_GANG_START         SBS_BQ_DF_ADDRESS_START
+#define TEST_GANG_SIZE          (4 * SBS_BQ_DF_ROW_SIZE)
+#define TEST_GANG_ROW           1
+
+typedef struct
+{
+  sbs_bq_df_image_t image;
+  uint8_t data[TEST_GANG_SIZE];
+  uint8_t valid[SBS_BQ_DF_BITMAP_SIZE(TEST_GANG_SIZE)];
+  uint8_t dirty[SBS_BQ_DF_BITMAP_SIZE(TEST_GANG_SIZE)];
+}test_gang_df_t;
+
+static uint16_t testUnsealKey[2] = { 0x0414, 0x3672 };
+
+static void TestImage(test_gang_df_t *df, uint16_t startAddress)
+{
+  SBS_TEST_CHECK_EQ(SBSBqDfImageInit(&df->image, startAddress, TEST_GANG_SIZE, df->data, df->valid, df->dirty),
+                    SMBUS_ERR_OK);
+}
+
+static void TestBattery(sbs_smb_battery_t *battery, smbus_handle_t bus, uint8_t busAddress)
+{
+  memset(battery, 0, sizeof(*battery));
+  battery->bus = bus;
+  battery->busAddress = busAddress;
+  SBSBqBindCommands(battery);
+}
+
+static sbs_bq_security_mode_t TestMode(sbs_smb_battery_t *battery)
+{
+  sbs_bq_security_mode_t mode = SBS_BQ_SECURITY_MODE_RESERVED;
+
+  SBSBqGetSecurityMode(battery, &mode);
+  return mode;
+}
+
+// Every pack is unsealed, programmed, verified and sealed again, with the waits of one spent on the others
+static void TestProgram(smbus_handle_t bus, const sbs_bq_df_image_t *target)
+{
+  sbs_smb_battery_t battery[TEST_GANG_PACKS];
+  sbs_bq_gang_pack_t pack[TEST_GANG_PACKS];
+  test_gang_df_t df[TEST_GANG_PACKS], readBack;
+  sbs_bq_gang_config_t config = { .unsealKey = testUnsealKey, .target = target, .seal = true };
+
+  // A pack on its own first, for how long one takes
+  TestBattery(&battery[0], bus, 0x0B + 2 * TEST_GANG_PACKS);
+  TestImage(&df[0], TEST_GANG_START);
+  SBSBqGangInitPack(&pack[0], &battery[0], &df[0].image);
+  SBS_TEST_CHECK_EQ(SBSBqGangRun(&config, pack, 1), 0);
+  uint32_t packMs = pack[0].totalMs;
+
+  for (uint8_t i = 0; i < TEST_GANG_PACKS; i++)
+  {
+    TestBattery(&battery[i], bus, 0x0B + 2 * i);
+    TestImage(&df[i], TEST_GANG_START);
+    SBSBqGangInitPack(&pack[i], &battery[i], &df[i].image);
+  }
+
+  uint32_t startMs = SMBusPlatformMillis();
+  SBS_TEST_CHECK_EQ(SBSBqGangRun(&config, pack, TEST_GANG_PACKS), 0);
+  uint32_t elapsedMs = SMBusPlatformMillis() - startMs;
+
+  for (uint8_t i = 0; i < TEST_GANG_PACKS; i++)
+  {
+    SBS_TEST_CHECK_EQ(pack[i].state, SBS_BQ_GANG_STATE_DONE);
+    SBS_TEST_CHECK_EQ(pack[i].rowsWritten, 1);
+    SBS_TEST_CHECK(!pack[i].skipped);
+    SBS_TEST_CHECK_EQ(TestMode(&battery[i]), SBS_BQ_SECURITY_MODE_SEALED);
+
+    TestImage(&readBack, TEST_GANG_START);
+    SBS_TEST_CHECK_EQ(SBSBqDfDump(&battery[i], &readBack.image), SMBUS_ERR_OK);
+    SBS_TEST_CHECK(memcmp(&readBack.data[TEST_GANG_ROW * SBS_BQ_DF_ROW_SIZE],
+                          &target->data[TEST_GANG_ROW * SBS_BQ_DF_ROW_SIZE], SBS_BQ_DF_ROW_SIZE) == 0);
+  }
+
+  // One after the other they would take TEST_GANG_PACKS times as long
+  SBS_TEST_CHECK(elapsedMs < 2 * packMs);
+}
+
+// A pack already holding the target is only checksummed, and one that fails doesn't hold up the rest
+static void TestSkipAndFail(smbus_handle_t bus, const sbs_bq_df_image_t *target)
+{
+  sbs_smb_battery_t battery[2];
+  sbs_bq_gang_pack_t pack[2];
+  test_gang_df_t df[2];
+  sbs_bq_gang_config_t config = { .unsealKey = testUnsealKey, .target = target, .seal = true };
+  uint32_t checksum = 0;
+
+  TestBattery(&battery[0], bus, 0x0B);
+  TestBattery(&battery[1], bus, 0x0D);
+  SBS_TEST_CHECK_EQ(SBSBqDfReadChecksum(&battery[0], &checksum), SMBUS_ERR_OK);
+  config.checksum = &checksum;
+
+  // The image of the second pack doesn't cover the target
+  TestImage(&df[0], TEST_GANG_START);
+  TestImage(&df[1], TEST_GANG_START + TEST_GANG_SIZE);
+  SBSBqGangInitPack(&pack[0], &battery[0], &df[0].image);
+  SBSBqGangInitPack(&pack[1], &battery[1], &df[1].image);
+
+  SBS_TEST_CHECK_EQ(SBSBqGangRun(&config, pack, 2), 1);
+
+  SBS_TEST_CHECK_EQ(pack[0].state, SBS_BQ_GANG_STATE_DONE);
+  SBS_TEST_CHECK(pack[0].skipped);
+  SBS_TEST_CHECK_EQ(pack[0].rowsWritten, 0);
+  SBS_TEST_CHECK_EQ(df[0].image.rowsRead, 0);
+
+  SBS_TEST_CHECK_EQ(pack[1].state, SBS_BQ_GANG_STATE_FAILED);
+  SBS_TEST_CHECK_EQ(pack[1].failedState, SBS_BQ_GANG_STATE_STAGE);
+  SBS_TEST_CHECK_EQ(pack[1].result, SMBUS_ERR_INVALID_ARG);
+}
+
+int main(void)
+{
+  test_gang_df_t target;
+  uint8_t row[SBS_BQ_DF_ROW_SIZE];
+  smbus_handle_t bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+
+  TestImage(&target, TEST_GANG_START);
+  for (uint8_t i = 0; i < SBS_BQ_DF_ROW_SIZE; i++)
+    row[i] = 0xA5 ^ i;
+  SBS_TEST_CHECK_EQ(SBSBqDfImageWrite(&target.image, TEST_GANG_START + TEST_GANG_ROW * SBS_BQ_DF_ROW_SIZE, row,
+                                      sizeof(row)), SMBUS_ERR_OK);
+
+  SBS_TEST_CHECK(bus != NULL);
+  if (bus)
+  {
+    TestProgram(bus, &target.image);
+    TestSkipAndFail(bus, &target.image);
+    SMBusDeinit(bus);
+  }
+
+  return SBS_TEST_RESULT();
+}
@@ -0,0 +1,163 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_bq_lifetime.h"
+#include "smbus_sim.h"
+
+#define TEST_BLACK_BOX_ADDRESS  0x4040
+
+static void TestSection(sbs_bq_lifetime_t *lifetime, sbs_bq_lifetime_section_t section, const uint8_t *data, uint8_t len)
+{
+  lifetime->section[section][0] = len;
+  memcpy(&lifetime->section[section][1], data, len);
+}
+
+static void TestLifetime(sbs_bq_lifetime_t *lifetime)
+{
+  static const uint8_t block1[32] = {
+    0x10, 0x10, 0x20, 0x10, 0x30, 0x10, 0x00, 0x00,         // Cell max 4112, 4128, 4144, 0 mV
+    0xB8, 0x0B, 0xC2, 0x0B, 0xCC, 0x0B, 0x00, 0x00,         // Cell min 3000, 3010, 3020, 0 mV
+    0x64, 0x00,                                             // Delta 100 mV
+    0xD0, 0x07, 0x30, 0xF8,                                 // Charge 2000 mA, discharge -2000 mA
+    0x00, 0x00, 0x00, 0x00,
+    55, (uint8_t)-10, 12, 60, (uint8_t)-5, 70,              // Temperatures °C
+  };
+  static const uint8_t block2[] = {1, 2, 3, 4, 9, 8, 7};     // Only the first 3 cells' balancing times
+  static const uint8_t itStatus2[] = {5, 6, 1, 2, 3, 4, 0x78, 0x56, 0x34, 0x12};
+  uint8_t blackBox[2 + 32];
+
+  memset(lifetime, 0, sizeof(*lifetime));
+  lifetime->serialNumber = 0xBEEF;
+  lifetime->blackBoxAddress = TEST_BLACK_BOX_ADDRESS;
+  TestSection(lifetime, SBS_BQ_LIFETIME_SECTION_BLOCK_1, block1, sizeof(block1));
+  TestSection(lifetime, SBS_BQ_LIFETIME_SECTION_BLOCK_2, block2, sizeof(block2));
+  TestSection(lifetime, SBS_BQ_LIFETIME_SECTION_IT_STATUS_2, itStatus2, sizeof(itStatus2));
+
+  blackBox[0] = TEST_BLACK_BOX_ADDRESS & 0xFF;
+  blackBox[1] = TEST_BLACK_BOX_ADDRESS >> 8;
+  for (uint8_t i = 0; i < 32; i++)
+    blackBox[2 + i] = 0xA0 + i;
+  TestSection(lifetime, SBS_BQ_LIFETIME_SECTION_BLACK_BOX, blackBox, sizeof(blackBox));
+}
+
+// Only the sections read go into a record, and parsing it gives back the same sections
+static void TestRecord(void)
+{
+  sbs_bq_lifetime_t lifetime, parsed;
+  uint8_t record[SBS_BQ_LIFETIME_RECORD_MAX_SIZE];
+
+  TestLifetime(&lifetime);
+
+  size_t len = SBSBqLifetimeEncode(&lifetime, record, sizeof(record));
+  SBS_TEST_CHECK_EQ(len, 4 + (1 + 32) + (1 + 7) + (1 + 10) + (1 + 34));
+  SBS_TEST_CHECK_EQ(record[0], SBS_BQ_LIFETIME_RECORD_VERSION);
+  SBS_TEST_CHECK_EQ(record[1] | (record[2] << 8), 0xBEEF);
+  SBS_TEST_CHECK_EQ(record[3], (1 << SBS_BQ_LIFETIME_SECTION_BLOCK_1) | (1 << SBS_BQ_LIFETIME_SECTION_BLOCK_2) |
+                               (1 << SBS_BQ_LIFETIME_SECTION_IT_STATUS_2) | (1 << SBS_BQ_LIFETIME_SECTION_BLACK_BOX));
+  SBS_TEST_CHECK_EQ(SBSBqLifetimeEncode(&lifetime, record, len - 1), 0);
+
+  SBS_TEST_CHECK_EQ(SBSBqLifetimeParse(record, len, &parsed), len);
+  SBS_TEST_CHECK_EQ(parsed.serialNumber, 0xBEEF);
+  SBS_TEST_CHECK_EQ(parsed.blackBoxAddress, 0);
+  SBS_TEST_CHECK(!memcmp(parsed.section, lifetime.section, sizeof(parsed.section)));
+
+  // Truncated, from another version, or with a section longer than any read
+  SBS_TEST_CHECK_EQ(SBSBqLifetimeParse(record, len - 1, &parsed), 0);
+  record[0]++;
+  SBS_TEST_CHECK_EQ(SBSBqLifetimeParse(record, len, &parsed), 0);
+  record[0]--;
+  record[4] = SBS_BQ_LIFETIME_SECTION_SIZE + 1;
+  SBS_TEST_CHECK_EQ(SBSBqLifetimeParse(record, len, &parsed), 0);
+}
+
+static void TestDecode(void)
+{
+  sbs_bq_lifetime_t lifetime;
+  sbs_bq_lifetime_data_t data;
+
+  TestLifetime(&lifetime);
+
+  SBS_TEST_CHECK_EQ(SBSBqLifetimeDecode(&lifetime, &data), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(data.serialNumber, 0xBEEF);
+  SBS_TEST_CHECK_EQ(data.present, (1 << SBS_BQ_LIFETIME_SECTION_BLOCK_1) | (1 << SBS_BQ_LIFETIME_SECTION_BLOCK_2) |
+                                  (1 << SBS_BQ_LIFETIME_SECTION_IT_STATUS_2) | (1 << SBS_BQ_LIFETIME_SECTION_BLACK_BOX));
+
+  SBS_TEST_CHECK_EQ(data.lifetime1.cellVoltageMax[2], 4144);
+  SBS_TEST_CHECK_EQ(data.lifetime1.cellVoltageMin[0], 3000);
+  SBS_TEST_CHECK_EQ(data.lifetime1.cellDeltaMax, 100);
+  SBS_TEST_CHECK_EQ(data.lifetime1.dischargeCurrentMax, -2000);
+  SBS_TEST_CHECK_EQ(data.lifetime1.cellTempMin, -10);
+  SBS_TEST_CHECK_EQ(data.lifetime1.fetTempMax, 70);
+
+  // Fields past what the gauge returned read as 0
+  SBS_TEST_CHECK_EQ(data.lifetime2.watchdogResets, 4);
+  SBS_TEST_CHECK_EQ(data.lifetime2.balancingTime[2], 7);
+  SBS_TEST_CHECK_EQ(data.lifetime2.balancingTime[3], 0);
+  SBS_TEST_CHECK_EQ(data.lifetime3.totalRuntime, 0);
+
+  SBS_TEST_CHECK_EQ(data.itStatus2.learnStatus, 6);
+  SBS_TEST_CHECK_EQ(data.itStatus2.cellGrid[3], 4);
+  SBS_TEST_CHECK_EQ(data.itStatus2.stateTime, 0x12345678);
+
+  SBS_TEST_CHECK_EQ(data.blackBox.address, TEST_BLACK_BOX_ADDRESS);
+  SBS_TEST_CHECK_EQ(data.blackBox.size, 32);
+  SBS_TEST_CHECK_EQ(data.blackBox.data[31], 0xBF);
+
+  // A row answered for another address, or too short to hold one
+  lifetime.blackBoxAddress = TEST_BLACK_BOX_ADDRESS + 0x20;
+  SBS_TEST_CHECK_EQ(SBSBqLifetimeDecode(&lifetime, &data), SMBUS_ERR_UNEXPECTED_DATA_RECEIVED);
+  SBS_TEST_CHECK_EQ(data.lifetime1.cellDeltaMax, 100);
+
+  lifetime.section[SBS_BQ_LIFETIME_SECTION_BLACK_BOX][0] = 1;
+  SBS_TEST_CHECK_EQ(SBSBqLifetimeDecode(&lifetime, &data), SMBUS_ERR_UNEXPECTED_DATA_RECEIVED);
+
+  // A parsed record has no requested address to compare against
+  lifetime.section[SBS_BQ_LIFETIME_SECTION_BLACK_BOX][0] = 34;
+  lifetime.blackBoxAddress = 0;
+  SBS_TEST_CHECK_EQ(SBSBqLifetimeDecode(&lifetime, &data), SMBUS_ERR_OK);
+}
+
+// Several simulated packs in one scheduler run
+static void TestRead(void)
+{
+  smbus_handle_t bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, true);
+  sbs_smb_battery_t battery[3];
+  sbs_bq_lifetime_t lifetime[3];
+  sbs_sched_job_t job[3 * 7];
+  sbs_sched_t sched;
+
+  SBS_TEST_CHECK(bus != NULL);
+  if (!bus)
+    return;
+
+  SBSSchedInit(&sched, job, 3 * 7);
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    memset(&battery[i], 0, sizeof(battery[i]));
+    battery[i].bus = bus;
+    battery[i].busAddress = 0x0B + 2 * i;
+    SBS_TEST_CHECK_EQ(SBSBqLifetimeSched(&sched, &battery[i], TEST_BLACK_BOX_ADDRESS, &lifetime[i]), SMBUS_ERR_OK);
+  }
+  SBS_TEST_CHECK_EQ(SBSBqLifetimeSched(&sched, &battery[0], TEST_BLACK_BOX_ADDRESS, &lifetime[0]), SMBUS_ERR_FAIL);
+  SBS_TEST_CHECK_EQ(SBSSchedRun(&sched), 0);
+
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    sbs_bq_lifetime_data_t data;
+
+    SBS_TEST_CHECK_EQ(SBSBqLifetimeDecode(&lifetime[i], &data), SMBUS_ERR_OK);
+    SBS_TEST_CHECK_EQ(data.present, (1 << SBS_BQ_LIFETIME_SECTION_COUNT) - 1);
+    SBS_TEST_CHECK_EQ(data.blackBox.address, TEST_BLACK_BOX_ADDRESS);
+  }
+
+  SMBusDeinit(bus);
+}
+
+int main(void)
+{
+  TestRecord();
+  TestDecode();
+  TestRead();
+  return SBS_TEST_RESULT();
+}
@@ -0,0 +1,94 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_bq.h"
+#include "sbs_bq_cmd.h"
+#include "sbs_sched.h"
+#include "smbus_sim.h"
+
+// Flags land on their TRM bits and reserved bits set nothing
+static void TestDecode(void)
+{
+  sbs_bq_safety_t safety;
+  sbs_bq_pf_t pf;
+  sbs_bq_operation_status_t op;
+  sbs_bq_charging_status_t charging;
+  sbs_bq_gauging_status_t gauging;
+
+  SBSBqDecodeSafety((1UL << 0) | (1UL << 16) | (1UL << 27), &safety);
+  SBS_TEST_CHECK(safety.cellUnderVoltage);
+  SBS_TEST_CHECK(!safety.cellOverVoltage);
+  SBS_TEST_CHECK(safety.overTempFet);
+  SBS_TEST_CHECK(safety.underTempDischarge);
+  SBS_TEST_CHECK(!safety.underTempCharge);
+
+  SBSBqDecodeSafety((1UL << 15) | (1UL << 17), &safety);
+  SBS_TEST_CHECK_EQ(safety.raw, (1UL << 15) | (1UL << 17));
+  SBS_TEST_CHECK(!safety.cellUnderVoltageCompensated && !safety.overTempFet && !safety.prechargeTimeout);
+
+  SBSBqDecodePf((1UL << 6) | (1UL << 15) | (1UL << 28), &pf);
+  SBS_TEST_CHECK(pf.safetyOverTempFet);
+  SBS_TEST_CHECK(!pf.safetyOverTempCell);
+  SBS_TEST_CHECK(pf.fuseFailure);
+  SBS_TEST_CHECK(pf.thermistor4);
+  SBS_TEST_CHECK(!pf.thermistor3);
+
+  SBSBqDecodeOperationStatus(0x20001A06, &op);
+  SBS_TEST_CHECK(op.dischargeFet && op.chargeFet && !op.prechargeFet);
+  SBS_TEST_CHECK_EQ(op.securityMode, SBS_BQ_SECURITY_MODE_UNSEALED);
+  SBS_TEST_CHECK(op.safetyStatus && op.permanentFailure && !op.shutdownLowVoltage);
+  SBS_TEST_CHECK(op.emergencyShutdown && !op.cellBalancing);
+
+  SBSBqDecodeChargingStatus((1UL << 3) | (1UL << 7) | (1UL << 15), &charging);
+  SBS_TEST_CHECK(charging.recommendedTemp);
+  SBS_TEST_CHECK(!charging.prechargeVoltage);
+  SBS_TEST_CHECK(charging.validChargeTermination);
+
+  SBSBqDecodeGaugingStatus((1UL << 1) | (1UL << 9) | (1UL << 20), &gauging);
+  SBS_TEST_CHECK(gauging.fullyCharged && !gauging.fullyDischarged);
+  SBS_TEST_CHECK(!gauging.rest && !gauging.resistanceUpdatesDisabled);
+  SBS_TEST_CHECK(gauging.ocvFlatRegion);
+}
+
+// Read from a simulated pack, which reports SEALED and no safety or PF flags
+static void TestRead(void)
+{
+  sbs_smb_battery_t battery;
+  sbs_bq_status_t status;
+  sbs_sched_job_t job[7];
+  sbs_sched_t sched;
+
+  memset(&battery, 0, sizeof(battery));
+  battery.bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+  battery.busAddress = 0x0B;
+  SBS_TEST_CHECK(battery.bus != NULL);
+  if (!battery.bus)
+    return;
+
+  SBS_TEST_CHECK_EQ(SBSBqReadStatus(&battery, &status), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(status.operationStatus.securityMode, SBS_BQ_SECURITY_MODE_SEALED);
+  SBS_TEST_CHECK(!status.operationStatus.safetyStatus && !status.operationStatus.permanentFailure);
+  SBS_TEST_CHECK_EQ(status.safetyStatus.raw, 0);
+  SBS_TEST_CHECK_EQ(status.pfStatus.raw, 0);
+
+  // The scheduled read queues all seven, and refuses to queue part of them
+  SBSSchedInit(&sched, job, 6);
+  SBS_TEST_CHECK_EQ(SBSBqSchedStatus(&sched, &battery, &status), SMBUS_ERR_FAIL);
+  SBS_TEST_CHECK_EQ(sched.count, 0);
+
+  SBSSchedInit(&sched, job, 7);
+  SBS_TEST_CHECK_EQ(SBSBqSchedStatus(&sched, &battery, &status), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(sched.count, 7);
+  SBS_TEST_CHECK_EQ(SBSSchedRun(&sched), 0);
+  SBS_TEST_CHECK_EQ(status.operationStatus.securityMode, SBS_BQ_SECURITY_MODE_SEALED);
+
+  SMBusDeinit(battery.bus);
+}
+
+int main(void)
+{
+  TestDecode();
+  TestRead();
+  return SBS_TEST_RESULT();
+}
@@ -0,0 +1,162 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_bqfs.h"
+#include "smbus_sim.h"
+
+static const char testScript[] =
+  ";--------------------------------------------------------\r\n"
+  "; Program the gauge\r\n"
+  "W: 16 00 14 04\r\n"
+  "X: 2\r\n"
+  "\r\n"
+  "c: 16 04 f4 01 ; AtRate\r\n"
+  "X:1000";
+
+// Feed the script chunkSize bytes at a time and collect the commands
+static int TestParse(size_t chunkSize, sbs_bqfs_cmd_t cmd[], uint8_t maxCount, uint8_t *count)
+{
+  sbs_bqfs_parser_t parser;
+  const char *text = testScript;
+  size_t left = sizeof(testScript) - 1;
+
+  SBSBqfsParserInit(&parser);
+  *count = 0;
+
+  while (true)
+  {
+    size_t len = (left < chunkSize) ? left : chunkSize;
+    size_t consumed;
+    sbs_bqfs_cmd_t next;
+
+    int ret = SBSBqfsParse(&parser, text, len, &consumed, &next);
+    if (ret != SMBUS_ERR_OK)
+      return ret;
+    if (next.type != SBS_BQFS_CMD_NONE && *count < maxCount)
+      cmd[(*count)++] = next;
+    if (!len)
+      return SMBUS_ERR_OK;
+
+    text += consumed;
+    left -= consumed;
+  }
+}
+
+// Commands don't depend on how the text is split up
+static void TestParseChunks(void)
+{
+  static const size_t chunkSize[] = {1, 3, 7, sizeof(testScript)};
+
+  for (uint8_t i = 0; i < sizeof(chunkSize) / sizeof(chunkSize[0]); i++)
+  {
+    sbs_bqfs_cmd_t cmd[8];
+    uint8_t count;
+
+    SBS_TEST_CHECK_EQ(TestParse(chunkSize[i], cmd, 8, &count), SMBUS_ERR_OK);
+    SBS_TEST_CHECK_EQ(count, 4);
+    if (count != 4)
+      continue;
+
+    SBS_TEST_CHECK_EQ(cmd[0].type, SBS_BQFS_CMD_WRITE);
+    SBS_TEST_CHECK_EQ(cmd[0].devAddr, 0x0B);
+    SBS_TEST_CHECK_EQ(cmd[0].reg, 0x00);
+    SBS_TEST_CHECK_EQ(cmd[0].len, 2);
+    SBS_TEST_CHECK_EQ(cmd[0].data[1], 0x04);
+    SBS_TEST_CHECK_EQ(cmd[0].line, 3);
+
+    SBS_TEST_CHECK_EQ(cmd[1].type, SBS_BQFS_CMD_WAIT);
+    SBS_TEST_CHECK_EQ(cmd[1].waitMs, 2);
+
+    SBS_TEST_CHECK_EQ(cmd[2].type, SBS_BQFS_CMD_COMPARE);
+    SBS_TEST_CHECK_EQ(cmd[2].reg, 0x04);
+    SBS_TEST_CHECK_EQ(cmd[2].len, 2);
+    SBS_TEST_CHECK_EQ(cmd[2].data[0], 0xF4);
+    SBS_TEST_CHECK_EQ(cmd[2].line, 6);
+
+    // The last line has no line break
+    SBS_TEST_CHECK_EQ(cmd[3].type, SBS_BQFS_CMD_WAIT);
+    SBS_TEST_CHECK_EQ(cmd[3].waitMs, 1000);
+  }
+}
+
+static int TestParseLine(const char *text, uint32_t *line)
+{
+  sbs_bqfs_parser_t parser;
+  sbs_bqfs_cmd_t cmd;
+  size_t len = strlen(text), consumed;
+  int ret;
+
+  SBSBqfsParserInit(&parser);
+  do
+  {
+    ret = SBSBqfsParse(&parser, text, len, &consumed, &cmd);
+    text += consumed;
+    len -= consumed;
+  } while (ret == SMBUS_ERR_OK && len);
+
+  if (ret == SMBUS_ERR_OK)
+    ret = SBSBqfsParse(&parser, NULL, 0, &consumed, &cmd);
+
+  *line = parser.line;
+  return ret;
+}
+
+// Malformed lines are refused with the line they are on
+static void TestParseErrors(void)
+{
+  static const char *bad[] = {
+    "; ok\nW: 16\n",                // No register
+    "; ok\nC: 16 04\n",             // Nothing to compare
+    "; ok\nX: 1 2\n",               // Two waits
+    "; ok\nX: 1f\n",                // Waits are decimal
+    "; ok\nW: 16 100\n",            // Not a byte
+    "; ok\nW 16 04\n",              // No colon
+    "; ok\nQ: 16 04\n",             // Unknown command
+  };
+  uint32_t line;
+
+  for (uint8_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+  {
+    SBS_TEST_CHECK_EQ(TestParseLine(bad[i], &line), SMBUS_ERR_INVALID_ARG);
+    SBS_TEST_CHECK_EQ(line, 2);
+  }
+
+  char longLine[8 + 3 * (SBS_BQFS_MAX_DATA + 1) + 1] = "W: 16 44";
+  for (uint16_t i = 0; i <= SBS_BQFS_MAX_DATA; i++)
+    strcat(longLine, " 00");
+  SBS_TEST_CHECK_EQ(TestParseLine(longLine, &line), SMBUS_ERR_INVALID_ARG);
+}
+
+// Play on the simulated bus: the compare matches as soon as the write lands, so most of the wait is polled away
+static void TestPlay(void)
+{
+  sbs_smb_battery_t battery;
+  sbs_bqfs_player_t player;
+  static const char script[] = "W: 16 04 F4 01\nX: 50\nX: 50\nC: 16 04 F4 01\nC: 16 04 00 00\n";
+
+  memset(&battery, 0, sizeof(battery));
+  battery.bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+  battery.busAddress = 0x0B;
+  SBS_TEST_CHECK(battery.bus != NULL);
+  if (!battery.bus)
+    return;
+
+  SBSBqfsPlayerInit(&player, &battery);
+  SBS_TEST_CHECK_EQ(SBSBqfsPlay(&player, script, strlen(script)), SMBUS_ERR_UNEXPECTED_DATA_RECEIVED);
+  SBS_TEST_CHECK_EQ(player.line, 5);
+  SBS_TEST_CHECK_EQ(player.writes, 1);
+  SBS_TEST_CHECK_EQ(player.compares, 2);
+  SBS_TEST_CHECK_EQ(player.waitMs, 100);
+  SBS_TEST_CHECK_EQ(player.savedMs, 100 - SBS_BQFS_DEFAULT_POLL_INTERVAL_MS);
+
+  SMBusDeinit(battery.bus);
+}
+
+int main(void)
+{
+  TestParseChunks();
+  TestParseErrors();
+  TestPlay();
+  return SBS_TEST_RESULT();
+}
@@ -0,0 +1,126 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_smb.h"
+#include "sbs_cache.h"
+#include "smbus_sim.h"
+
+#define TEST_CACHE_TTL_MS       50
+
+// Changes AtRate() behind the cache's back, so a read only sees it if it went to the battery
+static void TestSetAtRate(sbs_smb_battery_t *battery, int16_t atRate)
+{
+  SMBusWriteWord(battery->bus, battery->busAddress, SBS_COMMAND_AT_RATE, (uint16_t)atRate);
+}
+
+static int16_t TestAtRate(sbs_smb_battery_t *battery)
+{
+  int16_t atRate = 0;
+
+  SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_SMB_CMD_CODE_AT_RATE, NULL, 0, &atRate, sizeof(atRate)), SMBUS_ERR_OK);
+  return atRate;
+}
+
+// A value is served from the cache until its TTL runs out
+static void TestExpiry(sbs_smb_battery_t *battery, sbs_cache_t *cache)
+{
+  TestSetAtRate(battery, 100);
+  SBS_TEST_CHECK_EQ(SBSCacheSetTtl(cache, SBS_SMB_CMD_CODE_AT_RATE, TEST_CACHE_TTL_MS), SMBUS_ERR_OK);
+
+  uint32_t misses = cache->misses;
+  SBS_TEST_CHECK_EQ(TestAtRate(battery), 100);
+  SBS_TEST_CHECK_EQ(cache->misses, misses + 1);
+
+  TestSetAtRate(battery, 200);
+  uint32_t hits = cache->hits;
+  SBS_TEST_CHECK_EQ(TestAtRate(battery), 100);
+  SBS_TEST_CHECK_EQ(cache->hits, hits + 1);
+
+  SMBusPlatformDelayMs(TEST_CACHE_TTL_MS + 10);
+  SBS_TEST_CHECK_EQ(TestAtRate(battery), 200);
+  SBS_TEST_CHECK_EQ(cache->misses, misses + 2);
+
+  // Changing the TTL drops the value read under the old one
+  TestSetAtRate(battery, 300);
+  SBS_TEST_CHECK_EQ(SBSCacheSetTtl(cache, SBS_SMB_CMD_CODE_AT_RATE, SBS_CACHE_TTL_FOREVER), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(TestAtRate(battery), 300);
+  TestSetAtRate(battery, 400);
+  SMBusPlatformDelayMs(TEST_CACHE_TTL_MS + 10);
+  SBS_TEST_CHECK_EQ(TestAtRate(battery), 300);
+
+  SBSCacheInvalidate(cache);
+  SBS_TEST_CHECK_EQ(TestAtRate(battery), 400);
+}
+
+// A write through SBSRunCommand() drops every cached value, including those that never expire
+static void TestWriteInvalidates(sbs_smb_battery_t *battery, sbs_cache_t *cache)
+{
+  uint16_t serialNumber = 0;
+  int16_t atRate = 500;
+
+  SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_SMB_CMD_CODE_SERIAL_NUMBER, NULL, 0, &serialNumber,
+                                  sizeof(serialNumber)), SMBUS_ERR_OK);
+  TestAtRate(battery);
+
+  uint32_t hits = cache->hits;
+  SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_SMB_CMD_CODE_SERIAL_NUMBER, NULL, 0, &serialNumber,
+                                  sizeof(serialNumber)), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(cache->hits, hits + 1);
+
+  SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_SMB_CMD_CODE_AT_RATE, &atRate, sizeof(atRate), NULL, 0), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(cache->hits, hits + 1);
+
+  uint32_t misses = cache->misses;
+  SBS_TEST_CHECK_EQ(TestAtRate(battery), 500);
+  SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_SMB_CMD_CODE_SERIAL_NUMBER, NULL, 0, &serialNumber,
+                                  sizeof(serialNumber)), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(cache->misses, misses + 2);
+  SBS_TEST_CHECK(serialNumber != 0);
+}
+
+// Commands that depend on a previous write, and those given no TTL, always go to the battery
+static void TestNeverCached(sbs_smb_battery_t *battery, sbs_cache_t *cache)
+{
+  uint8_t manufacturerData[1 + I2C_SMBUS_BLOCK_MAX];
+  uint16_t voltage = 0;
+
+  SBS_TEST_CHECK_EQ(SBSCacheSetTtl(cache, SBS_SMB_CMD_CODE_MANUFACTURER_DATA, SBS_CACHE_DEFAULT_TTL_MS),
+                    SMBUS_ERR_INVALID_ARG);
+  SBS_TEST_CHECK_EQ(SBSCacheSetTtl(cache, SBS_SMB_CMD_CODE_MAX, SBS_CACHE_DEFAULT_TTL_MS), SMBUS_ERR_INVALID_ARG);
+  SBS_TEST_CHECK_EQ(SBSCacheSetTtl(cache, SBS_SMB_CMD_CODE_VOLTAGE, SBS_CACHE_TTL_NONE), SMBUS_ERR_OK);
+
+  uint32_t hits = cache->hits, misses = cache->misses;
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_SMB_CMD_CODE_VOLTAGE, NULL, 0, &voltage, sizeof(voltage)),
+                      SMBUS_ERR_OK);
+    SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_DATA, NULL, 0, manufacturerData,
+                                    sizeof(manufacturerData)), SMBUS_ERR_OK);
+  }
+  SBS_TEST_CHECK_EQ(cache->hits, hits);
+  SBS_TEST_CHECK_EQ(cache->misses, misses);
+}
+
+int main(void)
+{
+  sbs_smb_battery_t battery;
+  sbs_cache_t cache;
+
+  memset(&battery, 0, sizeof(battery));
+  battery.bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+  battery.busAddress = 0x0B;
+  SBS_TEST_CHECK(battery.bus != NULL);
+  SBS_TEST_CHECK_EQ(SBSCacheInit(&cache), SMBUS_ERR_OK);
+  if (battery.bus)
+  {
+    battery.cache = &cache;
+    TestExpiry(&battery, &cache);
+    TestWriteInvalidates(&battery, &cache);
+    TestNeverCached(&battery, &cache);
+    SMBusDeinit(battery.bus);
+  }
+  SBSCacheDeinit(&cache);
+
+  return SBS_TEST_RESULT();
+}
@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_smb.h"
+#include "sbs_mux.h"
+#include "sbs_charger.h"
+#include "smbus_sim.h"
+
+#define TEST_CHARGER_PERIOD_MS  20
+
+// Waits out the period so the next poll reads the battery
+static bool TestPollDue(sbs_charger_t *charger)
+{
+  SMBusPlatformDelayMs(charger->waitMs + 1);
+  return SBSChargerPoll(charger);
+}
+
+// Both requests are written on the first poll, then nothing until the period is up and a request changes
+static void TestWriteOnChange(sbs_charger_t *charger)
+{
+  SBS_TEST_CHECK(SBSChargerPoll(charger));
+  SBS_TEST_CHECK_EQ(charger->result, SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(charger->writes, 2);
+  SBS_TEST_CHECK(charger->written);
+  SBS_TEST_CHECK_EQ(charger->voltage, charger->battery->chargingVoltage);
+  SBS_TEST_CHECK_EQ(charger->current, charger->battery->chargingCurrent);
+  SBS_TEST_CHECK(charger->voltage != 0 && charger->current != 0);
+
+  SBS_TEST_CHECK(!SBSChargerPoll(charger));
+  SBS_TEST_CHECK(charger->waitMs > 0 && charger->waitMs <= TEST_CHARGER_PERIOD_MS);
+
+  SBS_TEST_CHECK(TestPollDue(charger));
+  SBS_TEST_CHECK_EQ(charger->writes, 2);
+
+  // Only the request that differs from what the charger holds is written
+  uint16_t current = charger->current;
+  charger->current = current / 2;
+  SBS_TEST_CHECK(TestPollDue(charger));
+  SBS_TEST_CHECK_EQ(charger->writes, 3);
+  SBS_TEST_CHECK_EQ(charger->current, current);
+
+  SBSChargerInvalidate(charger);
+  SBS_TEST_CHECK(TestPollDue(charger));
+  SBS_TEST_CHECK_EQ(charger->writes, 5);
+}
+
+// Unchanged values are written again once refreshMs has passed, to keep the charger's watchdog from expiring
+static void TestRefresh(sbs_charger_t *charger)
+{
+  uint32_t writes = charger->writes;
+
+  charger->refreshMs = 10 * TEST_CHARGER_PERIOD_MS;
+  SBS_TEST_CHECK(TestPollDue(charger));
+  SBS_TEST_CHECK_EQ(charger->writes, writes);
+
+  SMBusPlatformDelayMs(charger->refreshMs);
+  SBS_TEST_CHECK(TestPollDue(charger));
+  SBS_TEST_CHECK_EQ(charger->writes, writes + 2);
+
+  SBS_TEST_CHECK(TestPollDue(charger));
+  SBS_TEST_CHECK_EQ(charger->writes, writes + 2);
+
+  // 0 only writes changes
+  charger->refreshMs = 0;
+  SMBusPlatformDelayMs(3 * TEST_CHARGER_PERIOD_MS);
+  SBS_TEST_CHECK(TestPollDue(charger));
+  SBS_TEST_CHECK_EQ(charger->writes, writes + 2);
+}
+
+// After a failed write the charger's values are unknown, so the next poll that gets through sends both
+static void TestFailedWrite(sbs_charger_t *charger, sbs_mux_t *mux)
+{
+  uint32_t writes = charger->writes;
+
+  SBSChargerInvalidate(charger);
+  charger->mux = mux;
+  charger->muxChannel = SBS_MUX_MAX_CHANNELS;
+  SBS_TEST_CHECK(TestPollDue(charger));
+  SBS_TEST_CHECK_EQ(charger->result, SMBUS_ERR_INVALID_ARG);
+  SBS_TEST_CHECK(!charger->written);
+  SBS_TEST_CHECK_EQ(charger->writes, writes);
+
+  charger->mux = NULL;
+  SBS_TEST_CHECK(TestPollDue(charger));
+  SBS_TEST_CHECK_EQ(charger->result, SMBUS_ERR_OK);
+  SBS_TEST_CHECK(charger->written);
+  SBS_TEST_CHECK_EQ(charger->writes, writes + 2);
+}
+
+int main(void)
+{
+  sbs_smb_battery_t battery;
+  sbs_charger_t charger;
+  sbs_mux_t mux;
+
+  memset(&battery, 0, sizeof(battery));
+  battery.bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+  battery.busAddress = 0x0B;
+  SBS_TEST_CHECK(battery.bus != NULL);
+  if (battery.bus)
+  {
+    SBSMuxInit(&mux, battery.bus, SMBUS_SIM_MUX_ADDRESS_FIRST, NULL);
+    SBSChargerInit(&charger, battery.bus, SBS_CHARGER_DEFAULT_ADDRESS, &battery, TEST_CHARGER_PERIOD_MS);
+    TestWriteOnChange(&charger);
+    TestRefresh(&charger);
+    TestFailedWrite(&charger, &mux);
+    SMBusDeinit(battery.bus);
+  }
+
+  return SBS_TEST_RESULT();
+}
@@ -0,0 +1,134 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_smb.h"
+#include "sbs_mux.h"
+#include "smbus_sim.h"
+
+#define TEST_MUX_A      SMBUS_SIM_MUX_ADDRESS_FIRST
+#define TEST_MUX_B      (SMBUS_SIM_MUX_ADDRESS_FIRST + 1)
+
+// Channel mask the simulated mux really has enabled
+static uint8_t TestMask(smbus_handle_t bus, uint8_t address)
+{
+  uint8_t mask = 0xFF;
+
+  SMBusReceiveByte(bus, address, &mask);
+  return mask;
+}
+
+// Changing the mask behind the handle's back shows whether a select was sent
+static void TestSetMask(smbus_handle_t bus, uint8_t address, uint8_t mask)
+{
+  SMBusWriteRaw(bus, address, &mask, 1);
+}
+
+// A select is only sent when the channel changes, or once the handle no longer knows the channel
+static void TestSelectOnce(smbus_handle_t bus)
+{
+  sbs_mux_t mux;
+
+  SBSMuxInit(&mux, bus, TEST_MUX_A, NULL);
+  SBS_TEST_CHECK_EQ(mux.activeChannel, SBS_MUX_CHANNEL_UNKNOWN);
+
+  SBS_TEST_CHECK_EQ(SBSMuxSelect(&mux, 1), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(TestMask(bus, TEST_MUX_A), 1 << 1);
+  SBS_TEST_CHECK_EQ(mux.activeChannel, 1);
+
+  TestSetMask(bus, TEST_MUX_A, 1 << 5);
+  SBS_TEST_CHECK_EQ(SBSMuxSelect(&mux, 1), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(TestMask(bus, TEST_MUX_A), 1 << 5);
+
+  SBSMuxInvalidate(&mux);
+  SBS_TEST_CHECK_EQ(SBSMuxSelect(&mux, 1), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(TestMask(bus, TEST_MUX_A), 1 << 1);
+
+  SBS_TEST_CHECK_EQ(SBSMuxSelect(&mux, 2), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(TestMask(bus, TEST_MUX_A), 1 << 2);
+
+  SBS_TEST_CHECK_EQ(SBSMuxSelect(&mux, SBS_MUX_MAX_CHANNELS), SMBUS_ERR_INVALID_ARG);
+  SBS_TEST_CHECK_EQ(mux.activeChannel, 2);
+
+  SBS_TEST_CHECK_EQ(SBSMuxDisable(&mux), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(TestMask(bus, TEST_MUX_A), 0);
+  SBS_TEST_CHECK_EQ(mux.activeChannel, SBS_MUX_CHANNEL_NONE);
+}
+
+// Selecting on one mux disables the others on the bus, so batteries at the same address never collide
+static void TestSharedBus(smbus_handle_t bus)
+{
+  sbs_smb_battery_t battery[2];
+  sbs_mux_t mux[2];
+  uint16_t serialNumber[2];
+
+  SBSMuxInit(&mux[0], bus, TEST_MUX_A, NULL);
+  SBSMuxInit(&mux[1], bus, TEST_MUX_B, &mux[0]);
+  SBSMuxDisable(&mux[0]);
+  SBSMuxDisable(&mux[1]);
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    memset(&battery[i], 0, sizeof(battery[i]));
+    battery[i].bus = bus;
+    battery[i].busAddress = 0x0B;
+    battery[i].mux = &mux[i];
+    battery[i].muxChannel = 3;
+  }
+
+  SBS_TEST_CHECK_EQ(SBSRunCommand(&battery[0], SBS_SMB_CMD_CODE_SERIAL_NUMBER, NULL, 0, &serialNumber[0],
+                                  sizeof(serialNumber[0])), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(SBSRunCommand(&battery[1], SBS_SMB_CMD_CODE_SERIAL_NUMBER, NULL, 0, &serialNumber[1],
+                                  sizeof(serialNumber[1])), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(serialNumber[0] != serialNumber[1]);
+  SBS_TEST_CHECK_EQ(TestMask(bus, TEST_MUX_A), 0);
+  SBS_TEST_CHECK_EQ(TestMask(bus, TEST_MUX_B), 1 << 3);
+  SBS_TEST_CHECK_EQ(mux[0].activeChannel, SBS_MUX_CHANNEL_NONE);
+
+  SBSMuxDisable(&mux[1]);
+}
+
+// Batteries are grouped by bus, mux and channel so each channel is selected once per pass
+static void TestSort(smbus_handle_t bus)
+{
+  sbs_smb_battery_t battery[5], *order[5];
+  sbs_mux_t mux;
+  static const int8_t channel[5] = { 2, 0, 2, 1, 0 };
+  int ret[5];
+
+  SBSMuxInit(&mux, bus, TEST_MUX_A, NULL);
+  for (uint8_t i = 0; i < 5; i++)
+  {
+    memset(&battery[i], 0, sizeof(battery[i]));
+    battery[i].bus = bus;
+    battery[i].busAddress = 0x0B + 2 * (i % 2);
+    battery[i].mux = &mux;
+    battery[i].muxChannel = channel[i];
+    order[i] = &battery[i];
+  }
+
+  SBS_TEST_CHECK_EQ(SBSMuxGetBatteryInfo(order, 5, ret), 0);
+  for (uint8_t i = 0; i < 5; i++)
+    SBS_TEST_CHECK_EQ(ret[i], SMBUS_ERR_OK);
+  for (uint8_t i = 1; i < 5; i++)
+    SBS_TEST_CHECK(order[i - 1]->muxChannel <= order[i]->muxChannel);
+  SBS_TEST_CHECK_EQ(mux.activeChannel, 2);
+
+  SBSMuxDisable(&mux);
+}
+
+int main(void)
+{
+  smbus_handle_t bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+
+  SBS_TEST_CHECK(bus != NULL);
+  if (bus)
+  {
+    TestSelectOnce(bus);
+    TestSharedBus(bus);
+    TestSort(bus);
+    SMBusDeinit(bus);
+  }
+
+  return SBS_TEST_RESULT();
+}
@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_smb.h"
+#include "sbs_bqfs.h"
+#include "smbus_sim.h"
+
+#define TEST_PEC_ADDRESS        0x0B    // Simulated batteries at odd addresses report SBS 1.1 with PEC
+#define TEST_NO_PEC_ADDRESS     0x0C
+
+static void TestBattery(sbs_smb_battery_t *battery, smbus_handle_t bus, uint8_t busAddress, sbs_smb_pec_t pec)
+{
+  memset(battery, 0, sizeof(*battery));
+  battery->bus = bus;
+  battery->busAddress = busAddress;
+  battery->pec = pec;
+}
+
+static bool TestBusPec(smbus_handle_t bus)
+{
+  smbus_info_t info;
+
+  SMBusGetInfo(bus, &info);
+  return info.usePEC;
+}
+
+// A battery that doesn't ask for anything gets PEC as the bus was set up, whatever the last device left
+static void TestBusSetting(void)
+{
+  smbus_handle_t bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, true);
+  sbs_smb_battery_t battery, noPec;
+  uint16_t voltage;
+
+  SBS_TEST_CHECK(bus != NULL);
+  if (!bus)
+    return;
+
+  TestBattery(&battery, bus, TEST_PEC_ADDRESS, 0);
+  SBS_TEST_CHECK_EQ(battery.pec, SBS_SMB_PEC_BUS);
+  SBS_TEST_CHECK_EQ(SBSRunCommand(&battery, SBS_SMB_CMD_CODE_VOLTAGE, NULL, 0, &voltage, sizeof(voltage)), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(battery.pec, SBS_SMB_PEC_BUS);
+  SBS_TEST_CHECK(TestBusPec(bus));
+
+  TestBattery(&noPec, bus, TEST_NO_PEC_ADDRESS, SBS_SMB_PEC_OFF);
+  SBS_TEST_CHECK_EQ(SBSRunCommand(&noPec, SBS_SMB_CMD_CODE_VOLTAGE, NULL, 0, &voltage, sizeof(voltage)), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(!TestBusPec(bus));
+  SBS_TEST_CHECK_EQ(SBSRunCommand(&battery, SBS_SMB_CMD_CODE_VOLTAGE, NULL, 0, &voltage, sizeof(voltage)), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(TestBusPec(bus));
+
+  SMBusSetPec(bus, false);
+  SBS_TEST_CHECK_EQ(SBSSelectBattery(&battery), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(TestBusPec(bus));
+
+  SMBusDeinit(bus);
+}
+
+// AUTO settles on ON or OFF from SpecificationInfo() on the first select that it answers
+static void TestNegotiate(void)
+{
+  smbus_handle_t bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+  sbs_smb_battery_t battery;
+  uint16_t voltage;
+
+  SBS_TEST_CHECK(bus != NULL);
+  if (!bus)
+    return;
+
+  TestBattery(&battery, bus, TEST_PEC_ADDRESS, SBS_SMB_PEC_AUTO);
+  SBS_TEST_CHECK_EQ(SBSRunCommand(&battery, SBS_SMB_CMD_CODE_VOLTAGE, NULL, 0, &voltage, sizeof(voltage)), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(battery.pec, SBS_SMB_PEC_ON);
+  SBS_TEST_CHECK(TestBusPec(bus));
+
+  TestBattery(&battery, bus, TEST_NO_PEC_ADDRESS, SBS_SMB_PEC_AUTO);
+  SBS_TEST_CHECK_EQ(SBSRunCommand(&battery, SBS_SMB_CMD_CODE_VOLTAGE, NULL, 0, &voltage, sizeof(voltage)), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(battery.pec, SBS_SMB_PEC_OFF);
+  SBS_TEST_CHECK(!TestBusPec(bus));
+
+  // The selector doesn't answer SpecificationInfo(), like a pack that isn't there, so it is asked again next time
+  TestBattery(&battery, bus, SMBUS_SIM_SELECTOR_ADDRESS, SBS_SMB_PEC_AUTO);
+  SBS_TEST_CHECK(SBSSelectBattery(&battery) != SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(battery.pec, SBS_SMB_PEC_AUTO);
+  SBS_TEST_CHECK(SBSSelectBattery(&battery) != SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(battery.pec, SBS_SMB_PEC_AUTO);
+
+  SMBusDeinit(bus);
+}
+
+// Flash streams only route the battery, so they never negotiate
+static void TestFlashStreamSkips(void)
+{
+  smbus_handle_t bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+  sbs_smb_battery_t battery;
+  sbs_bqfs_player_t player;
+  static const char script[] = "W: 16 04 00 00\nC: 16 04 00 00\n";
+
+  SBS_TEST_CHECK(bus != NULL);
+  if (!bus)
+    return;
+
+  TestBattery(&battery, bus, TEST_PEC_ADDRESS, SBS_SMB_PEC_AUTO);
+  SBSBqfsPlayerInit(&player, &battery);
+  SBS_TEST_CHECK_EQ(SBSBqfsPlay(&player, script, strlen(script)), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(battery.pec, SBS_SMB_PEC_AUTO);
+  SBS_TEST_CHECK(!TestBusPec(bus));
+
+  SMBusDeinit(bus);
+}
+
+int main(void)
+{
+  TestBusSetting();
+  TestNegotiate();
+  TestFlashStreamSkips();
+  return SBS_TEST_RESULT();
+}
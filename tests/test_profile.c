@@ -0,0 +1,138 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_profile.h"
+#include "smbus_sim.h"
+
+static void TestProfile(sbs_profile_t *profile, uint16_t serialNumber)
+{
+  memset(profile, 0, sizeof(*profile));
+  profile->serialNumber = serialNumber;
+  profile->manufactureDate = 0x586F;
+  profile->specInfo = 0x0031;
+  profile->deviceType = 0x4500;
+  profile->chemicalId = 0x1210;
+  profile->pec = true;
+  profile->mac = SBS_PROFILE_MAC_BLOCK_ACCESS;
+  profile->auth = SBS_PROFILE_AUTH_TWO_WORD_KEY;
+  profile->supported[0] = 0xA5;
+  profile->supported[SBS_PROFILE_CMD_BYTES - 1] = 0x01;
+}
+
+// Every serialized field comes back, and the changed flags don't
+static void TestRoundTrip(void)
+{
+  sbs_profile_t profile[3], loaded[3], probed;
+  sbs_profile_store_t store, loadedStore;
+  uint8_t blob[256];
+
+  SBSProfileStoreInit(&store, profile, 3);
+  for (uint16_t i = 0; i < 3; i++)
+  {
+    TestProfile(&probed, 100 + i);
+    SBS_TEST_CHECK(SBSProfileStorePut(&store, &probed) == &profile[i]);
+  }
+
+  // Same battery again replaces its profile
+  TestProfile(&probed, 101);
+  probed.chemicalId = 0x0354;
+  SBS_TEST_CHECK(SBSProfileStorePut(&store, &probed) == &profile[1]);
+  SBS_TEST_CHECK_EQ(store.count, 3);
+
+  size_t len = SBSProfileStoreSerialize(&store, blob, sizeof(blob));
+  SBS_TEST_CHECK_EQ(len, SBSProfileStoreBlobSize(&store));
+  SBS_TEST_CHECK_EQ(SBSProfileStoreSerialize(&store, blob, len - 1), 0);
+
+  SBSProfileStoreInit(&loadedStore, loaded, 3);
+  SBS_TEST_CHECK_EQ(SBSProfileStoreDeserialize(&loadedStore, blob, len), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(loadedStore.count, 3);
+  SBS_TEST_CHECK(!SBSProfileStoreChanged(&loadedStore));
+
+  SBSProfileStoreSaved(&store);
+  SBS_TEST_CHECK(!memcmp(profile, loaded, sizeof(profile)));
+
+  sbs_profile_t *found = SBSProfileStoreFind(&loadedStore, 101, 0x586F);
+  SBS_TEST_CHECK(found != NULL);
+  if (found)
+  {
+    SBS_TEST_CHECK_EQ(found->chemicalId, 0x0354);
+    SBS_TEST_CHECK(SBSProfileSupports(found, 0));
+    SBS_TEST_CHECK(!SBSProfileSupports(found, 1));
+    SBS_TEST_CHECK(SBSProfileSupports(found, 8 * (SBS_PROFILE_CMD_BYTES - 1)));
+  }
+}
+
+// Damaged or foreign blobs leave the store empty, and a blob too big for the store keeps what fits
+static void TestBadBlobs(void)
+{
+  sbs_profile_t profile[2], loaded[2];
+  sbs_profile_store_t store, loadedStore;
+  uint8_t blob[256];
+
+  SBSProfileStoreInit(&store, profile, 2);
+  for (uint16_t i = 0; i < 2; i++)
+  {
+    sbs_profile_t probed;
+    TestProfile(&probed, 200 + i);
+    SBSProfileStorePut(&store, &probed);
+  }
+  size_t len = SBSProfileStoreSerialize(&store, blob, sizeof(blob));
+
+  SBSProfileStoreInit(&loadedStore, loaded, 2);
+
+  blob[len / 2] ^= 0x10;
+  SBS_TEST_CHECK_EQ(SBSProfileStoreDeserialize(&loadedStore, blob, len), SMBUS_ERR_UNEXPECTED_DATA_RECEIVED);
+  SBS_TEST_CHECK_EQ(loadedStore.count, 0);
+  blob[len / 2] ^= 0x10;
+
+  SBS_TEST_CHECK_EQ(SBSProfileStoreDeserialize(&loadedStore, blob, len - 1), SMBUS_ERR_UNEXPECTED_DATA_RECEIVED);
+
+  blob[4]++;
+  SBS_TEST_CHECK_EQ(SBSProfileStoreDeserialize(&loadedStore, blob, len), SMBUS_ERR_UNEXPECTED_DATA_RECEIVED);
+  blob[4]--;
+
+  SBSProfileStoreInit(&loadedStore, loaded, 1);
+  SBS_TEST_CHECK_EQ(SBSProfileStoreDeserialize(&loadedStore, blob, len), SMBUS_ERR_FAIL);
+  SBS_TEST_CHECK_EQ(loadedStore.count, 1);
+  SBS_TEST_CHECK_EQ(loaded[0].serialNumber, 200);
+}
+
+// A simulated battery is probed once, then recognized, and its PEC comes from the profile
+static void TestProbe(void)
+{
+  sbs_smb_battery_t battery;
+  sbs_profile_t profile[1], *found;
+  sbs_profile_store_t store;
+
+  memset(&battery, 0, sizeof(battery));
+  battery.bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+  battery.busAddress = 0x0B;
+  battery.pec = SBS_SMB_PEC_AUTO;
+  SBS_TEST_CHECK(battery.bus != NULL);
+  if (!battery.bus)
+    return;
+
+  SBSProfileStoreInit(&store, profile, 1);
+  SBS_TEST_CHECK_EQ(SBSProfileGet(&battery, &store, &found), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(found == &profile[0]);
+  SBS_TEST_CHECK(profile[0].pec);
+  SBS_TEST_CHECK_EQ(battery.pec, SBS_SMB_PEC_ON);
+  SBS_TEST_CHECK(SBSProfileSupports(&profile[0], SBS_SMB_CMD_CODE_SERIAL_NUMBER));
+  SBS_TEST_CHECK(SBSProfileStoreChanged(&store));
+
+  SBSProfileStoreSaved(&store);
+  SBS_TEST_CHECK_EQ(SBSProfileGet(&battery, &store, &found), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(found == &profile[0]);
+  SBS_TEST_CHECK(!SBSProfileStoreChanged(&store));
+
+  SMBusDeinit(battery.bus);
+}
+
+int main(void)
+{
+  TestRoundTrip();
+  TestBadBlobs();
+  TestProbe();
+  return SBS_TEST_RESULT();
+}
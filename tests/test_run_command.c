@@ -0,0 +1,79 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_smb.h"
+#include "sbs_bq_cmd.h"
+#include "smbus_sim.h"
+
+// The simulated battery returns the last ManufacturerAccess() or ManufacturerBlockAccess() command in both
+static uint16_t TestMacCommand(sbs_smb_battery_t *battery)
+{
+  uint16_t value = 0;
+
+  SMBusReadWord(battery->bus, battery->busAddress, SBS_COMMAND_MANUFACTURER_ACCESS, &value);
+  return value;
+}
+
+// A split command run with only an input sends it as the subcommand
+static void TestWriteOnly(sbs_smb_battery_t *battery)
+{
+  uint16_t subCommand = 0x0041;
+
+  SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_ACCESS, &subCommand, sizeof(subCommand),
+                                  NULL, 0), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(TestMacCommand(battery), 0x0041);
+
+  subCommand = 0x0012;
+  SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_BLOCK_ACCESS, &subCommand, sizeof(subCommand),
+                                  NULL, 0), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(TestMacCommand(battery), 0x0012);
+
+  // A chip command sends its own
+  SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_BQ_CMD_CODE_CALIBRATION_OUTPUT_EXIT, NULL, 0, NULL, 0), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(TestMacCommand(battery) != 0x0012);
+}
+
+// Nothing to send or read is not a success
+static void TestNothingSent(sbs_smb_battery_t *battery)
+{
+  SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_SMB_CMD_CODE_VOLTAGE, NULL, 0, NULL, 0), SMBUS_ERR_FAIL);
+  SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_SMB_CMD_CODE_MANUFACTURER_ACCESS, NULL, 0, NULL, 0), SMBUS_ERR_FAIL);
+}
+
+// Chip commands resolve only once a command set is bound, SBS commands resolve either way
+static void TestCommandSet(sbs_smb_battery_t *battery)
+{
+  sbs_bq_operation_status_t op;
+  uint16_t voltage = 0;
+
+  battery->cmdSet = NULL;
+  SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_BQ_CMD_CODE_OPERATION_STATUS, NULL, 0, &op, sizeof(op)),
+                    SMBUS_ERR_INVALID_ARG);
+
+  SBSBqBindCommands(battery);
+  SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_BQ_CMD_CODE_OPERATION_STATUS, NULL, 0, &op, sizeof(op)), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(op.securityMode, SBS_BQ_SECURITY_MODE_SEALED);
+  SBS_TEST_CHECK_EQ(SBSRunCommand(battery, SBS_SMB_CMD_CODE_VOLTAGE, NULL, 0, &voltage, sizeof(voltage)), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(voltage != 0);
+}
+
+int main(void)
+{
+  sbs_smb_battery_t battery;
+
+  memset(&battery, 0, sizeof(battery));
+  battery.bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+  battery.busAddress = 0x0B;
+  SBS_TEST_CHECK(battery.bus != NULL);
+  if (battery.bus)
+  {
+    SBSBqBindCommands(&battery);
+    TestWriteOnly(&battery);
+    TestNothingSent(&battery);
+    TestCommandSet(&battery);
+    SMBusDeinit(battery.bus);
+  }
+
+  return SBS_TEST_RESULT();
+}
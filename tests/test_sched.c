@@ -0,0 +1,131 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_smb.h"
+#include "sbs_bq_cmd.h"
+#include "sbs_mux.h"
+#include "sbs_sched.h"
+#include "smbus_sim.h"
+
+static void TestBattery(sbs_smb_battery_t *battery, smbus_handle_t bus, uint8_t busAddress)
+{
+  memset(battery, 0, sizeof(*battery));
+  battery->bus = bus;
+  battery->busAddress = busAddress;
+  SBSBqBindCommands(battery);
+}
+
+// An output smaller than the command decodes is refused when the job is added and when it is collected
+static void TestOutSize(smbus_handle_t bus)
+{
+  sbs_smb_battery_t battery;
+  sbs_sched_job_t job[2];
+  sbs_sched_t sched;
+  uint32_t small;
+
+  TestBattery(&battery, bus, 0x0B);
+  SBSSchedInit(&sched, job, 2);
+
+  SBS_TEST_CHECK(SBSSchedAdd(&sched, &battery, SBS_BQ_CMD_CODE_OPERATION_STATUS, 0, 0, &small, sizeof(small)) == NULL);
+  SBS_TEST_CHECK(SBSSchedAdd(&sched, &battery, SBS_BQ_CMD_CODE_OPERATION_STATUS, 0, 0, &small, 0) == NULL);
+  SBS_TEST_CHECK_EQ(sched.count, 0);
+
+  SBS_TEST_CHECK_EQ(SBSRunCommand(&battery, SBS_BQ_CMD_CODE_OPERATION_STATUS, NULL, 0, &small, sizeof(small)),
+                    SMBUS_ERR_INVALID_ARG);
+  SBS_TEST_CHECK_EQ(SBSSubmitCommand(&battery, SBS_BQ_CMD_CODE_OPERATION_STATUS, 0), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(SBSCollectCommand(&battery, SBS_BQ_CMD_CODE_OPERATION_STATUS, &small, sizeof(small)),
+                    SMBUS_ERR_INVALID_ARG);
+}
+
+// A split command is submitted and collected in two polls, with a job for another gauge run in between
+static void TestOverlap(smbus_handle_t bus)
+{
+  sbs_smb_battery_t first, second;
+  sbs_bq_operation_status_t op;
+  sbs_sched_job_t job[3];
+  sbs_sched_t sched;
+  uint16_t voltage = 0, serialNumber = 0;
+
+  TestBattery(&first, bus, 0x0B);
+  TestBattery(&second, bus, 0x0D);
+  SBSSchedInit(&sched, job, 3);
+
+  sbs_sched_job_t *mac = SBSSchedAdd(&sched, &first, SBS_BQ_CMD_CODE_OPERATION_STATUS, 0, 50, &op, sizeof(op));
+  sbs_sched_job_t *same = SBSSchedAdd(&sched, &first, SBS_SMB_CMD_CODE_SERIAL_NUMBER, 0, 0, &serialNumber,
+                                      sizeof(serialNumber));
+  sbs_sched_job_t *other = SBSSchedAdd(&sched, &second, SBS_SMB_CMD_CODE_VOLTAGE, 0, 0, &voltage, sizeof(voltage));
+  SBS_TEST_CHECK(mac && same && other);
+  if (!mac || !same || !other)
+    return;
+
+  SBS_TEST_CHECK(SBSSchedPoll(&sched));
+  SBS_TEST_CHECK_EQ(mac->state, SBS_SCHED_JOB_WAITING);
+
+  // The same gauge has to wait for its response, the other one doesn't
+  SBS_TEST_CHECK(SBSSchedPoll(&sched));
+  SBS_TEST_CHECK_EQ(same->state, SBS_SCHED_JOB_QUEUED);
+  SBS_TEST_CHECK_EQ(other->state, SBS_SCHED_JOB_DONE);
+  SBS_TEST_CHECK(voltage != 0);
+
+  SBS_TEST_CHECK(SBSSchedPoll(&sched));
+  SBS_TEST_CHECK_EQ(mac->state, SBS_SCHED_JOB_WAITING);
+  SBS_TEST_CHECK(sched.waitMs > 0 && sched.waitMs <= 50);
+
+  SBS_TEST_CHECK_EQ(SBSSchedRun(&sched), 0);
+  SBS_TEST_CHECK_EQ(mac->state, SBS_SCHED_JOB_DONE);
+  SBS_TEST_CHECK_EQ(op.securityMode, SBS_BQ_SECURITY_MODE_SEALED);
+  SBS_TEST_CHECK_EQ(same->state, SBS_SCHED_JOB_DONE);
+  SBS_TEST_CHECK(serialNumber != 0);
+  SBS_TEST_CHECK(!SBSSchedPoll(&sched));
+}
+
+// A battery on the enabled mux channel goes before an older job that needs a switch
+static void TestRouted(smbus_handle_t bus)
+{
+  sbs_smb_battery_t battery[2];
+  sbs_sched_job_t job[2];
+  sbs_sched_t sched;
+  uint16_t voltage[2];
+  sbs_mux_t mux;
+
+  SBSMuxInit(&mux, bus, SBS_MUX_DEFAULT_ADDRESS, NULL);
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    TestBattery(&battery[i], bus, 0x0B);
+    battery[i].mux = &mux;
+    battery[i].muxChannel = i + 1;
+  }
+  SBS_TEST_CHECK_EQ(SBSMuxSelect(&mux, 2), SMBUS_ERR_OK);
+
+  SBSSchedInit(&sched, job, 2);
+  SBSSchedAdd(&sched, &battery[0], SBS_SMB_CMD_CODE_VOLTAGE, 0, 0, &voltage[0], sizeof(voltage[0]));
+  SBSSchedAdd(&sched, &battery[1], SBS_SMB_CMD_CODE_VOLTAGE, 0, 0, &voltage[1], sizeof(voltage[1]));
+
+  SBS_TEST_CHECK(SBSSchedPoll(&sched));
+  SBS_TEST_CHECK_EQ(job[0].state, SBS_SCHED_JOB_QUEUED);
+  SBS_TEST_CHECK_EQ(job[1].state, SBS_SCHED_JOB_DONE);
+  SBS_TEST_CHECK_EQ(mux.activeChannel, 2);
+
+  SBS_TEST_CHECK(SBSSchedPoll(&sched));
+  SBS_TEST_CHECK_EQ(job[0].state, SBS_SCHED_JOB_DONE);
+  SBS_TEST_CHECK_EQ(mux.activeChannel, 1);
+
+  SBSMuxDisable(&mux);
+}
+
+int main(void)
+{
+  smbus_handle_t bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+
+  SBS_TEST_CHECK(bus != NULL);
+  if (bus)
+  {
+    TestOutSize(bus);
+    TestOverlap(bus);
+    TestRouted(bus);
+    SMBusDeinit(bus);
+  }
+
+  return SBS_TEST_RESULT();
+}
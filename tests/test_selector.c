@@ -0,0 +1,103 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_smb.h"
+#include "sbs_selector.h"
+#include "smbus_sim.h"
+
+// SelectorState() as it is on the wire, read without PEC like the selector expects
+static uint16_t TestRawState(smbus_handle_t bus)
+{
+  uint16_t value = 0;
+
+  SMBusSetPec(bus, false);
+  SMBusReadWord(bus, SBS_SELECTOR_DEFAULT_ADDRESS, SBS_SELECTOR_COMMAND_STATE, &value);
+  return value;
+}
+
+// [15:12 SMB][11:8 POWER_BY][7:4 CHARGE][3:0 PRESENT]
+static void TestStateLayout(void)
+{
+  smbus_handle_t bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+  sbs_selector_state_t state;
+  sbs_mux_t selector;
+
+  SBS_TEST_CHECK(bus != NULL);
+  if (!bus)
+    return;
+
+  SBSSelectorInit(&selector, bus, SBS_SELECTOR_DEFAULT_ADDRESS);
+
+  // The simulated selector starts on battery A with all four present
+  SBS_TEST_CHECK_EQ(TestRawState(bus), 0x110F);
+  SBS_TEST_CHECK_EQ(SBSSelectorReadState(&selector, &state), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(state.smb, 0x1);
+  SBS_TEST_CHECK_EQ(state.powerBy, 0x1);
+  SBS_TEST_CHECK_EQ(state.charge, 0x0);
+  SBS_TEST_CHECK_EQ(state.present, 0xF);
+  SBS_TEST_CHECK_EQ(selector.activeChannel, 0);
+
+  // PRESENT is read only
+  state.smb = 0x4;
+  state.charge = 0x2;
+  state.present = 0;
+  SBS_TEST_CHECK_EQ(SBSSelectorWriteState(&selector, &state), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(TestRawState(bus), 0x412F);
+  SBS_TEST_CHECK_EQ(selector.activeChannel, 2);
+
+  SMBusDeinit(bus);
+}
+
+// Selecting a battery only changes the SMB nibble and reaches a different battery at the same address
+static void TestSwitch(void)
+{
+  smbus_handle_t bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, true);
+  sbs_smb_battery_t battery[SBS_SELECTOR_MAX_BATTERIES];
+  uint16_t serialNumber[SBS_SELECTOR_MAX_BATTERIES];
+  sbs_mux_t selector;
+
+  SBS_TEST_CHECK(bus != NULL);
+  if (!bus)
+    return;
+
+  SBSSelectorInit(&selector, bus, SBS_SELECTOR_DEFAULT_ADDRESS);
+
+  for (uint8_t i = 0; i < SBS_SELECTOR_MAX_BATTERIES; i++)
+  {
+    memset(&battery[i], 0, sizeof(battery[i]));
+    battery[i].bus = bus;
+    battery[i].busAddress = 0x0B;
+    battery[i].mux = &selector;
+    battery[i].muxChannel = i;
+  }
+
+  for (int8_t i = SBS_SELECTOR_MAX_BATTERIES - 1; i >= 0; i--)
+  {
+    SBS_TEST_CHECK_EQ(SBSRunCommand(&battery[i], SBS_SMB_CMD_CODE_SERIAL_NUMBER, NULL, 0, &serialNumber[i],
+                                    sizeof(serialNumber[i])), SMBUS_ERR_OK);
+    SBS_TEST_CHECK_EQ(selector.activeChannel, i);
+    SBS_TEST_CHECK_EQ(TestRawState(bus), ((1 << i) << SBS_SELECTOR_SMB_SHIFT) | 0x010F);
+    SMBusSetPec(bus, true);
+  }
+
+  for (uint8_t i = 1; i < SBS_SELECTOR_MAX_BATTERIES; i++)
+    SBS_TEST_CHECK(serialNumber[i] != serialNumber[0]);
+
+  // The bus is left with PEC as it was
+  smbus_info_t info;
+  SBS_TEST_CHECK_EQ(SBSMuxSelect(&selector, 1), SMBUS_ERR_OK);
+  SMBusGetInfo(bus, &info);
+  SBS_TEST_CHECK(info.usePEC);
+
+  SBS_TEST_CHECK_EQ(SBSMuxSelect(&selector, SBS_SELECTOR_MAX_BATTERIES), SMBUS_ERR_INVALID_ARG);
+
+  SMBusDeinit(bus);
+}
+
+int main(void)
+{
+  TestStateLayout();
+  TestSwitch();
+  return SBS_TEST_RESULT();
+}
@@ -0,0 +1,149 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "sbs_test.h"
+#include "sbs_smb.h"
+#include "sbs_shm.h"
+
+#define TEST_SHM_SLOTS          2
+#define TEST_SHM_PUBLISHES      200000
+
+typedef struct
+{
+  sbs_shm_t *shm;
+  volatile int done;
+}test_shm_writer_t;
+
+// Every field of a published battery is derived from the same count, so a torn copy has fields that disagree
+static void TestFill(sbs_smb_battery_t *battery, uint16_t count)
+{
+  memset(battery, 0, sizeof(*battery));
+  battery->cycleCount = count;
+  battery->terminalVoltage = count;
+  battery->remainingCapacity = (uint16_t)~count;
+  memset(battery->name, 'a' + count % 26, sizeof(battery->name) - 1);
+}
+
+static int TestConsistent(const sbs_shm_reading_t *reading)
+{
+  const sbs_smb_battery_t *battery = &reading->battery;
+  uint16_t inverted = ~battery->cycleCount;
+
+  if (battery->terminalVoltage != battery->cycleCount || battery->remainingCapacity != inverted ||
+      (uint16_t)(reading->sequence - 1) != battery->cycleCount)
+    return 0;
+
+  for (size_t i = 0; i < sizeof(battery->name) - 1; i++)
+    if (battery->name[i] != 'a' + battery->cycleCount % 26)
+      return 0;
+
+  return 1;
+}
+
+static void *TestWriter(void *arg)
+{
+  test_shm_writer_t *writer = (test_shm_writer_t *)arg;
+  sbs_smb_battery_t battery;
+
+  for (uint32_t i = 0; i < TEST_SHM_PUBLISHES; i++)
+  {
+    TestFill(&battery, (uint16_t)i);
+    SBSShmPublish(writer->shm, 1, "writer", &battery, SMBUS_ERR_OK);
+  }
+
+  writer->done = 1;
+  return NULL;
+}
+
+// A reader sees what was published, with the pointers that mean nothing in another process cleared
+static void TestPublish(sbs_shm_t *shm, sbs_shm_t *reader)
+{
+  sbs_smb_battery_t battery;
+  sbs_shm_reading_t reading;
+
+  SBS_TEST_CHECK_EQ(SBSShmSlotCount(reader), TEST_SHM_SLOTS);
+  SBS_TEST_CHECK_EQ(SBSShmRead(reader, 0, &reading), SMBUS_ERR_FAIL);
+  SBS_TEST_CHECK_EQ(SBSShmSequence(reader, 0), 0);
+  SBS_TEST_CHECK_EQ(SBSShmRead(reader, TEST_SHM_SLOTS, &reading), SMBUS_ERR_INVALID_ARG);
+
+  TestFill(&battery, 7);
+  battery.bus = (smbus_handle_t)&battery;
+  battery.cache = (sbs_cache_t *)&battery;
+  SBS_TEST_CHECK_EQ(SBSShmPublish(shm, 0, "bus0/0x0B", &battery, SMBUS_ERR_TIMEOUT), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(SBSShmPublish(shm, TEST_SHM_SLOTS, "bus0/0x0B", &battery, SMBUS_ERR_OK), SMBUS_ERR_INVALID_ARG);
+
+  SBS_TEST_CHECK_EQ(SBSShmRead(reader, 0, &reading), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(SBSShmSequence(reader, 0), 1);
+  SBS_TEST_CHECK_EQ(reading.sequence, 1);
+  SBS_TEST_CHECK_EQ(reading.error, SMBUS_ERR_TIMEOUT);
+  SBS_TEST_CHECK(strcmp(reading.label, "bus0/0x0B") == 0);
+  SBS_TEST_CHECK(reading.timestampMs != 0);
+  SBS_TEST_CHECK(reading.battery.bus == NULL && reading.battery.cache == NULL);
+  SBS_TEST_CHECK(TestConsistent(&reading) == 0);    // Sequence 1 against a count of 7
+  SBS_TEST_CHECK_EQ(reading.battery.cycleCount, 7);
+
+  SBSShmPublish(shm, 0, NULL, &battery, SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(SBSShmRead(reader, 0, &reading), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(reading.sequence, 2);
+  SBS_TEST_CHECK(strcmp(reading.label, "bus0/0x0B") == 0);
+}
+
+// A reader polling while the slot is republished never gets a mix of two publishes
+static void TestConcurrent(sbs_shm_t *shm, sbs_shm_t *reader)
+{
+  test_shm_writer_t writer = { shm, 0 };
+  sbs_shm_reading_t reading;
+  uint32_t reads = 0, torn = 0, last = 0, backwards = 0;
+  pthread_t thread;
+
+  SBS_TEST_CHECK_EQ(pthread_create(&thread, NULL, TestWriter, &writer), 0);
+
+  while (!writer.done)
+  {
+    if (SBSShmRead(reader, 1, &reading) != SMBUS_ERR_OK)
+      continue;
+
+    reads++;
+    if (!TestConsistent(&reading))
+      torn++;
+    if (reading.sequence < last)
+      backwards++;
+    last = reading.sequence;
+  }
+
+  pthread_join(thread, NULL);
+
+  SBS_TEST_CHECK(reads > 0);
+  SBS_TEST_CHECK_EQ(torn, 0);
+  SBS_TEST_CHECK_EQ(backwards, 0);
+  SBS_TEST_CHECK_EQ(SBSShmSequence(reader, 1), TEST_SHM_PUBLISHES);
+  SBS_TEST_CHECK_EQ(SBSShmRead(reader, 1, &reading), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(TestConsistent(&reading));
+}
+
+int main(void)
+{
+  char name[32];
+
+  snprintf(name, sizeof(name), "/sbs_test_shm_%d", (int)getpid());
+
+  sbs_shm_t *shm = SBSShmCreate(name, TEST_SHM_SLOTS);
+  sbs_shm_t *reader = SBSShmOpen(name);
+
+  SBS_TEST_CHECK(shm != NULL && reader != NULL);
+  if (shm && reader)
+  {
+    TestPublish(shm, reader);
+    TestConcurrent(shm, reader);
+  }
+
+  SBSShmClose(reader);
+  SBSShmClose(shm);
+  SBS_TEST_CHECK_EQ(SBSShmUnlink(name), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(SBSShmOpen(name) == NULL);
+
+  return SBS_TEST_RESULT();
+}
@@ -0,0 +1,126 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_telemetry.h"
+
+static void TestBattery(sbs_smb_battery_t *battery)
+{
+  memset(battery, 0, sizeof(*battery));
+  battery->serialNumber = 0x1234;
+  battery->manufactureDate.day = 15;
+  battery->manufactureDate.month = 3;
+  battery->manufactureDate.year = 2024;
+  battery->specInfo.vScale = 1;
+  battery->specInfo.iScale = 10;
+  strcpy(battery->name, "bq40z50");
+  strcpy(battery->chemistry, "LION");
+  strcpy(battery->manufacturer, "TI");
+  battery->status.initialized = true;
+  battery->temperatureDeciK = 2981;
+  battery->terminalVoltage = 12000;
+  battery->relativeStateOfCharge = 87;
+  battery->remainingCapacity = 4000;
+  battery->cycleCount = 12;
+  battery->chargingVoltage = 12600;
+  battery->chargingCurrent = 2000;
+}
+
+// The first snapshot is a SESSION frame followed by a DATA frame with every field
+static void TestFirstSnapshot(void)
+{
+  static const uint8_t expected[] = {
+    SBS_TELEMETRY_FRAME_SESSION, 7, 24,
+    0x34, 0x12, 0x6F, 0x58, 1, 0, 10, 0,
+    7, 'b', 'q', '4', '0', 'z', '5', '0', 4, 'L', 'I', 'O', 'N', 2, 'T', 'I',
+    SBS_TELEMETRY_FRAME_DATA, 7, 16,
+    SBS_TELEMETRY_FIELD_ALL,
+    0x80, 0x00,               // INITIALIZED
+    0xA5, 0x0B,               // 2981
+    0xE0, 0x2E,               // 12000
+    87,
+    0xA0, 0x0F,               // 4000
+    12, 0,
+    0x38, 0x31,               // 12600
+    0xD0, 0x07,               // 2000
+  };
+  sbs_telemetry_t ctx;
+  sbs_smb_battery_t battery;
+  uint8_t buff[SBS_TELEMETRY_MAX_SNAPSHOT_SIZE];
+  size_t len;
+
+  TestBattery(&battery);
+  SBSTelemetryInit(&ctx, 7);
+
+  SBS_TEST_CHECK_EQ(SBSTelemetryEncode(&ctx, &battery, buff, sizeof(buff), &len), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(len, sizeof(expected));
+  SBS_TEST_CHECK(len == sizeof(expected) && !memcmp(buff, expected, len));
+}
+
+// Later snapshots carry only the fields that changed, and nothing at all if none did
+static void TestChangedFields(void)
+{
+  sbs_telemetry_t ctx;
+  sbs_smb_battery_t battery;
+  uint8_t buff[SBS_TELEMETRY_MAX_SNAPSHOT_SIZE];
+  size_t len;
+
+  TestBattery(&battery);
+  SBSTelemetryInit(&ctx, 1);
+  SBSTelemetryEncode(&ctx, &battery, buff, sizeof(buff), &len);
+
+  SBS_TEST_CHECK_EQ(SBSTelemetryEncode(&ctx, &battery, buff, sizeof(buff), &len), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(len, 0);
+
+  battery.relativeStateOfCharge = 86;
+  battery.terminalVoltage = 11990;
+  SBS_TEST_CHECK_EQ(SBSTelemetryEncode(&ctx, &battery, buff, sizeof(buff), &len), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(len, SBS_TELEMETRY_FRAME_HEADER_SIZE + 4);
+  SBS_TEST_CHECK_EQ(buff[0], SBS_TELEMETRY_FRAME_DATA);
+  SBS_TEST_CHECK_EQ(buff[2], 4);
+  SBS_TEST_CHECK_EQ(buff[3], SBS_TELEMETRY_FIELD_VOLTAGE | SBS_TELEMETRY_FIELD_RELATIVE_SOC);
+  SBS_TEST_CHECK_EQ(buff[4] | (buff[5] << 8), 11990);
+  SBS_TEST_CHECK_EQ(buff[6], 86);
+
+  // A reset resends the SESSION frame and every field
+  SBSTelemetryReset(&ctx);
+  SBS_TEST_CHECK_EQ(SBSTelemetryEncode(&ctx, &battery, buff, sizeof(buff), &len), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(buff[0], SBS_TELEMETRY_FRAME_SESSION);
+  SBS_TEST_CHECK_EQ(buff[SBS_TELEMETRY_FRAME_HEADER_SIZE + buff[2] + SBS_TELEMETRY_FRAME_HEADER_SIZE], SBS_TELEMETRY_FIELD_ALL);
+}
+
+// Snapshots that don't fit leave the buffer and the context as they were
+static void TestBatchOverflow(void)
+{
+  sbs_telemetry_t ctx[2], *ctxList[2] = {&ctx[0], &ctx[1]};
+  sbs_smb_battery_t battery[2];
+  const sbs_smb_battery_t *batteryList[2] = {&battery[0], &battery[1]};
+  uint8_t buff[80];
+  size_t len, first;
+  uint16_t encoded;
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    TestBattery(&battery[i]);
+    SBSTelemetryInit(&ctx[i], i);
+  }
+
+  SBS_TEST_CHECK_EQ(SBSTelemetryEncodeBatch(ctxList, batteryList, 2, buff, sizeof(buff), &len, &encoded), SMBUS_ERR_FAIL);
+  SBS_TEST_CHECK_EQ(encoded, 1);
+  SBS_TEST_CHECK(ctx[0].sessionSent);
+  SBS_TEST_CHECK(!ctx[1].sessionSent);
+  first = len;
+
+  SBS_TEST_CHECK_EQ(SBSTelemetryEncodeBatch(ctxList, batteryList, 2, buff, sizeof(buff), &len, &encoded), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(encoded, 2);
+  SBS_TEST_CHECK_EQ(len, first);
+  SBS_TEST_CHECK_EQ(buff[1], 1);
+}
+
+int main(void)
+{
+  TestFirstSnapshot();
+  TestChangedFields();
+  TestBatchOverflow();
+  return SBS_TEST_RESULT();
+}
@@ -0,0 +1,73 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sbs_test.h"
+#include "sbs_smb.h"
+#include "sbs_units.h"
+#include "smbus_sim.h"
+
+#define TEST_UNITS_CAPACITY_MODE        0x8000      // BatteryMode() CAPACITY_MODE bit
+
+// Raw words are scaled with integer maths only, by the kind of value each command returns
+static void TestConvert(void)
+{
+  sbs_smb_spec_info_t spec = { .vScale = 10, .iScale = 100 };
+  sbs_smb_spec_info_t unscaled = { .vScale = 0, .iScale = 0 };
+
+  SBS_TEST_CHECK_EQ(SBSUnitsConvert(SBS_SMB_CMD_CODE_VOLTAGE, 1200, &spec, SBS_SMB_CAPACITY_UNIT_CURRENT), 12000);
+  SBS_TEST_CHECK_EQ(SBSUnitsConvert(SBS_SMB_CMD_CODE_VOLTAGE, 1200, &unscaled, SBS_SMB_CAPACITY_UNIT_CURRENT), 1200);
+  SBS_TEST_CHECK_EQ(SBSUnitsConvert(SBS_SMB_CMD_CODE_CURRENT, (uint16_t)-5, &spec, SBS_SMB_CAPACITY_UNIT_CURRENT), -500);
+  SBS_TEST_CHECK_EQ(SBSUnitsConvert(SBS_SMB_CMD_CODE_CHARGING_CURRENT, 0xFFFF, &unscaled, SBS_SMB_CAPACITY_UNIT_CURRENT),
+                    0xFFFF);
+  SBS_TEST_CHECK_EQ(SBSUnitsConvert(SBS_SMB_CMD_CODE_REMAINING_CAPACITY, 40, &spec, SBS_SMB_CAPACITY_UNIT_CURRENT), 4000);
+  SBS_TEST_CHECK_EQ(SBSUnitsConvert(SBS_SMB_CMD_CODE_REMAINING_CAPACITY, 40, &spec, SBS_SMB_CAPACITY_UNIT_POWER), 40000);
+  SBS_TEST_CHECK_EQ(SBSUnitsConvert(SBS_SMB_CMD_CODE_TEMPERATURE, 2981, &spec, SBS_SMB_CAPACITY_UNIT_CURRENT), 2495);
+  SBS_TEST_CHECK_EQ(SBSUnitsConvert(SBS_SMB_CMD_CODE_TEMPERATURE, 2500, &spec, SBS_SMB_CAPACITY_UNIT_CURRENT), -2315);
+  SBS_TEST_CHECK_EQ(SBSUnitsConvert(SBS_SMB_CMD_CODE_CYCLE_COUNT, 42, &spec, SBS_SMB_CAPACITY_UNIT_POWER), 42);
+}
+
+// SpecificationInfo() is read once, BatteryMode() along with every capacity so a mode change is picked up
+static void TestReadScaled(sbs_smb_battery_t *battery)
+{
+  int32_t value = 0;
+
+  SBS_TEST_CHECK_EQ(SBSReadScaled(battery, SBS_SMB_CMD_CODE_DESIGN_VOLTAGE, &value), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(value, 11100);
+  SBS_TEST_CHECK(battery->specInfo.vScale != 0);
+
+  SBS_TEST_CHECK_EQ(SBSReadScaled(battery, SBS_SMB_CMD_CODE_AVERAGE_CURRENT, &value), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(value, -500);
+
+  SBS_TEST_CHECK_EQ(SBSReadScaled(battery, SBS_SMB_CMD_CODE_FULL_CHARGE_CAPACITY, &value), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(value, 5000);
+
+  SMBusWriteWord(battery->bus, battery->busAddress, SBS_COMMAND_BATTERY_MODE, TEST_UNITS_CAPACITY_MODE);
+  SBS_TEST_CHECK_EQ(SBSReadScaled(battery, SBS_SMB_CMD_CODE_FULL_CHARGE_CAPACITY, &value), SMBUS_ERR_OK);
+  SBS_TEST_CHECK_EQ(value, 50000);
+  SBS_TEST_CHECK_EQ(battery->mode.capacityUnit, SBS_SMB_CAPACITY_UNIT_POWER);
+  SMBusWriteWord(battery->bus, battery->busAddress, SBS_COMMAND_BATTERY_MODE, 0);
+
+  SBS_TEST_CHECK_EQ(SBSReadScaled(battery, SBS_SMB_CMD_CODE_TEMPERATURE, &value), SMBUS_ERR_OK);
+  SBS_TEST_CHECK(value > 2000 && value < 3000);
+
+  SBS_TEST_CHECK_EQ(SBSReadScaled(battery, SBS_SMB_CMD_CODE_CYCLE_COUNT, &value), SMBUS_ERR_INVALID_ARG);
+}
+
+int main(void)
+{
+  sbs_smb_battery_t battery;
+
+  TestConvert();
+
+  memset(&battery, 0, sizeof(battery));
+  battery.bus = SMBusInit(SMBUS_SIM_PORT_NAME, 0, 0, -1, -1, -1, 1000, false);
+  battery.busAddress = 0x0B;
+  SBS_TEST_CHECK(battery.bus != NULL);
+  if (battery.bus)
+  {
+    TestReadScaled(&battery);
+    SMBusDeinit(battery.bus);
+  }
+
+  return SBS_TEST_RESULT();
+}